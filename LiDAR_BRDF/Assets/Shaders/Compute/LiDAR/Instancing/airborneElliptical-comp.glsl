@@ -18,14 +18,12 @@ layout (local_size_variable) in;
 
 layout (std430, binding = 0) buffer RayBuffer			{ RayGPUData rayData[]; };
 layout (std430, binding = 1) buffer WaypointBuffer		{ vec4 waypoints[]; };
-layout (std430, binding = 2) buffer NoiseBuffer			{ float noiseBuffer[]; };
 
 uniform float	ellipseRadius;
 uniform float	ellipseScale;
 uniform float	heightJittering;
 uniform float	heightRadius;
 uniform float	incrementRadians;
-uniform uint	noiseBufferSize;
 uniform uint	numPulses;
 uniform uint	numThreads;
 uniform uint	pathLength;
@@ -33,12 +31,13 @@ uniform float	pulseIncrement;
 uniform float	pulseRadius;
 uniform float	rayJittering;
 uniform uint	raysPulse;
+uniform uint	seed;
 uniform uint	threadOffset;
 
 
 float getUniformRandomValue(const uint index, const uint offset)
 {
-	return noiseBuffer[(index + offset) % noiseBufferSize];
+	return getCounterRandomValue(seed, index, offset) * 2.0f - 1.0f;
 }
 
 void main()
@@ -16,11 +16,9 @@ layout (local_size_variable) in;
 
 layout (std430, binding = 0) buffer RayBuffer			{ RayGPUData rayData[]; };
 layout (std430, binding = 1) buffer WaypointBuffer		{ vec4 waypoints[]; };
-layout (std430, binding = 2) buffer NoiseBuffer			{ float noiseBuffer[]; };
 
 uniform float	heightJittering;
 uniform float	incrementRadians;
-uniform uint	noiseBufferSize;
 uniform uint	numPulses;
 uniform uint	numThreads;
 uniform uint	offset;
@@ -29,13 +27,14 @@ uniform float	pulseRadius;
 uniform uint	raysPulse;
 uniform float	rayJittering;
 uniform float	startRadians;
+uniform uint	seed;
 uniform uint	threadOffset;
 uniform uint	zigzag;
 
 
 float getUniformRandomValue(const uint index, const uint offset)
 {
-	return noiseBuffer[(index + offset) % noiseBufferSize];
+	return getCounterRandomValue(seed, index, offset) * 2.0f - 1.0f;
 }
 
 void main()
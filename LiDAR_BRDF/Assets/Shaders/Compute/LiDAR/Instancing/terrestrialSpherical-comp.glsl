@@ -15,8 +15,7 @@ layout (local_size_variable) in;
 
 layout (std430, binding = 0) buffer ChannelPosBuffer	{ vec4 channelPosition[]; };
 layout (std430, binding = 1) buffer RayBuffer			{ RayGPUData rayData[]; };
-layout (std430, binding = 2) buffer NoiseBuffer			{ float noiseBuffer[]; };
-layout (std430, binding = 3) buffer VerticalAngleBuffer { float verticalAngleIncrement[]; };
+layout (std430, binding = 2) buffer VerticalAngleBuffer { float verticalAngleIncrement[]; };
 
 uniform vec3	advance;
 uniform float	angleJittering;
@@ -24,12 +23,12 @@ uniform float	axisJittering;
 uniform float	channelSpacing;
 uniform vec2	fovRadians;
 uniform vec2	incrementRadians;
-uniform uint	noiseBufferSize;
 uniform uint	numChannels;
 uniform uint	numThreads;
 uniform vec3	position;
 uniform float	pulseRadius;
 uniform uint	raysPulse;
+uniform uint	seed;
 uniform float	startRadians;
 uniform float	startingAngleVertical;
 uniform uint	threadOffset;
@@ -39,7 +38,7 @@ uniform int		verticalRes;
 
 float getUniformRandomValue(const uint index, const uint offset)
 {
-	return noiseBuffer[(index + offset) % noiseBufferSize];
+	return getCounterRandomValue(seed, index, offset) * 2.0f - 1.0f;
 }
 
 void main()
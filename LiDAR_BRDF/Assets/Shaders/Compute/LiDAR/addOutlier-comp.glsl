@@ -5,6 +5,7 @@ layout (local_size_variable) in;
 
 #define DISTANCE_NOISE_OFFSET 0xFCBA23
 #define NOISE_OFFSET 0x234578
+#define RETURN_NOISE_STRIDE 0x1000000
 								
 #include <Assets/Shaders/Compute/Templates/constraints.glsl>
 #include <Assets/Shaders/Compute/Templates/modelStructs.glsl>
@@ -12,15 +13,15 @@ layout (local_size_variable) in;
 
 layout (std430, binding = 0) buffer RayBuffer		{ RayGPUData				rayData[]; };
 layout (std430, binding = 1) buffer CollisionBuffer	{ TriangleCollisionGPUData	faceCollision[]; };
-layout (std430, binding = 2) buffer NoiseBuffer		{ float						noiseBuffer[]; };
-layout (std430, binding = 3) buffer CountBuffer		{ uint						numCollisions; };
-layout (std430, binding = 4) buffer NewCountBuffer	{ uint						newCollisions; };
+layout (std430, binding = 2) buffer CountBuffer		{ uint						numCollisions; };
+layout (std430, binding = 3) buffer NewCountBuffer	{ uint						newCollisions; };
 
-uniform uint		noiseBufferSize;
 uniform vec2		noiseRange;
 uniform float		noiseThreshold;
+uniform uint		globalRayOffset;			// Index of the first ray of this batch in the whole simulation
 uniform uint		nullModelCompID;
 uniform uint		numPulses;
+uniform uint		seed;
 
 #define NORMALIZE_NOISE(n) (n * (noiseRange.y - noiseRange.x) + noiseRange.x)
 
@@ -29,19 +30,23 @@ void main()
 	const uint index = gl_GlobalInvocationID.x;
 	if (index >= newCollisions) return;
 
-	const uint rayIndex = faceCollision[numCollisions - newCollisions + index].rayIndex;
+	const uint collisionIndex = numCollisions - newCollisions + index;
+	const uint rayIndex = faceCollision[collisionIndex].rayIndex;
 
-	if (faceCollision[index].rayIndex != UINT_MAX)
+	if (rayIndex != UINT_MAX)
 	{
+		// Keyed by the ray and return which produced the collision, as in reduceCollisions
+		const uint noiseIndex		= globalRayOffset + rayIndex;
+		const uint noiseStream		= faceCollision[collisionIndex].returnNumber * RETURN_NOISE_STRIDE;
 		const vec3 rayDirection		= normalize(rayData[rayIndex].previousDirection);
-		const vec3 collisionPoint	= faceCollision[numCollisions - newCollisions + index].point;
+		const vec3 collisionPoint	= faceCollision[collisionIndex].point;
 		const float maxDistance		= distance(rayData[rayIndex].startingPoint, collisionPoint);		// Max. parametric t
-		const float noise			= noiseBuffer[(index + NOISE_OFFSET) % noiseBufferSize];
+		const float noise			= getCounterRandomValue(seed, noiseIndex, NOISE_OFFSET + noiseStream);
 
 		if ((noise * 2.0f - 1.0f) > noiseThreshold)
 		{
 			const uint finalIndex	= atomicAdd(numCollisions, 1);
-			const float noiseDist	= noiseBuffer[(index + DISTANCE_NOISE_OFFSET) % noiseBufferSize] * 1.5f;
+			const float noiseDist	= getCounterRandomValue(seed, noiseIndex, DISTANCE_NOISE_OFFSET + noiseStream) * 1.5f;
 			const float distance	= NORMALIZE_NOISE(noiseDist) * maxDistance;
 
 			faceCollision[finalIndex].point				= rayData[rayIndex].startingPoint + rayDirection * distance;
@@ -18,12 +18,15 @@ layout (std430, binding = 5) buffer CollisionBuffer	{ TriangleCollisionGPUData	r
 layout (std430, binding = 6) buffer CountBuffer		{ uint						numCollisions; };
 layout (std430, binding = 7) buffer BRDFBuffer		{ float						brdfData[]; };
 layout (std430, binding = 8) buffer HermiteBuffer	{ float						hermiteTensor[]; };
+layout (std430, binding = 9) buffer SpectralBuffer	{ float						spectralIntensity[]; };
 
 uniform float		atmosphericAttenuation;
 uniform uint		bathymetric;
+uniform uint		materialOffset;					// First material of the spectral band whose BRDF is sampled
 uniform uint		numRaysPulse;
 uniform float		reflectanceWeight;
 uniform float		sensorDiameter;
+uniform uint		spectralOutput;					// Intensity is written into spectralIntensity instead of the collision
 uniform float		systemAttenuation;
 uniform float		waterHeight;
 
@@ -75,7 +78,7 @@ float reflectIrradiance(const uint index, const vec2 KdKs, const RayGPUData ray)
 	const vec3 L = normalize(ray.origin - rayCollision[index].point);
 	const float y_dot = abs(dot(L, N));
 
-	uint materialID = meshData[rayCollision[index].modelCompID].materialID;
+	uint materialID = meshData[rayCollision[index].modelCompID].materialID + materialOffset;
 	float y = (abs(dot(L, N)) * PI / 2.0f) * 180.0f / PI, x = ((atan(L.z, L.x) + PI / 2.0f) * 2.0f) * 180.0f / PI;
 	
 	return clamp(getHermiteInterpolation(materialID, x, y), .0f, 1.0f);
@@ -88,13 +91,19 @@ void main()
 
 	const float brdfFactor			= reflectIrradiance(index, vec2(1.0f), rayData[rayCollision[index].rayIndex]);
 	const uint previousCollision	= rayCollision[index].previousCollision;
+	float intensity;
 
 	if (previousCollision != UINT_MAX && (meshData[rayCollision[previousCollision].modelCompID].surface & WATER_MASK) != 0 && bathymetric == 1)
 	{
-		rayCollision[index].intensity = computeBathymetricIntensity(index, brdfFactor, rayData[rayCollision[index].rayIndex]);
+		intensity = computeBathymetricIntensity(index, brdfFactor, rayData[rayCollision[index].rayIndex]);
 	}
 	else
 	{
-		rayCollision[index].intensity = computeIntensity(index, brdfFactor, rayData[rayCollision[index].rayIndex]);
+		intensity = computeIntensity(index, brdfFactor, rayData[rayCollision[index].rayIndex]);
 	}
+
+	if (spectralOutput == 1)
+		spectralIntensity[index] = intensity;
+	else
+		rayCollision[index].intensity = intensity;
 }
\ No newline at end of file
@@ -6,32 +6,45 @@ layout (local_size_variable) in;
 #include <Assets/Shaders/Compute/Templates/constraints.glsl>
 #include <Assets/Shaders/Compute/Templates/modelStructs.glsl>
 
+#define INSTANCE_FLAG 0x80000000u
+
 layout (std430, binding = 0) buffer ClusterBuffer	{ BVHCluster				clusterData[]; };
 layout (std430, binding = 1) buffer VertexBuffer	{ VertexGPUData				vertexData[]; };
 layout (std430, binding = 2) buffer FaceBuffer		{ FaceGPUData				faceData[]; };
 layout (std430, binding = 3) buffer MeshDataBuffer	{ MeshGPUData				meshData[]; };
 layout (std430, binding = 4) buffer RayBuffer		{ RayGPUData				rayData[]; };
 layout (std430, binding = 5) buffer CollisionBuffer	{ TriangleCollisionGPUData	faceCollision[]; };
+layout (std430, binding = 6) buffer RayHitsBuffer	{ RayHitGPUData				rayHits[]; };
+layout (std430, binding = 7) buffer NodeVisitBuffer	{ uint						nodeVisits; };
+layout (std430, binding = 8) buffer InstanceBuffer	{ InstanceGPUData			instanceData[]; };
+layout (std430, binding = 9) buffer LeafFaceBuffer	{ uint						leafFace[]; };
 
+uniform uint		countNodeVisits;				// Visited BVH nodes are accumulated into nodeVisits
+uniform float		maxDistance;					// Maximum range plus its upper soft boundary
 uniform uint		numClusters;					// Start traversal from last cluster (root)
 uniform uint		numRays;
+uniform uint		reuseHits;						// Hits from a previous traversal are reused if the ray was neither moved nor deviated
+
+float	hitDistance;
+uint	hitFace;
+uint	hitInstance;
 
 
-// Computes intersection between a ray and an axis-aligned bounding box. Slabs method
-bool rayAABBIntersection(in RayGPUData ray, vec3 minPoint, vec3 maxPoint, float currentMinDistance)
+// Computes intersection between a ray and an axis-aligned bounding box. Slabs method. Boxes behind the origin or starting beyond currentMinDistance are discarded
+bool rayAABBIntersection(in RayGPUData ray, vec3 inverseDirection, vec3 minPoint, vec3 maxPoint, float currentMinDistance, out float tNear)
 {
-	vec3 tMin	= (minPoint - ray.origin) / ray.direction;
-    vec3 tMax	= (maxPoint - ray.origin) / ray.direction;
+	vec3 tMin	= (minPoint - ray.origin) * inverseDirection;
+    vec3 tMax	= (maxPoint - ray.origin) * inverseDirection;
     vec3 t1		= min(tMin, tMax);
     vec3 t2		= max(tMin, tMax);
-    float tNear = max(max(t1.x, t1.y), t1.z);
     float tFar	= min(min(t2.x, t2.y), t2.z);
+    tNear		= max(max(t1.x, t1.y), t1.z);
 
-    return tFar >= tNear;
+    return tFar >= max(tNear, .0f) && tNear <= currentMinDistance;
 }
 
-// Computes intersection between a ray and a triangle
-bool rayTriangleIntersection(const uint index, in FaceGPUData face, in RayGPUData ray, in BVHCluster cluster)
+// Computes intersection between a ray and a triangle. Returns the parametric value of the intersection, if any
+bool rayTriangleIntersection(in FaceGPUData face, in RayGPUData ray, out float t)
 {
 	const VertexGPUData v1 = vertexData[face.vertices.x + meshData[face.modelCompID].startIndex], 
 						v2 = vertexData[face.vertices.y + meshData[face.modelCompID].startIndex],
@@ -69,25 +82,49 @@ bool rayTriangleIntersection(const uint index, in FaceGPUData face, in RayGPUDat
 		return false;
 	}
 
-	float t = f * dot(edge2, q);
+	t = f * dot(edge2, q);
+
+	return t >= -EPSILON;				// There is a LINE intersection but no RAY intersection otherwise
+}
+
+// Keeps the nearest hit. Hits at the same distance keep their traversal order, e.g. fragments of a split face which are reached from several leaves
+void updateHit(const float t, const uint faceIndex, const uint instanceIndex)
+{
+	if (t >= hitDistance) return;
+
+	hitDistance	= t;
+	hitFace		= faceIndex;
+	hitInstance	= instanceIndex;
+}
+
+// Fills the collision of a ray from a gathered hit. Faces of instances belong to their prototype, whereas model components are those of the instance
+void setCollision(const uint index, in RayGPUData ray, const float t, const uint faceIndex, const uint instanceIndex)
+{
 	vec3 intersectionPoint = ray.origin + ray.direction * t;
-	float distanceToOrigin = distance(ray.origin, intersectionPoint);
 
-	if (t >= -EPSILON && t < faceCollision[index].distance)
+	faceCollision[index].point			= intersectionPoint;
+	faceCollision[index].normal			= faceData[faceIndex].normal;
+	faceCollision[index].distance		= distance(ray.origin, intersectionPoint);	
+	faceCollision[index].faceIndex		= faceIndex;			
+	faceCollision[index].modelCompID	= faceData[faceIndex].modelCompID;
+	faceCollision[index].returnNumber	= ray.returnNumber;
+	faceCollision[index].tangent		= ray.direction;
+
+	if (instanceIndex != UINT_MAX)
 	{
-		faceCollision[index].point			= intersectionPoint;
-		faceCollision[index].normal			= face.normal;
-		faceCollision[index].tangent		= normalize(ray.direction);
-		faceCollision[index].distance		= distanceToOrigin;	
-		faceCollision[index].faceIndex		= cluster.faceIndex;			
-		faceCollision[index].modelCompID	= face.modelCompID;
-		faceCollision[index].returnNumber	= ray.returnNumber;
-		faceCollision[index].tangent		= ray.direction;
-
-		return true;
+		faceCollision[index].normal			= normalize(transpose(mat3(instanceData[instanceIndex].inverseTransform)) * faceData[faceIndex].normal);
+		faceCollision[index].modelCompID	= instanceData[instanceIndex].modelCompOffset + faceData[faceIndex].modelCompID - instanceData[instanceIndex].prototypeCompOffset;
 	}
+}
+
+// Reuses the nearest hit of a ray which was neither moved nor deviated since it was found, as a new traversal would find it again. Returns false if the ray must be traversed again
+bool consumeHit(const uint index, in RayGPUData ray)
+{
+	if (rayHits[index].origin != ray.origin || rayHits[index].direction != ray.direction) return false;
 
-	return false;							// There is a LINE intersection but no RAY intersection
+	if (rayHits[index].faceIndex != UINT_MAX) setCollision(index, ray, rayHits[index].distance, rayHits[index].faceIndex, rayHits[index].instanceIndex);
+
+	return true;
 }
 
 
@@ -107,31 +144,121 @@ void main()
 	// Ray could be not active
 	if (rayData[index].continueRay == 0) return; 
 
+	const RayGPUData ray = rayData[index];
+	if (reuseHits == 1 && consumeHit(index, ray)) return;
+
+	const vec3	inverseDirection	= 1.0f / ray.direction;
+
 	// Initialize stack
-	bool	collided			= false;
-	int		currentIndex		= 0;
-	uint	toExplore[200];
+	int		currentIndex		= -1;
+	uint	toExplore[200], toExploreInstance[200];
+	float	toExploreDistance[200];
+	float	t, tNear1, tNear2, bestDistance;
+	uint	localVisits			= 0;
+
+	// Nodes below an instance are tested against the ray in the space of its prototype. Directions are not normalized, so distances are preserved
+	RayGPUData	localRay				= ray;
+	vec3		localInverseDirection	= inverseDirection;
+	uint		currentInstance			= UINT_MAX, clusterIndex, instanceIndex;
+	float		clusterDistance;
+
+	// Refracted rays travel away from the starting point, hence this bound is conservative regarding the range checked in reduceCollisions
+	hitDistance	= maxDistance + distance(ray.startingPoint, ray.origin);
+	hitFace		= UINT_MAX;
+	hitInstance	= UINT_MAX;
 
-	toExplore[currentIndex] = numClusters - 1;			// First node to explore: root
+	if (rayAABBIntersection(ray, inverseDirection, clusterData[numClusters - 1].minPoint, clusterData[numClusters - 1].maxPoint, hitDistance, tNear1))
+	{
+		toExplore[++currentIndex]		= numClusters - 1;				// First node to explore: root
+		toExploreInstance[currentIndex]	= UINT_MAX;
+		toExploreDistance[currentIndex] = tNear1;
+	}
 
 	while (currentIndex >= 0)
 	{
-		BVHCluster cluster = clusterData[toExplore[currentIndex]];
+		// Nodes are culled again as the nearest hit may have been updated since they were pushed
+		bestDistance		= hitDistance;
+		clusterIndex		= toExplore[currentIndex];
+		instanceIndex		= toExploreInstance[currentIndex];
+		clusterDistance		= toExploreDistance[currentIndex--];
 
-		if (rayAABBIntersection(rayData[index], cluster.minPoint, cluster.maxPoint, faceCollision[index].distance))
+		if (clusterDistance > bestDistance) continue;
+
+		if (instanceIndex != currentInstance)
 		{
-			if (cluster.faceIndex != UINT_MAX)
+			currentInstance		= instanceIndex;
+			localRay.origin		= ray.origin;
+			localRay.direction	= ray.direction;
+
+			if (currentInstance != UINT_MAX)
 			{
-				rayTriangleIntersection(index, faceData[cluster.faceIndex], rayData[index], cluster);
+				localRay.origin		= vec3(instanceData[currentInstance].inverseTransform * vec4(ray.origin, 1.0f));
+				localRay.direction	= mat3(instanceData[currentInstance].inverseTransform) * ray.direction;
 			}
-			else
+
+			localInverseDirection = 1.0f / localRay.direction;
+		}
+
+		BVHCluster cluster = clusterData[clusterIndex];
+		++localVisits;
+
+		if ((cluster.faceIndex & INSTANCE_FLAG) != 0)
+		{
+			// Instance leaf: its world-space box was already intersected, hence the traversal goes on with the root of its prototype
+			toExplore[++currentIndex]		= instanceData[cluster.faceIndex & ~INSTANCE_FLAG].blasRoot;
+			toExploreInstance[currentIndex]	= cluster.faceIndex & ~INSTANCE_FLAG;
+			toExploreDistance[currentIndex] = clusterDistance;
+		}
+		else if (cluster.faceIndex != UINT_MAX)
+		{
+			// Faces of a leaf are contiguous in the leaf faces buffer
+			for (uint faceIdx = cluster.faceIndex; faceIdx < cluster.faceIndex + cluster.numFaces; ++faceIdx)
 			{
-				toExplore[currentIndex]		= cluster.prevIndex1;
-				toExplore[++currentIndex]	= cluster.prevIndex2;
-				++currentIndex;												// Prevent --currentIndex instead of branching
+				if (rayTriangleIntersection(faceData[leafFace[faceIdx]], localRay, t)) updateHit(t, leafFace[faceIdx], currentInstance);
 			}
 		}
+		else
+		{
+			const bool intersect1 = rayAABBIntersection(localRay, localInverseDirection, clusterData[cluster.prevIndex1].minPoint, clusterData[cluster.prevIndex1].maxPoint, bestDistance, tNear1);
+			const bool intersect2 = rayAABBIntersection(localRay, localInverseDirection, clusterData[cluster.prevIndex2].minPoint, clusterData[cluster.prevIndex2].maxPoint, bestDistance, tNear2);
 
-		--currentIndex;
+			// The farthest child is pushed first so that the nearest one is explored next
+			if (intersect1 && intersect2 && tNear1 < tNear2)
+			{
+				toExplore[++currentIndex]		= cluster.prevIndex2;
+				toExploreInstance[currentIndex]	= currentInstance;
+				toExploreDistance[currentIndex] = tNear2;
+				toExplore[++currentIndex]		= cluster.prevIndex1;
+				toExploreInstance[currentIndex]	= currentInstance;
+				toExploreDistance[currentIndex] = tNear1;
+			}
+			else
+			{
+				if (intersect1)
+				{
+					toExplore[++currentIndex]		= cluster.prevIndex1;
+					toExploreInstance[currentIndex]	= currentInstance;
+					toExploreDistance[currentIndex] = tNear1;
+				}
+
+				if (intersect2)
+				{
+					toExplore[++currentIndex]		= cluster.prevIndex2;
+					toExploreInstance[currentIndex]	= currentInstance;
+					toExploreDistance[currentIndex] = tNear2;
+				}
+			}
+		}
 	}
+
+	if (countNodeVisits == 1) atomicAdd(nodeVisits, localVisits);
+
+	// Nearest hit is saved for the following returns
+	rayHits[index].origin			= ray.origin;
+	rayHits[index].direction		= ray.direction;
+	rayHits[index].distance			= hitDistance;
+	rayHits[index].faceIndex		= hitFace;
+	rayHits[index].instanceIndex	= hitInstance;
+
+	if (hitFace != UINT_MAX) setCollision(index, ray, hitDistance, hitFace, hitInstance);
 }
\ No newline at end of file
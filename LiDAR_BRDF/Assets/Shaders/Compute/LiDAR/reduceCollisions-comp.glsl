@@ -24,6 +24,7 @@ layout (local_size_variable) in;
 #define MODEL_COMP_NOISE_OFFSET 0xAC987
 #define POINT_NOISE_OFFSET		0xAC666
 #define TERRAIN_NOISE_OFFSET	uvec2(0x56789, 0x65432)
+#define RETURN_NOISE_STRIDE		0x1000000							// Streams are below 2^24, hence every return draws from its own streams
 
 layout(std430, binding = 0) buffer VertexBuffer				{ VertexGPUData				vertexData[]; };
 layout(std430, binding = 1) buffer FaceBuffer				{ FaceGPUData				faceData[]; };
@@ -31,19 +32,19 @@ layout(std430, binding = 2) buffer MeshDataBuffer			{ MeshGPUData				meshData[];
 layout(std430, binding = 3) buffer MaterialBuffer			{ MaterialGPUData			materialData[]; };
 layout(std430, binding = 4) buffer RayBuffer				{ RayGPUData				rayData[]; };
 layout(std430, binding = 5) buffer CollisionBuffer			{ TriangleCollisionGPUData  rayCollision[]; };
-layout(std430, binding = 6) buffer NoiseBuffer				{ float						noiseBuffer[]; };
-layout(std430, binding = 7) buffer FinalCollisionBuffer		{ TriangleCollisionGPUData	compactCollision[]; };
-layout(std430, binding = 8) buffer CountBuffer				{ uint						numCollisions; };
+layout(std430, binding = 6) buffer FinalCollisionBuffer		{ TriangleCollisionGPUData	compactCollision[]; };
+layout(std430, binding = 7) buffer CountBuffer				{ uint						numCollisions; };
 
 uniform uint		bathymetric;
+uniform uint		globalRayOffset;			// Index of the first ray of this batch in the whole simulation
 uniform	uint		inducedTerrainError;
 uniform float		maxDistance;
 uniform vec2		maxDistanceBoundary;
 uniform uint		maxReturns;
-uniform uint		noiseBufferSize;
 uniform uint		numPulses;				
 uniform uint		numRaysPulse;
 uniform float		pulseRadius;
+uniform uint		seed;
 uniform vec3		sensorNormal;
 uniform uint		shinySurfaceError;
 
@@ -95,9 +96,10 @@ float getLossThreshold(const float ks)
 	return lossMultCoefficient * pow(ks + lossAddCoefficient, lossPower);
 }
 
-float getWhiteNoise(const uint index, const uint offset)
+// Noise of a ray is keyed by its index in the whole simulation and its current return, so that it is never repeated across batches or returns
+float getWhiteNoise(const uint rayIndex, const uint stream)
 {
-	return noiseBuffer[(index + offset) % noiseBufferSize];
+	return getCounterRandomValue(seed, globalRayOffset + rayIndex, stream + rayData[rayIndex].returnNumber * RETURN_NOISE_STRIDE);
 }
 
 void invalidateRay(uint index)
@@ -108,7 +110,7 @@ void invalidateRay(uint index)
 
 vec3 translateShinySurface(uint rayIndex, uint collisionIndex, float shininessFactor)
 {
-	const float modelCompRandom		= getWhiteNoise(rayCollision[collisionIndex].modelCompID, MODEL_COMP_NOISE_OFFSET) * SHINY_MODEL_WEIGHT;
+	const float modelCompRandom		= getCounterRandomValue(seed, rayCollision[collisionIndex].modelCompID, MODEL_COMP_NOISE_OFFSET) * SHINY_MODEL_WEIGHT;		// Bias shared by the whole model component
 	const float pointRandom			= getWhiteNoise(rayIndex, POINT_NOISE_OFFSET) * SHINY_INDIVIDUAL_ERROR;
 	const float isShiny				= float(shininessFactor > EPSILON);
 
@@ -210,7 +212,7 @@ void main()
 			if (rayCollision[collisionIndex].faceIndex != UINT_MAX)
 			{
 				uint isSameCollision = uint(distance(rayCollision[minCollisionIndex].point, rayCollision[collisionIndex].point) < allowedRadius
-										   || rayCollision[minCollisionIndex].faceIndex == rayCollision[collisionIndex].faceIndex
+										   || (rayCollision[minCollisionIndex].faceIndex == rayCollision[collisionIndex].faceIndex && rayCollision[minCollisionIndex].modelCompID == rayCollision[collisionIndex].modelCompID)
 									       || areTriangleContiguous(rayCollision[minCollisionIndex].modelCompID, rayCollision[collisionIndex].modelCompID, rayCollision[minCollisionIndex].faceIndex, rayCollision[collisionIndex].faceIndex));
 				rayData[collisionIndex].continueRay			= 1 - isSameCollision;
 				rayData[collisionIndex].lastCollisionIndex	= collisionIndex;
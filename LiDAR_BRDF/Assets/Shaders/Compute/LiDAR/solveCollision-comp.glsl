@@ -31,15 +31,14 @@ layout (std430, binding = 2) buffer MeshDataBuffer	{ MeshGPUData				meshData[];
 layout (std430, binding = 3) buffer MaterialBuffer	{ MaterialGPUData			materialData[]; };
 layout (std430, binding = 4) buffer RayBuffer		{ RayGPUData				rayData[]; };
 layout (std430, binding = 5) buffer TemporalBuffer	{ TriangleCollisionGPUData	rayCollision[]; };
-layout (std430, binding = 6) buffer NoiseBuffer		{ float						noiseBuffer[]; };
 
 uniform	uint		inducedTerrainError;
 uniform float		maxDistance;
 uniform vec2		maxDistanceBoundary;
 uniform uint		maxReturns;
-uniform uint		noiseBufferSize;
 uniform uint		numPulses;
 uniform uint		numRaysPulse;
+uniform uint		seed;
 uniform uint		shinySurfaceError;
 uniform uint		waveLength;
 
@@ -55,7 +54,7 @@ vec3 computeRayDirection(uint rayIndex, uint collisionIndex, bool isSurfaceWater
 
 float getWhiteNoise(const uint index, const uint offset)
 {
-	return noiseBuffer[(index + offset) % noiseBufferSize];
+	return getCounterRandomValue(seed, index, offset);
 }
 
 vec3 translateShinySurface(uint rayIndex, uint collisionIndex)
@@ -47,6 +47,17 @@ struct BVHCluster
 	uint	prevIndex2;
 
 	uint	faceIndex;
+	uint	numFaces;
+};
+
+struct InstanceGPUData
+{
+	mat4	transform;
+	mat4	inverseTransform;
+
+	uint	blasRoot;
+	uint	modelCompOffset;
+	uint	prototypeCompOffset;
 };
 
 struct RayGPUData 
@@ -67,6 +78,18 @@ struct RayGPUData
 	uint	continueRay;
 };
 
+struct RayHitGPUData
+{
+	vec3	origin;
+	float	distance;
+
+	vec3	direction;
+	uint	faceIndex;
+
+	uint	instanceIndex;
+	uint	padding1, padding2, padding3;
+};
+
 struct TriangleCollisionGPUData
 {
 	vec3	point;
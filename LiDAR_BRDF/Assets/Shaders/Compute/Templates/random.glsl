@@ -1,3 +1,28 @@
 float rand(vec2 ab){
     return fract(sin(dot(ab, vec2(12.9898f, 78.233f))) * 43758.5453f);
+}
+
+#define PHILOX_MULTIPLIER	0xD256D193u
+#define PHILOX_WEYL			0x9E3779B9u
+#define PHILOX_ROUNDS		10
+
+// Philox2x32-10 counter-based generator. It mirrors RandomUtilities::philox so that CPU and GPU draw the same values
+uvec2 philox(uvec2 counter, uint key)
+{
+	uint hi, lo;
+
+	for (int round = 0; round < PHILOX_ROUNDS; ++round)
+	{
+		umulExtended(PHILOX_MULTIPLIER, counter.x, hi, lo);
+		counter = uvec2(hi ^ key ^ counter.y, lo);
+		key += PHILOX_WEYL;
+	}
+
+	return counter;
+}
+
+// Uniform value in [0, 1) for a given seed, element (e.g. ray) and stream of random values
+float getCounterRandomValue(const uint seed, const uint index, const uint stream)
+{
+	return float(philox(uvec2(index, stream), seed).x >> 8) * (1.0f / 16777216.0f);
 }
\ No newline at end of file
@@ -47,6 +47,20 @@ std::vector<AABB> AABB::split(const unsigned edgeDivisions) const
 	return aabb;
 }
 
+AABB AABB::transform(const mat4& matrix) const
+{
+	AABB aabb;
+
+	for (unsigned corner = 0; corner < 8; ++corner)
+	{
+		const vec3 point((corner & 1) ? _max.x : _min.x, (corner & 2) ? _max.y : _min.y, (corner & 4) ? _max.z : _min.z);
+
+		aabb.update(vec3(matrix * vec4(point, 1.0f)));
+	}
+
+	return aabb;
+}
+
 void AABB::update(const AABB& aabb)
 {
 	this->update(aabb.max());
@@ -70,6 +70,11 @@ public:
 	*/
 	std::vector<AABB> split(const unsigned edgeDivisions) const;
 
+	/**
+	*	@return Axis aligned bounding box of the eight corners once they are transformed.
+	*/
+	AABB transform(const mat4& matrix) const;
+
 	/**
 	*	@brief Updates the boundaries with a new axis aligned bounding box.
 	*/
@@ -144,6 +144,14 @@ namespace Intersections3D
 	*	@return True if both entities intersect.
 	*/
 	bool intersect(AABB& aabb, EisemannRay& ray);
+
+	/**
+	*	@brief Slabs intersection test between an axis-aligned bounding box and a ray clipped to [0, maxDistance].
+	*	@param inverseDirection Component-wise inverse of the ray direction.
+	*	@param tNear Parametric distance where the ray enters the box, if returned value is true. It can be negative if the origin lies inside the box.
+	*	@return False if the box is missed, lies behind the origin or starts beyond maxDistance.
+	*/
+	bool intersect(const vec3& minPoint, const vec3& maxPoint, const vec3& origin, const vec3& inverseDirection, const float maxDistance, float& tNear);
 };
 
 
@@ -654,3 +662,16 @@ inline bool Intersections3D::intersect(AABB& aabb, EisemannRay& ray)
 {
 	return ray.intersect(aabb);
 }
+
+inline bool Intersections3D::intersect(const vec3& minPoint, const vec3& maxPoint, const vec3& origin, const vec3& inverseDirection, const float maxDistance, float& tNear)
+{
+	const vec3 tMin = (minPoint - origin) * inverseDirection;
+	const vec3 tMax = (maxPoint - origin) * inverseDirection;
+	const vec3 t1 = glm::min(tMin, tMax);
+	const vec3 t2 = glm::max(tMin, tMax);
+	const float tFar = glm::min(glm::min(t2.x, t2.y), t2.z);
+
+	tNear = glm::max(glm::max(t1.x, t1.y), t1.z);
+
+	return tFar >= glm::max(tNear, .0f) && tNear <= maxDistance;
+}
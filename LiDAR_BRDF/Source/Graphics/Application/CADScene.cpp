@@ -14,6 +14,7 @@ std::string CADScene::SCENE_SETTINGS_FOLDER = "Assets/Scene/Settings/";
 
 const std::string CADScene::SCENE_CAMERA_FILE = "Camera.txt";
 const std::string CADScene::SCENE_LIGHTS_FILE = "Lights.txt";
+const std::string CADScene::SCENE_INSTANCES_FILE = "Instances.txt";
 
 // [Public methods]
 
@@ -130,13 +131,16 @@ void CADScene::loadLights()
 
 void CADScene::loadModels()
 {
-	MaterialList* materialList = MaterialList::getInstance();
-
 	_sceneGroup = new Group3D();
-	_sceneGroup->setMaterial(materialList->getMaterial(CGAppEnum::MATERIAL_CAD_WHITE));
+	if (!Model3D::HEADLESS) _sceneGroup->setMaterial(MaterialList::getInstance()->getMaterial(CGAppEnum::MATERIAL_CAD_WHITE));	// Material textures need an OpenGL context
 
 	const unsigned rootFolderLength = SCENE_ROOT_FOLDER.length();
 	const std::string textureFolder = SCENE_ROOT_FOLDER;
+	std::vector<std::string> modelPaths;
+	std::vector<CADModel*> models;
+	std::unordered_map<std::string, std::vector<mat4>> instances;
+
+	this->readInstancesFromSettings(instances);
 
 	for (auto& assetFile : std::filesystem::recursive_directory_iterator(SCENE_ROOT_FOLDER))
 	{
@@ -145,9 +149,39 @@ void CADScene::loadModels()
 			std::string modelPath = assetFile.path().generic_string();
 			const size_t extensionDotIndex_01 = modelPath.find_last_of('.');
 
-			CADModel* model = new CADModel(modelPath.substr(0, extensionDotIndex_01), textureFolder, true);
+			modelPaths.push_back(modelPath.substr(0, extensionDotIndex_01));
+		}
+	}
+
+	// Iteration order of directories is not specified, whereas identifiers of model components depend on the order of models
+	std::sort(modelPaths.begin(), modelPaths.end());
+
+	for (const std::string& modelPath : modelPaths)
+	{
+		CADModel* model = new CADModel(modelPath, textureFolder, true);
+		auto instanceIt = instances.find(modelPath.substr(rootFolderLength));
+
+		// Instantiated models are only read once, whatever the number of placements
+		if (instanceIt == instances.end())
+		{
 			_sceneGroup->addComponent(model);
 		}
+		else
+		{
+			for (const mat4& modelMatrix : instanceIt->second)
+			{
+				_sceneGroup->addInstance(model, modelMatrix);
+			}
+		}
+
+		models.push_back(model);
+	}
+
+	// Files are read and parsed concurrently. GPU-dependent steps are completed afterwards by this thread, following the order of models
+	#pragma omp parallel for schedule(dynamic)
+	for (int modelIdx = 0; modelIdx < models.size(); ++modelIdx)
+	{
+		models[modelIdx]->read();
 	}
 
 	LiDARScene::loadModels();
@@ -180,19 +214,19 @@ bool CADScene::readCameraFromSettings(Camera* camera)
 			floatValues.clear();
 			FileManagement::readTokens(currentLine, ' ', strValues, floatValues);
 
-			if (floatValues.size() == 3 && lineHeader._Starts_with(CAMERA_POS_HEADER))
+			if (floatValues.size() == 3 && lineHeader.rfind(CAMERA_POS_HEADER, 0) == 0)
 			{
 				camera->setPosition(vec3(floatValues[0], floatValues[1], floatValues[2]));
 			}
-			else if (floatValues.size() == 3 && lineHeader._Starts_with(CAMERA_LOOKAT_HEADER))
+			else if (floatValues.size() == 3 && lineHeader.rfind(CAMERA_LOOKAT_HEADER, 0) == 0)
 			{
 				camera->setLookAt(vec3(floatValues[0], floatValues[1], floatValues[2]));
 			}
-			else if (!floatValues.empty() && lineHeader._Starts_with(CAMERA_FOV_X_HEADER))
+			else if (!floatValues.empty() && lineHeader.rfind(CAMERA_FOV_X_HEADER, 0) == 0)
 			{
 				camera->setFovX(floatValues[0] * M_PI / 180.0f);
 			}
-			else if (!floatValues.empty() && lineHeader._Starts_with(CAMERA_FOV_Y_HEADER))
+			else if (!floatValues.empty() && lineHeader.rfind(CAMERA_FOV_Y_HEADER, 0) == 0)
 			{
 				camera->setFovY(floatValues[0] * M_PI / 180.0f);
 			}
@@ -204,6 +238,52 @@ bool CADScene::readCameraFromSettings(Camera* camera)
 	return true;
 }
 
+bool CADScene::readInstancesFromSettings(std::unordered_map<std::string, std::vector<mat4>>& instances)
+{
+	const std::string filename = SCENE_SETTINGS_FOLDER + SCENE_INSTANCES_FILE;
+	std::string currentLine;
+	std::ifstream inputStream;
+	std::vector<float> floatValues;
+	std::vector<std::string> strValues;
+
+	inputStream.open(filename.c_str());
+
+	if (inputStream.fail()) return false;
+
+	while (!(inputStream >> std::ws).eof())
+	{
+		std::getline(inputStream, currentLine);
+
+		if (currentLine.find(COMMENT_CHAR) == 0) continue;
+
+		floatValues.clear();
+		strValues.clear();
+		FileManagement::readTokens(currentLine, ' ', strValues, floatValues);
+
+		if (strValues.size() == 1 && (floatValues.size() == 3 || floatValues.size() == 6 || floatValues.size() == 7 || floatValues.size() == 9))
+		{
+			const vec3 translation(floatValues[0], floatValues[1], floatValues[2]);
+			vec3 rotation(.0f), scale(1.0f);
+
+			if (floatValues.size() >= 6) rotation = glm::radians(vec3(floatValues[3], floatValues[4], floatValues[5]));
+			if (floatValues.size() == 7) scale = vec3(floatValues[6]);
+			else if (floatValues.size() == 9) scale = vec3(floatValues[6], floatValues[7], floatValues[8]);
+
+			mat4 modelMatrix = glm::translate(mat4(1.0f), translation);
+			modelMatrix = glm::rotate(modelMatrix, rotation.z, vec3(.0f, .0f, 1.0f));
+			modelMatrix = glm::rotate(modelMatrix, rotation.y, vec3(.0f, 1.0f, .0f));
+			modelMatrix = glm::rotate(modelMatrix, rotation.x, vec3(1.0f, .0f, .0f));
+			modelMatrix = glm::scale(modelMatrix, scale);
+
+			instances[strValues[0]].push_back(modelMatrix);
+		}
+	}
+
+	inputStream.close();
+
+	return true;
+}
+
 bool CADScene::readLightsFromSettings()
 {
 	// File management
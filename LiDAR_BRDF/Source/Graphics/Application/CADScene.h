@@ -45,6 +45,7 @@ protected:
 	// Settings constraints
 	const static std::string SCENE_CAMERA_FILE;				//!<
 	const static std::string SCENE_LIGHTS_FILE;				//!<
+	const static std::string SCENE_INSTANCES_FILE;			//!< Placements of models which are instantiated rather than replicated
 
 protected:
 	/**
@@ -82,6 +83,13 @@ protected:
 	*/
 	bool readCameraFromSettings(Camera* camera);
 
+	/**
+	*	@brief Loads instance placements from a file, if possible. Each line holds a model path relative to the scene folder, without extension,
+	*	followed by its translation and, optionally, its rotation in degrees and scale.
+	*	@param instances Transformations of every instance, indexed by model path.
+	*/
+	bool readInstancesFromSettings(std::unordered_map<std::string, std::vector<mat4>>& instances);
+
 	/**
 	*	@brief Load lights from a file, if possible.
 	*/
@@ -51,6 +51,8 @@ public:
 	inline static const float		MIN_CHANNEL_ANGLE_INC = .0f;				//!<
 	inline static const float		MAX_OUTLIER_THRESHOLD = 1.0f;				//!<
 	inline static const float		MIN_OUTLIER_THRESHOLD = 0.0f;				//!<
+	inline static const unsigned	MAX_BVH_LEAF_FACES = 8;						//!< Maximum number of faces of a single BVH leaf
+	inline static const unsigned	MIN_BVH_LEAF_FACES = 1;						//!< A single face per leaf, i.e. no subtree is collapsed
 		
 	// TLS
 	inline static const float		TLS_MAX_ANGLE = 360.0f;						//!<
@@ -101,6 +103,21 @@ public:
 	inline static const char* RayBuilder_STR[NUM_RAY_BUILDERS] = { "Terrestrial (Spherical)", "Aerial (Linear)", "Aerial (Zig Zag)",
 																   "Aerial (Elliptical)" };
 
+	// --------- Intersection Backend ---------
+	// Quantized nodes of the compressed BVH are only decoded by the CPU solver; compute shaders always traverse full BVHCluster nodes
+	enum IntersectionBackend : uint8_t {
+		GPU_BACKEND, CPU_BACKEND, CPU_WIDE_BACKEND, CPU_COMPRESSED_BACKEND, NUM_BACKENDS
+	};
+
+	inline static const char* IntersectionBackend_STR[NUM_BACKENDS] = { "GPU (Compute Shaders)", "CPU (Multithreaded)", "CPU (8-wide BVH)", "CPU only (Compressed BVH)" };
+
+	// --------- BVH Builder ---------
+	enum BVHBuilder : uint8_t {
+		PLOC_GPU_BUILDER, BINNED_SAH_CPU_BUILDER, LBVH_CPU_BUILDER, NUM_BVH_BUILDERS
+	};
+
+	inline static const char* BVHBuilder_STR[NUM_BVH_BUILDERS] = { "PLOC (GPU)", "Binned SAH (CPU)", "LBVH (CPU)" };
+
 	// --------- LiDAR Specifications ---------
 	enum LiDARSpecifications : uint8_t {
 		CUSTOM, HDL64E, Pandar64, HDL32E, Puck, PuckLite, PuckHiRes, UltraPuck, AlphaPrime, Zenmuse_L1, NUM_SPECIFICATIONS
@@ -149,8 +166,16 @@ public:
 	int			_LiDARSpecs;								//!< Model whose specifications these parameters are supposed to follow
 
 	// Computational parameters
-	bool		_gpuInstantiation;							//!<
+	int			_backend;									//!< Device where ray-scene intersections are solved, either GPU or CPU. CPU backends build rays and scene in main memory with no OpenGL call
+	int			_bvhBuilder;								//!< Algorithm which builds the BVH of non-instanced geometry
+	unsigned	_bvhLeafFaces;								//!< Faces that a BVH leaf may hold once subtrees are collapsed by their cost
+	bool		_bvhPreSplit;								//!< Splits large or thin non-instanced faces into fragments with tighter boxes before building the BVH
+	bool		_exportBVHQuality;							//!< Analyzes the BVH once it is built and exports its metrics along with the pipeline ones
+	bool		_gpuInstantiation;							//!< Rays are built by compute shaders, only with the GPU backend
 	int			_numExecs;									//!< Number of repetitions for a LiDAR simulation
+	int			_randomSeed;								//!< Key of the counter-based generator, so that simulations can be reproduced
+	bool		_reuseRayHits;								//!< Nearest hit of each ray is reused by later returns while the ray is neither moved nor deviated
+	bool		_spectralBatch;								//!< Rays are traced once and shaded for every wavelength of the range
 	
 	// Global parameters
 	int			_channels;									//!< Number of simultaneous channels
@@ -222,7 +247,14 @@ public:
 	LiDARParameters() :
 		_LiDARType(RayBuild::TERRESTRIAL_SPHERICAL),
 		_LiDARSpecs(LiDARSpecifications::CUSTOM),
+		_backend(IntersectionBackend::GPU_BACKEND),
+		_bvhBuilder(BVHBuilder::PLOC_GPU_BUILDER),
+		_bvhLeafFaces(4),
+		_bvhPreSplit(false),
+		_exportBVHQuality(false),
 		_gpuInstantiation(true),
+		_reuseRayHits(true),
+		_spectralBatch(false),
 		_channels(Channels::CH_16),
 		_discardFirstExecution(false),
 		_douglasPeckerEpsilon(3.0f),
@@ -234,6 +266,7 @@ public:
 		_maxRangeSoftBoundary(-10.0f, 3.0f),
 		_maxReturns(1),
 		_numExecs(1),
+		_randomSeed(0),
 		_outlierRange(.0f, 1.0f),
 		_outlierThreshold(0.8f),
 		_peakPower(65.0f),
@@ -326,6 +359,11 @@ public:
 	*/
 	ivec2 getWaveLength() { return _wavelength; }
 
+	/**
+	*	@return True if rays are built by compute shaders.
+	*/
+	bool isGPUInstantiated() { return _gpuInstantiation && _backend == GPU_BACKEND; }
+
 	/**
 	*	@return True if LiDAR ray builder is a terrestrial choice.
 	*/
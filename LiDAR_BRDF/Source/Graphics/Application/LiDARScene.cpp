@@ -8,6 +8,7 @@
 #include "Graphics/Core/RenderingShader.h"
 #include "Graphics/Core/ShaderList.h"
 #include "Interface/Window.h"
+#include "Utilities/BVHQualityReport.h"
 
 /// [Public methods]
 
@@ -35,7 +36,8 @@ LiDARScene::~LiDARScene()
 void LiDARScene::clearSimulation()
 {
 	_pointCloud->archive();
-	_drawPointCloud->updateVAO();
+	_pointCloud->clearCapturedPoints();
+	if (_drawPointCloud) _drawPointCloud->updateVAO();
 
 	for (Model3D::ModelComponent* modelComponent : *_sceneGroup->getRegisteredModelComponents())
 	{
@@ -45,6 +47,12 @@ void LiDARScene::clearSimulation()
 
 void LiDARScene::load()
 {	
+	if (Model3D::HEADLESS)
+	{
+		this->loadModels();						// Neither lights nor cameras are needed for simulating
+		return;
+	}
+
 	Scene::load();
 
 	if (_sceneGroup) 
@@ -54,7 +62,7 @@ void LiDARScene::load()
 void LiDARScene::launchSimulation()
 {
 	_LiDAR->launchSimulation(true);
-	_drawPointCloud->updateVAO();
+	if (_drawPointCloud) _drawPointCloud->updateVAO();
 }
 
 void LiDARScene::render(const mat4& mModel, RenderingParameters* rendParams)
@@ -176,11 +184,12 @@ void LiDARScene::computeLiDARModelMatrix(std::vector<mat4>* matrix, LiDARParamet
 
 void LiDARScene::loadModelsCore(Group3D::StaticGPUData* staticGPUData)
 {
-	MaterialList* materialList = MaterialList::getInstance();
-
 	_LiDAR = new LiDARSimulation(_sceneGroup);
 	_LiDAR->setGroupGPUData(staticGPUData);
 	_pointCloud = _LiDAR->getLiDARPointCloud();
+
+	if (Model3D::HEADLESS) return;
+
 	_drawPointCloud = new DrawLiDARPointCloud(_pointCloud);
 	_drawPointCloud->load();
 
@@ -207,7 +216,18 @@ void LiDARScene::loadModels()
 	{
 		_sceneGroup->load();
 		_sceneGroup->registerScene();
-		Group3D::StaticGPUData* staticGPUData = _sceneGroup->generateBVH(true);
+		_sceneGroup->setBVHBuilder(static_cast<Group3D::BVHBuilder>(LiDARSimulation::getLiDARParams()->_bvhBuilder));
+		_sceneGroup->setMaxLeafFaces(LiDARSimulation::getLiDARParams()->_bvhLeafFaces);
+		_sceneGroup->setPreSplitFaces(LiDARSimulation::getLiDARParams()->_bvhPreSplit);
+		_sceneGroup->setGPUBuffers(LiDARSimulation::getLiDARParams()->_backend == LiDARParameters::GPU_BACKEND);
+		Group3D::StaticGPUData* staticGPUData = _sceneGroup->generateBVH(!Model3D::HEADLESS);
+
+		if (LiDARSimulation::getLiDARParams()->_exportBVHQuality)
+		{
+			BVHQualityReport bvhQuality;
+			bvhQuality.analyze(_sceneGroup);
+			bvhQuality.exportJSON();
+		}
 
 		this->loadModelsCore(staticGPUData);
 	}
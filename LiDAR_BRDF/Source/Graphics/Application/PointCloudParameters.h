@@ -7,13 +7,21 @@
 */
 
 /**
-*	@brief Wraps the parameters of a point cloud file (PLY).
+*	@brief Wraps the parameters of a point cloud file (PLY or LAS).
 */
 struct PointCloudParameters
 {
+public:
+	enum PointCloudFormat : uint8_t {
+		PLY_FORMAT, LAS_FORMAT, NUM_FORMATS
+	};
+	inline static const char* PointCloudFormat_STR[NUM_FORMATS] = { "PLY (Binary)", "LAS 1.4" };
+	inline static const char* PointCloudFormat_EXTENSION[NUM_FORMATS] = { ".ply", ".las" };
+
 public:
 	bool		_asynchronousWrite;					//!<
 	char		_filenameBuffer[32];				//!< File where point cloud is saved
+	int			_format;							//!< Output file format
 	bool		_savePointCloud;					//!< Save point cloud after simulation or not
 
 public:
@@ -23,6 +31,7 @@ public:
 	PointCloudParameters() :
 		_asynchronousWrite(true),
 		_filenameBuffer("PointCloud.ply"),
+		_format(PointCloudFormat::PLY_FORMAT),
 		_savePointCloud(true)
 	{
 	}
@@ -33,4 +42,15 @@ public:
 	~PointCloudParameters()
 	{
 	}
+
+	/**
+	*	@return Filename without its extension, followed by a suffix and the extension of the selected format.
+	*/
+	std::string getFilename(const std::string& suffix = "") const
+	{
+		std::string filename = std::string(_filenameBuffer);
+		filename = filename.substr(0, filename.find("."));
+
+		return filename + suffix + PointCloudFormat_EXTENSION[_format];
+	}
 };
\ No newline at end of file
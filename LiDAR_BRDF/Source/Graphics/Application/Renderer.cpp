@@ -47,13 +47,13 @@ void Renderer::readSceneIndex(uint8_t& sceneIndex, std::vector<std::string>& add
 
 			if (!strTokens.empty())
 			{
-				if (!strTokens[0]._Starts_with(STR_LINE_COMMENT))
+				if (strTokens[0].rfind(STR_LINE_COMMENT, 0) != 0)
 				{
-					if (strTokens[0]._Equal("CAD"))
+					if (strTokens[0] == "CAD")
 					{
 						sceneIndex = CGAppEnum::CAD_SCENE;
 					}
-					else if (strTokens[0]._Equal("Terrain"))
+					else if (strTokens[0] == "Terrain")
 					{
 						sceneIndex = CGAppEnum::TERRAIN_SCENE;
 					}
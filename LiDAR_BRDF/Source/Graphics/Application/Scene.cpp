@@ -8,7 +8,7 @@
 
 Scene::Scene():
 	_cameraManager(std::unique_ptr<CameraManager>(new CameraManager())), _sceneGroup(nullptr),
-	_nextFramebufferID(0), _ssaoFBO(new SSAOFBO())
+	_nextFramebufferID(0), _ssaoFBO(Model3D::HEADLESS ? nullptr : new SSAOFBO())
 {
 	_window = Window::getInstance();
 }
@@ -12,13 +12,13 @@ void AerialEllipticalBuilder::buildRays(LiDARParameters* LiDARParams, AABB& scen
 {
 	ALSParameters* parameters = dynamic_cast<ALSParameters*>(_parameters);
 
-	if (LiDARParams->_gpuInstantiation)
+	if (LiDARParams->isGPUInstantiated())
 	{
 		this->buildRaysGPU(parameters, LiDARParams, sceneAABB);
 	}
 	else
 	{
-		this->buildRaysCPU(parameters, LiDARParams, sceneAABB);
+		this->uploadRaysCPU(LiDARParams);
 	}
 }
 
@@ -51,68 +51,50 @@ RayBuilder::ALSParameters* AerialEllipticalBuilder::buildParameters(LiDARParamet
 	// State params
 	std::vector<vec4> waypoints;
 	std::vector<Interpolation*> airbonePaths = this->getAirbonePaths(LiDARParams, params->_numSteps, sceneAABB, LiDARParams->_alsPosition.y);
-	this->retrievePath(airbonePaths, waypoints, params->_advancePulse);
+	this->retrievePath(airbonePaths, waypoints, params->_advancePulse, LiDARParams->_randomSeed);
 
 	params->_numThreads = waypoints.size() - airbonePaths.size();
 	params->_pathLength = waypoints.size() / airbonePaths.size();		// Each interpolation produces the same number of points
 	RayBuilder::initializeContext(LiDARParams, params);
 
-	if (LiDARParams->_gpuInstantiation)
+	if (LiDARParams->isGPUInstantiated())
 	{
 		params->_waypointBuffer = ComputeShader::setReadBuffer(waypoints, GL_STATIC_DRAW);
 	}
 
+	params->_waypoints.swap(waypoints);
+
 	return params;
 }
 
-void AerialEllipticalBuilder::buildRaysCPU(ALSParameters* parameters, LiDARParameters* LiDARParams, AABB& sceneAABB)
+void AerialEllipticalBuilder::throwPulses(LiDARParameters* LiDARParams, const unsigned firstPulse, const unsigned numPulses, std::vector<Model3D::RayGPUData>& rays)
 {
-	// Jittering initialization
-	RandomUtilities::initializeUniformDistribution(-1.0f, 1.0f);
-
-	// Retrieve waypoints to emulate platform movement
-	std::vector<vec4> waypoints;
-	std::vector<Interpolation*> airbonePaths = this->getAirbonePaths(LiDARParams, parameters->_numSteps, sceneAABB, LiDARParams->_alsPosition.y);
-	this->retrievePath(airbonePaths, waypoints, parameters->_advancePulse);
+	ALSParameters* parameters = dynamic_cast<ALSParameters*>(_parameters);
 
-	// Iterate through each interpolation path
-	unsigned pathLength = waypoints.size() / airbonePaths.size();		// Each interpolation produces the same number of points
-	unsigned raysPerPathTimestamp = (pathLength - 1) * parameters->_numPulsesScan * LiDARParams->_raysPulse;
-	std::vector<Model3D::RayGPUData> rays(airbonePaths.size() * raysPerPathTimestamp);
+	// A single pulse is thrown from each waypoint but the first one of every path, as in GPU
+	const unsigned seed = LiDARParams->_randomSeed;
+	const unsigned pathLength = parameters->_pathLength;
 
-	for (int pathIdx = 0; pathIdx < airbonePaths.size(); ++pathIdx)
+	#pragma omp parallel for
+	for (int batchPulseIdx = 0; batchPulseIdx < static_cast<int>(numPulses); ++batchPulseIdx)
 	{
-		float baseAngle = RandomUtilities::getUniformRandomValue();
-		vec4 spherePosition, sensorPosition;
-		unsigned pointOffset = pathLength * pathIdx;
-
-		#pragma omp parallel for
-		for (int point = pointOffset + 1; point < pointOffset + pathLength; ++point)
-		{
-			unsigned baseIndex = pathIdx * raysPerPathTimestamp + (point - 1) * parameters->_numPulsesScan * LiDARParams->_raysPulse;
-			float angle = baseAngle + (point - pointOffset - 1) * parameters->_incrementRadians;
-
-			spherePosition = vec4(sin(angle), .0f, cos(angle), .0f) * parameters->_ellipseRadius;
-			spherePosition.x *= parameters->_ellipseScale;
-			spherePosition.x += RandomUtilities::getUniformRandomValue() * LiDARParams->_alsRayJittering;
-			spherePosition.y = -parameters->_heightRadius + RandomUtilities::getUniformRandomValue() * LiDARParams->_alsRayJittering;
-			spherePosition.z += RandomUtilities::getUniformRandomValue() * LiDARParams->_alsRayJittering;
-			sensorPosition = waypoints[point] + vec4(.0f, RandomUtilities::getUniformRandomValue() * LiDARParams->_alsHeightJittering, .0f, .0f);
+		const unsigned pulseIdx = firstPulse + batchPulseIdx;
+		const unsigned pathIdx = pulseIdx / (pathLength - 1), pathPulseIdx = pulseIdx % (pathLength - 1);
+		const unsigned point = pathIdx * pathLength + pathPulseIdx + 1, baseIndex = batchPulseIdx * LiDARParams->_raysPulse;
+		const float baseAngle = getJittering(seed, pathIdx, PATH_NOISE_STREAM);
+		const float angle = baseAngle + pathPulseIdx * parameters->_incrementRadians;
+
+		vec4 spherePosition = vec4(sin(angle), .0f, cos(angle), .0f) * parameters->_ellipseRadius;
+		spherePosition.x *= parameters->_ellipseScale;
+		spherePosition.x += getJittering(seed, pulseIdx, RAY_NOISE_STREAM.x) * LiDARParams->_alsRayJittering;
+		spherePosition.y = -parameters->_heightRadius + getJittering(seed, pulseIdx, RAY_NOISE_STREAM.y) * LiDARParams->_alsRayJittering;
+		spherePosition.z += getJittering(seed, pulseIdx, RAY_NOISE_STREAM.z) * LiDARParams->_alsRayJittering;
+		const vec4 sensorPosition = parameters->_waypoints[point] + vec4(.0f, getJittering(seed, pulseIdx, HEIGHT_NOISE_STREAM) * LiDARParams->_alsHeightJittering, .0f, .0f);
 			
-			rays[baseIndex] = Model3D::RayGPUData(sensorPosition, sensorPosition + spherePosition);
+		rays[baseIndex] = Model3D::RayGPUData(sensorPosition, sensorPosition + spherePosition);
 
-			this->addPulseRadius(rays, baseIndex, parameters->_upVector, LiDARParams->_raysPulse, LiDARParams->_pulseRadius);
-		}
+		this->addPulseRadius(rays, baseIndex, parameters->_upVector, LiDARParams->_raysPulse, LiDARParams->_pulseRadius, pulseIdx, seed);
 	}
-
-	parameters->_leftRays -= rays.size();
-
-	for (Interpolation* interpolation : airbonePaths)
-	{
-		delete interpolation;
-	}
-
-	parameters->_rayBuffer = ComputeShader::setReadBuffer(rays, GL_DYNAMIC_DRAW);
 }
 
 void AerialEllipticalBuilder::buildRaysGPU(ALSParameters* parameters, LiDARParameters* LiDARParams, AABB& sceneAABB)
@@ -125,20 +107,20 @@ void AerialEllipticalBuilder::buildRaysGPU(ALSParameters* parameters, LiDARParam
 		unsigned threadOffset = (parameters->_numRays * LiDARParams->_raysPulse - parameters->_leftRays) / LiDARParams->_raysPulse;
 		parameters->_currentNumRays = std::min(parameters->_allowedRaysIteration, parameters->_leftRays);
 
-		shader->bindBuffers(std::vector<GLuint> { parameters->_rayBuffer, parameters->_waypointBuffer, parameters->_noiseBuffer });
+		shader->bindBuffers(std::vector<GLuint> { parameters->_rayBuffer, parameters->_waypointBuffer });
 		shader->use();
 		shader->setUniform("ellipseRadius", parameters->_ellipseRadius);
 		shader->setUniform("ellipseScale", parameters->_ellipseScale);
 		shader->setUniform("heightJittering", LiDARParams->_alsHeightJittering);
 		shader->setUniform("heightRadius", parameters->_heightRadius);
 		shader->setUniform("incrementRadians", parameters->_incrementRadians);
-		shader->setUniform("noiseBufferSize", NOISE_BUFFER_SIZE);
 		shader->setUniform("numPulses", parameters->_numPulsesScan);
 		shader->setUniform("numThreads", parameters->_currentNumRays);
 		shader->setUniform("pathLength", parameters->_pathLength);
 		shader->setUniform("pulseRadius", LiDARParams->_pulseRadius);
 		shader->setUniform("rayJittering", LiDARParams->_alsRayJittering);
 		shader->setUniform("raysPulse", unsigned(LiDARParams->_raysPulse));
+		shader->setUniform("seed", unsigned(LiDARParams->_randomSeed));
 		shader->setUniform("threadOffset", threadOffset);
 		shader->execute(parameters->_numGroups, 1, 1, ComputeShader::getMaxGroupSize(), 1, 1);
 
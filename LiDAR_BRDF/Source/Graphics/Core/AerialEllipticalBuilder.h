@@ -20,9 +20,9 @@ protected:
 	ALSParameters* buildParameters(LiDARParameters* LiDARParams, AABB& sceneAABB);
 
 	/**
-	*	@brief Builds rays to be launched in CPU.
+	*	@brief Builds a range of pulses in CPU.
 	*/
-	virtual void buildRaysCPU(ALSParameters* parameters, LiDARParameters* LiDARParams, AABB& sceneAABB);
+	virtual void throwPulses(LiDARParameters* LiDARParams, const unsigned firstPulse, const unsigned numPulses, std::vector<Model3D::RayGPUData>& rays);
 
 	/**
 	*	@brief Builds rays to be launched in GPU.
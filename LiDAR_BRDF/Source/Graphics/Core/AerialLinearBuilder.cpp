@@ -12,13 +12,13 @@ void AerialLinearBuilder::buildRays(LiDARParameters* LiDARParams, AABB& sceneAAB
 {
 	ALSParameters* parameters = dynamic_cast<ALSParameters*>(_parameters);
 
-	if (LiDARParams->_gpuInstantiation)
+	if (LiDARParams->isGPUInstantiated())
 	{
 		this->buildRaysGPU(parameters, LiDARParams, sceneAABB);
 	}
 	else
 	{
-		this->buildRaysCPU(parameters, LiDARParams, sceneAABB);
+		this->uploadRaysCPU(LiDARParams);
 	}
 }
 
@@ -50,54 +50,20 @@ RayBuilder::ALSParameters* AerialLinearBuilder::buildParameters(LiDARParameters*
 	// State params
 	std::vector<vec4> waypoints;
 	std::vector<Interpolation*> airbonePaths = this->getAirbonePaths(LiDARParams, params->_numSteps, sceneAABB, LiDARParams->_alsPosition.y);
-	this->retrievePath(airbonePaths, waypoints, params->_advanceScan_t);
+	this->retrievePath(airbonePaths, waypoints, params->_advanceScan_t, LiDARParams->_randomSeed);
 
 	params->_numThreads = (waypoints.size() - airbonePaths.size()) * params->_numPulsesScan;
 	params->_pathLength = waypoints.size() / airbonePaths.size();		// Each interpolation produces the same number of points
 	RayBuilder::initializeContext(LiDARParams, params);
 
-	if (LiDARParams->_gpuInstantiation)
+	if (LiDARParams->isGPUInstantiated())
 	{
 		params->_waypointBuffer = ComputeShader::setReadBuffer(waypoints, GL_STATIC_DRAW);
 	}
 
-	return params;
-}
-
-void AerialLinearBuilder::buildRaysCPU(ALSParameters* parameters, LiDARParameters* LiDARParams, AABB& sceneAABB)
-{
-	// Jittering initialization
-	RandomUtilities::initializeUniformDistribution(-1.0f, 1.0f);
-
-	// Retrieve waypoints to emulate platform movement
-	std::vector<vec4> waypoints;
-	std::vector<Interpolation*> airbonePaths = this->getAirbonePaths(LiDARParams, parameters->_numSteps, sceneAABB, LiDARParams->_alsPosition.y);
-	this->retrievePath(airbonePaths, waypoints, parameters->_advanceScan_t);
-
-	// Iterate through each interpolation path
-	unsigned pathLength = waypoints.size() / airbonePaths.size();		// Each interpolation produces the same number of points
-	unsigned raysPerPathTimestamp = (pathLength - 1) * parameters->_numPulsesScan * LiDARParams->_raysPulse;
-	std::vector<Model3D::RayGPUData> rays(airbonePaths.size() * raysPerPathTimestamp * LiDARParams->_raysPulse);
-
-	for (int pathIdx = 0; pathIdx < airbonePaths.size(); ++pathIdx)
-	{
-		unsigned pointOffset = pathLength * pathIdx;
+	params->_waypoints.swap(waypoints);
 
-		for (int point = pointOffset + 1; point < pointOffset + pathLength; ++point)
-		{
-			unsigned baseIndex = pathIdx * raysPerPathTimestamp + (point - 1) * parameters->_numPulsesScan * LiDARParams->_raysPulse;
-			this->throwRays(parameters, LiDARParams, rays, waypoints[point], glm::normalize(waypoints[point] - waypoints[point - 1]), parameters->_startRadians, parameters->_fovRadians, parameters->_numPulsesScan, baseIndex);
-		}
-	}
-
-	parameters->_leftRays -= std::min(size_t(parameters->_leftRays), rays.size());
-
-	for (Interpolation* interpolation : airbonePaths)
-	{
-		delete interpolation;
-	}
-
-	parameters->_rayBuffer = ComputeShader::setReadBuffer(rays, GL_DYNAMIC_DRAW);
+	return params;
 }
 
 void AerialLinearBuilder::buildRaysGPU(ALSParameters* parameters, LiDARParameters* LiDARParams, AABB& sceneAABB)
@@ -110,17 +76,17 @@ void AerialLinearBuilder::buildRaysGPU(ALSParameters* parameters, LiDARParameter
 		unsigned threadOffset = (parameters->_numRays * LiDARParams->_raysPulse - parameters->_leftRays) / LiDARParams->_raysPulse;
 		parameters->_currentNumRays = std::min(parameters->_allowedRaysIteration, parameters->_leftRays);
 
-		shader->bindBuffers(std::vector<GLuint> { parameters->_rayBuffer, parameters->_waypointBuffer, parameters->_noiseBuffer });
+		shader->bindBuffers(std::vector<GLuint> { parameters->_rayBuffer, parameters->_waypointBuffer });
 		shader->use();
 		shader->setUniform("heightJittering", LiDARParams->_alsHeightJittering);
 		shader->setUniform("incrementRadians", parameters->_incrementRadians);
-		shader->setUniform("noiseBufferSize", NOISE_BUFFER_SIZE);
 		shader->setUniform("numPulses", parameters->_numPulsesScan);
 		shader->setUniform("numThreads", parameters->_currentNumRays);
 		shader->setUniform("pathLength", parameters->_pathLength);
 		shader->setUniform("pulseRadius", LiDARParams->_pulseRadius);
 		shader->setUniform("rayJittering", LiDARParams->_alsRayJittering);
 		shader->setUniform("raysPulse", unsigned(LiDARParams->_raysPulse));
+		shader->setUniform("seed", unsigned(LiDARParams->_randomSeed));
 		shader->setUniform("startRadians", parameters->_startRadians);
 		shader->setUniform("threadOffset", threadOffset);
 		shader->setUniform("zigzag", GLuint(0));
@@ -130,23 +96,29 @@ void AerialLinearBuilder::buildRaysGPU(ALSParameters* parameters, LiDARParameter
 	}
 }
 
-void AerialLinearBuilder::throwRays(ALSParameters* parameters, LiDARParameters* LiDARParams, std::vector<Model3D::RayGPUData>& rays, const vec3& LiDARPosition, const vec3& LiDARDirection,
-									const float startAngle, const float fov, const unsigned numPulses, unsigned baseIndex)
+void AerialLinearBuilder::throwPulses(LiDARParameters* LiDARParams, const unsigned firstPulse, const unsigned numPulses, std::vector<Model3D::RayGPUData>& rays)
 {
-	vec3 normalizedDirection = glm::normalize(LiDARDirection);
-	vec3 rotateAxis = vec3(-normalizedDirection.z, 0.0f, normalizedDirection.x);
+	ALSParameters* parameters = dynamic_cast<ALSParameters*>(_parameters);
+	const unsigned seed = LiDARParams->_randomSeed, pathLength = parameters->_pathLength;
 
+	// Each pulse writes its own range of rays, hence the result does not depend on the number of threads nor the size of the batch
 	#pragma omp parallel for
-	for (int rayIdx = 0; rayIdx < numPulses; ++rayIdx)
+	for (int batchPulseIdx = 0; batchPulseIdx < static_cast<int>(numPulses); ++batchPulseIdx)
 	{
-		float angle = parameters->_incrementRadians * rayIdx + parameters->_startRadians;
+		const unsigned pulseIdx = firstPulse + batchPulseIdx, scanIdx = pulseIdx / parameters->_numPulsesScan, scanPulseIdx = pulseIdx % parameters->_numPulsesScan;
+		const unsigned point = scanIdx / (pathLength - 1) * pathLength + scanIdx % (pathLength - 1) + 1, baseIndex = batchPulseIdx * LiDARParams->_raysPulse;
+		const vec3 LiDARPosition = vec3(parameters->_waypoints[point]);
+		const vec3 normalizedDirection = glm::normalize(LiDARPosition - vec3(parameters->_waypoints[point - 1]));
+		const vec3 rotateAxis = vec3(-normalizedDirection.z, 0.0f, normalizedDirection.x);
+
+		float angle = parameters->_incrementRadians * scanPulseIdx + parameters->_startRadians;
 		vec3 spherePosition = rotateAxis * -std::sin(angle);
-		spherePosition.x += RandomUtilities::getUniformRandomValue() * LiDARParams->_alsRayJittering;
-		spherePosition.y = -std::cos(angle) + RandomUtilities::getUniformRandomValue() * LiDARParams->_alsRayJittering;
-		spherePosition.z += RandomUtilities::getUniformRandomValue() * LiDARParams->_alsRayJittering;
-		vec3 sensorPosition = LiDARPosition + vec3(.0f, RandomUtilities::getUniformRandomValue() * LiDARParams->_alsHeightJittering, .0f);
+		spherePosition.x += getJittering(seed, pulseIdx, RAY_NOISE_STREAM.x) * LiDARParams->_alsRayJittering;
+		spherePosition.y = -std::cos(angle) + getJittering(seed, pulseIdx, RAY_NOISE_STREAM.y) * LiDARParams->_alsRayJittering;
+		spherePosition.z += getJittering(seed, pulseIdx, RAY_NOISE_STREAM.z) * LiDARParams->_alsRayJittering;
+		vec3 sensorPosition = LiDARPosition + vec3(.0f, getJittering(seed, pulseIdx, HEIGHT_NOISE_STREAM) * LiDARParams->_alsHeightJittering, .0f);
 		
-		rays[baseIndex + rayIdx * LiDARParams->_raysPulse] = Model3D::RayGPUData(sensorPosition, sensorPosition + spherePosition);
-		this->addPulseRadius(rays, baseIndex + rayIdx * LiDARParams->_raysPulse, parameters->_upVector, LiDARParams->_raysPulse, LiDARParams->_pulseRadius);
+		rays[baseIndex] = Model3D::RayGPUData(sensorPosition, sensorPosition + spherePosition);
+		this->addPulseRadius(rays, baseIndex, parameters->_upVector, LiDARParams->_raysPulse, LiDARParams->_pulseRadius, pulseIdx, seed);
 	}
 }
\ No newline at end of file
@@ -20,21 +20,15 @@ protected:
 	ALSParameters* buildParameters(LiDARParameters* LiDARParams, AABB& sceneAABB);
 	
 	/**
-	*	@brief Builds rays to be launched in CPU.
+	*	@brief Builds a range of pulses in CPU.
 	*/
-	virtual void buildRaysCPU(ALSParameters* parameters, LiDARParameters* LiDARParams, AABB& sceneAABB);
+	virtual void throwPulses(LiDARParameters* LiDARParams, const unsigned firstPulse, const unsigned numPulses, std::vector<Model3D::RayGPUData>& rays);
 	
 	/**
 	*	@brief Builds rays to be launched in GPU.
 	*/
 	virtual void buildRaysGPU(ALSParameters* parameters, LiDARParameters* LiDARParams, AABB& sceneAABB);
 	
-	/**
-	*	@brief  
-	*/
-	void throwRays(ALSParameters* parameters, LiDARParameters* LiDARParams, std::vector<Model3D::RayGPUData>& rays, const vec3& LiDARPosition, const vec3& LiDARDirection, 
-				   const float startAngle, const float fov, const unsigned numPulses, unsigned baseIndex);
-
 public:
 	/**
 	*	@brief Builds those rays which are thrown from the LiDAR sensor according to the class instance.
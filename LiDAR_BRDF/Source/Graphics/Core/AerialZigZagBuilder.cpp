@@ -11,13 +11,13 @@ void AerialZigZagBuilder::buildRays(LiDARParameters* LiDARParams, AABB& sceneAAB
 {
 	ALSParameters* parameters = dynamic_cast<ALSParameters*>(_parameters);
 
-	if (LiDARParams->_gpuInstantiation)
+	if (LiDARParams->isGPUInstantiated())
 	{
 		this->buildRaysGPU(parameters, LiDARParams, sceneAABB);
 	}
 	else
 	{
-		this->buildRaysCPU(parameters, LiDARParams, sceneAABB);
+		this->uploadRaysCPU(LiDARParams);
 	}
 }
 
@@ -49,56 +49,20 @@ RayBuilder::ALSParameters* AerialZigZagBuilder::buildParameters(LiDARParameters*
 	// State params
 	std::vector<vec4> waypoints;
 	std::vector<Interpolation*> airbonePaths = this->getAirbonePaths(LiDARParams, params->_numSteps, sceneAABB, LiDARParams->_alsPosition.y);
-	this->retrievePath(airbonePaths, waypoints, params->_advanceScan_t);
+	this->retrievePath(airbonePaths, waypoints, params->_advanceScan_t, LiDARParams->_randomSeed);
 
 	params->_numThreads = (waypoints.size() - airbonePaths.size()) * params->_numPulsesScan;
 	params->_pathLength = waypoints.size() / airbonePaths.size();		// Each interpolation produces the same number of points
 	RayBuilder::initializeContext(LiDARParams, params);
 
-	if (LiDARParams->_gpuInstantiation)
+	if (LiDARParams->isGPUInstantiated())
 	{
 		params->_waypointBuffer = ComputeShader::setReadBuffer(waypoints, GL_STATIC_DRAW);
 	}
 
-	return params;
-}
-
-void AerialZigZagBuilder::buildRaysCPU(ALSParameters* parameters, LiDARParameters* LiDARParams, AABB& sceneAABB)
-{
-	// Jittering initialization
-	RandomUtilities::initializeUniformDistribution(-1.0f, 1.0f);
-
-	// Retrieve waypoints to emulate platform movement
-	std::vector<vec4> waypoints;
-	std::vector<Interpolation*> airbonePaths = this->getAirbonePaths(LiDARParams, parameters->_numSteps, sceneAABB, LiDARParams->_alsPosition.y);
-	this->retrievePath(airbonePaths, waypoints, parameters->_advanceScan_t);
-
-	// Iterate through each interpolation path
-	float zigZagSign = 1.0f;
-	unsigned pathLength = waypoints.size() / airbonePaths.size();		// Each interpolation produces the same number of points
-	unsigned raysPerPathTimestamp = (pathLength - 1) * parameters->_numPulsesScan * LiDARParams->_raysPulse;
-	std::vector<Model3D::RayGPUData> rays(airbonePaths.size() * raysPerPathTimestamp);
-
-	for (int pathIdx = 0; pathIdx < airbonePaths.size(); ++pathIdx)
-	{
-		unsigned pointOffset = pathLength * pathIdx;
-
-		for (int point = pointOffset + 1; point < pointOffset + pathLength; ++point)
-		{
-			unsigned baseIndex = pathIdx * raysPerPathTimestamp + (point - 1) * parameters->_numPulsesScan * LiDARParams->_raysPulse;
-			this->throwRays(parameters, LiDARParams, rays, waypoints[point], parameters->_startRadians, parameters->_fovRadians, parameters->_numPulsesScan, zigZagSign, parameters->_advancePulse, baseIndex);
-			zigZagSign *= -1.0f;
-		}
-	}
-
-	parameters->_leftRays -= rays.size();
-
-	for (Interpolation* interpolation : airbonePaths)
-	{
-		delete interpolation;
-	}
+	params->_waypoints.swap(waypoints);
 
-	parameters->_rayBuffer = ComputeShader::setReadBuffer(rays, GL_DYNAMIC_DRAW);
+	return params;
 }
 
 void AerialZigZagBuilder::buildRaysGPU(ALSParameters* parameters, LiDARParameters* LiDARParams, AABB& sceneAABB)
@@ -111,17 +75,17 @@ void AerialZigZagBuilder::buildRaysGPU(ALSParameters* parameters, LiDARParameter
 		unsigned threadOffset = (parameters->_numRays * LiDARParams->_raysPulse - parameters->_leftRays) / LiDARParams->_raysPulse;
 		parameters->_currentNumRays = std::min(parameters->_allowedRaysIteration, parameters->_leftRays);
 
-		shader->bindBuffers(std::vector<GLuint> { parameters->_rayBuffer, parameters->_waypointBuffer, parameters->_noiseBuffer });
+		shader->bindBuffers(std::vector<GLuint> { parameters->_rayBuffer, parameters->_waypointBuffer });
 		shader->use();
 		shader->setUniform("heightJittering", LiDARParams->_alsHeightJittering);
 		shader->setUniform("incrementRadians", parameters->_incrementRadians);
-		shader->setUniform("noiseBufferSize", NOISE_BUFFER_SIZE);
 		shader->setUniform("numPulses", parameters->_numPulsesScan);
 		shader->setUniform("numThreads", parameters->_currentNumRays);
 		shader->setUniform("pathLength", parameters->_pathLength);
 		shader->setUniform("pulseRadius", LiDARParams->_pulseRadius);
 		shader->setUniform("rayJittering", LiDARParams->_alsRayJittering);
 		shader->setUniform("raysPulse", unsigned(LiDARParams->_raysPulse));
+		shader->setUniform("seed", unsigned(LiDARParams->_randomSeed));
 		shader->setUniform("startRadians", parameters->_startRadians);
 		shader->setUniform("threadOffset", threadOffset);
 		shader->setUniform("zigzag", GLuint(1));
@@ -131,23 +95,27 @@ void AerialZigZagBuilder::buildRaysGPU(ALSParameters* parameters, LiDARParameter
 	}
 }
 
-void AerialZigZagBuilder::throwRays(ALSParameters* parameters, LiDARParameters* LiDARParams, std::vector<Model3D::RayGPUData>& rays, const vec3& LiDARPosition, const float startAngle, const float fov,
-								    const unsigned numPulses, const float zigZagSign, const float advancePulse, unsigned baseIndex)
+void AerialZigZagBuilder::throwPulses(LiDARParameters* LiDARParams, const unsigned firstPulse, const unsigned numPulses, std::vector<Model3D::RayGPUData>& rays)
 {
-	vec3 spherePosition, sensorPosition;
-	float baseAngle = zigZagSign * startAngle, angleIncrement = fov / numPulses;
+	ALSParameters* parameters = dynamic_cast<ALSParameters*>(_parameters);
+	const unsigned seed = LiDARParams->_randomSeed, pathLength = parameters->_pathLength;
+	const float angleIncrement = parameters->_fovRadians / parameters->_numPulsesScan;
 
-	//#pragma omp parallel for
-	for (int rayIdx = 0; rayIdx < numPulses; ++rayIdx)
+	// The direction of each scan only depends on its index, hence the result does not depend on the number of threads nor the size of the batch
+	#pragma omp parallel for
+	for (int batchPulseIdx = 0; batchPulseIdx < static_cast<int>(numPulses); ++batchPulseIdx)
 	{
-		float angle = baseAngle + zigZagSign * angleIncrement * rayIdx;
-
-		spherePosition = vec3(RandomUtilities::getUniformRandomValue() * LiDARParams->_alsRayJittering, 
-							  -std::cos(angle) + RandomUtilities::getUniformRandomValue() * LiDARParams->_alsRayJittering, 
-							  -std::sin(angle) + RandomUtilities::getUniformRandomValue() * LiDARParams->_alsRayJittering);
-		sensorPosition = LiDARPosition + vec3(advancePulse * rayIdx, RandomUtilities::getUniformRandomValue() * LiDARParams->_alsHeightJittering, .0f);
-
-		rays[baseIndex + rayIdx * LiDARParams->_raysPulse] = Model3D::RayGPUData(sensorPosition, sensorPosition + spherePosition);
-		this->addPulseRadius(rays, baseIndex + rayIdx * LiDARParams->_raysPulse, parameters->_upVector, LiDARParams->_raysPulse, LiDARParams->_pulseRadius);
+		const unsigned pulseIdx = firstPulse + batchPulseIdx, scanIdx = pulseIdx / parameters->_numPulsesScan, scanPulseIdx = pulseIdx % parameters->_numPulsesScan;
+		const unsigned point = scanIdx / (pathLength - 1) * pathLength + scanIdx % (pathLength - 1) + 1, baseIndex = batchPulseIdx * LiDARParams->_raysPulse;
+		const float zigZagSign = scanIdx % 2 == 0 ? 1.0f : -1.0f;
+
+		float angle = zigZagSign * parameters->_startRadians + zigZagSign * angleIncrement * scanPulseIdx;
+		vec3 spherePosition = vec3(getJittering(seed, pulseIdx, RAY_NOISE_STREAM.x) * LiDARParams->_alsRayJittering, 
+								   -std::cos(angle) + getJittering(seed, pulseIdx, RAY_NOISE_STREAM.y) * LiDARParams->_alsRayJittering, 
+								   -std::sin(angle) + getJittering(seed, pulseIdx, RAY_NOISE_STREAM.z) * LiDARParams->_alsRayJittering);
+		vec3 sensorPosition = vec3(parameters->_waypoints[point]) + vec3(parameters->_advancePulse * scanPulseIdx, getJittering(seed, pulseIdx, HEIGHT_NOISE_STREAM) * LiDARParams->_alsHeightJittering, .0f);
+
+		rays[baseIndex] = Model3D::RayGPUData(sensorPosition, sensorPosition + spherePosition);
+		this->addPulseRadius(rays, baseIndex, parameters->_upVector, LiDARParams->_raysPulse, LiDARParams->_pulseRadius, pulseIdx, seed);
 	}
 }
\ No newline at end of file
@@ -20,20 +20,14 @@ protected:
 	ALSParameters* buildParameters(LiDARParameters* LiDARParams, AABB& sceneAABB);
 
 	/**
-	*	@brief Builds rays to be launched in CPU.
+	*	@brief Builds a range of pulses in CPU.
 	*/
-	virtual void buildRaysCPU(ALSParameters* parameters, LiDARParameters* LiDARParams, AABB& sceneAABB);
+	virtual void throwPulses(LiDARParameters* LiDARParams, const unsigned firstPulse, const unsigned numPulses, std::vector<Model3D::RayGPUData>& rays);
 
 	/**
 	*	@brief Builds rays to be launched in GPU.
 	*/
 	virtual void buildRaysGPU(ALSParameters* parameters, LiDARParameters* LiDARParams, AABB& sceneAABB);
-	
-	/**
-	*	@brief
-	*/
-	void throwRays(ALSParameters* parameters, LiDARParameters* LiDARParams, std::vector<Model3D::RayGPUData>& rays, const vec3& LiDARPosition, const float startAngle, 
-				   const float fov, const unsigned numPulses, const float zigZagSign, const float advancePulse, unsigned baseIndex);
 
 public:
 	/**
@@ -10,6 +10,7 @@
 #include "Graphics/Core/VAO.h"
 #include "Utilities/FileManagement.h"
 #include "Utilities/ChronoUtilities.h"
+#include "Utilities/MemoryMappedFile.h"
 
 // Initialization of static attributes
 std::unordered_map<std::string, std::unique_ptr<Material>>	CADModel::_cadMaterials;
@@ -20,6 +21,12 @@ const std::string CADModel::CUSTOM_CLASSES_EXTENSION	= ".semanticCustom";
 const std::string CADModel::MATERIAL_EXTENSION			= ".LiDARMaterial";
 const std::string CADModel::OBJ_EXTENSION				= ".obj";
 
+const uint32_t CADModel::BINARY_ALIGNMENT				= 64;
+const char CADModel::BINARY_SIGNATURE[4]				= { 'L', 'B', 'I', 'N' };
+const uint32_t CADModel::BINARY_VERSION					= 3;
+
+static_assert(sizeof(CADModel::BinaryHeader) % 8 == 0, "Component table must be aligned after the header");
+
 /// [Public methods]
 
 CADModel::CADModel(const std::string& filename, const std::string& textureFolder, const bool useBinary) : 
@@ -28,6 +35,7 @@ CADModel::CADModel(const std::string& filename, const std::string& textureFolder
 	_filename = filename;
 	_textureFolder = textureFolder;
 	_useBinary = useBinary;
+	_binaryExists = _binaryOutdated = _read = _readFromBinary = _readSuccess = false;
 }
 
 CADModel::~CADModel()
@@ -38,16 +46,11 @@ bool CADModel::load(const mat4& modelMatrix)
 {
 	if (!_loaded)
 	{
-		bool success = false, binaryExists = false;
+		bool success = this->read();
 
-		if (_useBinary && (binaryExists = std::filesystem::exists(_filename + BINARY_EXTENSION)))
-		{
-			success = this->loadModelFromBinaryFile();
-		}
-			
-		if (!success)
+		if (success)
 		{
-			success = this->loadModelFromOBJ(modelMatrix);
+			success = _readFromBinary ? this->loadModelFromBinaryFile() : this->loadModelFromOBJ(modelMatrix);
 		}
 
 		if (success)
@@ -57,7 +60,7 @@ bool CADModel::load(const mat4& modelMatrix)
 			this->assignMaterial();
 		}
 
-		if (!binaryExists && success)
+		if ((!_binaryExists || _binaryOutdated) && success)
 		{
 			this->writeToBinary();
 		}
@@ -68,6 +71,19 @@ bool CADModel::load(const mat4& modelMatrix)
 	return _loaded;
 }
 
+bool CADModel::read()
+{
+	if (!_read)
+	{
+		_binaryExists = _useBinary && std::filesystem::exists(_filename + BINARY_EXTENSION);
+		_readFromBinary = _binaryExists && this->readBinary(_filename + BINARY_EXTENSION, _modelComp);
+		_readSuccess = _readFromBinary || this->readOBJ();
+		_read = true;
+	}
+
+	return _readSuccess;
+}
+
 /// [Protected methods]
 
 bool CADModel::assignASPRSClasses()
@@ -202,10 +218,37 @@ void CADModel::computeMeshData(ModelComponent* modelComp)
 	glDeleteBuffers(1, &outBufferID);
 }
 
+void CADModel::computeMeshDataCPU(ModelComponent* modelComp)
+{
+	const int numFaces = modelComp->_topology.size();
+	modelComp->_triangleMesh.resize(numFaces * 4);
+
+	#pragma omp parallel for
+	for (int faceIdx = 0; faceIdx < numFaces; ++faceIdx)
+	{
+		FaceGPUData& face = modelComp->_topology[faceIdx];
+		const vec3 a = modelComp->_geometry[face._vertices.x]._position;
+		const vec3 b = modelComp->_geometry[face._vertices.y]._position;
+		const vec3 c = modelComp->_geometry[face._vertices.z]._position;
+
+		modelComp->_triangleMesh[faceIdx * 4]		= face._vertices.x;
+		modelComp->_triangleMesh[faceIdx * 4 + 1]	= face._vertices.y;
+		modelComp->_triangleMesh[faceIdx * 4 + 2]	= face._vertices.z;
+		modelComp->_triangleMesh[faceIdx * 4 + 3]	= Model3D::RESTART_PRIMITIVE_INDEX;
+
+		// Boundaries and location data for BVH
+		face._minPoint	= glm::min(a, glm::min(b, c));
+		face._maxPoint	= glm::max(a, glm::max(b, c));
+		face._normal	= glm::normalize(glm::cross(b - a, c - a));
+	}
+}
+
 Material* CADModel::createMaterial(ModelComponent* modelComp)
 {
 	static const std::string nullMaterialName = "None";
 
+	if (HEADLESS) return nullptr;											// Textures need an OpenGL context; colors are taken from the model description instead
+
 	Material* material = MaterialList::getInstance()->getMaterial(CGAppEnum::MATERIAL_CAD_WHITE);
 	Model3D::ModelComponentDescription* modelDescription = &modelComp->_modelDescription;
 	TextureList* textureList = TextureList::getInstance();
@@ -289,13 +332,18 @@ void CADModel::createModelComponent(objl::Mesh* mesh, ModelComponent* modelComp)
 	if (!modelComp->_material)
 	{
 		modelComp->_modelDescription = Model3D::ModelComponentDescription(mesh);
-		modelComp->_material = this->createMaterial(modelComp);
 		modelComp->setName(modelComp->_modelDescription._modelName);
 	}
 }
 
 void CADModel::generateGeometryTopology(Model3D::ModelComponent* modelComp, const mat4& modelMatrix)
 {
+	if (HEADLESS)
+	{
+		this->generateGeometryTopologyCPU(modelComp, modelMatrix);
+		return;
+	}
+
 	ComputeShader* shader = ShaderList::getInstance()->getComputeShader(RendEnum::MODEL_APPLY_MODEL_MATRIX);
 	const int arraySize = modelComp->_geometry.size();
 	const int numGroups = ComputeShader::getNumGroups(arraySize);
@@ -317,10 +365,22 @@ void CADModel::generateGeometryTopology(Model3D::ModelComponent* modelComp, cons
 	this->computeMeshData(modelComp);
 
 	glDeleteBuffers(1, &modelBufferID);
+}
 
-	// Wireframe & point cloud are derived from previous operations
-	modelComp->buildPointCloudTopology();
-	modelComp->buildWireframeTopology();
+void CADModel::generateGeometryTopologyCPU(Model3D::ModelComponent* modelComp, const mat4& modelMatrix)
+{
+	const mat4 mModel = modelMatrix * _modelMatrix;
+
+	#pragma omp parallel for
+	for (int vertexIdx = 0; vertexIdx < modelComp->_geometry.size(); ++vertexIdx)
+	{
+		VertexGPUData& vertex = modelComp->_geometry[vertexIdx];
+		vertex._position	= vec3(mModel * vec4(vertex._position, 1.0f));
+		vertex._normal		= vec3(mModel * vec4(vertex._normal, .0f));
+	}
+
+	this->computeTangentsCPU(modelComp);
+	this->computeMeshDataCPU(modelComp);
 }
 
 std::string CADModel::getKeyValue(std::map<std::string, std::string>& keyMap, std::string& modelName, std::string& defaultClass)
@@ -352,22 +412,41 @@ std::string CADModel::getKeyValue(std::map<std::string, std::string>& keyMap, st
 
 bool CADModel::loadModelFromBinaryFile()
 {
-	bool success;
-
-	if (success = this->readBinary(_filename +  BINARY_EXTENSION, _modelComp))
+	for (ModelComponent* modelComp : _modelComp)
 	{
-		for (ModelComponent* modelComp : _modelComp)
-		{
-			modelComp->_material = this->createMaterial(modelComp);
-			modelComp->setName(modelComp->_modelDescription._modelName);
-			this->setVAOData(modelComp);
-		}
+		modelComp->_material = this->createMaterial(modelComp);
+		modelComp->setName(modelComp->_modelDescription._modelName);
+		this->setVAOData(modelComp);
 	}
 
-	return success;
+	return true;
 }
 
 bool CADModel::loadModelFromOBJ(const mat4& modelMatrix)
+{
+	for (ModelComponent* modelComp : _modelComp)
+	{
+		if (!modelComp->_material) modelComp->_material = this->createMaterial(modelComp);
+		this->generateGeometryTopology(modelComp, modelMatrix);
+	}
+
+	// Wireframe & point cloud are derived from previous operations, and they only involve CPU
+	#pragma omp parallel for schedule(dynamic)
+	for (int modelCompIdx = 0; modelCompIdx < _modelComp.size(); ++modelCompIdx)
+	{
+		_modelComp[modelCompIdx]->buildPointCloudTopology();
+		_modelComp[modelCompIdx]->buildWireframeTopology();
+	}
+
+	for (ModelComponent* modelComp : _modelComp)
+	{
+		this->setVAOData(modelComp);
+	}
+
+	return true;
+}
+
+bool CADModel::readOBJ()
 {
 	objl::Loader loader;
 	bool success = loader.LoadFile(_filename + OBJ_EXTENSION);
@@ -396,8 +475,6 @@ bool CADModel::loadModelFromOBJ(const mat4& modelMatrix)
 		for (int i = 0; i < loader.LoadedMeshes.size(); i++)
 		{
 			this->createModelComponent(&(loader.LoadedMeshes[i]), _modelComp[i]);
-			this->generateGeometryTopology(_modelComp[i], modelMatrix);
-			this->setVAOData(_modelComp[i]);
 
 			currentModelName = std::string(_modelComp[i]->_modelDescription._modelName);
 			numNameCollisions += currentModelName == modelName;
@@ -415,7 +492,96 @@ bool CADModel::loadModelFromOBJ(const mat4& modelMatrix)
 	return success;
 }
 
+uint64_t CADModel::getChecksum(const char* data, const size_t size, uint64_t hash)
+{
+	for (size_t byteIdx = 0; byteIdx < size; ++byteIdx)
+	{
+		hash ^= uint8_t(data[byteIdx]);
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
 bool CADModel::readBinary(const std::string& filename, const std::vector<Model3D::ModelComponent*>& modelComp)
+{
+	const size_t elementSize[NUM_BINARY_ARRAYS] = { sizeof(Model3D::VertexGPUData), sizeof(Model3D::FaceGPUData), sizeof(GLuint), sizeof(GLuint), sizeof(GLuint) };
+
+	MemoryMappedFile file;
+	BinaryHeader header;
+
+	// Any file which cannot be read is rewritten once the model is loaded from the OBJ file
+	_binaryOutdated = true;
+
+	if (!file.open(filename))
+	{
+		return false;
+	}
+
+	if (file.size() < sizeof(BinaryHeader) || std::memcmp(file.data(), BINARY_SIGNATURE, sizeof(BINARY_SIGNATURE)) != 0)
+	{
+		file.close();
+		return this->readLegacyBinary(filename);
+	}
+
+	// Validate header, component table and array boundaries before touching any array. The checksum covers the arrays as well
+	std::memcpy(&header, file.data(), sizeof(BinaryHeader));
+	const size_t tableSize = size_t(header._numModelComps) * sizeof(BinaryComponentRecord);
+
+	if (header._version != BINARY_VERSION || header._fileSize != file.size() || sizeof(BinaryHeader) + tableSize > file.size() ||
+		getChecksum(file.data() + sizeof(BinaryHeader), file.size() - sizeof(BinaryHeader)) != header._checksum)
+	{
+		return false;
+	}
+
+	const BinaryComponentRecord* record = reinterpret_cast<const BinaryComponentRecord*>(file.data() + sizeof(BinaryHeader));
+
+	for (unsigned compIdx = 0; compIdx < header._numModelComps; ++compIdx)
+	{
+		for (int arrayIdx = 0; arrayIdx < NUM_BINARY_ARRAYS; ++arrayIdx)
+		{
+			if (record[compIdx]._offset[arrayIdx] + record[compIdx]._count[arrayIdx] * elementSize[arrayIdx] > file.size()) return false;
+		}
+	}
+
+	while (_modelComp.size() < header._numModelComps)
+	{
+		_modelComp.push_back(new ModelComponent(this));
+	}
+
+	// Arrays are copied straight from the mapped pages, without intermediate buffers
+	#pragma omp parallel for schedule(dynamic)
+	for (int compIdx = 0; compIdx < int(header._numModelComps); ++compIdx)
+	{
+		const BinaryComponentRecord& compRecord = record[compIdx];
+		Model3D::ModelComponent* model = modelComp[compIdx];
+
+		auto getArray = [&](const BinaryArray array) -> const char* { return file.data() + compRecord._offset[array]; };
+
+		const Model3D::VertexGPUData* geometry = reinterpret_cast<const Model3D::VertexGPUData*>(getArray(BINARY_GEOMETRY));
+		model->_geometry.assign(geometry, geometry + compRecord._count[BINARY_GEOMETRY]);
+
+		const Model3D::FaceGPUData* topology = reinterpret_cast<const Model3D::FaceGPUData*>(getArray(BINARY_TOPOLOGY));
+		model->_topology.assign(topology, topology + compRecord._count[BINARY_TOPOLOGY]);
+
+		const GLuint* triangleMesh = reinterpret_cast<const GLuint*>(getArray(BINARY_TRIANGLE_MESH));
+		model->_triangleMesh.assign(triangleMesh, triangleMesh + compRecord._count[BINARY_TRIANGLE_MESH]);
+
+		const GLuint* pointCloud = reinterpret_cast<const GLuint*>(getArray(BINARY_POINT_CLOUD));
+		model->_pointCloud.assign(pointCloud, pointCloud + compRecord._count[BINARY_POINT_CLOUD]);
+
+		const GLuint* wireframe = reinterpret_cast<const GLuint*>(getArray(BINARY_WIREFRAME));
+		model->_wireframe.assign(wireframe, wireframe + compRecord._count[BINARY_WIREFRAME]);
+
+		model->_modelDescription = compRecord._modelDescription;
+	}
+
+	_binaryOutdated = false;
+
+	return true;
+}
+
+bool CADModel::readLegacyBinary(const std::string& filename)
 {
 	std::ifstream fin(filename, std::ios::in | std::ios::binary);
 	if (!fin.is_open())
@@ -431,7 +597,7 @@ bool CADModel::readBinary(const std::string& filename, const std::vector<Model3D
 		_modelComp.push_back(new ModelComponent(this));
 	}
 
-	for (Model3D::ModelComponent* model : modelComp)
+	for (Model3D::ModelComponent* model : _modelComp)
 	{
 		fin.read((char*)&numVertices, sizeof(size_t));
 		model->_geometry.resize(numVertices);
@@ -536,12 +702,14 @@ void CADModel::readClassFile(const std::string& filename, std::map<std::string,
 
 void CADModel::setVAOData(ModelComponent* modelComp)
 {
-	VAO* vao = new VAO(true);
-
 	modelComp->_topologyIndicesLength[RendEnum::IBO_POINT_CLOUD] = modelComp->_pointCloud.size();
 	modelComp->_topologyIndicesLength[RendEnum::IBO_WIREFRAME] = modelComp->_wireframe.size();
 	modelComp->_topologyIndicesLength[RendEnum::IBO_TRIANGLE_MESH] = modelComp->_triangleMesh.size();
 
+	if (HEADLESS) return;
+
+	VAO* vao = new VAO(true);
+
 	vao->setVBOData(modelComp->_geometry);
 	vao->setIBOData(RendEnum::IBO_POINT_CLOUD, modelComp->_pointCloud);
 	vao->setIBOData(RendEnum::IBO_WIREFRAME, modelComp->_wireframe);
@@ -552,42 +720,77 @@ void CADModel::setVAOData(ModelComponent* modelComp)
 
 bool CADModel::writeToBinary()
 {
-	std::ofstream fout(_filename + ".bin", std::ios::out | std::ios::binary);
-	if (!fout.is_open())
-	{
-		return false;
-	}
+	const size_t elementSize[NUM_BINARY_ARRAYS] = { sizeof(Model3D::VertexGPUData), sizeof(Model3D::FaceGPUData), sizeof(GLuint), sizeof(GLuint), sizeof(GLuint) };
+	auto alignOffset = [](const uint64_t offset) -> uint64_t { return (offset + BINARY_ALIGNMENT - 1) / BINARY_ALIGNMENT * BINARY_ALIGNMENT; };
+	auto getArray = [](Model3D::ModelComponent* model, const int array) -> std::pair<const char*, size_t>
+		{
+			switch (array)
+			{
+			case BINARY_GEOMETRY:		return { (const char*)model->_geometry.data(), model->_geometry.size() };
+			case BINARY_TOPOLOGY:		return { (const char*)model->_topology.data(), model->_topology.size() };
+			case BINARY_TRIANGLE_MESH:	return { (const char*)model->_triangleMesh.data(), model->_triangleMesh.size() };
+			case BINARY_POINT_CLOUD:	return { (const char*)model->_pointCloud.data(), model->_pointCloud.size() };
+			default:					return { (const char*)model->_wireframe.data(), model->_wireframe.size() };
+			}
+		};
 
-	size_t numIndices;
-	const size_t numModelComps = _modelComp.size();
-	fout.write((char*)&numModelComps, sizeof(size_t));
+	// Layout: header, component table and arrays aligned to BINARY_ALIGNMENT
+	std::vector<BinaryComponentRecord> record(_modelComp.size());
+	uint64_t offset = alignOffset(sizeof(BinaryHeader) + record.size() * sizeof(BinaryComponentRecord));
 
-	for (Model3D::ModelComponent* model : _modelComp)
+	for (unsigned compIdx = 0; compIdx < _modelComp.size(); ++compIdx)
 	{
-		const size_t numVertices = model->_geometry.size();
-		fout.write((char*)&numVertices, sizeof(size_t));
-		fout.write((char*)&model->_geometry[0], numVertices * sizeof(Model3D::VertexGPUData));
+		std::memset(&record[compIdx], 0, sizeof(BinaryComponentRecord));			// Padding bytes take part in the checksum
+		record[compIdx]._modelDescription = _modelComp[compIdx]->_modelDescription;
 
-		const size_t numTriangles = model->_topology.size();
-		fout.write((char*)&numTriangles, sizeof(size_t));
-		fout.write((char*)&model->_topology[0], numTriangles * sizeof(Model3D::FaceGPUData));
+		for (int arrayIdx = 0; arrayIdx < NUM_BINARY_ARRAYS; ++arrayIdx)
+		{
+			record[compIdx]._offset[arrayIdx] = offset;
+			record[compIdx]._count[arrayIdx] = getArray(_modelComp[compIdx], arrayIdx).second;
+			offset = alignOffset(offset + record[compIdx]._count[arrayIdx] * elementSize[arrayIdx]);
+		}
+	}
 
-		numIndices = model->_triangleMesh.size();
-		fout.write((char*)&numIndices, sizeof(size_t));
-		fout.write((char*)&model->_triangleMesh[0], numIndices * sizeof(GLuint));
+	// Visits every range after the header in file order, so that the checksum is computed over the same bytes that are written
+	const std::vector<char> padding(BINARY_ALIGNMENT, 0);
+	auto visitPayload = [&](const std::function<void(const char*, size_t)>& visit)
+		{
+			uint64_t writtenBytes = sizeof(BinaryHeader) + record.size() * sizeof(BinaryComponentRecord);
+			visit((const char*)record.data(), record.size() * sizeof(BinaryComponentRecord));
 
-		numIndices = model->_pointCloud.size();
-		fout.write((char*)&numIndices, sizeof(size_t));
-		fout.write((char*)&model->_pointCloud[0], numIndices * sizeof(GLuint));
+			for (unsigned compIdx = 0; compIdx < _modelComp.size(); ++compIdx)
+			{
+				for (int arrayIdx = 0; arrayIdx < NUM_BINARY_ARRAYS; ++arrayIdx)
+				{
+					const std::pair<const char*, size_t> array = getArray(_modelComp[compIdx], arrayIdx);
 
-		numIndices = model->_wireframe.size();
-		fout.write((char*)&numIndices, sizeof(size_t));
-		fout.write((char*)&model->_wireframe[0], numIndices * sizeof(GLuint));
+					visit(padding.data(), record[compIdx]._offset[arrayIdx] - writtenBytes);
+					visit(array.first, array.second * elementSize[arrayIdx]);
+					writtenBytes = record[compIdx]._offset[arrayIdx] + array.second * elementSize[arrayIdx];
+				}
+			}
+
+			visit(padding.data(), offset - writtenBytes);
+		};
 
-		fout.write((char*)&model->_modelDescription, sizeof(Model3D::ModelComponentDescription));
+	BinaryHeader header;
+	std::memcpy(header._signature, BINARY_SIGNATURE, sizeof(BINARY_SIGNATURE));
+	header._version = BINARY_VERSION;
+	header._numModelComps = uint32_t(_modelComp.size());
+	header._alignment = BINARY_ALIGNMENT;
+	header._fileSize = offset;
+	header._checksum = 0xcbf29ce484222325ull;
+	visitPayload([&](const char* data, size_t size) { header._checksum = getChecksum(data, size, header._checksum); });
+
+	std::ofstream fout(_filename + BINARY_EXTENSION, std::ios::out | std::ios::binary);
+	if (!fout.is_open())
+	{
+		return false;
 	}
 
+	fout.write((char*)&header, sizeof(BinaryHeader));
+	visitPayload([&](const char* data, size_t size) { fout.write(data, size); });
 	fout.close();
 
-	return true;
+	return !fout.fail();
 }
\ No newline at end of file
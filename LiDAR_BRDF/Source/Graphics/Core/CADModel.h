@@ -16,9 +16,45 @@
 */
 class CADModel: public Model3D
 {
+protected:
+	/**
+	*	@brief Arrays stored for each model component in a binary file.
+	*/
+	enum BinaryArray : uint8_t
+	{
+		BINARY_GEOMETRY, BINARY_TOPOLOGY, BINARY_TRIANGLE_MESH, BINARY_POINT_CLOUD, BINARY_WIREFRAME, NUM_BINARY_ARRAYS
+	};
+
+	/**
+	*	@brief Header of a binary file (version 2). Counts and offsets have fixed width regardless of the host.
+	*/
+	struct BinaryHeader
+	{
+		char		_signature[4];								//!< BINARY_SIGNATURE
+		uint32_t	_version;									//!< BINARY_VERSION
+		uint32_t	_numModelComps;								//!< Number of records of the component table, which follows the header
+		uint32_t	_alignment;									//!< Alignment of every array in bytes
+		uint64_t	_fileSize;									//!< Detects truncated files
+		uint64_t	_checksum;									//!< FNV-1a hash of everything after the header, i.e. component table, arrays and padding
+	};
+
+	/**
+	*	@brief Entry of the component table. Arrays can be read directly from a mapping of the file.
+	*/
+	struct BinaryComponentRecord
+	{
+		uint64_t	_offset[NUM_BINARY_ARRAYS];					//!< Offset in bytes of each array from the beginning of the file
+		uint64_t	_count[NUM_BINARY_ARRAYS];					//!< Number of elements of each array
+		Model3D::ModelComponentDescription _modelDescription;	//!< Material and name
+	};
+
 protected:
 	static std::unordered_map<std::string, std::unique_ptr<Material>> _cadMaterials;
 
+	const static uint32_t		BINARY_ALIGNMENT;			//!< Arrays are aligned to cache lines
+	const static char			BINARY_SIGNATURE[4];		//!< First bytes of a binary file since version 2
+	const static uint32_t		BINARY_VERSION;				//!< Current version of binary files
+
 public:
 	const static std::string ASPRS_CLASSES_EXTENSION;		//!< File extension for ASPRS semantic concepts
 	const static std::string BINARY_EXTENSION;				//!< File extension for binary models
@@ -31,6 +67,13 @@ protected:
 	std::string _textureFolder;								//!< Folder where model textures may be located
 	bool		_useBinary;									//!< Use binary file instead of original obj models
 
+	// [Reading state] Models are read from disk before transferring them to GPU
+	bool		_binaryExists;								//!< A binary file was found while reading
+	bool		_binaryOutdated;							//!< The binary file has a previous version or is corrupt, and must be rewritten
+	bool		_read;										//!< Files were already read
+	bool		_readFromBinary;							//!< Topologies are complete, as they were stored in the binary file
+	bool		_readSuccess;								//!< Success of reading process
+
 protected:
 	/**
 	*	@brief Assigns ASPRS classes from file to models.
@@ -52,41 +95,67 @@ protected:
 	*/
 	void computeMeshData(Model3D::ModelComponent* modelComp);
 
+	/**
+	*	@brief Computes the triangle mesh buffer, the face boundaries and normals in CPU, as in the compute shader of computeMeshData.
+	*/
+	void computeMeshDataCPU(Model3D::ModelComponent* modelComp);
+
 	/**
 	*	@brief Creates a new material from the attributes of a model component.
 	*/
 	Material* createMaterial(ModelComponent* modelComp);
 
 	/**
-	*	@brief Initializes a model component with the content of a mesh.
+	*	@brief Initializes a model component with the content of a mesh. Its material is not created, as it may need OpenGL.
 	*/
 	void createModelComponent(objl::Mesh* mesh, ModelComponent* modelComp);
 
 	/**
-	*	@brief Generates geometry via GPU.
+	*	@brief Generates geometry via GPU. Point cloud and wireframe topologies are not built here.
 	*/
 	void generateGeometryTopology(Model3D::ModelComponent* modelComp, const mat4& modelMatrix);
 
+	/**
+	*	@brief Generates geometry in CPU when there is no OpenGL context. Displacement mapping is not applied, as it needs textures.
+	*/
+	void generateGeometryTopologyCPU(Model3D::ModelComponent* modelComp, const mat4& modelMatrix);
+
 	/**
 	*	@brief Searchs the class in keyMap of a model whose name is given by modelName.
 	*/
 	std::string getKeyValue(std::map<std::string, std::string>& keyMap, std::string& modelName, std::string& defaultClass);
 
 	/**
-	*	@brief Fills the content of model component with binary file data.
+	*	@brief Transfers the model components read from a binary file to GPU.
 	*/
 	bool loadModelFromBinaryFile();
 
 	/**
-	*	@brief Generates geometry via GPU.
+	*	@brief Completes the model components read from an OBJ file via GPU, and transfers them for rendering.
 	*/
 	bool loadModelFromOBJ(const mat4& modelMatrix);
 
 	/**
-	*	@brief Loads the CAD model from a binary file, if possible.
+	*	@return FNV-1a hash of a sequence of bytes.
+	*	@param hash Hash of the preceding bytes, so that non-contiguous ranges are hashed as a single sequence.
+	*/
+	static uint64_t getChecksum(const char* data, const size_t size, uint64_t hash = 0xcbf29ce484222325ull);
+
+	/**
+	*	@brief Loads the CAD model from a binary file, if possible. Files without header are read with the first layout and marked as outdated.
 	*/
 	bool readBinary(const std::string& filename, const std::vector<Model3D::ModelComponent*>& modelComp);
 
+	/**
+	*	@brief Reads a binary file written before the header was introduced, i.e. a sequence of size_t counts followed by their arrays.
+	*/
+	bool readLegacyBinary(const std::string& filename);
+
+	/**
+	*	@brief Parses the OBJ file into model components.
+	*/
+	bool readOBJ();
+
 	/**
 	*	@brief Loads all the pair class-value in a file.
 	*/
@@ -98,7 +167,8 @@ protected:
 	void setVAOData(ModelComponent* modelComp);
 
 	/**
-	*	@brief Writes the model to a binary file in order to fasten the following executions.
+	*	@brief Writes the model to a binary file in order to fasten the following executions. The current version is always written, 
+	*	so that outdated files are converted the first time they are loaded.
 	*	@return Success of writing process.
 	*/
 	bool writeToBinary();
@@ -128,6 +198,13 @@ public:
 	*/
 	virtual bool load(const mat4& modelMatrix = mat4(1.0f));
 
+	/**
+	*	@brief Reads the geometry and topology from disk without issuing OpenGL calls, hence several models can be read concurrently. 
+	*	GPU-dependent steps are completed by load, which reads the model itself if this method was not called before.
+	*	@return Success of operation.
+	*/
+	bool read();
+
 	/**
 	*	@brief Deleted assignment operator.
 	*	@param model Model to copy attributes.
@@ -129,6 +129,13 @@ public:
 	*/
 	template<typename T>
 	static void updateReadBuffer(const GLuint id, const T* data, const unsigned arraySize, const GLuint changeFrequency = GL_DYNAMIC_DRAW);
+
+	/**
+	*	@brief Overwrites a range of an already allocated buffer, so that large arrays can be uploaded by pieces.
+	*	@param offset First element (not byte) of the buffer to be overwritten.
+	*/
+	template<typename T>
+	static void updateReadBufferRange(const GLuint id, const T* data, const unsigned offset, const unsigned arraySize);
 };
 
 template<typename T>
@@ -201,3 +208,10 @@ inline void ComputeShader::updateReadBuffer(const GLuint id, const T* data, cons
 	glBindBuffer(GL_SHADER_STORAGE_BUFFER, id);
 	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(T) * arraySize, data, changeFrequency);
 }
+
+template<typename T>
+inline void ComputeShader::updateReadBufferRange(const GLuint id, const T* data, const unsigned offset, const unsigned arraySize)
+{
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, id);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(T) * static_cast<GLintptr>(offset), sizeof(T) * static_cast<GLsizeiptr>(arraySize), data);
+}
@@ -1,24 +1,42 @@
 #include "stdafx.h"
 #include "Group3D.h"
 
+#include <atomic>
+#include <iomanip>
 #include "Geometry/3D/Ray3D.h"
 #include "Geometry/3D/TriangleMesh.h"
 #include "Geometry/3D/Intersections3D.h"
 #include "Graphics/Application/Renderer.h"
 #include "Graphics/Application/RenderingParameters.h"
+#include "Graphics/Core/InstancedModel.h"
 #include "Graphics/Core/OpenGLUtilities.h"
 #include "Graphics/Core/ShaderList.h"
 #include "Graphics/Core/VAO.h"
 #include "Utilities/ChronoUtilities.h"
 
 /// [Initialization of static attributes]
-const GLuint	Group3D::BVH_BUILDING_RADIUS = 100;
+const GLuint		Group3D::BVH_BUILDING_RADIUS = 100;
+const std::string	Group3D::BVH_CACHE_EXTENSION = ".bvh";
+const std::string	Group3D::BVH_CACHE_FOLDER = "Assets/Cache/";
+const uint32_t		Group3D::BVH_CACHE_VERSION = 4;
+const GLuint		Group3D::BVH_INSTANCE_FLAG = 0x80000000;
+const GLuint		Group3D::BVH_RADIX_SORT_DIGIT_BITS = 8;
+const float			Group3D::BVH_INTERSECTION_COST = 1.0f;
+const GLuint		Group3D::BVH_NULL_INDEX = 0xFFFFFFF;
+const float			Group3D::BVH_REFIT_MAX_DEGRADATION = 1.5f;
+const GLuint		Group3D::BVH_SAH_BINS = 16;
+const GLuint		Group3D::BVH_SAH_PARALLEL_SIZE = 1 << 16;
+const GLuint		Group3D::BVH_SAH_SUBTREE_SIZE = 1 << 12;
+const float			Group3D::BVH_SPLIT_AREA_RATIO = 4.0f;
+const GLuint		Group3D::BVH_SPLIT_MAX_DEPTH = 4;
+const float			Group3D::BVH_SPLIT_SCENE_AREA = 0.01f;
+const float			Group3D::BVH_TRAVERSAL_COST = 1.0f;
 
 /// [Public methods]
 
 Group3D::Group3D(const mat4& modelMatrix):
 	Model3D(modelMatrix, 1),									// Just in case we need to save some component properties
-	_numClusters(0), _bvhVAO(nullptr), _staticGPUData(nullptr)
+	_bvhBuilder(PLOC_BUILDER), _bvhSAHCost(.0f), _gpuBuffers(true), _maxLeafFaces(1), _numClusters(0), _preSplitFaces(false), _bvhVAO(nullptr), _staticGPUData(nullptr), _staticCPUData(nullptr)
 {
 }
 
@@ -29,8 +47,14 @@ Group3D::~Group3D()
 		delete object;
 	}
 
+	for (Model3D* prototype : _prototypes)
+	{
+		delete prototype;
+	}
+
 	delete _bvhVAO;
 	delete _staticGPUData;
+	delete _staticCPUData;
 }
 
 void Group3D::addComponent(Model3D* object)
@@ -38,144 +62,74 @@ void Group3D::addComponent(Model3D* object)
 	_objects.push_back(object);
 }
 
-Group3D::StaticGPUData* Group3D::generateBVH(bool buildVisualization)
+void Group3D::addInstance(Model3D* prototype, const mat4& modelMatrix)
 {
-	VolatileGPUData* volatileGPUData;
-
-	this->retrieveColorsGPU();
-	this->aggregateSSBOData(volatileGPUData, _staticGPUData);
-
-	// BVH generation
-	const unsigned radius = BVH_BUILDING_RADIUS;
-	
-	ComputeShader* findNeighborShader		= ShaderList::getInstance()->getComputeShader(RendEnum::FIND_BEST_NEIGHBOR);
-	ComputeShader* clusterMergingShader		= ShaderList::getInstance()->getComputeShader(RendEnum::CLUSTER_MERGING);
-	ComputeShader* reallocClustersShader	= ShaderList::getInstance()->getComputeShader(RendEnum::REALLOCATE_CLUSTERS);
-	ComputeShader* endLoopCompShader		= ShaderList::getInstance()->getComputeShader(RendEnum::END_LOOP_COMPUTATIONS);
-
-	// Prefix scan
-	ComputeShader* reduceShader				= ShaderList::getInstance()->getComputeShader(RendEnum::REDUCE_PREFIX_SCAN);
-	ComputeShader* downSweepShader			= ShaderList::getInstance()->getComputeShader(RendEnum::DOWN_SWEEP_PREFIX_SCAN);
-	ComputeShader* resetPositionShader		= ShaderList::getInstance()->getComputeShader(RendEnum::RESET_LAST_POSITION_PREFIX_SCAN);
+	if (std::find(_prototypes.begin(), _prototypes.end(), prototype) == _prototypes.end())
+	{
+		_prototypes.push_back(prototype);
+	}
 
-	// Compute shader execution data: groups and iteration control
-	unsigned arraySize = _staticGPUData->_numTriangles, startIndex = arraySize, finishBit = 0, iteration, numExec, numThreads, startThreads;
-	int numGroups, numGroups2Log;
-	const int maxGroupSize = ComputeShader::getMaxGroupSize();
+	InstancedModel* instance = new InstancedModel(prototype, modelMatrix);
+	_instances.push_back(instance);
+	_objects.push_back(instance);
+}
 
-	// Prepare buffers for GPU
-	BVHCluster* outCluster = new BVHCluster[arraySize];					// We declare an input buffer instead of asking for a GPU one cause we've proved it's faster
+Group3D::StaticGPUData* Group3D::generateBVH(bool buildVisualization)
+{
+	VolatileGPUData* volatileGPUData;
 
-	// Compact cluster buffer support
-	GLuint* currentPosBuffer = new GLuint[arraySize], *currentPosBufferOut = new GLuint[arraySize];
-	std::iota(currentPosBufferOut, currentPosBufferOut + arraySize, 0);
+	delete _staticCPUData;
+	_staticCPUData = nullptr;									// Mirror is retrieved again once it is requested
+	_bvhSAHCost = .0f;											// Reference cost for refits, measured before the first one
 
-	GLuint coutBuffer				= volatileGPUData->_tempClusterSSBO;													// Swapped during loop => not const
-	GLuint cinBuffer				= ComputeShader::setReadBuffer(outCluster, arraySize);
-	GLuint inCurrentPosition		= ComputeShader::setReadBuffer(currentPosBuffer, arraySize);		// Position of compact buffer where a cluster is saved
-	GLuint outCurrentPosition		= ComputeShader::setReadBuffer(currentPosBufferOut, arraySize);
-	const GLuint neighborIndex		= ComputeShader::setWriteBuffer(GLuint(), arraySize);				// Nearest neighbor search	
-	const GLuint prefixScan			= ComputeShader::setWriteBuffer(GLuint(), arraySize);				// Final position of each valid cluster for the next loop iteration
-	const GLuint validCluster		= ComputeShader::setWriteBuffer(GLuint(), arraySize);				// Clusters which takes part of next loop iteration
-	const GLuint mergedCluster		= ComputeShader::setWriteBuffer(GLuint(), arraySize);				// A merged cluster is always valid, but the opposite situation is not fitting
-	const GLuint numNodesCount		= ComputeShader::setReadData(arraySize);							// Number of currently added nodes, which increases as the clusters are merged
-	const GLuint arraySizeCount		= ComputeShader::setWriteBuffer(GLuint(), 1);
+	if (Model3D::HEADLESS)
+		this->retrieveColorsCPU();
+	else
+		this->retrieveColorsGPU();
 
-	while (arraySize > 1)
+	if (!_gpuBuffers && _bvhBuilder == PLOC_BUILDER)
 	{
-		// Binary tree and whole array group sizes and iteration boundaries
-		numGroups		= ComputeShader::getNumGroups(arraySize);
-		startThreads	= std::ceil(arraySize / 2.0f);
-		numExec			= std::ceil(std::log2(arraySize));
-		numGroups2Log	= ComputeShader::getNumGroups(startThreads);
-
-		std::vector<GLuint> threadCount{ startThreads };				// Thread sizes are repeated on reduce and sweep down phases
-		threadCount.reserve(numExec);
-
-		std::swap(coutBuffer, cinBuffer);
-		std::swap(inCurrentPosition, outCurrentPosition);
-
-		findNeighborShader->bindBuffers(std::vector<GLuint>{ cinBuffer, neighborIndex });
-		findNeighborShader->use();
-		findNeighborShader->setUniform("arraySize", arraySize);
-		findNeighborShader->setUniform("radius", radius);
-		findNeighborShader->execute(numGroups, 1, 1, maxGroupSize, 1, 1);
+		std::cout << "PLOC builder needs GPU buffers; BVH is built with binned SAH instead" << std::endl;
+		_bvhBuilder = BINNED_SAH_BUILDER;
+	}
 
-		clusterMergingShader->bindBuffers(std::vector<GLuint>{ cinBuffer, _staticGPUData->_clusterSSBO, neighborIndex, validCluster, mergedCluster, 
-															   prefixScan, inCurrentPosition, numNodesCount });
-		clusterMergingShader->use();
-		clusterMergingShader->setUniform("arraySize", arraySize);
-		clusterMergingShader->execute(numGroups, 1, 1, maxGroupSize, 1, 1);
+	const uint64_t contentHash = this->computeContentHash();
+	const std::string cacheFilename = this->getBVHCacheFilename(contentHash);
 
-		// FIRST STEP: build a binary tree with a summatory of the array
-		reduceShader->bindBuffers(std::vector<GLuint> { prefixScan });
-		reduceShader->use();
-		reduceShader->setUniform("arraySize", arraySize);
+	if (this->readBVHCache(cacheFilename, contentHash))
+	{
+		std::cout << "BVH loaded from " << cacheFilename << std::endl;
 
-		iteration = 0;
-		while (iteration < numExec)
+		if (buildVisualization && !_gpuBuffers)
 		{
-			numThreads = threadCount[threadCount.size() - 1];
-
-			reduceShader->setUniform("iteration", iteration++);
-			reduceShader->setUniform("numThreads", numThreads);
-			reduceShader->execute(numGroups2Log, 1, 1, maxGroupSize, 1, 1);
-
-			threadCount.push_back(std::ceil(numThreads / 2.0f));
+			this->buildBVHVAO(_staticCPUData->_cluster);
 		}
-
-		// SECOND STEP: set last position to zero, its faster to do it in GPU than retrieve the array in CPU, modify and write it again to GPU
-		resetPositionShader->bindBuffers(std::vector<GLuint> { prefixScan });
-		resetPositionShader->use();
-		resetPositionShader->setUniform("arraySize", arraySize);
-		resetPositionShader->execute(1, 1, 1, 1, 1, 1);
-
-		// THIRD STEP: build tree back to first level and compute final summatory
-		downSweepShader->bindBuffers(std::vector<GLuint> { prefixScan });
-		downSweepShader->use();
-		downSweepShader->setUniform("arraySize", arraySize);
-
-		iteration = threadCount.size() - 2;
-		while (iteration >= 0 && iteration < numExec)
+		else if (buildVisualization)
 		{
-			downSweepShader->setUniform("iteration", iteration);
-			downSweepShader->setUniform("numThreads", threadCount[iteration--]);
-			downSweepShader->execute(numGroups2Log, 1, 1, maxGroupSize, 1, 1);
-		}
-
-		reallocClustersShader->bindBuffers(std::vector<GLuint>{ cinBuffer, coutBuffer, validCluster, prefixScan, inCurrentPosition, outCurrentPosition });
-		reallocClustersShader->use();
-		reallocClustersShader->setUniform("arraySize", arraySize);
-		reallocClustersShader->execute(numGroups, 1, 1, maxGroupSize, 1, 1);
+			// Nodes were read straight into their SSBO, hence they are retrieved once to build the VAO
+			std::vector<BVHCluster> cluster(_staticGPUData->_numClusters);
 
-		// Updates cluster size
-		endLoopCompShader->bindBuffers(std::vector<GLuint>{ arraySizeCount, prefixScan, validCluster });
-		endLoopCompShader->use();
-		endLoopCompShader->setUniform("arraySize", arraySize);
-		endLoopCompShader->execute(1, 1, 1, 1, 1, 1); 
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, _staticGPUData->_clusterSSBO);
+			glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, cluster.size() * sizeof(BVHCluster), cluster.data());
+			this->buildBVHVAO(cluster);
+		}
 
-		arraySize = endLoopCompShader->readData(arraySizeCount, GLuint())[0];
+		return _staticGPUData;
 	}
 
-	// Wait for the end of compute shaders
-	//BVHCluster* clusterData = ComputeShader::readData(_staticGPUData->_clusterSSBO, BVHCluster());
-/*	volatileGPUData->_cluster = std::move(std::vector<BVHCluster>(clusterData, clusterData + _staticGPUData->_numTriangles * 2 - 1));*/				
-
-	// Free buffers from GPU
-	GLuint toDeleteBuffers[] = { coutBuffer, cinBuffer, inCurrentPosition, outCurrentPosition, neighborIndex,
-							     prefixScan, validCluster, mergedCluster, numNodesCount, arraySizeCount };
-	glDeleteBuffers(sizeof(toDeleteBuffers) / sizeof(GLuint), toDeleteBuffers);
+	this->aggregateSSBOData(volatileGPUData, _staticGPUData);
+	this->buildBVH(volatileGPUData);
 
 	// CG Visualization
 	if (buildVisualization)
 	{
-		this->buildBVHVAO(volatileGPUData);
+		this->buildBVHVAO(volatileGPUData->_cluster);
 	}
 
-	// Free dynamic memory
-	delete[]	outCluster;
-	delete[]	currentPosBuffer;
-	delete[]	currentPosBufferOut;
+	if (!this->writeBVHCache(cacheFilename, contentHash))
+	{
+		std::cout << "BVH could not be saved in " << cacheFilename << std::endl;
+	}
 
 	return _staticGPUData;
 }
@@ -201,6 +155,74 @@ Model3D::ModelComponent* Group3D::getModelComponent(unsigned id)
 	return _globalModelComp[id];
 }
 
+Group3D::StaticCPUData* Group3D::getStaticCPUData(const BVHLayout layout)
+{
+	if (!_staticGPUData) return _staticCPUData;
+
+	auto readBuffer = [](const GLuint bufferID, auto& data)
+	{
+		GLint bufferSize = 0;
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferID);
+		glGetBufferParameteriv(GL_SHADER_STORAGE_BUFFER, GL_BUFFER_SIZE, &bufferSize);
+
+		data.resize(bufferSize / sizeof(data[0]));
+		glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, data.size() * sizeof(data[0]), data.data());
+	};
+
+	// Nothing is read if GPU buffers are disabled, as the CPU data is then the only copy of the scene and it is never released
+	if (_gpuBuffers && !_staticCPUData)
+	{
+		_staticCPUData = new StaticCPUData;
+		readBuffer(_staticGPUData->_groupGeometrySSBO, _staticCPUData->_geometry);
+		readBuffer(_staticGPUData->_groupTopologySSBO, _staticCPUData->_triangleMesh);
+		readBuffer(_staticGPUData->_groupMeshSSBO, _staticCPUData->_meshData);
+		readBuffer(_staticGPUData->_leafFaceSSBO, _staticCPUData->_leafFace);
+
+		if (_staticGPUData->_numInstances > 0)
+		{
+			readBuffer(_staticGPUData->_instanceSSBO, _staticCPUData->_instance);
+		}
+	}
+
+	// Binary nodes are needed by every layout, except the compressed one once it is built
+	if (_gpuBuffers && _staticCPUData->_cluster.empty() && (layout != COMPRESSED_BVH || _staticCPUData->_compressedRoot.empty()))
+	{
+		readBuffer(_staticGPUData->_clusterSSBO, _staticCPUData->_cluster);
+	}
+
+	if (layout == WIDE_BVH && _staticCPUData->_wideNode.empty())
+	{
+		this->buildWideBVH(_staticCPUData);
+	}
+	else if (layout == COMPRESSED_BVH && _staticCPUData->_compressedRoot.empty())
+	{
+		// Binary nodes are kept if the tree does not fit in compressed references, so that the caller falls back to them, or if they cannot be read again
+		if (this->buildCompressedBVH(_staticCPUData) && _gpuBuffers)
+		{
+			std::vector<BVHCluster>().swap(_staticCPUData->_cluster);
+		}
+	}
+
+	return _staticCPUData;
+}
+
+Group3D::StaticGPUData* Group3D::getStaticGPUData()
+{
+	if (!_staticGPUData || _gpuBuffers) return _staticGPUData;
+
+	// The scene was built in main memory, which is now kept as the mirror of GPU buffers
+	_staticGPUData->_groupGeometrySSBO	= ComputeShader::setReadBuffer(_staticCPUData->_geometry, GL_STATIC_DRAW);
+	_staticGPUData->_groupTopologySSBO	= ComputeShader::setReadBuffer(_staticCPUData->_triangleMesh, GL_STATIC_DRAW);
+	_staticGPUData->_groupMeshSSBO		= ComputeShader::setReadBuffer(_staticCPUData->_meshData, GL_STATIC_DRAW);
+	_staticGPUData->_clusterSSBO		= ComputeShader::setReadBuffer(_staticCPUData->_cluster, GL_DYNAMIC_DRAW);
+	_staticGPUData->_leafFaceSSBO		= _staticCPUData->_leafFace.empty() ? ComputeShader::setWriteBuffer(GLuint(), 1, GL_STATIC_DRAW) : ComputeShader::setReadBuffer(_staticCPUData->_leafFace, GL_STATIC_DRAW);
+	_staticGPUData->_instanceSSBO		= _staticCPUData->_instance.empty() ? ComputeShader::setWriteBuffer(InstanceGPUData(), 1, GL_STATIC_DRAW) : ComputeShader::setReadBuffer(_staticCPUData->_instance, GL_STATIC_DRAW);
+	_gpuBuffers							= true;
+
+	return _staticGPUData;
+}
+
 vec3 Group3D::getSemanticColor(unsigned int group)
 {
 	return _groupColor[group];
@@ -222,6 +244,12 @@ bool Group3D::load(const mat4& modelMatrix)
 	bool success = true;
 	const mat4& mMatrix = modelMatrix * _modelMatrix;
 
+	// Prototypes keep their own space, since instances carry the whole transformation
+	for (int prototypeIdx = 0; prototypeIdx < _prototypes.size(); ++prototypeIdx)
+	{
+		success &= _prototypes[prototypeIdx]->load(mat4(1.0f));
+	}
+
 	for (int modelIdx = 0; modelIdx < _objects.size(); ++modelIdx)
 	{
 		success &= _objects[modelIdx]->load(mMatrix);
@@ -230,6 +258,165 @@ bool Group3D::load(const mat4& modelMatrix)
 	return success;
 }
 
+bool Group3D::refitBVH(Model3D* model, const mat4& transform)
+{
+	if (!_staticGPUData || _staticGPUData->_numClusters == 0) return false;
+
+	// Buffers are retrieved from GPU; the mirror is kept only if it was already requested
+	const bool keepCPUData		= _staticCPUData != nullptr;
+	StaticCPUData* cpuData		= this->getStaticCPUData();
+	std::vector<BVHCluster>& cluster = cpuData->_cluster;
+
+	if (_bvhSAHCost <= .0f)
+	{
+		_bvhSAHCost = this->computeSAHCost(cluster, cpuData->_instance);
+	}
+
+	model->setModelMatrix(transform * model->getModelMatrix());
+
+	auto instanceIt = std::find(_instances.begin(), _instances.end(), model);
+
+	if (instanceIt != _instances.end())
+	{
+		// Instances only update their placement, as the tree of their prototype is shared
+		const unsigned modelCompOffset = (*instanceIt)->getModelComponent(0)->_id;
+
+		for (InstanceGPUData& instance : cpuData->_instance)
+		{
+			if (instance._modelCompOffset != modelCompOffset) continue;
+
+			instance._transform			= (*instanceIt)->getModelMatrix();
+			instance._inverseTransform	= glm::inverse(instance._transform);
+		}
+
+		if (_gpuBuffers)
+		{
+			ComputeShader::updateReadBufferRange(_staticGPUData->_instanceSSBO, cpuData->_instance.data(), 0, _staticGPUData->_numInstances);
+		}
+	}
+	else
+	{
+		// First step: vertices and faces of the model components are moved, as transformations are already applied to the group buffers
+		const mat3 normalMatrix = glm::transpose(glm::inverse(mat3(transform)));
+		std::vector<uint8_t> isMoved(_globalModelComp.size(), 0);
+
+		for (unsigned modelCompIdx = 0; modelCompIdx < model->getNumModelComponents(); ++modelCompIdx)
+		{
+			const MeshGPUData& mesh = cpuData->_meshData[model->getModelComponent(modelCompIdx)->_id];
+			isMoved[model->getModelComponent(modelCompIdx)->_id] = 1;
+
+			#pragma omp parallel for
+			for (int vertexIdx = 0; vertexIdx < static_cast<int>(mesh._numVertices); ++vertexIdx)
+			{
+				VertexGPUData& vertex = cpuData->_geometry[mesh._startIndex + vertexIdx];
+
+				vertex._position	= vec3(transform * vec4(vertex._position, 1.0f));
+				vertex._normal		= glm::normalize(normalMatrix * vertex._normal);
+				vertex._tangent		= mat3(transform) * vertex._tangent;
+			}
+		}
+
+		#pragma omp parallel for
+		for (int faceIdx = 0; faceIdx < static_cast<int>(cpuData->_triangleMesh.size()); ++faceIdx)
+		{
+			FaceGPUData& face = cpuData->_triangleMesh[faceIdx];
+			if (!isMoved[face._modelCompID]) continue;
+
+			const unsigned startIndex = cpuData->_meshData[face._modelCompID]._startIndex;
+
+			face._minPoint	= vec3(INFINITY);
+			face._maxPoint	= vec3(-INFINITY);
+			face._normal	= glm::normalize(normalMatrix * face._normal);
+
+			for (int vertexIdx = 0; vertexIdx < 3; ++vertexIdx)
+			{
+				const vec3& position = cpuData->_geometry[startIndex + face._vertices[vertexIdx]]._position;
+
+				face._minPoint = glm::min(face._minPoint, position);
+				face._maxPoint = glm::max(face._maxPoint, position);
+			}
+		}
+
+		if (_gpuBuffers)
+		{
+			ComputeShader::updateReadBufferRange(_staticGPUData->_groupGeometrySSBO, cpuData->_geometry.data(), 0, cpuData->_geometry.size());
+			ComputeShader::updateReadBufferRange(_staticGPUData->_groupTopologySSBO, cpuData->_triangleMesh.data(), 0, cpuData->_triangleMesh.size());
+		}
+	}
+
+	// Second step: boxes are propagated bottom-up. Children are stored before their parents, and trees of prototypes before the tree of the scene
+	for (BVHCluster& node : cluster)
+	{
+		if ((node._faceIndex & BVH_INSTANCE_FLAG) != 0)
+		{
+			const InstanceGPUData& instance = cpuData->_instance[node._faceIndex & ~BVH_INSTANCE_FLAG];
+			const AABB instanceAABB = AABB(cluster[instance._blasRoot]._minPoint, cluster[instance._blasRoot]._maxPoint).transform(instance._transform);
+
+			node._minPoint = instanceAABB.min();
+			node._maxPoint = instanceAABB.max();
+		}
+		else if (node._faceIndex != BVH_NULL_INDEX)
+		{
+			node._minPoint = vec3(INFINITY);
+			node._maxPoint = vec3(-INFINITY);
+
+			for (unsigned faceIdx = node._faceIndex; faceIdx < node._faceIndex + node._numFaces; ++faceIdx)
+			{
+				const FaceGPUData& face = cpuData->_triangleMesh[cpuData->_leafFace[faceIdx]];
+
+				node._minPoint = glm::min(node._minPoint, face._minPoint);
+				node._maxPoint = glm::max(node._maxPoint, face._maxPoint);
+			}
+		}
+		else
+		{
+			node._minPoint = glm::min(cluster[node._prevIndex1]._minPoint, cluster[node._prevIndex2]._minPoint);
+			node._maxPoint = glm::max(cluster[node._prevIndex1]._maxPoint, cluster[node._prevIndex2]._maxPoint);
+		}
+	}
+
+	_aabb = AABB(cluster.back()._minPoint, cluster.back()._maxPoint);
+
+	// Third step: refitted boxes may overlap much more than the built ones, in which case the topology is no longer worth keeping
+	const float degradation = this->computeSAHCost(cluster, cpuData->_instance) / _bvhSAHCost;
+
+	if (degradation > BVH_REFIT_MAX_DEGRADATION)
+	{
+		std::cout << "BVH refit degraded its cost " << degradation << " times; rebuilding it" << std::endl;
+
+		this->rebuildBVH(cpuData);
+
+		return true;
+	}
+
+	if (_gpuBuffers)
+	{
+		ComputeShader::updateReadBufferRange(_staticGPUData->_clusterSSBO, cluster.data(), 0, cluster.size());
+	}
+
+	if (_bvhVAO)
+	{
+		delete _bvhVAO;
+		_bvhVAO = Primitives::getCubesVAO(cluster, _numClusters = cluster.size());
+	}
+
+	// Layouts derived from the binary nodes are built again once they are requested
+	if (keepCPUData)
+	{
+		std::vector<WideBVHNode>().swap(cpuData->_wideNode);
+		std::vector<GLuint>().swap(cpuData->_wideInstanceRoot);
+		std::vector<CompressedBVHNode>().swap(cpuData->_compressedNode);
+		std::vector<CompressedBVHRoot>().swap(cpuData->_compressedRoot);
+	}
+	else
+	{
+		delete _staticCPUData;
+		_staticCPUData = nullptr;
+	}
+
+	return false;
+}
+
 void Group3D::registerModelComponent(ModelComponent* modelComp)
 {
 	unsigned id = _globalModelComp.size();
@@ -253,6 +440,25 @@ void Group3D::registerScene()
 	{
 		model->registerModelComponentGroup(this);
 	}
+
+	// Triangles of prototypes are placed at the end of the group buffers, after the ones covered by the tree built in GPU
+	for (Model3D* prototype : _prototypes)
+	{
+		prototype->registerModelComponentGroup(this);
+	}
+}
+
+void Group3D::retrieveColorsCPU()
+{
+	for (Model3D* object : _objects)
+	{
+		object->retrieveColorsCPU();
+	}
+
+	for (Model3D* prototype : _prototypes)
+	{
+		prototype->retrieveColorsCPU();
+	}
 }
 
 void Group3D::retrieveColorsGPU()
@@ -261,6 +467,11 @@ void Group3D::retrieveColorsGPU()
 	{
 		object->retrieveColorsGPU();
 	}
+
+	for (Model3D* prototype : _prototypes)
+	{
+		prototype->retrieveColorsGPU();
+	}
 }
 
 // --------------------------- Rendering ----------------------------------
@@ -392,151 +603,1875 @@ void Group3D::drawBVH(RenderingShader* shader, const RendEnum::RendShaderTypes s
 
 void Group3D::aggregateSSBOData(VolatileGPUData*& volatileGPUData, StaticGPUData*& staticGPUData)
 {
-	VolatileGroupData* groupData = new VolatileGroupData;
+	std::vector<MeshGPUData> meshData(_globalModelComp.size());
 	unsigned numVertices = 0, numTriangles = 0;
 	volatileGPUData = new VolatileGPUData;
 	staticGPUData = new StaticGPUData;
 
+	// Prototype triangles are only referenced by their own BVHs, so they are left out of the tree of non-instanced geometry
+	std::unordered_map<Model3D*, unsigned> prototypeIndex;
+	std::vector<std::vector<BVHCluster>> prototypeLeaves(_prototypes.size());
+	std::vector<AABB> prototypeAABB(_prototypes.size());
+
+	for (unsigned prototypeIdx = 0; prototypeIdx < _prototypes.size(); ++prototypeIdx)
+	{
+		prototypeIndex[_prototypes[prototypeIdx]] = prototypeIdx;
+	}
+
 	// We need to gather all the geometry and topology from the scene
-	// First step: count vertices and faces to resize arrays only 1 time
+	// First step: count vertices and faces so that GPU buffers are allocated only 1 time. Splitting faces also needs the boundaries of non-instanced geometry
+	AABB staticAABB;
 
 	for (ModelComponent* modelComp : _globalModelComp)
 	{
 		numVertices += modelComp->_geometry.size();
 		numTriangles += modelComp->_topology.size();
+
+		if (_preSplitFaces && prototypeIndex.find(modelComp->_root) == prototypeIndex.end())
+		{
+			for (const FaceGPUData& face : modelComp->_topology)
+			{
+				staticAABB.update(face._minPoint);
+				staticAABB.update(face._maxPoint);
+			}
+		}
 	}
 
+	const vec3 staticSize = staticAABB.size();
+	const float maxFragmentArea = BVH_SPLIT_SCENE_AREA * 2.0f * (staticSize.x * staticSize.y + staticSize.x * staticSize.z + staticSize.y * staticSize.z);
+
 	//this->writeModelComponentsPly();
 
-	groupData->_geometry.resize(numVertices);
-	groupData->_triangleMesh.resize(numTriangles);
-	groupData->_meshData.resize(_globalModelComp.size());
+	std::cout << "Number of vertices: " << numVertices << std::endl;
+	std::cout << "Number of triangles: " << numTriangles << std::endl;
 
-	std::cout << "Number of vertices: " << groupData->_geometry.size() << std::endl;
-	std::cout << "Number of triangles: " << groupData->_triangleMesh.size() << std::endl;
+	// Scene data is gathered into main memory rather than into GPU buffers if these are disabled
+	StaticCPUData* cpuData = nullptr;
+
+	if (_gpuBuffers)
+	{
+		staticGPUData->_groupGeometrySSBO	= ComputeShader::setWriteBuffer(VertexGPUData(), numVertices, GL_STATIC_DRAW);
+		staticGPUData->_groupTopologySSBO	= ComputeShader::setWriteBuffer(FaceGPUData(), numTriangles, GL_STATIC_DRAW);
+	}
+	else
+	{
+		delete _staticCPUData;
+		_staticCPUData = cpuData = new StaticCPUData;
+		cpuData->_geometry.reserve(numVertices);
+		cpuData->_triangleMesh.reserve(numTriangles);
+	}
 
-	// Second step: gather geometry and topology
-	unsigned currentGeometry = 0, currentTopology = 0;
+	// Second step: stream each component into its range of the group buffers, so that its memory can be released right away
+	// and the group data never coexists with the whole scene in main memory. The AABB is gathered from the face boundaries meanwhile
+	unsigned currentGeometry = 0, currentTopology = 0, numStaticTriangles = 0;
+	AABB aabb;
 
 	for (ModelComponent* modelComp : _globalModelComp)
 	{
 		numVertices = modelComp->_geometry.size();
+		numTriangles = modelComp->_topology.size();
 
-		std::copy(modelComp->_geometry.begin(), modelComp->_geometry.end(), groupData->_geometry.begin() + currentGeometry);
-		std::copy(modelComp->_topology.begin(), modelComp->_topology.end(), groupData->_triangleMesh.begin() + currentTopology);
-
-		groupData->_meshData[modelComp->_id]._startIndex = currentGeometry;
-		groupData->_meshData[modelComp->_id]._numVertices = numVertices;
-		groupData->_meshData[modelComp->_id]._materialID = modelComp->_materialID;
+		if (cpuData)
+		{
+			cpuData->_geometry.insert(cpuData->_geometry.end(), modelComp->_geometry.begin(), modelComp->_geometry.end());
+			cpuData->_triangleMesh.insert(cpuData->_triangleMesh.end(), modelComp->_topology.begin(), modelComp->_topology.end());
+		}
+		else
+		{
+			ComputeShader::updateReadBufferRange(staticGPUData->_groupGeometrySSBO, modelComp->_geometry.data(), currentGeometry, numVertices);
+			ComputeShader::updateReadBufferRange(staticGPUData->_groupTopologySSBO, modelComp->_topology.data(), currentTopology, numTriangles);
+		}
 
-		currentGeometry += numVertices;
-		currentTopology += modelComp->_topology.size();
+		auto prototypeIt = prototypeIndex.find(modelComp->_root);
 
-		modelComp->releaseMemory();
+		if (prototypeIt == prototypeIndex.end())
+		{
+			for (unsigned faceIdx = 0; faceIdx < numTriangles; ++faceIdx)
+			{
+				const FaceGPUData& face = modelComp->_topology[faceIdx];
+				aabb.update(face._minPoint);
+				aabb.update(face._maxPoint);
+
+				// CPU builders take the boundaries of faces from main memory, whereas the GPU one reads them from the topology buffer unless faces are split
+				if (_preSplitFaces)
+				{
+					const vec3 vertex[3] = { modelComp->_geometry[face._vertices.x]._position, modelComp->_geometry[face._vertices.y]._position, modelComp->_geometry[face._vertices.z]._position };
+
+					this->splitFace(vertex, currentTopology + faceIdx, maxFragmentArea, volatileGPUData);
+				}
+				else if (_bvhBuilder != PLOC_BUILDER)
+				{
+					BVHCluster leaf;
+					leaf._minPoint		= face._minPoint;
+					leaf._maxPoint		= face._maxPoint;
+					leaf._prevIndex1	= leaf._prevIndex2 = BVH_NULL_INDEX;
+					leaf._faceIndex		= currentTopology + faceIdx;
+					volatileGPUData->_staticLeaves.push_back(leaf);
+				}
+			}
+
+			numStaticTriangles += numTriangles;
+		}
+		else
+		{
+			std::vector<BVHCluster>& leaves = prototypeLeaves[prototypeIt->second];
+
+			for (unsigned faceIdx = 0; faceIdx < numTriangles; ++faceIdx)
+			{
+				const FaceGPUData& face = modelComp->_topology[faceIdx];
+				BVHCluster leaf;
+
+				leaf._minPoint		= face._minPoint;
+				leaf._maxPoint		= face._maxPoint;
+				leaf._prevIndex1	= leaf._prevIndex2 = BVH_NULL_INDEX;
+				leaf._faceIndex		= currentTopology + faceIdx;
+				leaves.push_back(leaf);
+
+				prototypeAABB[prototypeIt->second].update(face._minPoint);
+				prototypeAABB[prototypeIt->second].update(face._maxPoint);
+			}
+		}
+
+		meshData[modelComp->_id]._startIndex = currentGeometry;
+		meshData[modelComp->_id]._numVertices = numVertices;
+		meshData[modelComp->_id]._materialID = modelComp->_materialID;
+
+		currentGeometry += numVertices;
+		currentTopology += numTriangles;
+
+		modelComp->releaseMemory();
+	}
+
+	// Prototypes are registered after any other model, therefore the tree built in GPU only covers the first triangles
+	volatileGPUData->_numStaticLeaves	= _preSplitFaces ? volatileGPUData->_fragmentFace.size() : numStaticTriangles;
+	_staticGPUData->_numTriangles		= numStaticTriangles;
+	_staticGPUData->_numClusters		= volatileGPUData->_numStaticLeaves > 0 ? volatileGPUData->_numStaticLeaves * 2 - 1 : 0;
+
+	if (_preSplitFaces)
+	{
+		std::cout << "Number of fragments: " << volatileGPUData->_numStaticLeaves << " (" << numStaticTriangles << " split faces)" << std::endl;
+	}
+
+	// Third step: instances share the meshes of their prototype, but not their materials
+	for (InstancedModel* instance : _instances)
+	{
+		Model3D* prototype = instance->getPrototype();
+		if (prototypeLeaves[prototypeIndex[prototype]].empty() || prototype->getNumModelComponents() == 0) continue;
+
+		for (unsigned modelCompIdx = 0; modelCompIdx < instance->getNumModelComponents(); ++modelCompIdx)
+		{
+			ModelComponent* modelComp = instance->getModelComponent(modelCompIdx);
+
+			meshData[modelComp->_id] = meshData[prototype->getModelComponent(modelCompIdx)->_id];
+			meshData[modelComp->_id]._materialID = modelComp->_materialID;
+		}
+	}
+
+	// Fourth step: BVHs of prototypes and placement of instances
+	this->buildPrototypeBVHs(volatileGPUData, prototypeIndex, prototypeLeaves, prototypeAABB, aabb);
+
+	this->_aabb							= aabb;
+
+	if (cpuData)
+	{
+		cpuData->_meshData.swap(meshData);
+	}
+	else
+	{
+		staticGPUData->_groupMeshSSBO	= ComputeShader::setReadBuffer(meshData, GL_STATIC_DRAW);
+	}
+
+	std::cout << "AABB Size: " << this->_aabb.size().x << ", " << this->_aabb.size().y << ", " << this->_aabb.size().z << std::endl;
+	std::cout << "AABB Center: " << this->_aabb.center().x << ", " << this->_aabb.center().y << ", " << this->_aabb.center().z << std::endl;
+
+	this->allocateClusterBuffer(volatileGPUData);
+}
+
+void Group3D::allocateClusterBuffer(VolatileGPUData* gpuData)
+{
+	if (gpuData->_numStaticLeaves > 0 && _bvhBuilder == PLOC_BUILDER)
+	{
+		// Boxes of fragments replace the ones of the topology buffer, where the GPU builder reads them
+		if (!gpuData->_fragmentFace.empty())
+		{
+			std::vector<FaceGPUData> fragment(gpuData->_staticLeaves.size());
+
+			for (unsigned fragmentIdx = 0; fragmentIdx < fragment.size(); ++fragmentIdx)
+			{
+				fragment[fragmentIdx]._minPoint = gpuData->_staticLeaves[fragmentIdx]._minPoint;
+				fragment[fragmentIdx]._maxPoint = gpuData->_staticLeaves[fragmentIdx]._maxPoint;
+			}
+
+			gpuData->_fragmentSSBO = ComputeShader::setReadBuffer(fragment, GL_STATIC_DRAW);
+			std::vector<BVHCluster>().swap(gpuData->_staticLeaves);
+		}
+
+		const GLuint mortonCodes		= this->computeMortonCodes(gpuData);
+		const GLuint sortedIndices		= this->sortFacesByMortonCode(gpuData, mortonCodes);
+
+		this->buildClusterBuffer(gpuData, sortedIndices);
+	}
+}
+
+void Group3D::buildBinnedSAHBVH(VolatileGPUData* gpuData)
+{
+	std::vector<BVHCluster>& leaves = gpuData->_staticLeaves;
+	const unsigned numLeaves = static_cast<unsigned>(leaves.size());
+
+	if (numLeaves == 0) return;
+
+	ChronoUtilities::initChrono();
+
+	// Subtrees of n leaves take 2n - 1 nodes, hence every range of leaves knows where its nodes are written and subtrees are built independently
+	struct LeafRange
+	{
+		unsigned	_firstLeaf, _lastLeaf;
+		unsigned	_nodeOffset;
+	};
+
+	std::vector<BVHCluster> nodes(numLeaves * 2 - 1);
+	std::vector<LeafRange> toSplit{ LeafRange{ 0, numLeaves, 0 } }, subtrees;
+
+	// First step: large ranges are split one after another, binning their leaves in parallel
+	while (!toSplit.empty())
+	{
+		const LeafRange range = toSplit.back();
+		toSplit.pop_back();
+
+		if (range._lastLeaf - range._firstLeaf <= BVH_SAH_SUBTREE_SIZE)
+		{
+			subtrees.push_back(range);
+			continue;
+		}
+
+		BVHCluster& node = nodes[range._nodeOffset + (range._lastLeaf - range._firstLeaf) * 2 - 2];
+		const unsigned middleLeaf = this->splitBinnedSAH(leaves, range._firstLeaf, range._lastLeaf, node._minPoint, node._maxPoint);
+		const unsigned rightOffset = range._nodeOffset + (middleLeaf - range._firstLeaf) * 2 - 1;
+
+		node._prevIndex1	= range._nodeOffset + (middleLeaf - range._firstLeaf) * 2 - 2;
+		node._prevIndex2	= rightOffset + (range._lastLeaf - middleLeaf) * 2 - 2;
+		node._faceIndex		= BVH_NULL_INDEX;
+
+		toSplit.push_back(LeafRange{ range._firstLeaf, middleLeaf, range._nodeOffset });
+		toSplit.push_back(LeafRange{ middleLeaf, range._lastLeaf, rightOffset });
+	}
+
+	// Second step: small subtrees are built in parallel, each of them by a single thread
+	#pragma omp parallel for schedule(dynamic)
+	for (int subtreeIdx = 0; subtreeIdx < static_cast<int>(subtrees.size()); ++subtreeIdx)
+	{
+		this->buildBinnedSAHSubtree(leaves, subtrees[subtreeIdx]._firstLeaf, subtrees[subtreeIdx]._lastLeaf, nodes, subtrees[subtreeIdx]._nodeOffset);
+	}
+
+	std::vector<BVHCluster>().swap(leaves);
+	gpuData->_cluster.swap(nodes);
+
+	std::cout << "Binned SAH BVH built in CPU in " << ChronoUtilities::getDuration(ChronoUtilities::MILLISECONDS) << " ms" << std::endl;
+}
+
+unsigned Group3D::buildBinnedSAHSubtree(std::vector<BVHCluster>& leaves, const unsigned firstLeaf, const unsigned lastLeaf, std::vector<BVHCluster>& nodes, const unsigned nodeOffset)
+{
+	const unsigned rootIdx = nodeOffset + (lastLeaf - firstLeaf) * 2 - 2;
+
+	if (lastLeaf - firstLeaf == 1)
+	{
+		nodes[rootIdx] = leaves[firstLeaf];
+
+		return rootIdx;
+	}
+
+	BVHCluster& node = nodes[rootIdx];
+	const unsigned middleLeaf = this->splitBinnedSAH(leaves, firstLeaf, lastLeaf, node._minPoint, node._maxPoint);
+
+	node._prevIndex1	= this->buildBinnedSAHSubtree(leaves, firstLeaf, middleLeaf, nodes, nodeOffset);
+	node._prevIndex2	= this->buildBinnedSAHSubtree(leaves, middleLeaf, lastLeaf, nodes, nodeOffset + (middleLeaf - firstLeaf) * 2 - 1);
+	node._faceIndex		= BVH_NULL_INDEX;
+
+	return rootIdx;
+}
+
+void Group3D::buildBVH(VolatileGPUData* gpuData)
+{
+	switch (_bvhBuilder)
+	{
+	case BINNED_SAH_BUILDER:
+		this->buildBinnedSAHBVH(gpuData);
+		break;
+	case LBVH_BUILDER:
+		this->buildLBVH(gpuData);
+		break;
+	default:
+		this->buildPLOCBVH(gpuData);
+		break;
+	}
+
+	this->buildInstancingBVH(gpuData);
+	this->collapseLeaves(gpuData);
+}
+
+void Group3D::buildBVHVAO(const std::vector<BVHCluster>& cluster)
+{
+	if (!_bvhVAO)
+	{
+		_bvhVAO = Primitives::getCubesVAO(cluster, _numClusters = cluster.size());
+	}
+}
+
+void Group3D::buildClusterBuffer(VolatileGPUData* gpuData, const GLuint sortedFaces)
+{
+	ComputeShader* buildClusterShader = ShaderList::getInstance()->getComputeShader(RendEnum::BUILD_CLUSTER_BUFFER);
+
+	const unsigned arraySize		= gpuData->_numStaticLeaves;
+	const unsigned clusterSize		= _staticGPUData->_numClusters;							// We'll only fill arraySize clusters
+	const GLuint faceSSBO			= gpuData->_fragmentFace.empty() ? _staticGPUData->_groupTopologySSBO : gpuData->_fragmentSSBO;
+	const int numGroups				= ComputeShader::getNumGroups(arraySize);
+
+	BVHCluster* clusterData			= new BVHCluster[clusterSize], *tempClusterData = new BVHCluster[arraySize];
+	_staticGPUData->_clusterSSBO	= ComputeShader::setWriteBuffer(BVHCluster(), clusterSize, GL_DYNAMIC_DRAW);
+	gpuData->_tempClusterSSBO		= ComputeShader::setWriteBuffer(BVHCluster(), arraySize, GL_DYNAMIC_DRAW);
+
+	buildClusterShader->bindBuffers(std::vector<GLuint> { faceSSBO, sortedFaces, _staticGPUData->_clusterSSBO, gpuData->_tempClusterSSBO });
+	buildClusterShader->use();
+	buildClusterShader->setUniform("arraySize", arraySize);
+	buildClusterShader->execute(numGroups, 1, 1, ComputeShader::getMaxGroupSize(), 1, 1);
+
+	glDeleteBuffers(1, &sortedFaces);
+}
+
+void Group3D::buildInstancingBVH(VolatileGPUData* gpuData)
+{
+	_staticGPUData->_numInstances = gpuData->_instance.size();
+
+	if (gpuData->_topLevelLeaves.empty())
+	{
+		return;
+	}
+
+	// The root of the tree of non-instanced geometry is linked as one more leaf of the top level
+	const unsigned numStaticClusters = gpuData->_cluster.size();
+
+	if (numStaticClusters > 0)
+	{
+		gpuData->_topLevelLeaves.push_back(gpuData->_cluster.back());
+	}
+
+	std::vector<BVHCluster>& leaves = gpuData->_topLevelLeaves;
+	const unsigned topLevelOffset = numStaticClusters + gpuData->_instancingCluster.size();
+
+	this->buildMedianSplitBVH(leaves, 0, leaves.size(), gpuData->_instancingCluster, numStaticClusters);
+	gpuData->_cluster.insert(gpuData->_cluster.end(), gpuData->_instancingCluster.begin(), gpuData->_instancingCluster.end());
+	std::vector<BVHCluster>().swap(gpuData->_instancingCluster);
+
+	std::cout << "Number of instances: " << _staticGPUData->_numInstances << " (top level from node " << topLevelOffset << ")" << std::endl;
+}
+
+void Group3D::buildLBVH(VolatileGPUData* gpuData)
+{
+	std::vector<BVHCluster>& leaves = gpuData->_staticLeaves;
+	const int numLeaves = static_cast<int>(leaves.size());
+
+	if (numLeaves == 0) return;
+
+	ChronoUtilities::initChrono();
+
+	// First step: boundaries of centroids, reduced from chunks of leaves
+	const int numChunks = static_cast<int>(glm::max(std::thread::hardware_concurrency(), 1u)) * 4;
+	const int chunkSize = (numLeaves + numChunks - 1) / numChunks;
+	std::vector<vec3> chunkMin(numChunks, vec3(FLT_MAX)), chunkMax(numChunks, vec3(-FLT_MAX));
+
+	#pragma omp parallel for
+	for (int chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+	{
+		for (int leafIdx = chunkIdx * chunkSize; leafIdx < glm::min((chunkIdx + 1) * chunkSize, numLeaves); ++leafIdx)
+		{
+			const vec3 centroid = (leaves[leafIdx]._minPoint + leaves[leafIdx]._maxPoint) / 2.0f;
+			chunkMin[chunkIdx] = glm::min(chunkMin[chunkIdx], centroid);
+			chunkMax[chunkIdx] = glm::max(chunkMax[chunkIdx], centroid);
+		}
+	}
+
+	vec3 centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+	for (int chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+	{
+		centroidMin = glm::min(centroidMin, chunkMin[chunkIdx]);
+		centroidMax = glm::max(centroidMax, chunkMax[chunkIdx]);
+	}
+
+	// Second step: 63-bit Morton codes, i.e. 21 bits per axis
+	auto expandBits = [](uint64_t value) -> uint64_t
+	{
+		value &= 0x1FFFFF;
+		value = (value | value << 32) & 0x1F00000000FFFF;
+		value = (value | value << 16) & 0x1F0000FF0000FF;
+		value = (value | value << 8) & 0x100F00F00F00F00F;
+		value = (value | value << 4) & 0x10C30C30C30C30C3;
+		value = (value | value << 2) & 0x1249249249249249;
+
+		return value;
+	};
+
+	const vec3 centroidExtent = glm::max(centroidMax - centroidMin, vec3(FLT_EPSILON));
+	std::vector<uint64_t> mortonCode(numLeaves);
+	std::vector<unsigned> sortedLeaf(numLeaves);
+
+	#pragma omp parallel for
+	for (int leafIdx = 0; leafIdx < numLeaves; ++leafIdx)
+	{
+		const vec3 centroid = ((leaves[leafIdx]._minPoint + leaves[leafIdx]._maxPoint) / 2.0f - centroidMin) / centroidExtent;
+		const uvec3 cell = glm::min(uvec3(centroid * 2097152.0f), uvec3(2097151));
+
+		mortonCode[leafIdx] = (expandBits(cell.x) << 2) | (expandBits(cell.y) << 1) | expandBits(cell.z);
+		sortedLeaf[leafIdx] = leafIdx;
+	}
+
+	this->radixSortMortonCodes(mortonCode, sortedLeaf);
+
+	// Third step: hierarchy of Karras (2012). Every inner node finds its range of sorted leaves and its split independently.
+	// Nodes i < numLeaves - 1 are inner nodes, whereas leaves are stored from numLeaves - 1 onwards
+	auto countLeadingZeros = [](uint64_t value) -> int
+	{
+		if (value == 0) return 64;
+
+		int numZeros = 0;
+		if ((value & 0xFFFFFFFF00000000) == 0) { numZeros += 32; value <<= 32; }
+		if ((value & 0xFFFF000000000000) == 0) { numZeros += 16; value <<= 16; }
+		if ((value & 0xFF00000000000000) == 0) { numZeros += 8; value <<= 8; }
+		if ((value & 0xF000000000000000) == 0) { numZeros += 4; value <<= 4; }
+		if ((value & 0xC000000000000000) == 0) { numZeros += 2; value <<= 2; }
+		if ((value & 0x8000000000000000) == 0) { numZeros += 1; }
+
+		return numZeros;
+	};
+
+	// Length of the common prefix of two sorted codes. Duplicated codes are told apart by their positions
+	auto commonPrefix = [&](const int i, const int j) -> int
+	{
+		if (j < 0 || j >= numLeaves) return -1;
+		if (mortonCode[i] == mortonCode[j]) return 64 + countLeadingZeros(static_cast<uint64_t>(i ^ j)) - 32;
+
+		return countLeadingZeros(mortonCode[i] ^ mortonCode[j]);
+	};
+
+	const int numInnerNodes = numLeaves - 1;
+	std::vector<unsigned> parent(numInnerNodes + numLeaves, BVH_NULL_INDEX);
+	std::vector<uvec2> children(numInnerNodes);
+
+	#pragma omp parallel for
+	for (int nodeIdx = 0; nodeIdx < numInnerNodes; ++nodeIdx)
+	{
+		// Direction of the range and its length
+		const int direction = commonPrefix(nodeIdx, nodeIdx + 1) - commonPrefix(nodeIdx, nodeIdx - 1) > 0 ? 1 : -1;
+		const int minPrefix = commonPrefix(nodeIdx, nodeIdx - direction);
+		int maxLength = 2, length = 0;
+
+		while (commonPrefix(nodeIdx, nodeIdx + maxLength * direction) > minPrefix) maxLength *= 2;
+
+		for (int step = maxLength / 2; step >= 1; step /= 2)
+		{
+			if (commonPrefix(nodeIdx, nodeIdx + (length + step) * direction) > minPrefix) length += step;
+		}
+
+		// Highest bit where codes of the range differ
+		const int lastIdx = nodeIdx + length * direction, nodePrefix = commonPrefix(nodeIdx, lastIdx);
+		int split = 0, step = length;
+
+		do
+		{
+			step = (step + 1) / 2;
+			if (commonPrefix(nodeIdx, nodeIdx + (split + step) * direction) > nodePrefix) split += step;
+		}
+		while (step > 1);
+
+		const int gamma = nodeIdx + split * direction + glm::min(direction, 0);
+		const unsigned leftChild = glm::min(nodeIdx, lastIdx) == gamma ? numInnerNodes + gamma : gamma;
+		const unsigned rightChild = glm::max(nodeIdx, lastIdx) == gamma + 1 ? numInnerNodes + gamma + 1 : gamma + 1;
+
+		children[nodeIdx] = uvec2(leftChild, rightChild);
+		parent[leftChild] = parent[rightChild] = nodeIdx;
+	}
+
+	// Fourth step: boundaries are propagated bottom-up. The second thread which reaches an inner node completes it, and inner node i is always
+	// written at slot numLeaves + i, so that the tree does not depend on thread scheduling. Leaves keep their sorted order at the beginning
+	std::vector<BVHCluster> nodes(numInnerNodes + numLeaves);
+	std::vector<std::atomic<unsigned>> numVisits(numInnerNodes);
+
+	auto nodeSlot = [&](const unsigned karrasIdx) -> unsigned
+	{
+		return karrasIdx < static_cast<unsigned>(numInnerNodes) ? numLeaves + karrasIdx : karrasIdx - numInnerNodes;
+	};
+
+	#pragma omp parallel for
+	for (int leafIdx = 0; leafIdx < numLeaves; ++leafIdx)
+	{
+		nodes[leafIdx] = leaves[sortedLeaf[leafIdx]];
+
+		unsigned current = parent[numInnerNodes + leafIdx];
+
+		while (current != BVH_NULL_INDEX && numVisits[current].fetch_add(1) == 1)
+		{
+			const BVHCluster& leftChild = nodes[nodeSlot(children[current].x)], &rightChild = nodes[nodeSlot(children[current].y)];
+			BVHCluster& node = nodes[nodeSlot(current)];
+
+			node._minPoint		= glm::min(leftChild._minPoint, rightChild._minPoint);
+			node._maxPoint		= glm::max(leftChild._maxPoint, rightChild._maxPoint);
+			node._prevIndex1	= nodeSlot(children[current].x);
+			node._prevIndex2	= nodeSlot(children[current].y);
+			node._faceIndex		= BVH_NULL_INDEX;
+
+			current = parent[current];
+		}
+	}
+
+	// Fifth step: inner nodes are moved to their post-order position, which places children before their parents and the root last
+	std::vector<unsigned> innerSlot(numInnerNodes);
+	std::vector<uvec2> toVisit;											// Inner node and whether its children were already visited
+	unsigned nextSlot = numLeaves;
+
+	if (numInnerNodes > 0) toVisit.push_back(uvec2(0, 0));
+
+	while (!toVisit.empty())
+	{
+		const uvec2 current = toVisit.back();
+		toVisit.pop_back();
+
+		if (current.y)
+		{
+			innerSlot[current.x] = nextSlot++;
+			continue;
+		}
+
+		toVisit.push_back(uvec2(current.x, 1));
+		if (children[current.x].y < static_cast<unsigned>(numInnerNodes)) toVisit.push_back(uvec2(children[current.x].y, 0));
+		if (children[current.x].x < static_cast<unsigned>(numInnerNodes)) toVisit.push_back(uvec2(children[current.x].x, 0));
+	}
+
+	auto finalSlot = [&](const unsigned slot) -> unsigned
+	{
+		return slot < static_cast<unsigned>(numLeaves) ? slot : innerSlot[slot - numLeaves];
+	};
+
+	gpuData->_cluster.resize(nodes.size());
+	std::copy(nodes.begin(), nodes.begin() + numLeaves, gpuData->_cluster.begin());
+
+	#pragma omp parallel for
+	for (int nodeIdx = 0; nodeIdx < numInnerNodes; ++nodeIdx)
+	{
+		BVHCluster& node = gpuData->_cluster[innerSlot[nodeIdx]] = nodes[numLeaves + nodeIdx];
+
+		node._prevIndex1	= finalSlot(node._prevIndex1);
+		node._prevIndex2	= finalSlot(node._prevIndex2);
+	}
+
+	std::vector<BVHCluster>().swap(leaves);
+
+	std::cout << "LBVH built in CPU in " << ChronoUtilities::getDuration(ChronoUtilities::MILLISECONDS) << " ms" << std::endl;
+}
+
+unsigned Group3D::buildMedianSplitBVH(std::vector<BVHCluster>& leaves, const unsigned firstLeaf, const unsigned lastLeaf, std::vector<BVHCluster>& nodes, const unsigned nodeOffset)
+{
+	if (lastLeaf - firstLeaf == 1)
+	{
+		nodes.push_back(leaves[firstLeaf]);
+
+		return nodeOffset + nodes.size() - 1;
+	}
+
+	// Widest axis of centroids
+	AABB centroidAABB;
+	for (unsigned leafIdx = firstLeaf; leafIdx < lastLeaf; ++leafIdx)
+	{
+		centroidAABB.update((leaves[leafIdx]._minPoint + leaves[leafIdx]._maxPoint) / 2.0f);
+	}
+
+	const vec3 extent = centroidAABB.size();
+	const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+	const unsigned middleLeaf = (firstLeaf + lastLeaf) / 2;
+
+	std::nth_element(leaves.begin() + firstLeaf, leaves.begin() + middleLeaf, leaves.begin() + lastLeaf, [axis](const BVHCluster& a, const BVHCluster& b)
+		{
+			return a._minPoint[axis] + a._maxPoint[axis] < b._minPoint[axis] + b._maxPoint[axis];
+		});
+
+	const unsigned leftChild = this->buildMedianSplitBVH(leaves, firstLeaf, middleLeaf, nodes, nodeOffset);
+	const unsigned rightChild = this->buildMedianSplitBVH(leaves, middleLeaf, lastLeaf, nodes, nodeOffset);
+
+	BVHCluster node;
+	node._minPoint		= glm::min(nodes[leftChild - nodeOffset]._minPoint, nodes[rightChild - nodeOffset]._minPoint);
+	node._maxPoint		= glm::max(nodes[leftChild - nodeOffset]._maxPoint, nodes[rightChild - nodeOffset]._maxPoint);
+	node._prevIndex1	= leftChild;
+	node._prevIndex2	= rightChild;
+	node._faceIndex		= BVH_NULL_INDEX;
+	nodes.push_back(node);
+
+	return nodeOffset + nodes.size() - 1;
+}
+
+bool Group3D::buildCompressedBVH(StaticCPUData* cpuData)
+{
+	struct NodeToEncode
+	{
+		unsigned	_clusterIdx;
+		unsigned	_nodeIdx;
+		vec3		_minPoint, _maxPoint;										// Decoded box of the node, from where its children are quantized
+	};
+
+	const std::vector<BVHCluster>& cluster = cpuData->_cluster;
+	std::vector<NodeToEncode> toEncode;
+	bool overflow = false;
+
+	cpuData->_compressedNode.clear();
+	cpuData->_compressedRoot.clear();
+
+	if (cluster.empty()) return false;
+
+	// Indices beyond INDEX_MASK would overwrite the number of faces, and an instance would then be decoded as a face leaf
+	auto getReference = [&](const unsigned clusterIdx, const vec3& minPoint, const vec3& maxPoint) -> GLuint
+	{
+		const BVHCluster& node = cluster[clusterIdx];
+
+		if ((node._faceIndex & BVH_INSTANCE_FLAG) != 0)
+		{
+			overflow |= (node._faceIndex & ~BVH_INSTANCE_FLAG) > CompressedBVHNode::INDEX_MASK;
+
+			return CompressedBVHNode::LEAF_FLAG | (node._faceIndex & ~BVH_INSTANCE_FLAG & CompressedBVHNode::INDEX_MASK);
+		}
+		else if (node._faceIndex != BVH_NULL_INDEX)
+		{
+			overflow |= node._faceIndex > CompressedBVHNode::INDEX_MASK || node._numFaces > CompressedBVHNode::MAX_LEAF_FACES;
+
+			return CompressedBVHNode::LEAF_FLAG | ((node._numFaces & CompressedBVHNode::MAX_LEAF_FACES) << CompressedBVHNode::LEAF_FACES_SHIFT) | (node._faceIndex & CompressedBVHNode::INDEX_MASK);
+		}
+
+		const unsigned nodeIdx = static_cast<unsigned>(cpuData->_compressedNode.size());
+		overflow |= nodeIdx > CompressedBVHNode::INDEX_MASK;
+		cpuData->_compressedNode.emplace_back();
+		toEncode.push_back(NodeToEncode{ clusterIdx, nodeIdx, minPoint, maxPoint });
+
+		return nodeIdx;
+	};
+
+	auto encodeTree = [&](const unsigned root)
+	{
+		const BVHCluster& rootNode = cluster[root];
+		cpuData->_compressedRoot.push_back(CompressedBVHRoot{ rootNode._minPoint, rootNode._maxPoint, getReference(root, rootNode._minPoint, rootNode._maxPoint) });
+
+		while (!toEncode.empty())
+		{
+			const NodeToEncode nodeToEncode = toEncode.back();
+			const BVHCluster& node = cluster[nodeToEncode._clusterIdx];
+			const unsigned children[2] = { node._prevIndex1, node._prevIndex2 };
+			toEncode.pop_back();
+
+			for (unsigned childIdx = 0; childIdx < 2; ++childIdx)
+			{
+				const BVHCluster& child = cluster[children[childIdx]];
+				CompressedBVHNode& compressedNode = cpuData->_compressedNode[nodeToEncode._nodeIdx];
+				vec3 childMin, childMax;
+
+				// Bounds are rounded outwards, as far as the decoded value does not contain the full-precision one
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					const float minBound = nodeToEncode._minPoint[axis], maxBound = nodeToEncode._maxPoint[axis], extent = maxBound - minBound;
+					int quantizedMin = extent > .0f ? glm::clamp(static_cast<int>(std::floor((child._minPoint[axis] - minBound) / extent * 255.0f)), 0, 255) : 0;
+					int quantizedMax = extent > .0f ? glm::clamp(static_cast<int>(std::ceil((child._maxPoint[axis] - minBound) / extent * 255.0f)), 0, 255) : 255;
+
+					while (quantizedMin > 0 && CompressedBVHNode::decodeBound(minBound, maxBound, quantizedMin) > child._minPoint[axis]) --quantizedMin;
+					while (quantizedMax < 255 && CompressedBVHNode::decodeBound(minBound, maxBound, quantizedMax) < child._maxPoint[axis]) ++quantizedMax;
+
+					compressedNode._childMin[childIdx][axis] = static_cast<uint8_t>(quantizedMin);
+					compressedNode._childMax[childIdx][axis] = static_cast<uint8_t>(quantizedMax);
+				}
+
+				compressedNode.getChildBounds(childIdx, nodeToEncode._minPoint, nodeToEncode._maxPoint, childMin, childMax);
+				const GLuint reference = getReference(children[childIdx], childMin, childMax);
+				cpuData->_compressedNode[nodeToEncode._nodeIdx]._child[childIdx] = reference;		// Node reference may be invalidated by the insertion
+			}
+		}
+	};
+
+	encodeTree(static_cast<unsigned>(cluster.size()) - 1);
+
+	// Prototypes shared by several instances are encoded once, but every instance keeps a copy of its root
+	std::unordered_map<unsigned, unsigned> encodedRoot;
+
+	for (const InstanceGPUData& instance : cpuData->_instance)
+	{
+		auto rootIt = encodedRoot.find(instance._blasRoot);
+		if (rootIt == encodedRoot.end())
+		{
+			encodeTree(instance._blasRoot);
+			rootIt = encodedRoot.insert(std::make_pair(instance._blasRoot, static_cast<unsigned>(cpuData->_compressedRoot.size()) - 1)).first;
+		}
+		else
+		{
+			cpuData->_compressedRoot.push_back(cpuData->_compressedRoot[rootIt->second]);
+		}
+	}
+
+	if (overflow)
+	{
+		std::cout << "BVH indices exceed " << CompressedBVHNode::INDEX_MASK << "; the binary BVH is traversed instead of the compressed one" << std::endl;
+
+		std::vector<CompressedBVHNode>().swap(cpuData->_compressedNode);
+		std::vector<CompressedBVHRoot>().swap(cpuData->_compressedRoot);
+
+		return false;
+	}
+
+	std::cout << "Compressed BVH: " << cluster.size() * sizeof(BVHCluster) << " -> " << cpuData->_compressedNode.size() * sizeof(CompressedBVHNode) + cpuData->_compressedRoot.size() * sizeof(CompressedBVHRoot) << " bytes" << std::endl;
+
+	return true;
+}
+
+void Group3D::buildPLOCBVH(VolatileGPUData* gpuData)
+{
+	if (gpuData->_numStaticLeaves == 0) return;
+
+	// BVH generation
+	const unsigned radius = BVH_BUILDING_RADIUS;
+	
+	ComputeShader* findNeighborShader		= ShaderList::getInstance()->getComputeShader(RendEnum::FIND_BEST_NEIGHBOR);
+	ComputeShader* clusterMergingShader		= ShaderList::getInstance()->getComputeShader(RendEnum::CLUSTER_MERGING);
+	ComputeShader* reallocClustersShader	= ShaderList::getInstance()->getComputeShader(RendEnum::REALLOCATE_CLUSTERS);
+	ComputeShader* endLoopCompShader		= ShaderList::getInstance()->getComputeShader(RendEnum::END_LOOP_COMPUTATIONS);
+
+	// Prefix scan
+	ComputeShader* reduceShader				= ShaderList::getInstance()->getComputeShader(RendEnum::REDUCE_PREFIX_SCAN);
+	ComputeShader* downSweepShader			= ShaderList::getInstance()->getComputeShader(RendEnum::DOWN_SWEEP_PREFIX_SCAN);
+	ComputeShader* resetPositionShader		= ShaderList::getInstance()->getComputeShader(RendEnum::RESET_LAST_POSITION_PREFIX_SCAN);
+
+	// Compute shader execution data: groups and iteration control
+	unsigned arraySize = gpuData->_numStaticLeaves, startIndex = arraySize, finishBit = 0, iteration, numExec, numThreads, startThreads;
+	int numGroups, numGroups2Log;
+	const int maxGroupSize = ComputeShader::getMaxGroupSize();
+
+	// Prepare buffers for GPU
+	BVHCluster* outCluster = new BVHCluster[arraySize];					// We declare an input buffer instead of asking for a GPU one cause we've proved it's faster
+
+	// Compact cluster buffer support
+	GLuint* currentPosBuffer = new GLuint[arraySize], *currentPosBufferOut = new GLuint[arraySize];
+	std::iota(currentPosBufferOut, currentPosBufferOut + arraySize, 0);
+
+	GLuint coutBuffer				= gpuData->_tempClusterSSBO;													// Swapped during loop => not const
+	GLuint cinBuffer				= ComputeShader::setReadBuffer(outCluster, arraySize);
+	GLuint inCurrentPosition		= ComputeShader::setReadBuffer(currentPosBuffer, arraySize);		// Position of compact buffer where a cluster is saved
+	GLuint outCurrentPosition		= ComputeShader::setReadBuffer(currentPosBufferOut, arraySize);
+	const GLuint neighborIndex		= ComputeShader::setWriteBuffer(GLuint(), arraySize);				// Nearest neighbor search	
+	const GLuint prefixScan			= ComputeShader::setWriteBuffer(GLuint(), arraySize);				// Final position of each valid cluster for the next loop iteration
+	const GLuint validCluster		= ComputeShader::setWriteBuffer(GLuint(), arraySize);				// Clusters which takes part of next loop iteration
+	const GLuint mergedCluster		= ComputeShader::setWriteBuffer(GLuint(), arraySize);				// A merged cluster is always valid, but the opposite situation is not fitting
+	const GLuint numNodesCount		= ComputeShader::setReadData(arraySize);							// Number of currently added nodes, which increases as the clusters are merged
+	const GLuint arraySizeCount		= ComputeShader::setWriteBuffer(GLuint(), 1);
+
+	while (arraySize > 1)
+	{
+		// Binary tree and whole array group sizes and iteration boundaries
+		numGroups		= ComputeShader::getNumGroups(arraySize);
+		startThreads	= std::ceil(arraySize / 2.0f);
+		numExec			= std::ceil(std::log2(arraySize));
+		numGroups2Log	= ComputeShader::getNumGroups(startThreads);
+
+		std::vector<GLuint> threadCount{ startThreads };				// Thread sizes are repeated on reduce and sweep down phases
+		threadCount.reserve(numExec);
+
+		std::swap(coutBuffer, cinBuffer);
+		std::swap(inCurrentPosition, outCurrentPosition);
+
+		findNeighborShader->bindBuffers(std::vector<GLuint>{ cinBuffer, neighborIndex });
+		findNeighborShader->use();
+		findNeighborShader->setUniform("arraySize", arraySize);
+		findNeighborShader->setUniform("radius", radius);
+		findNeighborShader->execute(numGroups, 1, 1, maxGroupSize, 1, 1);
+
+		clusterMergingShader->bindBuffers(std::vector<GLuint>{ cinBuffer, _staticGPUData->_clusterSSBO, neighborIndex, validCluster, mergedCluster, 
+															   prefixScan, inCurrentPosition, numNodesCount });
+		clusterMergingShader->use();
+		clusterMergingShader->setUniform("arraySize", arraySize);
+		clusterMergingShader->execute(numGroups, 1, 1, maxGroupSize, 1, 1);
+
+		// FIRST STEP: build a binary tree with a summatory of the array
+		reduceShader->bindBuffers(std::vector<GLuint> { prefixScan });
+		reduceShader->use();
+		reduceShader->setUniform("arraySize", arraySize);
+
+		iteration = 0;
+		while (iteration < numExec)
+		{
+			numThreads = threadCount[threadCount.size() - 1];
+
+			reduceShader->setUniform("iteration", iteration++);
+			reduceShader->setUniform("numThreads", numThreads);
+			reduceShader->execute(numGroups2Log, 1, 1, maxGroupSize, 1, 1);
+
+			threadCount.push_back(std::ceil(numThreads / 2.0f));
+		}
+
+		// SECOND STEP: set last position to zero, its faster to do it in GPU than retrieve the array in CPU, modify and write it again to GPU
+		resetPositionShader->bindBuffers(std::vector<GLuint> { prefixScan });
+		resetPositionShader->use();
+		resetPositionShader->setUniform("arraySize", arraySize);
+		resetPositionShader->execute(1, 1, 1, 1, 1, 1);
+
+		// THIRD STEP: build tree back to first level and compute final summatory
+		downSweepShader->bindBuffers(std::vector<GLuint> { prefixScan });
+		downSweepShader->use();
+		downSweepShader->setUniform("arraySize", arraySize);
+
+		iteration = threadCount.size() - 2;
+		while (iteration >= 0 && iteration < numExec)
+		{
+			downSweepShader->setUniform("iteration", iteration);
+			downSweepShader->setUniform("numThreads", threadCount[iteration--]);
+			downSweepShader->execute(numGroups2Log, 1, 1, maxGroupSize, 1, 1);
+		}
+
+		reallocClustersShader->bindBuffers(std::vector<GLuint>{ cinBuffer, coutBuffer, validCluster, prefixScan, inCurrentPosition, outCurrentPosition });
+		reallocClustersShader->use();
+		reallocClustersShader->setUniform("arraySize", arraySize);
+		reallocClustersShader->execute(numGroups, 1, 1, maxGroupSize, 1, 1);
+
+		// Updates cluster size
+		endLoopCompShader->bindBuffers(std::vector<GLuint>{ arraySizeCount, prefixScan, validCluster });
+		endLoopCompShader->use();
+		endLoopCompShader->setUniform("arraySize", arraySize);
+		endLoopCompShader->execute(1, 1, 1, 1, 1, 1); 
+
+		arraySize = endLoopCompShader->readData(arraySizeCount, GLuint())[0];
+	}
+
+	// Nodes are read back once compute shaders finish, as trees of prototypes and the top level are appended and collapsed in CPU
+	gpuData->_cluster.resize(gpuData->_numStaticLeaves * 2 - 1);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, _staticGPUData->_clusterSSBO);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, gpuData->_cluster.size() * sizeof(BVHCluster), gpuData->_cluster.data());
+
+	// Free buffers from GPU
+	GLuint toDeleteBuffers[] = { coutBuffer, cinBuffer, inCurrentPosition, outCurrentPosition, neighborIndex,
+							     prefixScan, validCluster, mergedCluster, numNodesCount, arraySizeCount, _staticGPUData->_clusterSSBO };
+	glDeleteBuffers(sizeof(toDeleteBuffers) / sizeof(GLuint), toDeleteBuffers);
+	_staticGPUData->_clusterSSBO = -1;
+
+	// Free dynamic memory
+	delete[]	outCluster;
+	delete[]	currentPosBuffer;
+	delete[]	currentPosBufferOut;
+}
+
+void Group3D::buildPrototypeBVHs(VolatileGPUData* gpuData, std::unordered_map<Model3D*, unsigned>& prototypeIndex, std::vector<std::vector<BVHCluster>>& prototypeLeaves, const std::vector<AABB>& prototypeAABB, AABB& aabb)
+{
+	// BVHs of prototypes are independent and their sizes are known, hence they are built in parallel
+	std::vector<std::vector<BVHCluster>> prototypeNodes(_prototypes.size());
+	std::vector<unsigned> prototypeOffset(_prototypes.size()), blasRoot(_prototypes.size(), BVH_NULL_INDEX);
+
+	for (unsigned prototypeIdx = 0; prototypeIdx < _prototypes.size(); ++prototypeIdx)
+	{
+		prototypeOffset[prototypeIdx] = _staticGPUData->_numClusters;
+		if (!prototypeLeaves[prototypeIdx].empty()) _staticGPUData->_numClusters += prototypeLeaves[prototypeIdx].size() * 2 - 1;
+	}
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int prototypeIdx = 0; prototypeIdx < _prototypes.size(); ++prototypeIdx)
+	{
+		std::vector<BVHCluster>& leaves = prototypeLeaves[prototypeIdx];
+		if (leaves.empty()) continue;
+
+		prototypeNodes[prototypeIdx].reserve(leaves.size() * 2 - 1);
+		blasRoot[prototypeIdx] = this->buildMedianSplitBVH(leaves, 0, leaves.size(), prototypeNodes[prototypeIdx], prototypeOffset[prototypeIdx]);
+		std::vector<BVHCluster>().swap(leaves);
+	}
+
+	for (std::vector<BVHCluster>& nodes : prototypeNodes)
+	{
+		gpuData->_instancingCluster.insert(gpuData->_instancingCluster.end(), nodes.begin(), nodes.end());
+		std::vector<BVHCluster>().swap(nodes);
+	}
+
+	// Instances are placed in world space, where they become leaves of the top level
+	for (InstancedModel* instance : _instances)
+	{
+		Model3D* prototype = instance->getPrototype();
+		const unsigned prototypeIdx = prototypeIndex[prototype];
+		if (blasRoot[prototypeIdx] == BVH_NULL_INDEX || prototype->getNumModelComponents() == 0) continue;
+
+		InstanceGPUData instanceData;
+		instanceData._transform				= instance->getModelMatrix();
+		instanceData._inverseTransform		= glm::inverse(instanceData._transform);
+		instanceData._blasRoot				= blasRoot[prototypeIdx];
+		instanceData._modelCompOffset		= instance->getModelComponent(0)->_id;
+		instanceData._prototypeCompOffset	= prototype->getModelComponent(0)->_id;
+
+		const AABB instanceAABB = prototypeAABB[prototypeIdx].transform(instanceData._transform);
+		BVHCluster leaf;
+		leaf._minPoint		= instanceAABB.min();
+		leaf._maxPoint		= instanceAABB.max();
+		leaf._prevIndex1	= leaf._prevIndex2 = BVH_NULL_INDEX;
+		leaf._faceIndex		= BVH_INSTANCE_FLAG | static_cast<GLuint>(gpuData->_instance.size());
+
+		gpuData->_instance.push_back(instanceData);
+		gpuData->_topLevelLeaves.push_back(leaf);
+		aabb.update(instanceAABB);
+	}
+
+	// The top level also links the tree of non-instanced geometry, which is already in world space
+	if (!gpuData->_topLevelLeaves.empty())
+	{
+		_staticGPUData->_numClusters += (gpuData->_topLevelLeaves.size() + unsigned(gpuData->_numStaticLeaves > 0)) * 2 - 1;
+	}
+}
+
+void Group3D::buildWideBVH(StaticCPUData* cpuData)
+{
+	auto surfaceArea = [](const BVHCluster& node) -> float
+	{
+		const vec3 size = node._maxPoint - node._minPoint;
+
+		return 2.0f * (size.x * size.y + size.x * size.z + size.y * size.z);
+	};
+
+	const std::vector<BVHCluster>& cluster = cpuData->_cluster;
+	std::vector<std::pair<unsigned, unsigned>> toExplore;				// Binary node whose descendants fill a wide node, and such wide node
+	std::unordered_map<unsigned, unsigned> wideRoot;
+
+	cpuData->_wideNode.clear();
+	cpuData->_wideInstanceRoot.clear();
+
+	if (cluster.empty()) return;
+
+	auto collapseTree = [&](const unsigned root) -> unsigned
+	{
+		const unsigned wideRootIdx = static_cast<unsigned>(cpuData->_wideNode.size());
+
+		cpuData->_wideNode.emplace_back();
+		toExplore.push_back(std::make_pair(root, wideRootIdx));
+
+		while (!toExplore.empty())
+		{
+			const unsigned clusterIdx = toExplore.back().first, wideIdx = toExplore.back().second;
+			std::vector<unsigned> children;
+			toExplore.pop_back();
+
+			if (cluster[clusterIdx]._faceIndex != BVH_NULL_INDEX)
+			{
+				children.push_back(clusterIdx);									// Tree made of a single leaf
+			}
+			else
+			{
+				children.push_back(cluster[clusterIdx]._prevIndex1);
+				children.push_back(cluster[clusterIdx]._prevIndex2);
+			}
+
+			// The inner child with the largest area, i.e. the most likely to be hit, is replaced by its own children
+			while (children.size() < BVH_WIDTH)
+			{
+				int largestChild = -1;
+				float largestArea = -1.0f;
+
+				for (int childIdx = 0; childIdx < static_cast<int>(children.size()); ++childIdx)
+				{
+					const BVHCluster& child = cluster[children[childIdx]];
+
+					if (child._faceIndex == BVH_NULL_INDEX && surfaceArea(child) > largestArea)
+					{
+						largestChild = childIdx;
+						largestArea = surfaceArea(child);
+					}
+				}
+
+				if (largestChild < 0) break;
+
+				const BVHCluster& child = cluster[children[largestChild]];
+				children[largestChild] = child._prevIndex1;
+				children.push_back(child._prevIndex2);
+			}
+
+			for (unsigned slotIdx = 0; slotIdx < BVH_WIDTH; ++slotIdx)
+			{
+				vec3 minPoint(FLT_MAX), maxPoint(-FLT_MAX);
+				GLuint childIndex = BVH_NULL_INDEX, numFaces = 0;
+
+				if (slotIdx < children.size())
+				{
+					const BVHCluster& child = cluster[children[slotIdx]];
+					minPoint = child._minPoint;
+					maxPoint = child._maxPoint;
+
+					if (child._faceIndex == BVH_NULL_INDEX)
+					{
+						childIndex = static_cast<GLuint>(cpuData->_wideNode.size());
+						cpuData->_wideNode.emplace_back();
+						toExplore.push_back(std::make_pair(children[slotIdx], childIndex));
+					}
+					else
+					{
+						childIndex = child._faceIndex;
+						numFaces = (child._faceIndex & BVH_INSTANCE_FLAG) != 0 ? 0 : child._numFaces;
+					}
+				}
+
+				WideBVHNode& wideNode = cpuData->_wideNode[wideIdx];			// Not kept across insertions, as they may reallocate the vector
+				wideNode._minX[slotIdx] = minPoint.x; wideNode._minY[slotIdx] = minPoint.y; wideNode._minZ[slotIdx] = minPoint.z;
+				wideNode._maxX[slotIdx] = maxPoint.x; wideNode._maxY[slotIdx] = maxPoint.y; wideNode._maxZ[slotIdx] = maxPoint.z;
+				wideNode._child[slotIdx] = childIndex;
+				wideNode._numFaces[slotIdx] = numFaces;
+			}
+		}
+
+		return wideRootIdx;
+	};
+
+	collapseTree(static_cast<unsigned>(cluster.size()) - 1);
+
+	for (const InstanceGPUData& instance : cpuData->_instance)
+	{
+		auto rootIt = wideRoot.find(instance._blasRoot);
+		if (rootIt == wideRoot.end())
+		{
+			rootIt = wideRoot.insert(std::make_pair(instance._blasRoot, collapseTree(instance._blasRoot))).first;
+		}
+
+		cpuData->_wideInstanceRoot.push_back(rootIt->second);
+	}
+}
+
+void Group3D::collapseLeaves(VolatileGPUData* gpuData)
+{
+	std::vector<BVHCluster>& nodes = gpuData->_cluster;
+	std::vector<BVHCluster> cluster;
+	std::vector<GLuint> leafFace;
+
+	cluster.swap(nodes);
+	if (!cluster.empty()) this->collapseTree(gpuData, cluster, leafFace);
+
+	_staticGPUData->_numClusters		= nodes.size();
+	_staticGPUData->_numLeafFaces		= leafFace.size();
+
+	// Collapsed tree is uploaded, or kept in main memory as the only copy of the scene
+	if (_gpuBuffers)
+	{
+		_staticGPUData->_clusterSSBO	= ComputeShader::setReadBuffer(nodes, GL_DYNAMIC_DRAW);
+		_staticGPUData->_leafFaceSSBO	= leafFace.empty() ? ComputeShader::setWriteBuffer(GLuint(), 1, GL_STATIC_DRAW) : ComputeShader::setReadBuffer(leafFace, GL_STATIC_DRAW);
+		_staticGPUData->_instanceSSBO	= gpuData->_instance.empty() ? ComputeShader::setWriteBuffer(InstanceGPUData(), 1, GL_STATIC_DRAW) : ComputeShader::setReadBuffer(gpuData->_instance, GL_STATIC_DRAW);
+	}
+	else
+	{
+		_staticCPUData->_cluster		= nodes;
+		_staticCPUData->_leafFace.swap(leafFace);
+		_staticCPUData->_instance		= gpuData->_instance;
+
+		// Layouts derived from the previous nodes are built again once they are requested
+		std::vector<WideBVHNode>().swap(_staticCPUData->_wideNode);
+		std::vector<GLuint>().swap(_staticCPUData->_wideInstanceRoot);
+		std::vector<CompressedBVHNode>().swap(_staticCPUData->_compressedNode);
+		std::vector<CompressedBVHRoot>().swap(_staticCPUData->_compressedRoot);
+	}
+}
+
+void Group3D::collapseTree(VolatileGPUData* gpuData, std::vector<BVHCluster>& cluster, std::vector<GLuint>& leafFace)
+{
+	// Leaves of the tree of non-instanced geometry reference fragments if faces were split, whereas the leaf faces buffer references faces
+	if (!gpuData->_fragmentFace.empty())
+	{
+		for (unsigned clusterIdx = 0; clusterIdx < gpuData->_numStaticLeaves * 2 - 1; ++clusterIdx)
+		{
+			if (cluster[clusterIdx]._faceIndex != BVH_NULL_INDEX) cluster[clusterIdx]._faceIndex = gpuData->_fragmentFace[cluster[clusterIdx]._faceIndex];
+		}
+	}
+
+	auto surfaceArea = [](const BVHCluster& node) -> float
+	{
+		const vec3 size = node._maxPoint - node._minPoint;
+
+		return 2.0f * (size.x * size.y + size.x * size.z + size.y * size.z);
+	};
+
+	// First step: faces and cost of every subtree. Every builder writes children before their parents, hence a single sweep is enough
+	std::vector<unsigned> numFaces(cluster.size());
+	std::vector<float> cost(cluster.size());
+	std::vector<uint8_t> isLeaf(cluster.size(), 0);
+
+	for (unsigned clusterIdx = 0; clusterIdx < cluster.size(); ++clusterIdx)
+	{
+		const BVHCluster& node = cluster[clusterIdx];
+
+		if ((node._faceIndex & BVH_INSTANCE_FLAG) != 0)
+		{
+			// Instance leaves are never merged, and their cost is the one of the prototype tree
+			numFaces[clusterIdx]	= _maxLeafFaces + 1;
+			cost[clusterIdx]		= BVH_TRAVERSAL_COST + cost[gpuData->_instance[node._faceIndex & ~BVH_INSTANCE_FLAG]._blasRoot];
+		}
+		else if (node._faceIndex != BVH_NULL_INDEX)
+		{
+			numFaces[clusterIdx]	= 1;
+			cost[clusterIdx]		= BVH_INTERSECTION_COST;
+			isLeaf[clusterIdx]		= 1;
+		}
+		else
+		{
+			const unsigned child1 = node._prevIndex1, child2 = node._prevIndex2;
+			const float area = surfaceArea(node);
+			const float splitCost = BVH_TRAVERSAL_COST + (area > .0f ? (surfaceArea(cluster[child1]) * cost[child1] + surfaceArea(cluster[child2]) * cost[child2]) / area : cost[child1] + cost[child2]);
+
+			numFaces[clusterIdx]	= glm::min(numFaces[child1] + numFaces[child2], _maxLeafFaces + 1);
+			isLeaf[clusterIdx]		= numFaces[clusterIdx] <= _maxLeafFaces && BVH_INTERSECTION_COST * numFaces[clusterIdx] <= splitCost;
+			cost[clusterIdx]		= isLeaf[clusterIdx] ? BVH_INTERSECTION_COST * numFaces[clusterIdx] : splitCost;
+		}
+	}
+
+	// Second step: collapsed trees are written from the roots of prototypes, so that the root of the whole scene is still the last node
+	std::vector<BVHCluster>& nodes = gpuData->_cluster;
+	std::unordered_map<unsigned, unsigned> collapsedRoot;
+
+	nodes.reserve(cluster.size());
+	leafFace.reserve(cluster.size() / 2 + 1);
+
+	for (InstanceGPUData& instance : gpuData->_instance)
+	{
+		auto rootIt = collapsedRoot.find(instance._blasRoot);
+		if (rootIt == collapsedRoot.end())
+		{
+			rootIt = collapsedRoot.insert(std::make_pair(instance._blasRoot, this->collapseNode(cluster, isLeaf, instance._blasRoot, nodes, leafFace))).first;
+		}
+
+		instance._blasRoot = rootIt->second;
+	}
+
+	this->collapseNode(cluster, isLeaf, cluster.size() - 1, nodes, leafFace);
+	this->reorderNodes(nodes, gpuData->_instance);
+
+	std::cout << "BVH nodes: " << cluster.size() << " -> " << nodes.size() << " (up to " << _maxLeafFaces << " faces per leaf)" << std::endl;
+}
+
+unsigned Group3D::collapseNode(const std::vector<BVHCluster>& cluster, const std::vector<uint8_t>& isLeaf, const unsigned clusterIdx, std::vector<BVHCluster>& nodes, std::vector<GLuint>& leafFace)
+{
+	BVHCluster node = cluster[clusterIdx];
+	node._numFaces = 0;
+
+	if (isLeaf[clusterIdx])
+	{
+		// Faces of the subtree are gathered in traversal order
+		std::vector<unsigned> toExplore{ clusterIdx };
+		node._faceIndex = leafFace.size();
+
+		while (!toExplore.empty())
+		{
+			const BVHCluster& subtreeNode = cluster[toExplore.back()];
+			toExplore.pop_back();
+
+			if (subtreeNode._faceIndex != BVH_NULL_INDEX)
+			{
+				leafFace.push_back(subtreeNode._faceIndex);
+			}
+			else
+			{
+				toExplore.push_back(subtreeNode._prevIndex2);
+				toExplore.push_back(subtreeNode._prevIndex1);
+			}
+		}
+
+		// Fragments of the same face may be gathered into the same leaf
+		std::sort(leafFace.begin() + node._faceIndex, leafFace.end());
+		leafFace.erase(std::unique(leafFace.begin() + node._faceIndex, leafFace.end()), leafFace.end());
+
+		node._numFaces		= leafFace.size() - node._faceIndex;
+		node._prevIndex1	= node._prevIndex2 = BVH_NULL_INDEX;
+	}
+	else if (node._faceIndex == BVH_NULL_INDEX)
+	{
+		node._prevIndex1	= this->collapseNode(cluster, isLeaf, cluster[clusterIdx]._prevIndex1, nodes, leafFace);
+		node._prevIndex2	= this->collapseNode(cluster, isLeaf, cluster[clusterIdx]._prevIndex2, nodes, leafFace);
+	}
+
+	nodes.push_back(node);
+
+	return nodes.size() - 1;
+}
+
+uint64_t Group3D::computeContentHash()
+{
+	const uint64_t FNV_OFFSET = 14695981039346656037ull, FNV_PRIME = 1099511628211ull;
+
+	auto hashWords = [&](uint64_t& hash, const void* data, const size_t numWords)
+	{
+		const uint32_t* word = static_cast<const uint32_t*>(data);
+
+		for (size_t wordIdx = 0; wordIdx < numWords; ++wordIdx)
+		{
+			hash = (hash ^ word[wordIdx]) * FNV_PRIME;
+		}
+	};
+
+	// Padding fields are not initialized, therefore only meaningful attributes are hashed
+	std::vector<uint64_t> modelCompHash(_globalModelComp.size(), FNV_OFFSET);
+
+	#pragma omp parallel for
+	for (int modelCompIdx = 0; modelCompIdx < _globalModelComp.size(); ++modelCompIdx)
+	{
+		ModelComponent* modelComp = _globalModelComp[modelCompIdx];
+		uint64_t& hash = modelCompHash[modelCompIdx];
+		const uint32_t header[] = { unsigned(modelComp->_geometry.size()), unsigned(modelComp->_topology.size()), modelComp->_materialID };
+
+		hashWords(hash, header, 3);
+
+		for (const VertexGPUData& vertex : modelComp->_geometry)
+		{
+			hashWords(hash, &vertex._position, 3);
+			hashWords(hash, &vertex._normal, 3);
+			hashWords(hash, &vertex._textCoord, 2);
+			hashWords(hash, &vertex._kad, 4);
+			hashWords(hash, &vertex._ks, 1);
+			hashWords(hash, &vertex._shininess, 1);
+		}
+
+		for (const FaceGPUData& face : modelComp->_topology)
+		{
+			hashWords(hash, &face._vertices, 3);
+			hashWords(hash, &face._modelCompID, 1);
+		}
 	}
 
-	// Compute scene AABB once the geometry and topology is all given in a row
-	_staticGPUData->_numTriangles		= groupData->_triangleMesh.size();
-	this->_aabb							= this->computeAABB(groupData);
+	uint64_t hash = FNV_OFFSET;
+	const uint32_t bvhBuilder = _bvhBuilder, preSplitFaces = _preSplitFaces;
+	hashWords(hash, &BVH_BUILDING_RADIUS, 1);
+	hashWords(hash, &bvhBuilder, 1);
+	hashWords(hash, &_maxLeafFaces, 1);
+	hashWords(hash, &preSplitFaces, 1);
+	hashWords(hash, modelCompHash.data(), modelCompHash.size() * 2);
 
-	staticGPUData->_groupGeometrySSBO	= ComputeShader::setReadBuffer(groupData->_geometry, GL_STATIC_DRAW);
-	staticGPUData->_groupMeshSSBO		= ComputeShader::setReadBuffer(groupData->_meshData, GL_STATIC_DRAW);
-	staticGPUData->_groupTopologySSBO	= ComputeShader::setReadBuffer(groupData->_triangleMesh, GL_STATIC_DRAW);
-	const GLuint mortonCodes			= this->computeMortonCodes();
-	const GLuint sortedIndices			= this->sortFacesByMortonCode(mortonCodes);
+	// Instances only add transformations, since their prototypes are already registered
+	for (InstancedModel* instance : _instances)
+	{
+		const mat4 transform = instance->getModelMatrix();
+		const uint32_t prototypeIdx = std::find(_prototypes.begin(), _prototypes.end(), instance->getPrototype()) - _prototypes.begin();
 
-	std::cout << "AABB Size: " << this->_aabb.size().x << ", " << this->_aabb.size().y << ", " << this->_aabb.size().z << std::endl;
-	std::cout << "AABB Center: " << this->_aabb.center().x << ", " << this->_aabb.center().y << ", " << this->_aabb.center().z << std::endl;
-	
-	this->buildClusterBuffer(volatileGPUData, sortedIndices);
+		hashWords(hash, &prototypeIdx, 1);
+		hashWords(hash, &transform, 16);
+	}
 
-	delete groupData;
+	return hash;
 }
 
-void Group3D::buildBVHVAO(VolatileGPUData* gpuData)
+GLuint Group3D::computeMortonCodes(VolatileGPUData* gpuData)
 {
-	if (!_bvhVAO)
+	ComputeShader* computeMortonShader = ShaderList::getInstance()->getComputeShader(RendEnum::COMPUTE_MORTON_CODES);
+
+	const unsigned arraySize = gpuData->_numStaticLeaves;
+	const GLuint faceSSBO = gpuData->_fragmentFace.empty() ? _staticGPUData->_groupTopologySSBO : gpuData->_fragmentSSBO;
+	const int numGroups = ComputeShader::getNumGroups(arraySize);
+	const GLuint mortonCodeBuffer = ComputeShader::setWriteBuffer(unsigned(), arraySize);
+
+	computeMortonShader->bindBuffers(std::vector<GLuint> { faceSSBO, mortonCodeBuffer });
+	computeMortonShader->use();
+	computeMortonShader->setUniform("arraySize", arraySize);
+	computeMortonShader->setUniform("sceneMaxBoundary", _aabb.max());
+	computeMortonShader->setUniform("sceneMinBoundary", _aabb.min());
+	computeMortonShader->execute(numGroups, 1, 1, ComputeShader::getMaxGroupSize(), 1, 1);
+
+	return mortonCodeBuffer;
+}
+
+float Group3D::computeSAHCost(const std::vector<BVHCluster>& cluster, const std::vector<InstanceGPUData>& instance)
+{
+	if (cluster.empty()) return .0f;
+
+	auto surfaceArea = [](const BVHCluster& node) -> float
+	{
+		const vec3 size = node._maxPoint - node._minPoint;
+
+		return 2.0f * (size.x * size.y + size.x * size.z + size.y * size.z);
+	};
+
+	// Same cost as the one minimized while collapsing leaves, now with the actual number of faces of every leaf
+	std::vector<float> cost(cluster.size());
+
+	for (unsigned clusterIdx = 0; clusterIdx < cluster.size(); ++clusterIdx)
 	{
-		_bvhVAO = Primitives::getCubesVAO(gpuData->_cluster, _numClusters = gpuData->_cluster.size());
+		const BVHCluster& node = cluster[clusterIdx];
+
+		if ((node._faceIndex & BVH_INSTANCE_FLAG) != 0)
+		{
+			cost[clusterIdx] = BVH_TRAVERSAL_COST + cost[instance[node._faceIndex & ~BVH_INSTANCE_FLAG]._blasRoot];
+		}
+		else if (node._faceIndex != BVH_NULL_INDEX)
+		{
+			cost[clusterIdx] = BVH_INTERSECTION_COST * node._numFaces;
+		}
+		else
+		{
+			const unsigned child1 = node._prevIndex1, child2 = node._prevIndex2;
+			const float area = surfaceArea(node);
+
+			cost[clusterIdx] = BVH_TRAVERSAL_COST + (area > .0f ? (surfaceArea(cluster[child1]) * cost[child1] + surfaceArea(cluster[child2]) * cost[child2]) / area : cost[child1] + cost[child2]);
+		}
 	}
+
+	return cost.back();
 }
 
-void Group3D::buildClusterBuffer(VolatileGPUData* gpuData, const GLuint sortedFaces)
+std::string Group3D::getBVHCacheFilename(const uint64_t contentHash)
 {
-	ComputeShader* buildClusterShader = ShaderList::getInstance()->getComputeShader(RendEnum::BUILD_CLUSTER_BUFFER);
+	std::stringstream filename;
+	filename << BVH_CACHE_FOLDER << std::hex << std::setw(16) << std::setfill('0') << contentHash << BVH_CACHE_EXTENSION;
 
-	const unsigned arraySize		= _staticGPUData->_numTriangles;
-	const unsigned clusterSize		= _staticGPUData->_numTriangles * 2 - 1;				// We'll only fill arraySize clusters
-	const int numGroups				= ComputeShader::getNumGroups(arraySize);
+	return filename.str();
+}
 
-	BVHCluster* clusterData			= new BVHCluster[clusterSize], *tempClusterData = new BVHCluster[arraySize];
-	_staticGPUData->_clusterSSBO	= ComputeShader::setWriteBuffer(BVHCluster(), clusterSize, GL_DYNAMIC_DRAW);
-	gpuData->_tempClusterSSBO		= ComputeShader::setWriteBuffer(BVHCluster(), arraySize, GL_DYNAMIC_DRAW);
+void Group3D::radixSortMortonCodes(std::vector<uint64_t>& mortonCode, std::vector<unsigned>& index)
+{
+	const unsigned numDigits = 1 << BVH_RADIX_SORT_DIGIT_BITS, digitMask = numDigits - 1;
+	const int numElements = static_cast<int>(mortonCode.size());
+	const int numChunks = static_cast<int>(glm::max(std::thread::hardware_concurrency(), 1u)) * 4;
+	const int chunkSize = (numElements + numChunks - 1) / numChunks;
 
-	buildClusterShader->bindBuffers(std::vector<GLuint> { _staticGPUData->_groupTopologySSBO, sortedFaces, _staticGPUData->_clusterSSBO, gpuData->_tempClusterSSBO });
-	buildClusterShader->use();
-	buildClusterShader->setUniform("arraySize", arraySize);
-	buildClusterShader->execute(numGroups, 1, 1, ComputeShader::getMaxGroupSize(), 1, 1);
+	std::vector<uint64_t> sortedCode(numElements);
+	std::vector<unsigned> sortedIndex(numElements), histogram(numChunks * numDigits);
 
-	glDeleteBuffers(1, &sortedFaces);
+	for (unsigned shift = 0; shift < 64; shift += BVH_RADIX_SORT_DIGIT_BITS)
+	{
+		std::fill(histogram.begin(), histogram.end(), 0);
+
+		#pragma omp parallel for
+		for (int chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+		{
+			unsigned* chunkHistogram = histogram.data() + chunkIdx * numDigits;
+
+			for (int elementIdx = chunkIdx * chunkSize; elementIdx < glm::min((chunkIdx + 1) * chunkSize, numElements); ++elementIdx)
+			{
+				++chunkHistogram[(mortonCode[elementIdx] >> shift) & digitMask];
+			}
+		}
+
+		// Exclusive scan in digit-major order, so that every chunk scatters its elements after those of previous chunks. Passes where
+		// every element shares the same digit are skipped, as it happens with the highest bits of codes
+		unsigned offset = 0;
+		bool sameDigit = false;
+
+		for (unsigned digit = 0; digit < numDigits; ++digit)
+		{
+			unsigned digitCount = 0;
+
+			for (int chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+			{
+				const unsigned count = histogram[chunkIdx * numDigits + digit];
+				histogram[chunkIdx * numDigits + digit] = offset;
+				offset += count;
+				digitCount += count;
+			}
+
+			sameDigit |= digitCount == static_cast<unsigned>(numElements);
+		}
+
+		if (sameDigit) continue;
+
+		#pragma omp parallel for
+		for (int chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+		{
+			unsigned* chunkOffset = histogram.data() + chunkIdx * numDigits;
+
+			for (int elementIdx = chunkIdx * chunkSize; elementIdx < glm::min((chunkIdx + 1) * chunkSize, numElements); ++elementIdx)
+			{
+				const unsigned position = chunkOffset[(mortonCode[elementIdx] >> shift) & digitMask]++;
+				sortedCode[position] = mortonCode[elementIdx];
+				sortedIndex[position] = index[elementIdx];
+			}
+		}
+
+		mortonCode.swap(sortedCode);
+		index.swap(sortedIndex);
+	}
 }
 
-AABB Group3D::computeAABB(VolatileGroupData* groupData)
+bool Group3D::readBVHCache(const std::string& filename, const uint64_t contentHash)
 {
-	ComputeShader* computeAABBShader	= ShaderList::getInstance()->getComputeShader(RendEnum::COMPUTE_GROUP_AABB);
+	std::ifstream fin(filename, std::ios::in | std::ios::binary);
+	if (!fin.is_open())
+	{
+		return false;
+	}
+
+	uint32_t version;
+	uint64_t hash;
+	unsigned numTriangles, numInstances;
+	vec3 minPoint, maxPoint;
+	size_t numVertices, numFaces, numMeshes, numClusters, numLeafFaces;
+
+	fin.read((char*)&version, sizeof(uint32_t));
+	fin.read((char*)&hash, sizeof(uint64_t));
+	fin.read((char*)&numTriangles, sizeof(unsigned));
+	fin.read((char*)&numInstances, sizeof(unsigned));
+	fin.read((char*)&minPoint, sizeof(vec3));
+	fin.read((char*)&maxPoint, sizeof(vec3));
+	fin.read((char*)&numVertices, sizeof(size_t));
+	fin.read((char*)&numFaces, sizeof(size_t));
+	fin.read((char*)&numMeshes, sizeof(size_t));
+	fin.read((char*)&numClusters, sizeof(size_t));
+	fin.read((char*)&numLeafFaces, sizeof(size_t));
+
+	if (!fin || version != BVH_CACHE_VERSION || hash != contentHash || numMeshes != _globalModelComp.size() || numInstances != _instances.size())
+	{
+		return false;
+	}
+
+	StaticGPUData* staticGPUData		= new StaticGPUData;
+	StaticCPUData* staticCPUData		= nullptr;
+	staticGPUData->_numTriangles		= numTriangles;
+	staticGPUData->_numClusters			= numClusters;
+	staticGPUData->_numInstances		= numInstances;
+	staticGPUData->_numLeafFaces		= numLeafFaces;
+
+	// File content is written into mapped SSBOs with no intermediate copy
+	auto readBuffer = [&](const size_t numBytes, const GLuint changeFrequency) -> GLuint
+	{
+		GLuint bufferID;
+
+		glGenBuffers(1, &bufferID);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, bufferID);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, numBytes, nullptr, changeFrequency);
+
+		if (numBytes > 0)										// Empty ranges cannot be mapped
+		{
+			char* bufferData = (char*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, numBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+			fin.read(bufferData, numBytes);
+			glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+		}
 
-	const GLuint triangleBufferID		= ComputeShader::setReadBuffer(groupData->_triangleMesh, GL_DYNAMIC_DRAW);
-	const GLuint maxPointBufferID		= ComputeShader::setWriteBuffer(vec4(), 1, GL_DYNAMIC_DRAW);
-	const GLuint minPointBufferID		= ComputeShader::setWriteBuffer(vec4(), 1, GL_DYNAMIC_DRAW);
+		return bufferID;
+	};
 
-	unsigned arraySize		= _staticGPUData->_numTriangles;
-	const int numExec		= std::ceil(std::log2(arraySize));
-	unsigned numThreads		= std::ceil(arraySize / 2.0f);
-	int numGroups			= ComputeShader::getNumGroups(numThreads);
+	// Otherwise arrays are read into main memory, which is the only copy of the scene
+	auto readArray = [&](auto& data, const size_t size)
+	{
+		data.resize(size);
+		fin.read((char*)data.data(), size * sizeof(data[0]));
+	};
 
-	computeAABBShader->bindBuffers(std::vector<GLuint> { triangleBufferID, maxPointBufferID, minPointBufferID });
-	computeAABBShader->use();
-	computeAABBShader->setUniform("arraySize", arraySize);
+	if (_gpuBuffers)
+	{
+		staticGPUData->_groupGeometrySSBO	= readBuffer(numVertices * sizeof(VertexGPUData), GL_STATIC_DRAW);
+		staticGPUData->_groupTopologySSBO	= readBuffer(numFaces * sizeof(FaceGPUData), GL_STATIC_DRAW);
+		staticGPUData->_groupMeshSSBO		= readBuffer(numMeshes * sizeof(MeshGPUData), GL_STATIC_DRAW);
+		staticGPUData->_clusterSSBO			= readBuffer(numClusters * sizeof(BVHCluster), GL_DYNAMIC_DRAW);
+		staticGPUData->_leafFaceSSBO		= numLeafFaces > 0 ? readBuffer(numLeafFaces * sizeof(GLuint), GL_STATIC_DRAW) : ComputeShader::setWriteBuffer(GLuint(), 1, GL_STATIC_DRAW);
+		staticGPUData->_instanceSSBO		= numInstances > 0 ? readBuffer(numInstances * sizeof(InstanceGPUData), GL_STATIC_DRAW) : ComputeShader::setWriteBuffer(InstanceGPUData(), 1, GL_STATIC_DRAW);
+	}
+	else
+	{
+		staticCPUData = new StaticCPUData;
+		readArray(staticCPUData->_geometry, numVertices);
+		readArray(staticCPUData->_triangleMesh, numFaces);
+		readArray(staticCPUData->_meshData, numMeshes);
+		readArray(staticCPUData->_cluster, numClusters);
+		readArray(staticCPUData->_leafFace, numLeafFaces);
+		readArray(staticCPUData->_instance, numInstances);
+	}
 
-	for (unsigned i = 0; i < numExec; ++i)
+	if (!fin)
 	{
-		computeAABBShader->setUniform("iteration", i);
-		computeAABBShader->setUniform("numThreads", numThreads);
-		computeAABBShader->execute(numGroups, 1, 1, ComputeShader::getMaxGroupSize(), 1, 1);
+		delete staticGPUData;									// Truncated file, BVH must be built again
+		delete staticCPUData;
 
-		numThreads = std::ceil(numThreads / 2.0f);
-		numGroups = ComputeShader::getNumGroups(numThreads);
+		return false;
 	}
 
-	vec4* pMaxPoint = computeAABBShader->readData(maxPointBufferID, vec4()), *pMinPoint = computeAABBShader->readData(minPointBufferID, vec4());
-	vec3 maxPoint = *pMaxPoint, minPoint = *pMinPoint;
+	delete _staticGPUData;
+	_staticGPUData = staticGPUData;
+	delete _staticCPUData;
+	_staticCPUData = staticCPUData;
+	_aabb = AABB(minPoint, maxPoint);
 
-	glDeleteBuffers(1, &triangleBufferID);
-	glDeleteBuffers(1, &maxPointBufferID);
-	glDeleteBuffers(1, &minPointBufferID);
+	for (ModelComponent* modelComp : _globalModelComp)
+	{
+		modelComp->releaseMemory();								// As in aggregateSSBOData
+	}
 
-	return AABB(minPoint, maxPoint);
+	return true;
 }
 
-GLuint Group3D::computeMortonCodes()
+void Group3D::rebuildBVH(StaticCPUData* cpuData)
 {
-	ComputeShader* computeMortonShader = ShaderList::getInstance()->getComputeShader(RendEnum::COMPUTE_MORTON_CODES);
+	VolatileGPUData* volatileGPUData = new VolatileGPUData;
+	const std::vector<FaceGPUData>& faces = cpuData->_triangleMesh;
 
-	const unsigned arraySize = _staticGPUData->_numTriangles;
-	const int numGroups = ComputeShader::getNumGroups(arraySize);
-	const GLuint mortonCodeBuffer = ComputeShader::setWriteBuffer(unsigned(), arraySize);
+	// Leaves are gathered from the refitted faces, since model components released their geometry once it was aggregated
+	std::unordered_map<Model3D*, unsigned> prototypeIndex;
+	std::vector<std::vector<BVHCluster>> prototypeLeaves(_prototypes.size());
+	std::vector<AABB> prototypeAABB(_prototypes.size());
+	AABB aabb;
 
-	computeMortonShader->bindBuffers(std::vector<GLuint> { _staticGPUData->_groupTopologySSBO, mortonCodeBuffer });
-	computeMortonShader->use();
-	computeMortonShader->setUniform("arraySize", arraySize);
-	computeMortonShader->setUniform("sceneMaxBoundary", _aabb.max());
-	computeMortonShader->setUniform("sceneMinBoundary", _aabb.min());
-	computeMortonShader->execute(numGroups, 1, 1, ComputeShader::getMaxGroupSize(), 1, 1);
+	for (unsigned prototypeIdx = 0; prototypeIdx < _prototypes.size(); ++prototypeIdx)
+	{
+		prototypeIndex[_prototypes[prototypeIdx]] = prototypeIdx;
+	}
 
-	return mortonCodeBuffer;
+	// Non-instanced faces come first, and fragments are split according to their boundaries
+	for (unsigned faceIdx = 0; faceIdx < _staticGPUData->_numTriangles; ++faceIdx)
+	{
+		aabb.update(faces[faceIdx]._minPoint);
+		aabb.update(faces[faceIdx]._maxPoint);
+	}
+
+	const vec3 staticSize = aabb.size();
+	const float maxFragmentArea = BVH_SPLIT_SCENE_AREA * 2.0f * (staticSize.x * staticSize.y + staticSize.x * staticSize.z + staticSize.y * staticSize.z);
+
+	for (unsigned faceIdx = 0; faceIdx < faces.size(); ++faceIdx)
+	{
+		const FaceGPUData& face = faces[faceIdx];
+		BVHCluster leaf;
+
+		leaf._minPoint		= face._minPoint;
+		leaf._maxPoint		= face._maxPoint;
+		leaf._prevIndex1	= leaf._prevIndex2 = BVH_NULL_INDEX;
+		leaf._faceIndex		= faceIdx;
+
+		if (faceIdx < _staticGPUData->_numTriangles)
+		{
+			if (_preSplitFaces)
+			{
+				const unsigned startIndex = cpuData->_meshData[face._modelCompID]._startIndex;
+				const vec3 vertex[3] = { cpuData->_geometry[startIndex + face._vertices.x]._position, cpuData->_geometry[startIndex + face._vertices.y]._position, cpuData->_geometry[startIndex + face._vertices.z]._position };
+
+				this->splitFace(vertex, faceIdx, maxFragmentArea, volatileGPUData);
+			}
+			else if (_bvhBuilder != PLOC_BUILDER)
+			{
+				volatileGPUData->_staticLeaves.push_back(leaf);
+			}
+		}
+		else
+		{
+			const unsigned prototypeIdx = prototypeIndex[_globalModelComp[face._modelCompID]->_root];
+
+			prototypeLeaves[prototypeIdx].push_back(leaf);
+			prototypeAABB[prototypeIdx].update(face._minPoint);
+			prototypeAABB[prototypeIdx].update(face._maxPoint);
+		}
+	}
+
+	if (_gpuBuffers)
+	{
+		glDeleteBuffers(1, &_staticGPUData->_clusterSSBO);
+		glDeleteBuffers(1, &_staticGPUData->_instanceSSBO);
+		glDeleteBuffers(1, &_staticGPUData->_leafFaceSSBO);
+	}
+
+	volatileGPUData->_numStaticLeaves	= _preSplitFaces ? volatileGPUData->_fragmentFace.size() : _staticGPUData->_numTriangles;
+	_staticGPUData->_numClusters		= volatileGPUData->_numStaticLeaves > 0 ? volatileGPUData->_numStaticLeaves * 2 - 1 : 0;
+
+	this->buildPrototypeBVHs(volatileGPUData, prototypeIndex, prototypeLeaves, prototypeAABB, aabb);
+	this->allocateClusterBuffer(volatileGPUData);
+	this->buildBVH(volatileGPUData);
+
+	_aabb			= aabb;
+	_bvhSAHCost		= .0f;
+
+	if (_bvhVAO)
+	{
+		delete _bvhVAO;
+		_bvhVAO = nullptr;
+
+		this->buildBVHVAO(volatileGPUData->_cluster);
+	}
+
+	delete volatileGPUData;
+
+	// Mirror is retrieved again once it is requested, unless it is the only copy of the scene
+	if (_gpuBuffers)
+	{
+		delete _staticCPUData;
+		_staticCPUData = nullptr;
+	}
+}
+
+void Group3D::reorderNodes(std::vector<BVHCluster>& nodes, std::vector<InstanceGPUData>& instance)
+{
+	auto surfaceArea = [](const BVHCluster& node) -> float
+	{
+		const vec3 size = node._maxPoint - node._minPoint;
+
+		return 2.0f * (size.x * size.y + size.x * size.z + size.y * size.z);
+	};
+
+	std::vector<BVHCluster> orderedNodes(nodes.size());
+	std::vector<unsigned> toExplore;									// Placed nodes whose children are not allocated yet
+	std::unordered_map<unsigned, unsigned> orderedRoot;
+	unsigned nextNode = nodes.size();
+
+	auto placeTree = [&](const unsigned root) -> unsigned
+	{
+		const unsigned orderedRootIdx = --nextNode;
+
+		orderedNodes[orderedRootIdx] = nodes[root];
+		toExplore.push_back(orderedRootIdx);
+
+		while (!toExplore.empty())
+		{
+			BVHCluster& node = orderedNodes[toExplore.back()];
+			toExplore.pop_back();
+
+			if (node._faceIndex != BVH_NULL_INDEX) continue;
+
+			// Both children share the same cache lines, and the one with the largest area, i.e. the most likely to be hit, comes right before its parent
+			unsigned child1 = node._prevIndex1, child2 = node._prevIndex2;
+			if (surfaceArea(nodes[child1]) < surfaceArea(nodes[child2])) std::swap(child1, child2);
+
+			node._prevIndex1 = nextNode - 1;
+			node._prevIndex2 = nextNode - 2;
+			orderedNodes[--nextNode] = nodes[child1];
+			orderedNodes[--nextNode] = nodes[child2];
+
+			// Depth-first: the subtree of the first child is allocated before the subtree of the second one
+			toExplore.push_back(node._prevIndex2);
+			toExplore.push_back(node._prevIndex1);
+		}
+
+		return orderedRootIdx;
+	};
+
+	placeTree(nodes.size() - 1);
+
+	for (InstanceGPUData& instanceData : instance)
+	{
+		auto rootIt = orderedRoot.find(instanceData._blasRoot);
+		if (rootIt == orderedRoot.end())
+		{
+			rootIt = orderedRoot.insert(std::make_pair(instanceData._blasRoot, placeTree(instanceData._blasRoot))).first;
+		}
+
+		instanceData._blasRoot = rootIt->second;
+	}
+
+	nodes.swap(orderedNodes);
+}
+
+unsigned Group3D::splitBinnedSAH(std::vector<BVHCluster>& leaves, const unsigned firstLeaf, const unsigned lastLeaf, vec3& minPoint, vec3& maxPoint)
+{
+	struct SAHBin
+	{
+		vec3		_minPoint, _maxPoint;
+		unsigned	_numLeaves;
+
+		SAHBin() : _minPoint(FLT_MAX), _maxPoint(-FLT_MAX), _numLeaves(0) {}
+	};
+
+	auto surfaceArea = [](const vec3& minPoint, const vec3& maxPoint) -> float
+	{
+		const vec3 size = glm::max(maxPoint - minPoint, vec3(.0f));
+
+		return 2.0f * (size.x * size.y + size.x * size.z + size.y * size.z);
+	};
+
+	// Large ranges are processed as chunks, one per iteration of a parallel loop, and then reduced
+	const unsigned numLeaves = lastLeaf - firstLeaf;
+	const int numChunks = numLeaves >= BVH_SAH_PARALLEL_SIZE ? static_cast<int>(glm::max(std::thread::hardware_concurrency(), 1u)) * 4 : 1;
+	const unsigned chunkSize = (numLeaves + numChunks - 1) / numChunks;
+
+	// First step: boundaries of leaves and their centroids
+	std::vector<vec3> chunkMin(numChunks * 2, vec3(FLT_MAX)), chunkMax(numChunks * 2, vec3(-FLT_MAX));
+
+	#pragma omp parallel for if (numChunks > 1)
+	for (int chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+	{
+		const unsigned chunkFirst = firstLeaf + glm::min(chunkIdx * chunkSize, numLeaves), chunkLast = firstLeaf + glm::min((chunkIdx + 1) * chunkSize, numLeaves);
+
+		for (unsigned leafIdx = chunkFirst; leafIdx < chunkLast; ++leafIdx)
+		{
+			const vec3 centroid = (leaves[leafIdx]._minPoint + leaves[leafIdx]._maxPoint) / 2.0f;
+
+			chunkMin[chunkIdx * 2] = glm::min(chunkMin[chunkIdx * 2], leaves[leafIdx]._minPoint);
+			chunkMax[chunkIdx * 2] = glm::max(chunkMax[chunkIdx * 2], leaves[leafIdx]._maxPoint);
+			chunkMin[chunkIdx * 2 + 1] = glm::min(chunkMin[chunkIdx * 2 + 1], centroid);
+			chunkMax[chunkIdx * 2 + 1] = glm::max(chunkMax[chunkIdx * 2 + 1], centroid);
+		}
+	}
+
+	vec3 centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+	minPoint = vec3(FLT_MAX);
+	maxPoint = vec3(-FLT_MAX);
+
+	for (int chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+	{
+		minPoint = glm::min(minPoint, chunkMin[chunkIdx * 2]);
+		maxPoint = glm::max(maxPoint, chunkMax[chunkIdx * 2]);
+		centroidMin = glm::min(centroidMin, chunkMin[chunkIdx * 2 + 1]);
+		centroidMax = glm::max(centroidMax, chunkMax[chunkIdx * 2 + 1]);
+	}
+
+	const vec3 centroidExtent = centroidMax - centroidMin;
+	auto getBin = [&](const BVHCluster& leaf, const int axis) -> unsigned
+	{
+		const float centroid = (leaf._minPoint[axis] + leaf._maxPoint[axis]) / 2.0f;
+
+		return glm::min(static_cast<unsigned>((centroid - centroidMin[axis]) / centroidExtent[axis] * BVH_SAH_BINS), BVH_SAH_BINS - 1);
+	};
+
+	// Second step: leaves are binned along the three axes
+	std::vector<SAHBin> chunkBin(numChunks * 3 * BVH_SAH_BINS);
+
+	#pragma omp parallel for if (numChunks > 1)
+	for (int chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+	{
+		const unsigned chunkFirst = firstLeaf + glm::min(chunkIdx * chunkSize, numLeaves), chunkLast = firstLeaf + glm::min((chunkIdx + 1) * chunkSize, numLeaves);
+		SAHBin* bin = chunkBin.data() + chunkIdx * 3 * BVH_SAH_BINS;
+
+		for (unsigned leafIdx = chunkFirst; leafIdx < chunkLast; ++leafIdx)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				if (centroidExtent[axis] <= .0f) continue;
+
+				SAHBin& leafBin = bin[axis * BVH_SAH_BINS + getBin(leaves[leafIdx], axis)];
+				leafBin._minPoint = glm::min(leafBin._minPoint, leaves[leafIdx]._minPoint);
+				leafBin._maxPoint = glm::max(leafBin._maxPoint, leaves[leafIdx]._maxPoint);
+				++leafBin._numLeaves;
+			}
+		}
+	}
+
+	// Third step: the cheapest plane between bins, according to the surface area heuristic
+	int bestAxis = -1;
+	unsigned bestSplit = 0;
+	float bestCost = FLT_MAX;
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		if (centroidExtent[axis] <= .0f) continue;
+
+		SAHBin bin[BVH_SAH_BINS], leftBin;
+		float leftCost[BVH_SAH_BINS];
+
+		for (int chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+		{
+			for (unsigned binIdx = 0; binIdx < BVH_SAH_BINS; ++binIdx)
+			{
+				const SAHBin& chunk = chunkBin[(chunkIdx * 3 + axis) * BVH_SAH_BINS + binIdx];
+				bin[binIdx]._minPoint = glm::min(bin[binIdx]._minPoint, chunk._minPoint);
+				bin[binIdx]._maxPoint = glm::max(bin[binIdx]._maxPoint, chunk._maxPoint);
+				bin[binIdx]._numLeaves += chunk._numLeaves;
+			}
+		}
+
+		for (unsigned binIdx = 0; binIdx < BVH_SAH_BINS - 1; ++binIdx)
+		{
+			leftBin._minPoint = glm::min(leftBin._minPoint, bin[binIdx]._minPoint);
+			leftBin._maxPoint = glm::max(leftBin._maxPoint, bin[binIdx]._maxPoint);
+			leftBin._numLeaves += bin[binIdx]._numLeaves;
+			leftCost[binIdx] = leftBin._numLeaves * surfaceArea(leftBin._minPoint, leftBin._maxPoint);
+		}
+
+		SAHBin rightBin;
+		for (unsigned binIdx = BVH_SAH_BINS - 1; binIdx > 0; --binIdx)
+		{
+			rightBin._minPoint = glm::min(rightBin._minPoint, bin[binIdx]._minPoint);
+			rightBin._maxPoint = glm::max(rightBin._maxPoint, bin[binIdx]._maxPoint);
+			rightBin._numLeaves += bin[binIdx]._numLeaves;
+
+			const float cost = leftCost[binIdx - 1] + rightBin._numLeaves * surfaceArea(rightBin._minPoint, rightBin._maxPoint);
+
+			if (rightBin._numLeaves > 0 && rightBin._numLeaves < numLeaves && cost < bestCost)
+			{
+				bestAxis = axis;
+				bestSplit = binIdx;
+				bestCost = cost;
+			}
+		}
+	}
+
+	// Centroids at the same point cannot be told apart, so they are split in halves
+	if (bestAxis < 0)
+	{
+		return (firstLeaf + lastLeaf) / 2;
+	}
+
+	const auto middleIt = std::partition(leaves.begin() + firstLeaf, leaves.begin() + lastLeaf, [&](const BVHCluster& leaf)
+		{
+			return getBin(leaf, bestAxis) < bestSplit;
+		});
+
+	return static_cast<unsigned>(middleIt - leaves.begin());
+}
+
+void Group3D::splitFace(const vec3* vertex, const GLuint faceIndex, const float maxFragmentArea, VolatileGPUData* gpuData)
+{
+	struct Fragment
+	{
+		std::vector<vec3>	_polygon;
+		unsigned			_depth;
+	};
+
+	auto polygonArea = [](const std::vector<vec3>& polygon) -> float
+	{
+		vec3 areaVector(.0f);
+
+		for (unsigned vertexIdx = 1; vertexIdx + 1 < polygon.size(); ++vertexIdx)
+		{
+			areaVector += glm::cross(polygon[vertexIdx] - polygon[0], polygon[vertexIdx + 1] - polygon[0]);
+		}
+
+		return .5f * glm::length(areaVector);
+	};
+
+	std::vector<Fragment> toSplit{ Fragment{ std::vector<vec3>(vertex, vertex + 3), 0 } };
+
+	while (!toSplit.empty())
+	{
+		Fragment fragment = std::move(toSplit.back());
+		toSplit.pop_back();
+
+		vec3 minPoint(INFINITY), maxPoint(-INFINITY);
+
+		for (const vec3& point : fragment._polygon)
+		{
+			minPoint = glm::min(minPoint, point);
+			maxPoint = glm::max(maxPoint, point);
+		}
+
+		// A flat polygon which fills a side of its box takes half of its surface area, hence larger ratios mean empty space
+		const vec3 size = maxPoint - minPoint;
+		const float boxArea = 2.0f * (size.x * size.y + size.x * size.z + size.y * size.z);
+
+		if (fragment._depth < BVH_SPLIT_MAX_DEPTH && (boxArea > 2.0f * BVH_SPLIT_AREA_RATIO * polygonArea(fragment._polygon) || boxArea > maxFragmentArea))
+		{
+			// The polygon is clipped by both halves of the longest axis, and vertices on the plane are kept by both of them
+			const int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+			const float plane = (minPoint[axis] + maxPoint[axis]) * .5f;
+			Fragment half[2] = { Fragment{ {}, fragment._depth + 1 }, Fragment{ {}, fragment._depth + 1 } };
+
+			for (unsigned vertexIdx = 0; vertexIdx < fragment._polygon.size(); ++vertexIdx)
+			{
+				const vec3& current = fragment._polygon[vertexIdx], &next = fragment._polygon[(vertexIdx + 1) % fragment._polygon.size()];
+
+				if (current[axis] <= plane) half[0]._polygon.push_back(current);
+				if (current[axis] >= plane) half[1]._polygon.push_back(current);
+
+				if ((current[axis] < plane && next[axis] > plane) || (current[axis] > plane && next[axis] < plane))
+				{
+					vec3 intersection = current + (next - current) * ((plane - current[axis]) / (next[axis] - current[axis]));
+					intersection[axis] = plane;									// Both boxes share the plane, so that no ray crosses the face between them
+
+					half[0]._polygon.push_back(intersection);
+					half[1]._polygon.push_back(intersection);
+				}
+			}
+
+			for (Fragment& halfFragment : half)
+			{
+				if (halfFragment._polygon.size() >= 3) toSplit.push_back(std::move(halfFragment));
+			}
+		}
+		else
+		{
+			BVHCluster leaf;
+			leaf._minPoint		= minPoint;
+			leaf._maxPoint		= maxPoint;
+			leaf._prevIndex1	= leaf._prevIndex2 = BVH_NULL_INDEX;
+			leaf._faceIndex		= static_cast<GLuint>(gpuData->_fragmentFace.size());
+
+			gpuData->_staticLeaves.push_back(leaf);
+			gpuData->_fragmentFace.push_back(faceIndex);
+		}
+	}
 }
 
-GLuint Group3D::sortFacesByMortonCode(const GLuint mortonCodes)
+GLuint Group3D::sortFacesByMortonCode(VolatileGPUData* gpuData, const GLuint mortonCodes)
 {
 	ComputeShader* bitMaskShader			= ShaderList::getInstance()->getComputeShader(RendEnum::BIT_MASK_RADIX_SORT);
 	ComputeShader* reduceShader				= ShaderList::getInstance()->getComputeShader(RendEnum::REDUCE_PREFIX_SCAN);
@@ -545,7 +2480,7 @@ GLuint Group3D::sortFacesByMortonCode(const GLuint mortonCodes)
 	ComputeShader* reallocatePositionShader = ShaderList::getInstance()->getComputeShader(RendEnum::REALLOCATE_RADIX_SORT);
 
 	const unsigned numBits	= 30;	// 10 bits per coordinate (3D)
-	unsigned arraySize		= _staticGPUData->_numTriangles, currentBits = 0;
+	unsigned arraySize		= gpuData->_numStaticLeaves, currentBits = 0;
 	const int numGroups		= ComputeShader::getNumGroups(arraySize);
 	const int maxGroupSize	= ComputeShader::getMaxGroupSize();
 	GLuint* indices			= new GLuint[arraySize];
@@ -634,6 +2569,60 @@ GLuint Group3D::sortFacesByMortonCode(const GLuint mortonCodes)
 	return indicesBufferID_2;
 }
 
+bool Group3D::writeBVHCache(const std::string& filename, const uint64_t contentHash)
+{
+	std::error_code errorCode;
+	std::filesystem::create_directories(BVH_CACHE_FOLDER, errorCode);
+
+	std::ofstream fout(filename, std::ios::out | std::ios::binary);
+	if (!fout.is_open())
+	{
+		return false;
+	}
+
+	// Buffers are retrieved from GPU; the mirror is kept only if it was already requested
+	const bool keepCPUData		= _staticCPUData != nullptr;
+	StaticCPUData* cpuData		= this->getStaticCPUData();
+
+	const unsigned numTriangles = _staticGPUData->_numTriangles, numInstances = _staticGPUData->_numInstances;
+	const vec3 minPoint = _aabb.min(), maxPoint = _aabb.max();
+	const size_t numVertices = cpuData->_geometry.size(), numFaces = cpuData->_triangleMesh.size(), numMeshes = cpuData->_meshData.size(), numClusters = cpuData->_cluster.size(), numLeafFaces = cpuData->_leafFace.size();
+
+	fout.write((char*)&BVH_CACHE_VERSION, sizeof(uint32_t));
+	fout.write((char*)&contentHash, sizeof(uint64_t));
+	fout.write((char*)&numTriangles, sizeof(unsigned));
+	fout.write((char*)&numInstances, sizeof(unsigned));
+	fout.write((char*)&minPoint, sizeof(vec3));
+	fout.write((char*)&maxPoint, sizeof(vec3));
+	fout.write((char*)&numVertices, sizeof(size_t));
+	fout.write((char*)&numFaces, sizeof(size_t));
+	fout.write((char*)&numMeshes, sizeof(size_t));
+	fout.write((char*)&numClusters, sizeof(size_t));
+	fout.write((char*)&numLeafFaces, sizeof(size_t));
+	fout.write((char*)cpuData->_geometry.data(), numVertices * sizeof(VertexGPUData));
+	fout.write((char*)cpuData->_triangleMesh.data(), numFaces * sizeof(FaceGPUData));
+	fout.write((char*)cpuData->_meshData.data(), numMeshes * sizeof(MeshGPUData));
+	fout.write((char*)cpuData->_cluster.data(), numClusters * sizeof(BVHCluster));
+	fout.write((char*)cpuData->_leafFace.data(), numLeafFaces * sizeof(GLuint));
+	fout.write((char*)cpuData->_instance.data(), numInstances * sizeof(InstanceGPUData));
+
+	const bool success = !fout.fail();
+	fout.close();
+
+	if (!keepCPUData)
+	{
+		delete _staticCPUData;
+		_staticCPUData = nullptr;
+	}
+
+	if (!success)
+	{
+		std::filesystem::remove(filename, errorCode);			// Never leave a truncated cache
+	}
+
+	return success;
+}
+
 void Group3D::writeModelComponentsPly()
 {
 	for (ModelComponent* modelComp: _globalModelComp)
@@ -673,25 +2662,30 @@ void Group3D::writeModelComponentsPly()
 
 /// VolatileGPUData
 
-Group3D::VolatileGPUData::VolatileGPUData() : _tempClusterSSBO(-1), _mortonCodesSSBO(-1)
+Group3D::VolatileGPUData::VolatileGPUData() : _numStaticLeaves(0), _tempClusterSSBO(-1), _mortonCodesSSBO(-1), _fragmentSSBO(-1)
 {
 }
 
 Group3D::VolatileGPUData::~VolatileGPUData()
 {
-	glDeleteBuffers(1, &_mortonCodesSSBO);
-	glDeleteBuffers(1, &_tempClusterSSBO);
+	// Buffers of the GPU builder are never allocated by CPU builders, which may run with no OpenGL context
+	for (GLuint bufferID : { _mortonCodesSSBO, _tempClusterSSBO, _fragmentSSBO })
+	{
+		if (bufferID != GLuint(-1)) glDeleteBuffers(1, &bufferID);
+	}
 }
 
 // StaticGPUData
 
-Group3D::StaticGPUData::StaticGPUData() : _groupGeometrySSBO(-1), _groupTopologySSBO(-1), _groupMeshSSBO(-1), _clusterSSBO(-1), _numTriangles(0)
+Group3D::StaticGPUData::StaticGPUData() : _groupGeometrySSBO(-1), _groupTopologySSBO(-1), _groupMeshSSBO(-1), _clusterSSBO(-1), _instanceSSBO(-1), _leafFaceSSBO(-1), _numClusters(0), _numInstances(0), _numLeafFaces(0), _numTriangles(0)
 {
 }
 
 Group3D::StaticGPUData::~StaticGPUData()
 {
-	// Delete buffers
-	GLuint toDeleteBuffers[] = { _groupGeometrySSBO, _groupTopologySSBO, _groupMeshSSBO, _clusterSSBO };
-	glDeleteBuffers(sizeof(toDeleteBuffers) / sizeof(GLuint), toDeleteBuffers);
+	// Delete buffers, which are never allocated if GPU buffers are disabled
+	for (GLuint bufferID : { _groupGeometrySSBO, _groupTopologySSBO, _groupMeshSSBO, _clusterSSBO, _instanceSSBO, _leafFaceSSBO })
+	{
+		if (bufferID != GLuint(-1)) glDeleteBuffers(1, &bufferID);
+	}
 }
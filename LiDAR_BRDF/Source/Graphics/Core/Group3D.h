@@ -3,6 +3,8 @@
 #include "Graphics/Core/Model3D.h"
 #include "tinyply.h"
 
+class InstancedModel;
+
 /**
 *	@file Group3D.h
 *	@authors Alfonso Lpez Ruiz (alr00048@red.ujaen.es)
@@ -10,42 +12,112 @@
 */
 
 #define BVH_NODE_INDICES 36					// 12 LINES x 2 VERTICES + 12 (RESTART_PRIMITIVE_INDEX)
+#define BVH_WIDTH 8							// Children of every node of the wide BVH, i.e. lanes of an AVX2 slab test
 
 /**
 *	@brief Wrapper for several 3d models which inherites from Model3D.
 */
 class Group3D: public Model3D
 {
+	friend class BVHQualityReport;
 public:
 	struct VolatileGPUData;
 	struct VolatileGroupData;
 	struct StaticGPUData;
+	struct StaticCPUData;
+	struct CompressedBVHNode;
+	struct CompressedBVHRoot;
+	struct WideBVHNode;
+
+	enum BVHBuilder : uint8_t {
+		PLOC_BUILDER, BINNED_SAH_BUILDER, LBVH_BUILDER
+	};
+
+	enum BVHLayout : uint8_t {
+		BINARY_BVH, WIDE_BVH, COMPRESSED_BVH
+	};
 
 protected:
 	const static GLuint					BVH_BUILDING_RADIUS;			//!< Radius to search nearest neighbors in BVH building process
+	const static std::string			BVH_CACHE_EXTENSION;			//!< Extension of files where BVHs are serialized
+	const static std::string			BVH_CACHE_FOLDER;				//!< Folder where serialized BVHs are saved
+	const static uint32_t				BVH_CACHE_VERSION;				//!< Must be increased whenever the BVH builder or the GPU structs change
+	const static GLuint					BVH_INSTANCE_FLAG;				//!< Marks leaves whose face index is actually the index of an instance
+	const static float					BVH_INTERSECTION_COST;			//!< Cost of testing a face, relative to the cost of visiting a node
+	const static GLuint					BVH_NULL_INDEX;					//!< Child and face index of nodes which do not reference them, as in compute shaders
+	const static GLuint					BVH_RADIX_SORT_DIGIT_BITS;		//!< Bits sorted by every pass of the CPU radix sort of Morton codes
+	const static float					BVH_REFIT_MAX_DEGRADATION;		//!< Growth of the surface area heuristic cost of a refitted BVH from which it is rebuilt
+	const static GLuint					BVH_SAH_BINS;					//!< Bins per axis where centroids are classified by the binned SAH builder
+	const static GLuint					BVH_SAH_PARALLEL_SIZE;			//!< Leaves from which the bins of a single split are filled in parallel
+	const static GLuint					BVH_SAH_SUBTREE_SIZE;			//!< Leaves of subtrees which are built by a single thread
+	const static float					BVH_SPLIT_AREA_RATIO;			//!< Ratio between the surface area of a fragment box and the area of the fragment from which it is split
+	const static GLuint					BVH_SPLIT_MAX_DEPTH;			//!< Maximum number of times a face is halved, i.e. up to 2^depth fragments
+	const static float					BVH_SPLIT_SCENE_AREA;			//!< Surface area of the non-instanced scene from which a fragment box is split
+	const static float					BVH_TRAVERSAL_COST;				//!< Cost of visiting an inner node in the surface area heuristic
 		
 protected:
 	AABB								_aabb;							//!< Boundaries of all those objects defined behind this group
+	BVHBuilder							_bvhBuilder;					//!< Algorithm which builds the tree of non-instanced geometry
+	float								_bvhSAHCost;					//!< Surface area heuristic cost of the BVH before being refitted. Zero until it is measured
 	std::vector<ModelComponent*>		_globalModelComp;				//!< Wraps every model component from the group
+	bool								_gpuBuffers;					//!< Scene and BVH are kept in SSBOs. Otherwise the CPU data is their only copy and no OpenGL call is issued
+	unsigned							_maxLeafFaces;					//!< Maximum number of faces that a collapsed BVH leaf may hold
 	unsigned							_numClusters;					//!< Total number of BVH nodes
 	std::vector<Model3D*>				_objects;						//!< Elements which take part of the group
+	bool								_preSplitFaces;					//!< Non-instanced faces are split into fragments with tighter boxes before building the BVH
+
+	// [Instancing]
+	std::vector<InstancedModel*>		_instances;						//!< Subset of objects which share the geometry of a prototype
+	std::vector<Model3D*>				_prototypes;					//!< Models whose geometry is instantiated. They are neither rendered nor hit by themselves
 
 	// [GPU data]
 	StaticGPUData*						_staticGPUData;					//!<
 
+	// [CPU data]
+	StaticCPUData*						_staticCPUData;					//!< Mirror of GPU buffers, only retrieved for CPU-based simulations, or the scene itself if GPU buffers are disabled
+
 	// [Rendering status]
 	VAO*								_bvhVAO;						//!< VAO which allows us to render current tree level
 
 protected:
 	/**
-	*	@brief Builds the buffers which are necessary to build the BVH.
+	*	@brief Builds the buffers which are necessary to build the BVH. Scene data is gathered into the CPU data instead if GPU buffers are disabled.
 	*/
 	void aggregateSSBOData(VolatileGPUData*& volatileGPUData, StaticGPUData*& staticGPUData);
+
+	/**
+	*	@brief Writes the leaves of the GPU builder into the cluster buffer. CPU builders keep their nodes in main memory until they are collapsed.
+	*/
+	void allocateClusterBuffer(VolatileGPUData* gpuData);
 	
+	/**
+	*	@brief Builds the tree of non-instanced geometry in CPU by splitting leaves top-down at the cheapest plane between bins of centroids.
+	*	Nodes follow the layout of the GPU builder, i.e. children are written before their parents and the root is the last node. They are written into gpuData->_cluster.
+	*/
+	void buildBinnedSAHBVH(VolatileGPUData* gpuData);
+
+	/**
+	*	@brief Builds the subtree of a range of leaves, whose 2n - 1 nodes are written from nodeOffset onwards.
+	*	@return Index of the root of the subtree.
+	*/
+	unsigned buildBinnedSAHSubtree(std::vector<BVHCluster>& leaves, const unsigned firstLeaf, const unsigned lastLeaf, std::vector<BVHCluster>& nodes, const unsigned nodeOffset);
+
+	/**
+	*	@brief Builds the tree of non-instanced geometry with the selected builder, links it to the top level and collapses its leaves.
+	*/
+	void buildBVH(VolatileGPUData* gpuData);
+
 	/**
 	*	@brief Builds the VAO which allows us to render the BVH levels.
+	*	@param cluster Nodes of the collapsed BVH.
+	*/
+	void buildBVHVAO(const std::vector<BVHCluster>& cluster);
+
+	/**
+	*	@brief Builds the top level of the BVH over instances and the tree of non-instanced geometry. Trees of prototypes and the top level are
+	*	appended to gpuData->_cluster.
 	*/
-	void buildBVHVAO(VolatileGPUData* gpuData);
+	void buildInstancingBVH(VolatileGPUData* gpuData);
 	
 	/**
 	*	@brief Builds the input buffer which is neeeded as input array to generate BVH.
@@ -54,21 +126,138 @@ protected:
 	void buildClusterBuffer(VolatileGPUData* gpuData, const GLuint sortedFaces);
 
 	/**
-	*	@brief Computes the AABB which wraps all the triangles contained in this group.
-	*	@param triangleBufferID To compute the AABB we need to define the triangle buffer in GPU, so that is saved to be reused.
+	*	@brief Builds the tree of non-instanced geometry in CPU as a linear BVH: leaves are sorted by their 63-bit Morton codes and every inner node
+	*	is emitted in parallel from the common prefixes of codes. Rebuilds are fast, though the tree is worse than the one of SAH-based builders.
+	*	Inner nodes are written into fixed slots and then laid out in post-order, so the tree and its cache are the same on every run.
+	*/
+	void buildLBVH(VolatileGPUData* gpuData);
+
+	/**
+	*	@brief Builds a BVH in CPU by splitting the given nodes at the median centroid of the widest axis. Nodes are written after their children,
+	*	hence the root is the last one as in the GPU builder.
+	*	@param leaves Nodes to be treated as leaves. They are reordered within the range [firstLeaf, lastLeaf).
+	*	@param nodeOffset Index of nodes[0] within the whole cluster buffer.
+	*	@return Index of the root within the whole cluster buffer.
+	*/
+	unsigned buildMedianSplitBVH(std::vector<BVHCluster>& leaves, const unsigned firstLeaf, const unsigned lastLeaf, std::vector<BVHCluster>& nodes, const unsigned nodeOffset);
+
+	/**
+	*	@brief Encodes the binary BVH of the CPU data with quantized child bounds. Nodes are written top-down, as the bounds of every
+	*	child are quantized within the decoded box of its parent.
+	*	@return False if some index or leaf size does not fit in a compressed reference. Compressed nodes are then left empty.
+	*/
+	bool buildCompressedBVH(StaticCPUData* cpuData);
+
+	/**
+	*	@brief Collapses the binary BVH of the CPU data into a BVH_WIDTH-wide BVH. Every wide node opens the inner child with the largest surface area
+	*	until its slots are taken. Trees of prototypes are collapsed once, after the tree of the scene.
+	*/
+	void buildWideBVH(StaticCPUData* cpuData);
+
+	/**
+	*	@brief Builds the tree of non-instanced geometry in GPU by iteratively merging nearest clusters of faces sorted by their Morton codes.
+	*	Nodes are read back into gpuData->_cluster, as the tree is collapsed in CPU.
 	*/
-	virtual AABB computeAABB(VolatileGroupData* groupData);
+	void buildPLOCBVH(VolatileGPUData* gpuData);
+
+	/**
+	*	@brief Builds the BVHs of prototypes after the nodes counted so far, and the world-space leaves of the top level for every instance.
+	*	@param prototypeLeaves Faces of every prototype. They are released once its tree is built.
+	*	@param aabb Boundaries of the scene, extended with every instance.
+	*/
+	void buildPrototypeBVHs(VolatileGPUData* gpuData, std::unordered_map<Model3D*, unsigned>& prototypeIndex, std::vector<std::vector<BVHCluster>>& prototypeLeaves, const std::vector<AABB>& prototypeAABB, AABB& aabb);
+
+	/**
+	*	@brief Collapses those subtrees with up to _maxLeafFaces faces into single leaves whenever the surface area heuristic deems it cheaper.
+	*	Faces of every leaf are gathered contiguously into the leaf faces buffer, and the cluster buffer is rewritten with the remaining nodes.
+	*	These are moved into the CPU data rather than uploaded if GPU buffers are disabled.
+	*/
+	void collapseLeaves(VolatileGPUData* gpuData);
+
+	/**
+	*	@brief Collapses a non-empty tree, whose nodes are written into gpuData->_cluster.
+	*	@param cluster Nodes of the binary tree, where the root is the last one.
+	*	@param leafFace Faces of every collapsed leaf.
+	*/
+	void collapseTree(VolatileGPUData* gpuData, std::vector<BVHCluster>& cluster, std::vector<GLuint>& leafFace);
+
+	/**
+	*	@brief Writes the collapsed subtree of a node, children first.
+	*	@param isLeaf Nodes whose subtree is collapsed into a single leaf.
+	*	@return Index of the node within the collapsed tree.
+	*/
+	unsigned collapseNode(const std::vector<BVHCluster>& cluster, const std::vector<uint8_t>& isLeaf, const unsigned clusterIdx, std::vector<BVHCluster>& nodes, std::vector<GLuint>& leafFace);
+
+	/**
+	*	@return Hash of the geometry, topology and materials of registered model components. Transformations are already applied to vertices.
+	*/
+	uint64_t computeContentHash();
 
 	/**
 	*	@brief Computes the morton codes for each triangle boundind box.
 	*/
-	GLuint computeMortonCodes();
+	GLuint computeMortonCodes(VolatileGPUData* gpuData);
+
+	/**
+	*	@return Surface area heuristic cost of a collapsed BVH, relative to the area of its root.
+	*/
+	float computeSAHCost(const std::vector<BVHCluster>& cluster, const std::vector<InstanceGPUData>& instance);
+
+	/**
+	*	@return Path of the BVH cache file linked to a content hash.
+	*/
+	std::string getBVHCacheFilename(const uint64_t contentHash);
+
+	/**
+	*	@brief Parallel LSD radix sort of Morton codes, with BVH_RADIX_SORT_DIGIT_BITS bits per pass.
+	*	@param index Values which are sorted along with their codes.
+	*/
+	void radixSortMortonCodes(std::vector<uint64_t>& mortonCode, std::vector<unsigned>& index);
+
+	/**
+	*	@brief Loads the BVH and the aggregated buffers from a cache file, straight into SSBOs or into the CPU data if GPU buffers are disabled.
+	*	@return False if the file does not exist or it was serialized from a different scene or version.
+	*/
+	bool readBVHCache(const std::string& filename, const uint64_t contentHash);
+
+	/**
+	*	@brief Builds the BVH again from the faces of the group buffers, as model components no longer keep their geometry.
+	*	@param cpuData Content of the group buffers.
+	*/
+	void rebuildBVH(StaticCPUData* cpuData);
 
 	/**
 	*	@brief Rearranges the face array to sort it by morton codes.
 	*	@param mortonCodes Computed morton codes from faces buffer.
 	*/
-	GLuint sortFacesByMortonCode(const GLuint mortonCodes);
+	GLuint sortFacesByMortonCode(VolatileGPUData* gpuData, const GLuint mortonCodes);
+
+	/**
+	*	@brief Relayouts the nodes in depth-first order, allocating both children of a node next to each other and the larger one next to their parent.
+	*	The root of the scene is still the last node and children are still stored before their parents. Roots of prototypes are remapped.
+	*/
+	void reorderNodes(std::vector<BVHCluster>& nodes, std::vector<InstanceGPUData>& instance);
+
+	/**
+	*	@brief Partitions a range of leaves at the plane with the lowest surface area heuristic cost. Large ranges are binned in parallel.
+	*	@param minPoint Minimum point of the boundaries of the range.
+	*	@param maxPoint Maximum point of the boundaries of the range.
+	*	@return First leaf of the second half.
+	*/
+	unsigned splitBinnedSAH(std::vector<BVHCluster>& leaves, const unsigned firstLeaf, const unsigned lastLeaf, vec3& minPoint, vec3& maxPoint);
+
+	/**
+	*	@brief Halves the box of a face along its longest axis while it is much larger than the clipped face, adding a leaf per fragment.
+	*	@param vertex Positions of the face.
+	*	@param faceIndex Index of the face within the topology buffer, which is kept by every fragment.
+	*	@param maxFragmentArea Surface area from which fragment boxes are split regardless of how tight they are.
+	*/
+	void splitFace(const vec3* vertex, const GLuint faceIndex, const float maxFragmentArea, VolatileGPUData* gpuData);
+
+	/**
+	*	@brief Serializes the BVH and the aggregated buffers so that the next launch does not need to build them.
+	*/
+	bool writeBVHCache(const std::string& filename, const uint64_t contentHash);
 
 	/**
 	*	@brief Saves group objects in a PLY file. 
@@ -93,7 +282,13 @@ public:
 	void addComponent(Model3D* object);
 
 	/**
-	*	@brief Builds the BVH from scratch once the group is loaded.
+	*	@brief Adds a new placement of a prototype, whose geometry and BVH are shared by every instance. The group takes ownership of the prototype.
+	*	@param modelMatrix Transformation from prototype to group space.
+	*/
+	void addInstance(Model3D* prototype, const mat4& modelMatrix);
+
+	/**
+	*	@brief Builds the BVH once the group is loaded, unless it was already serialized for the same scene content.
 	*/
 	StaticGPUData* generateBVH(bool buildVisualization = false);
 
@@ -102,6 +297,14 @@ public:
 	*/
 	virtual bool load(const mat4& modelMatrix = mat4(1.0f));
 
+	/**
+	*	@brief Moves a registered model once the BVH is built. Faces of non-instanced models are transformed in the group buffers, and boxes of
+	*	nodes are refitted bottom-up with no change of topology. The BVH is rebuilt if its cost grows beyond BVH_REFIT_MAX_DEGRADATION times the built one.
+	*	@param transform Transformation applied to the model in scene space, on top of its current placement.
+	*	@return True if the BVH was rebuilt.
+	*/
+	bool refitBVH(Model3D* model, const mat4& transform);
+
 	/**
 	*	@brief Assigns an id for a model component and registers it into an array.
 	*/
@@ -117,11 +320,37 @@ public:
 	*/
 	void registerScene();
 
+	/**
+	*	@brief Retrieve diffuse colors of every model in CPU, since there is no OpenGL context.
+	*/
+	virtual void retrieveColorsCPU();
+
 	/**
 	*	@brief Retrieve diffuse and specular colors from textures in compute shader.
 	*/
 	virtual void retrieveColorsGPU();
 
+	/**
+	*	@brief Selects the algorithm which builds the tree of non-instanced geometry. It must be set before the BVH is generated.
+	*/
+	void setBVHBuilder(const BVHBuilder builder) { _bvhBuilder = builder; }
+
+	/**
+	*	@brief Keeps scene data and BVH in SSBOs. Otherwise they are built in main memory with no OpenGL call, as needed by CPU simulations with no
+	*	OpenGL context, and the GPU builder is replaced by the binned SAH one. It must be set before the BVH is generated.
+	*/
+	void setGPUBuffers(const bool gpuBuffers) { _gpuBuffers = gpuBuffers; }
+
+	/**
+	*	@brief Sets the maximum number of faces of BVH leaves. It must be set before the BVH is generated.
+	*/
+	void setMaxLeafFaces(const unsigned maxLeafFaces) { _maxLeafFaces = glm::max(maxLeafFaces, 1u); }
+
+	/**
+	*	@brief Enables splitting non-instanced faces into fragments before building the BVH. It must be set before the BVH is generated.
+	*/
+	void setPreSplitFaces(const bool preSplit) { _preSplitFaces = preSplit; }
+
 	// ------------------------- Getters -------------------------------
 
 	/**
@@ -149,6 +378,17 @@ public:
 	*/
 	unsigned getNumTriangles() { if (_staticGPUData) return _staticGPUData->_numTriangles; else return 0; }
 
+	/**
+	*	@return Scene geometry, topology and BVH in main memory. It is retrieved from GPU the first time it is requested, as model components release their geometry once it is aggregated.
+	*	@param layout BVH to be traversed. The compressed one is only decoded by the CPU solver, as compute shaders read full BVHCluster nodes. It replaces the binary nodes, which are read again if a later simulation needs them. They are kept if GPU buffers are disabled.
+	*/
+	StaticCPUData* getStaticCPUData(const BVHLayout layout = BINARY_BVH);
+
+	/**
+	*	@return Scene geometry, topology and BVH in SSBOs. If GPU buffers were disabled, the CPU data is uploaded the first time it is requested.
+	*/
+	StaticGPUData* getStaticGPUData();
+
 	/**
 	*	@return Pointer of vector with all registered model components.
 	*/
@@ -261,11 +501,24 @@ public:
 	struct VolatileGPUData
 	{
 		// [BVH]
-		std::vector<BVHCluster>			_cluster;						//!< BVH nodes
+		std::vector<BVHCluster>			_cluster;						//!< BVH nodes, i.e. the tree of non-instanced geometry followed by prototypes and top level until they are collapsed
+
+		// [Instancing]
+		std::vector<BVHCluster>			_instancingCluster;				//!< BVHs of prototypes and top level, placed after the tree of non-instanced geometry
+		std::vector<InstanceGPUData>	_instance;						//!< Placement of every instance
+		std::vector<BVHCluster>			_topLevelLeaves;				//!< World-space bounding box of every instance
+
+		// [CPU builders]
+		std::vector<BVHCluster>			_staticLeaves;					//!< Boundaries of every non-instanced face or fragment
+
+		// [Pre-splitting]
+		std::vector<GLuint>				_fragmentFace;					//!< Face of every fragment. Empty unless faces are split
+		unsigned						_numStaticLeaves;				//!< Leaves of the tree of non-instanced geometry, either faces or fragments
 
 		// [GPU buffers]
 		GLuint							_tempClusterSSBO;				//!< Temporary buffer for BVH construction
 		GLuint							_mortonCodesSSBO;				//!< Morton codes for each triangle
+		GLuint							_fragmentSSBO;					//!< Boundaries of fragments, laid out as faces for the GPU builder
 
 		/**
 		*	@brief Default constructor.
@@ -294,14 +547,19 @@ public:
 	*/
 	struct StaticGPUData
 	{
-		// [SSBO]
+		// [SSBO] Never allocated if GPU buffers are disabled
 		GLuint							_groupGeometrySSBO;				//!< SSBO of group geometry
 		GLuint							_groupTopologySSBO;				//!< SSBO of group faces
 		GLuint							_groupMeshSSBO;					//!< SSBO of group meshes
 		GLuint							_clusterSSBO;					//!< BVH nodes
+		GLuint							_instanceSSBO;					//!< Placement of instances
+		GLuint							_leafFaceSSBO;					//!< Faces of every leaf, referenced as contiguous ranges
 
 		// [Metadata]
-		unsigned						_numTriangles;					//!< Replaces cluster array data to release memory
+		unsigned						_numClusters;					//!< BVH nodes, including the trees of prototypes and the top level. The root is the last one
+		unsigned						_numInstances;					//!< Instances referenced by the top level of the BVH
+		unsigned						_numLeafFaces;					//!< Length of the leaf faces buffer
+		unsigned						_numTriangles;					//!< Triangles of non-instanced geometry, i.e. leaves of the tree built in GPU
 
 		/**
 		*	@brief Default constructor.
@@ -313,5 +571,83 @@ public:
 		*/
 		~StaticGPUData();
 	};
+
+	/**
+	*	@brief Binary BVH node whose children bounds are quantized to 8 bits within the box of the node, rounded outwards. Bounds are therefore
+	*	decoded top-down during traversal. Children reference either another node or a leaf flagged with LEAF_FLAG, which keeps its number of
+	*	faces in bits 27-30 and its first position in the leaf faces buffer, or its instance if it has no faces, in the remaining bits.
+	*	A node takes 20 bytes instead of the 48 bytes of a BVHCluster, i.e. 2.4x per node. Leaves are folded into the references of their
+	*	parent, hence a tree of n leaves needs n - 1 compressed nodes rather than 2n - 1 clusters, which is about 4.8x less node memory.
+	*/
+	struct CompressedBVHNode
+	{
+		inline static const GLuint		LEAF_FLAG = 0x80000000;			//!< Child which is a leaf
+		inline static const GLuint		LEAF_FACES_SHIFT = 27;			//!< First bit of the number of faces of a leaf
+		inline static const GLuint		INDEX_MASK = 0x7FFFFFF;			//!< Bits of node, leaf face or instance indices
+		inline static const GLuint		MAX_LEAF_FACES = 0xF;			//!< Faces that fit in bits 27-30
+
+		uint8_t							_childMin[2][3];				//!< Quantized minimum point of both children
+		uint8_t							_childMax[2][3];				//!< Quantized maximum point of both children
+		GLuint							_child[2];						//!< Node or leaf reference of both children
+
+		/**
+		*	@return Bound of a child along an axis. Both ends of the range are exactly decoded.
+		*/
+		static float decodeBound(const float minBound, const float maxBound, const uint8_t quantizedBound) { const float t = quantizedBound / 255.0f; return minBound * (1.0f - t) + maxBound * t; }
+
+		/**
+		*	@brief Decodes the box of a child from the decoded box of this node.
+		*/
+		void getChildBounds(const unsigned childIdx, const vec3& minPoint, const vec3& maxPoint, vec3& childMin, vec3& childMax) const
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				childMin[axis] = decodeBound(minPoint[axis], maxPoint[axis], _childMin[childIdx][axis]);
+				childMax[axis] = decodeBound(minPoint[axis], maxPoint[axis], _childMax[childIdx][axis]);
+			}
+		}
+	};
+
+	/**
+	*	@brief Full-precision box of the root of a compressed BVH, from where the bounds of its descendants are decoded.
+	*/
+	struct CompressedBVHRoot
+	{
+		vec3							_minPoint;						//!<
+		vec3							_maxPoint;						//!<
+		GLuint							_child;							//!< Node or leaf reference, as in CompressedBVHNode
+	};
+
+	/**
+	*	@brief Node of the wide BVH, whose children bounds are stored as structure of arrays so that a single slab test covers all of them.
+	*	Slots of inner children reference another wide node, leaves reference their range of the leaf faces buffer and instance leaves keep
+	*	BVH_INSTANCE_FLAG. Empty slots have inverted bounds, which never pass a slab test whose planes are sorted by the ray direction.
+	*/
+	struct alignas(32) WideBVHNode
+	{
+		float							_minX[BVH_WIDTH], _minY[BVH_WIDTH], _minZ[BVH_WIDTH];
+		float							_maxX[BVH_WIDTH], _maxY[BVH_WIDTH], _maxZ[BVH_WIDTH];
+		GLuint							_child[BVH_WIDTH];				//!< Wide node, first position in the leaf faces buffer or flagged instance
+		GLuint							_numFaces[BVH_WIDTH];			//!< Faces of leaf children, zero otherwise
+	};
+
+	/**
+	*	@brief Scene data needed to solve ray intersections in CPU.
+	*/
+	struct StaticCPUData: public VolatileGroupData
+	{
+		// [BVH]
+		std::vector<BVHCluster>			_cluster;						//!< BVH nodes, where the root is the last one
+		std::vector<InstanceGPUData>	_instance;						//!< Placement of instances
+		std::vector<GLuint>				_leafFace;						//!< Faces of every leaf
+
+		// [Wide BVH]
+		std::vector<WideBVHNode>		_wideNode;						//!< Collapsed BVH, where the root of the scene is the first node
+		std::vector<GLuint>				_wideInstanceRoot;				//!< Wide node where the prototype of every instance starts
+
+		// [Compressed BVH]
+		std::vector<CompressedBVHNode>	_compressedNode;				//!< BVH nodes with quantized bounds
+		std::vector<CompressedBVHRoot>	_compressedRoot;				//!< Root of the scene, followed by the root of the prototype of every instance
+	};
 };
 
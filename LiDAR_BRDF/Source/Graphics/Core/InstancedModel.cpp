@@ -0,0 +1,93 @@
+#include "stdafx.h"
+#include "InstancedModel.h"
+
+/// [Public methods]
+
+InstancedModel::InstancedModel(Model3D* prototype, const mat4& modelMatrix) :
+	Model3D(modelMatrix, 0), _prototype(prototype)
+{
+}
+
+InstancedModel::~InstancedModel()
+{
+	for (ModelComponent* modelComp : _modelComp)
+	{
+		modelComp->_vao = nullptr;
+	}
+}
+
+void InstancedModel::drawAsLines(RenderingShader* shader, const RendEnum::RendShaderTypes shaderType, std::vector<mat4>& matrix)
+{
+	std::vector<mat4> instanceMatrix = this->getInstanceMatrices(matrix);
+
+	Model3D::drawAsLines(shader, shaderType, instanceMatrix);
+}
+
+void InstancedModel::drawAsPoints(RenderingShader* shader, const RendEnum::RendShaderTypes shaderType, std::vector<mat4>& matrix)
+{
+	std::vector<mat4> instanceMatrix = this->getInstanceMatrices(matrix);
+
+	Model3D::drawAsPoints(shader, shaderType, instanceMatrix);
+}
+
+void InstancedModel::drawAsTriangles(RenderingShader* shader, const RendEnum::RendShaderTypes shaderType, std::vector<mat4>& matrix)
+{
+	std::vector<mat4> instanceMatrix = this->getInstanceMatrices(matrix);
+
+	Model3D::drawAsTriangles(shader, shaderType, instanceMatrix);
+}
+
+void InstancedModel::drawAsTrianglesWithGroup(RenderingShader* shader, const RendEnum::RendShaderTypes shaderType, std::vector<mat4>& matrix, bool ASPRS)
+{
+	std::vector<mat4> instanceMatrix = this->getInstanceMatrices(matrix);
+
+	Model3D::drawAsTrianglesWithGroup(shader, shaderType, instanceMatrix, ASPRS);
+}
+
+void InstancedModel::drawAsTriangles4Shadows(RenderingShader* shader, const RendEnum::RendShaderTypes shaderType, std::vector<mat4>& matrix)
+{
+	std::vector<mat4> instanceMatrix = this->getInstanceMatrices(matrix);
+
+	Model3D::drawAsTriangles4Shadows(shader, shaderType, instanceMatrix);
+}
+
+bool InstancedModel::load(const mat4& modelMatrix)
+{
+	if (!_loaded)
+	{
+		_modelMatrix = modelMatrix * _modelMatrix;
+
+		for (unsigned modelCompIdx = 0; modelCompIdx < _prototype->getNumModelComponents(); ++modelCompIdx)
+		{
+			ModelComponent* prototypeComp = _prototype->getModelComponent(modelCompIdx);
+			ModelComponent* modelComp = new ModelComponent(this);
+
+			// Geometry stays in the prototype, whereas every attribute which can be modified per instance is copied
+			modelComp->_vao						= prototypeComp->_vao;
+			modelComp->_topologyIndicesLength	= prototypeComp->_topologyIndicesLength;
+			modelComp->_enabled					= prototypeComp->_enabled;
+			modelComp->_material				= prototypeComp->_material;
+			modelComp->_materialID				= prototypeComp->_materialID;
+			modelComp->_modelDescription		= prototypeComp->_modelDescription;
+			modelComp->_semanticGroup			= prototypeComp->_semanticGroup;
+			modelComp->_asprsSemanticGroup		= prototypeComp->_asprsSemanticGroup;
+			modelComp->setName(prototypeComp->_name);
+
+			_modelComp.push_back(modelComp);
+		}
+
+		_loaded = true;
+	}
+
+	return true;
+}
+
+/// [Protected methods]
+
+std::vector<mat4> InstancedModel::getInstanceMatrices(const std::vector<mat4>& matrix)
+{
+	std::vector<mat4> instanceMatrix = matrix;
+	instanceMatrix[RendEnum::MODEL_MATRIX] = matrix[RendEnum::MODEL_MATRIX] * _modelMatrix;
+
+	return instanceMatrix;
+}
\ No newline at end of file
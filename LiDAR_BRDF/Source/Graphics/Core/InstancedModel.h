@@ -0,0 +1,102 @@
+#pragma once
+
+#include "Graphics/Core/Model3D.h"
+
+/**
+*	@file InstancedModel.h
+*	@authors Alfonso Lpez Ruiz (alr00048@red.ujaen.es)
+*	@date 10/16/2026
+*/
+
+/**
+*	@brief Placement of a prototype model which shares its geometry, VAOs and BVH with any other instance of the same prototype.
+*	Its model components only hold attributes which may differ among instances, such as identifiers, materials and semantic groups.
+*/
+class InstancedModel: public Model3D
+{
+protected:
+	Model3D*		_prototype;				//!< Model whose geometry is instantiated. It is owned by the group
+
+protected:
+	/**
+	*	@return Matrices for rendering the prototype geometry at the instance location.
+	*/
+	std::vector<mat4> getInstanceMatrices(const std::vector<mat4>& matrix);
+
+public:
+	/**
+	*	@brief Constructor.
+	*	@param prototype Model whose geometry is instantiated.
+	*	@param modelMatrix Transformation from prototype to scene space.
+	*/
+	InstancedModel(Model3D* prototype, const mat4& modelMatrix = mat4(1.0f));
+
+	/**
+	*	@brief Destructor. VAOs belong to the prototype.
+	*/
+	virtual ~InstancedModel();
+
+	/**
+	*	@brief Renders the prototype as a set of lines.
+	*	@param shader Shader which will draw the model.
+	*	@param shaderType Index of shader at the list, so we can identify what type of uniform variables must be declared.
+	*	@param matrix Vector of matrices which can be applied in the rendering process.
+	*/
+	virtual void drawAsLines(RenderingShader* shader, const RendEnum::RendShaderTypes shaderType, std::vector<mat4>& matrix);
+
+	/**
+	*	@brief Renders the prototype as a set of points.
+	*	@param shader Shader which will draw the model.
+	*	@param shaderType Index of shader at the list, so we can identify what type of uniform variables must be declared.
+	*	@param matrix Vector of matrices which can be applied in the rendering process.
+	*/
+	virtual void drawAsPoints(RenderingShader* shader, const RendEnum::RendShaderTypes shaderType, std::vector<mat4>& matrix);
+
+	/**
+	*	@brief Renders the prototype as a set of triangles.
+	*	@param shader Shader which will draw the model.
+	*	@param shaderType Index of shader at the list, so we can identify what type of uniform variables must be declared.
+	*	@param matrix Vector of matrices which can be applied in the rendering process.
+	*/
+	virtual void drawAsTriangles(RenderingShader* shader, const RendEnum::RendShaderTypes shaderType, std::vector<mat4>& matrix);
+
+	/**
+	*	@brief Renders the prototype as a set of triangles whose color depends on the semantic group of this instance.
+	*	@param shader Shader which will draw the model.
+	*	@param shaderType Index of shader at the list, so we can identify what type of uniform variables must be declared.
+	*	@param matrix Vector of matrices which can be applied in the rendering process.
+	*/
+	virtual void drawAsTrianglesWithGroup(RenderingShader* shader, const RendEnum::RendShaderTypes shaderType, std::vector<mat4>& matrix, bool ASPRS = true);
+
+	/**
+	*	@brief Renders the prototype as a set of triangles with no texture as we only want to retrieve the depth.
+	*	@param shader Shader which will draw the model.
+	*	@param shaderType Index of shader at the list, so we can identify what type of uniform variables must be declared.
+	*	@param matrix Vector of matrices which can be applied in the rendering process.
+	*/
+	virtual void drawAsTriangles4Shadows(RenderingShader* shader, const RendEnum::RendShaderTypes shaderType, std::vector<mat4>& matrix);
+
+	/**
+	*	@brief Creates a model component for each component of the prototype, which must be loaded beforehand.
+	*	@param modelMatrix Transformation of the group where the instance is located.
+	*/
+	virtual bool load(const mat4& modelMatrix = mat4(1.0f));
+
+	/**
+	*	@brief Colors are retrieved from the prototype geometry.
+	*/
+	virtual void retrieveColorsCPU() {}
+
+	/**
+	*	@brief Colors are retrieved from the prototype geometry.
+	*/
+	virtual void retrieveColorsGPU() {}
+
+	// ------------- Getters ----------------
+
+	/**
+	*	@return Model whose geometry is instantiated.
+	*/
+	Model3D* getPrototype() { return _prototype; }
+};
+
@@ -0,0 +1,941 @@
+#include "stdafx.h"
+#include "LiDARCPUSolver.h"
+
+#include "Geometry/3D/Intersections3D.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/// [Public methods]
+
+LiDARCPUSolver::LiDARCPUSolver() : _groupData(nullptr), _numSpectralBands(1), _seed(0), _spectralMaterialStride(0), _bvhLayout(Group3D::BINARY_BVH)
+{
+}
+
+LiDARCPUSolver::~LiDARCPUSolver()
+{
+}
+
+void LiDARCPUSolver::solveRayIntersection(std::vector<Model3D::RayGPUData>& rays, std::vector<Model3D::TriangleCollisionGPUData>& collisions, LiDARParameters* params, const SimulationUniforms& uniforms, PipelineMetrics& pipelineMetrics, std::vector<float>* spectralIntensity)
+{
+	std::vector<Model3D::TriangleCollisionGPUData> batchCollisions;			// Indices of previous collisions are local to this batch, as in GPU
+	unsigned numCollisions = 0, previousCollisions = 0, newCollisions = 0, idReturn = 0;
+
+	const float maxDistance = params->_maxRange + params->_maxRangeSoftBoundary.y;
+
+	_rayCollision.resize(rays.size());
+	_rayHits.resize(rays.size());
+	batchCollisions.reserve(rays.size() / params->_raysPulse * params->_maxReturns);
+
+	pipelineMetrics.initChrono();
+	this->prepareData(rays, params);
+	pipelineMetrics.measureStage(PipelineMetrics::PREPARE);
+
+	do
+	{
+		pipelineMetrics.initChrono();
+		const unsigned long long nodeVisits = this->findBVHCollision(rays, params->_reuseRayHits && idReturn > 0, maxDistance);
+		pipelineMetrics.measureStage(PipelineMetrics::FIND_COLLISION);
+		pipelineMetrics.addNodeVisits(nodeVisits);
+		pipelineMetrics.addTracedRays(rays.size());
+
+		pipelineMetrics.initChrono();
+		this->reduceCollisions(rays, batchCollisions, params, uniforms);
+		pipelineMetrics.measureStage(PipelineMetrics::REDUCE);
+
+		numCollisions = static_cast<unsigned>(batchCollisions.size());
+		newCollisions = numCollisions - previousCollisions;
+		previousCollisions = numCollisions;
+
+		if (params->_includeOutliers)
+		{
+			pipelineMetrics.initChrono();
+			this->addOutliers(rays, batchCollisions, newCollisions, params, uniforms);
+			pipelineMetrics.measureStage(PipelineMetrics::OUTLIERS);
+
+			previousCollisions = static_cast<unsigned>(batchCollisions.size());
+		}
+	}
+	while (newCollisions > 1 && ++idReturn < params->_maxReturns);
+
+	pipelineMetrics.initChrono();
+	this->computeColor(rays, batchCollisions, params, uniforms);
+	pipelineMetrics.measureStage(PipelineMetrics::INTENSITY);
+
+	pipelineMetrics.initChrono();
+	this->updateReturns(rays, batchCollisions);
+	pipelineMetrics.measureStage(PipelineMetrics::RETURNS);
+
+	if (spectralIntensity)
+	{
+		const size_t numCollisions = batchCollisions.size();
+		spectralIntensity->resize(_numSpectralBands * numCollisions);
+
+		pipelineMetrics.initChrono();
+		for (unsigned bandIdx = 0; bandIdx < _numSpectralBands; ++bandIdx)
+		{
+			this->computeColor(rays, batchCollisions, params, uniforms, bandIdx * _spectralMaterialStride, spectralIntensity->data() + bandIdx * numCollisions);
+		}
+		pipelineMetrics.measureStage(PipelineMetrics::INTENSITY);
+	}
+
+	collisions.insert(collisions.end(), batchCollisions.begin(), batchCollisions.end());
+}
+
+/// [Protected methods]
+
+void LiDARCPUSolver::addOutliers(std::vector<Model3D::RayGPUData>& rays, std::vector<Model3D::TriangleCollisionGPUData>& collisions, const unsigned newCollisions, LiDARParameters* params, const SimulationUniforms& uniforms)
+{
+	const unsigned numCollisions = static_cast<unsigned>(collisions.size());
+	std::vector<Model3D::TriangleCollisionGPUData> outlier(newCollisions);
+	std::vector<unsigned char> isOutlier(newCollisions, 0);
+
+	#pragma omp parallel for
+	for (int index = 0; index < static_cast<int>(newCollisions); ++index)
+	{
+		const unsigned rayIndex = collisions[numCollisions - newCollisions + index]._rayIndex;
+		if (rayIndex == NULL_INDEX) continue;												// Outliers do not generate further outliers
+
+		// Keyed by the ray and return which produced the collision, as in reduceCollisions
+		const unsigned returnNumber = collisions[numCollisions - newCollisions + index]._returnNumber;
+		const float noise = this->getWhiteNoise(rayIndex, returnNumber, OUTLIER_NOISE_OFFSET, uniforms);
+		if (noise * 2.0f - 1.0f <= params->_outlierThreshold) continue;
+
+		const Model3D::RayGPUData& ray = rays[rayIndex];
+		const float distanceNoise = this->getWhiteNoise(rayIndex, returnNumber, OUTLIER_DISTANCE_NOISE_OFFSET, uniforms) * 1.5f;
+		const float maxDistance = glm::distance(ray._startingPoint, collisions[numCollisions - newCollisions + index]._point);
+		const float distance = (distanceNoise * (params->_outlierRange.y - params->_outlierRange.x) + params->_outlierRange.x) * maxDistance;
+
+		Model3D::TriangleCollisionGPUData& collision = outlier[index];
+		collision._point = ray._startingPoint + glm::normalize(ray._previousDirection) * distance;
+		collision._faceIndex = NULL_INDEX;
+		collision._normal = vec3(.0f);
+		collision._distance = distance;
+		collision._textCoord = vec2(.0f);
+		collision._modelCompID = uniforms._nullModelCompID;
+		collision._returnNumber = 0;
+		collision._rayDirection = vec3(.0f);
+		collision._rayIndex = NULL_INDEX;
+		collision._numReturns = 1;
+		collision._angle = .0f;
+		collision._intensity = .0f;
+		collision._previousCollision = NULL_INDEX;
+		collision._numIntersectedRays = 0;
+		collision._gpsTime = ray._gpsTime + (distance * 2.0f) / params->LIGHT_SPEED_MS;
+
+		isOutlier[index] = 1;
+	}
+
+	// Sequential compaction keeps the output deterministic (atomic counters in GPU)
+	for (unsigned index = 0; index < newCollisions; ++index)
+	{
+		if (isOutlier[index]) collisions.push_back(outlier[index]);
+	}
+}
+
+bool LiDARCPUSolver::areTriangleContiguous(const unsigned mesh1, const unsigned mesh2, const unsigned triangle1, const unsigned triangle2)
+{
+	const uvec3& indices1 = _groupData->_triangleMesh[triangle1]._vertices, &indices2 = _groupData->_triangleMesh[triangle2]._vertices;
+
+	return (mesh1 == mesh2) &&
+		   ((indices1.x == indices2.x || indices1.x == indices2.y || indices1.x == indices2.z) ||
+			(indices1.y == indices2.x || indices1.y == indices2.y || indices1.y == indices2.z) ||
+			(indices1.z == indices2.x || indices1.z == indices2.y || indices1.z == indices2.z));
+}
+
+float LiDARCPUSolver::computeBathymetricIntensity(const Model3D::TriangleCollisionGPUData& collision, const Model3D::TriangleCollisionGPUData& waterCollision, const float brdfFactor, const Model3D::RayGPUData& ray, const LiDARParameters* params, const SimulationUniforms& uniforms)
+{
+	const float maxDiffuseWater = glm::max(WATER_DIFFUSE.x, glm::max(WATER_DIFFUSE.y, WATER_DIFFUSE.z));
+	const float receiverArea	= glm::pi<float>() * (params->_sensorDiameter / 2.0f) * (params->_sensorDiameter / 2.0f);
+	const float altitude		= ray._startingPoint.y - uniforms._waterHeight;
+	const float depth			= uniforms._waterHeight - collision._point.y;
+	const vec3 transmitDir		= glm::normalize(waterCollision._point - ray._startingPoint);
+	const float transmitCosine	= glm::dot(transmitDir, vec3(.0f, -1.0f, .0f));
+	const float denom			= WATER_REFRACTIVE * altitude + depth;
+	const float waterAngle		= std::acos(glm::dot(vec3(.0f, -1.0f, .0f), ray._direction));
+	const float hypotenuse		= depth / std::cos(waterAngle);
+	const float sinus			= std::sin(waterAngle) * hypotenuse;
+	const float atmFactor		= this->getAttenuation(collision._distance, uniforms);
+
+	float intensity				= (ray._power * brdfFactor * receiverArea * transmitCosine * transmitCosine * uniforms._reflectanceWeight * atmFactor * 100.0f) / (glm::pi<float>() * denom * denom);
+	intensity					*= std::exp(-2.0f * maxDiffuseWater * depth * hypotenuse / sinus);
+
+	return intensity;
+}
+
+void LiDARCPUSolver::computeColor(std::vector<Model3D::RayGPUData>& rays, std::vector<Model3D::TriangleCollisionGPUData>& collisions, LiDARParameters* params, const SimulationUniforms& uniforms, const unsigned materialOffset, float* intensity)
+{
+	const int numCollisions = static_cast<int>(collisions.size());
+
+	#pragma omp parallel for
+	for (int index = 0; index < numCollisions; ++index)
+	{
+		Model3D::TriangleCollisionGPUData& collision = collisions[index];
+		float& collisionIntensity = intensity ? intensity[index] : collision._intensity;
+
+		if (collision._rayIndex == NULL_INDEX)												// Outliers keep a null intensity
+		{
+			if (intensity) collisionIntensity = collision._intensity;
+			continue;
+		}
+
+		const Model3D::RayGPUData& ray = rays[collision._rayIndex];
+		const float brdfFactor = this->reflectIrradiance(collision, ray, materialOffset);
+		const unsigned previousCollision = collision._previousCollision;
+
+		if (uniforms._bathymetric && previousCollision < static_cast<unsigned>(numCollisions) && collisions[previousCollision]._modelCompID < _groupData->_meshData.size() &&
+			(_groupData->_meshData[collisions[previousCollision]._modelCompID]._surfaceType & WATER_MASK) != 0)
+		{
+			collisionIntensity = this->computeBathymetricIntensity(collision, collisions[previousCollision], brdfFactor, ray, params, uniforms);
+		}
+		else
+		{
+			collisionIntensity = this->computeIntensity(collision, brdfFactor, ray, params, uniforms);
+		}
+	}
+}
+
+float LiDARCPUSolver::computeIntensity(const Model3D::TriangleCollisionGPUData& collision, const float brdfFactor, const Model3D::RayGPUData& ray, const LiDARParameters* params, const SimulationUniforms& uniforms)
+{
+	const float distance		= collision._distance;
+	const float squaredDistance	= distance * distance;
+	const float pulsePower		= ray._power * collision._numIntersectedRays;
+	const float squaredDiameter	= params->_sensorDiameter * params->_sensorDiameter;
+	const float atmFactor		= this->getAttenuation(distance, uniforms);
+
+	return (pulsePower * squaredDiameter * brdfFactor * uniforms._reflectanceWeight * atmFactor * params->_systemAttenuation) / (4.0f * squaredDistance);
+}
+
+bool LiDARCPUSolver::consumeHit(Model3D::TriangleCollisionGPUData& collision, const Model3D::RayHitGPUData& hit, const Model3D::RayGPUData& ray)
+{
+	// Refracted rays are moved and deviated, whereas the rest of them keep their line and would find the same face again
+	if (hit._origin != ray._origin || hit._direction != ray._direction) return false;
+
+	if (hit._faceIndex != NULL_INDEX) this->setCollision(collision, ray, hit._distance, hit._faceIndex, hit._instanceIndex);
+
+	return true;
+}
+
+unsigned long long LiDARCPUSolver::findBVHCollision(std::vector<Model3D::RayGPUData>& rays, const bool reuseHits, const float maxDistance)
+{
+	const int numRays = static_cast<int>(rays.size());
+	long long nodeVisits = 0;
+
+	#pragma omp parallel for schedule(dynamic, 256) reduction(+: nodeVisits)
+	for (int rayIdx = 0; rayIdx < numRays; ++rayIdx)
+	{
+		const Model3D::RayGPUData& ray = rays[rayIdx];
+		Model3D::TriangleCollisionGPUData& collision = _rayCollision[rayIdx];
+		Model3D::RayHitGPUData& hit = _rayHits[rayIdx];
+
+		collision._faceIndex = NULL_INDEX;
+		collision._distance = NULL_INDEX;
+		collision._rayIndex = NULL_INDEX;
+
+		if (ray._continueRay == 0) continue;
+		if (reuseHits && this->consumeHit(collision, hit, ray)) continue;
+
+		// Refracted rays travel away from the starting point, hence this bound is conservative regarding the range checked in reduceCollisions
+		hit._distance = maxDistance + glm::distance(ray._startingPoint, ray._origin);
+		hit._origin = ray._origin;
+		hit._direction = ray._direction;
+		hit._faceIndex = NULL_INDEX;
+		hit._instanceIndex = NULL_INDEX;
+
+		switch (_bvhLayout)
+		{
+		case Group3D::WIDE_BVH:
+			nodeVisits += this->traverseWideBVH(ray, hit);
+			break;
+		case Group3D::COMPRESSED_BVH:
+			nodeVisits += this->traverseCompressedBVH(ray, hit);
+			break;
+		default:
+			nodeVisits += this->traverseBVH(ray, hit);
+			break;
+		}
+
+		if (hit._faceIndex != NULL_INDEX) this->setCollision(collision, ray, hit._distance, hit._faceIndex, hit._instanceIndex);
+	}
+
+	return static_cast<unsigned long long>(nodeVisits);
+}
+
+float LiDARCPUSolver::getAttenuation(const float distance, const SimulationUniforms& uniforms)
+{
+	return std::pow(10.0f, -2.0f * distance * uniforms._atmosphericAttenuation / 10000.0f);
+}
+
+float LiDARCPUSolver::getHermiteInterpolation(const unsigned materialID, const float x, const float y)
+{
+	float x_i, y_i, x_f = std::modf(x, &x_i), y_f = std::modf(y, &y_i);
+	const int x0 = (static_cast<int>(x_i - 1) % 360 + 360) % 360, x1 = (x0 + 1) % 360, x2 = (x1 + 1) % 360, x3 = (x2 + 1) % 360;
+	const int y0 = glm::clamp(static_cast<int>(y_i - 1), 0, 90), y1 = glm::clamp(y0 + 1, 0, 90), y2 = glm::clamp(y1 + 1, 0, 90), y3 = glm::clamp(y2 + 1, 0, 90);
+	const float* brdf = _brdf.data() + materialID * BRDF_MATERIAL_SIZE;
+	const float* hermite = _hermiteTensor.data();
+
+	const float rx0 = brdf[x0 * 91 + y0], rx1 = brdf[x1 * 91 + y0], rx2 = brdf[x2 * 91 + y0], rx3 = brdf[x3 * 91 + y0];
+	const float ry0 = brdf[x0 * 91 + y0], ry1 = brdf[x0 * 91 + y1], ry2 = brdf[x0 * 91 + y2], ry3 = brdf[x0 * 91 + y3];
+
+	const float ax = rx0 * hermite[0] + rx1 * hermite[1] + rx2 * hermite[2] + rx3 * hermite[3];
+	const float bx = rx0 * hermite[4] + rx1 * hermite[5] + rx2 * hermite[6] + rx3 * hermite[7];
+	const float cx = rx0 * hermite[8] + rx1 * hermite[9] + rx2 * hermite[10] + rx3 * hermite[11];
+	const float dx = rx0 * hermite[12] + rx1 * hermite[13] + rx2 * hermite[14] + rx3 * hermite[15];
+
+	const float ay = ry0 * hermite[0] + ry1 * hermite[1] + ry2 * hermite[2] + ry3 * hermite[3];
+	const float by = ry0 * hermite[4] + ry1 * hermite[5] + ry2 * hermite[6] + ry3 * hermite[7];
+	const float cy = ry0 * hermite[8] + ry1 * hermite[9] + ry2 * hermite[10] + ry3 * hermite[11];
+	const float dy = ry0 * hermite[12] + ry1 * hermite[13] + ry2 * hermite[14] + ry3 * hermite[15];
+
+	return (x_f * (x_f * (x_f * ax + bx) + cx) + dx) + (y_f * (y_f * (y_f * ay + by) + cy) + dy);
+}
+
+float LiDARCPUSolver::getLossThreshold(const float ks, const LiDARParameters* params)
+{
+	if (ks < params->_zeroThreshold) return .0f;
+
+	return params->_multCoefficient * std::pow(ks + params->_addCoefficient, params->_lossPower);
+}
+
+void LiDARCPUSolver::intersectLeaf(const unsigned firstFace, const unsigned numFaces, const Model3D::RayGPUData& localRay, const unsigned instanceIndex, Model3D::RayHitGPUData& hit)
+{
+	// Faces of a leaf are contiguous in the leaf faces buffer
+	const unsigned* leafFace = _groupData->_leafFace.data() + firstFace;
+	float t;
+
+	for (unsigned faceIdx = 0; faceIdx < numFaces; ++faceIdx)
+	{
+		const unsigned faceIndex = leafFace[faceIdx];
+
+		// Hits at the same distance keep their traversal order, e.g. fragments of a split face which are reached from several leaves
+		if (this->rayTriangleIntersection(_groupData->_triangleMesh[faceIndex], localRay, t) && t < hit._distance)
+		{
+			hit._distance = t;
+			hit._faceIndex = faceIndex;
+			hit._instanceIndex = instanceIndex;
+		}
+	}
+}
+
+unsigned LiDARCPUSolver::intersectWideNode(const Group3D::WideBVHNode& node, const vec3& origin, const vec3& inverseDirection, const float maxDistance, float* tNear)
+{
+	// Entry planes are chosen by the sign of the direction, so that empty slots, whose bounds are inverted, are never hit
+	const float* nearX = inverseDirection.x >= .0f ? node._minX : node._maxX, *farX = inverseDirection.x >= .0f ? node._maxX : node._minX;
+	const float* nearY = inverseDirection.y >= .0f ? node._minY : node._maxY, *farY = inverseDirection.y >= .0f ? node._maxY : node._minY;
+	const float* nearZ = inverseDirection.z >= .0f ? node._minZ : node._maxZ, *farZ = inverseDirection.z >= .0f ? node._maxZ : node._minZ;
+
+#ifdef __AVX2__
+	const __m256 originX = _mm256_set1_ps(origin.x), originY = _mm256_set1_ps(origin.y), originZ = _mm256_set1_ps(origin.z);
+	const __m256 inverseX = _mm256_set1_ps(inverseDirection.x), inverseY = _mm256_set1_ps(inverseDirection.y), inverseZ = _mm256_set1_ps(inverseDirection.z);
+
+	const __m256 tEntry = _mm256_max_ps(_mm256_max_ps(
+		_mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(nearX), originX), inverseX),
+		_mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(nearY), originY), inverseY)),
+		_mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(nearZ), originZ), inverseZ));
+	const __m256 tExit = _mm256_min_ps(_mm256_min_ps(
+		_mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(farX), originX), inverseX),
+		_mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(farY), originY), inverseY)),
+		_mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(farZ), originZ), inverseZ));
+	const __m256 hit = _mm256_and_ps(
+		_mm256_cmp_ps(tExit, _mm256_max_ps(tEntry, _mm256_setzero_ps()), _CMP_GE_OQ),
+		_mm256_cmp_ps(tEntry, _mm256_set1_ps(maxDistance), _CMP_LE_OQ));
+
+	_mm256_storeu_ps(tNear, tEntry);
+
+	return static_cast<unsigned>(_mm256_movemask_ps(hit));
+#else
+	unsigned hitMask = 0;
+
+	for (unsigned slotIdx = 0; slotIdx < BVH_WIDTH; ++slotIdx)
+	{
+		const float tEntry = glm::max(glm::max((nearX[slotIdx] - origin.x) * inverseDirection.x, (nearY[slotIdx] - origin.y) * inverseDirection.y), (nearZ[slotIdx] - origin.z) * inverseDirection.z);
+		const float tExit = glm::min(glm::min((farX[slotIdx] - origin.x) * inverseDirection.x, (farY[slotIdx] - origin.y) * inverseDirection.y), (farZ[slotIdx] - origin.z) * inverseDirection.z);
+
+		tNear[slotIdx] = tEntry;
+		if (tExit >= glm::max(tEntry, .0f) && tEntry <= maxDistance) hitMask |= 1 << slotIdx;
+	}
+
+	return hitMask;
+#endif
+}
+
+void LiDARCPUSolver::prepareData(std::vector<Model3D::RayGPUData>& rays, LiDARParameters* params)
+{
+	const int numRays = static_cast<int>(rays.size());
+	const float power = params->_peakPower / static_cast<float>(params->_raysPulse);
+
+	#pragma omp parallel for
+	for (int rayIdx = 0; rayIdx < numRays; ++rayIdx)
+	{
+		Model3D::RayGPUData& ray = rays[rayIdx];
+		ray._returnNumber = 0;
+		ray._power = power;
+		ray._startingPoint = ray._origin;
+		ray._lastCollisionIndex = NULL_INDEX;
+		ray._continueRay = 1;
+		ray._previousDirection = ray._direction;
+	}
+}
+
+bool LiDARCPUSolver::rayTriangleIntersection(const Model3D::FaceGPUData& face, const Model3D::RayGPUData& ray, float& t)
+{
+	const unsigned startIndex = _groupData->_meshData[face._modelCompID]._startIndex;
+	const vec3& v1 = _groupData->_geometry[face._vertices.x + startIndex]._position;
+	const vec3& v2 = _groupData->_geometry[face._vertices.y + startIndex]._position;
+	const vec3& v3 = _groupData->_geometry[face._vertices.z + startIndex]._position;
+
+	const vec3 edge1 = v2 - v1, edge2 = v3 - v1;
+	const vec3 h = glm::cross(ray._direction, edge2);
+	const float a = glm::dot(edge1, h);
+
+	if (std::abs(a) < EPSILON) return false;										// Parallel to triangle
+
+	const float f = 1.0f / a;
+	const vec3 s = ray._origin - v1;
+	const float u = f * glm::dot(s, h);
+
+	if (u < .0f || u > 1.0f) return false;
+
+	const vec3 q = glm::cross(s, edge1);
+	const float v = f * glm::dot(ray._direction, q);
+
+	if (v < .0f || u + v > 1.0f) return false;
+
+	t = f * glm::dot(edge2, q);
+
+	return t >= -EPSILON;															// There is a line intersection but no ray intersection otherwise
+}
+
+unsigned LiDARCPUSolver::reduceCollisions(std::vector<Model3D::RayGPUData>& rays, std::vector<Model3D::TriangleCollisionGPUData>& collisions, LiDARParameters* params, const SimulationUniforms& uniforms)
+{
+	const unsigned raysPulse = params->_raysPulse;
+	const int numPulses = static_cast<int>(rays.size() / raysPulse);
+	std::vector<unsigned> validPulse(numPulses, 0);
+
+	#pragma omp parallel for
+	for (int pulseIdx = 0; pulseIdx < numPulses; ++pulseIdx)
+	{
+		const unsigned rayOffset = pulseIdx * raysPulse;
+		unsigned minCollisionIndex = NULL_INDEX;
+		float minDistance = NULL_INDEX;
+
+		for (unsigned rayIdx = 0; rayIdx < raysPulse; ++rayIdx)
+		{
+			const Model3D::TriangleCollisionGPUData& collision = _rayCollision[rayOffset + rayIdx];
+
+			if (collision._faceIndex != NULL_INDEX && collision._distance < minDistance)
+			{
+				minCollisionIndex = rayOffset + rayIdx;
+				minDistance = collision._distance;
+			}
+		}
+
+		// Pulses without hits are not traced again, as invalidateRay does in GPU
+		if (minCollisionIndex == NULL_INDEX)
+		{
+			for (unsigned rayIdx = 0; rayIdx < raysPulse; ++rayIdx)
+			{
+				rays[rayOffset + rayIdx]._continueRay = 0;
+				rays[rayOffset + rayIdx]._lastCollisionIndex = NULL_INDEX;
+			}
+
+			continue;
+		}
+
+		Model3D::TriangleCollisionGPUData& minCollision = _rayCollision[minCollisionIndex];
+		const Model3D::RayGPUData& minRay = rays[minCollisionIndex];
+		const float footprint = glm::distance(minRay._startingPoint, minCollision._point) * params->_pulseRadius;
+		const float allowedRadius = 2.0f * footprint * (2.0f - std::abs(glm::dot(minCollision._normal, -minRay._direction)));
+		const unsigned lastCollisionIndex = minRay._lastCollisionIndex;
+
+		minCollision._numIntersectedRays = 0;
+
+		for (unsigned rayIdx = 0; rayIdx < raysPulse; ++rayIdx)
+		{
+			const unsigned collisionIndex = rayOffset + rayIdx;
+			const Model3D::TriangleCollisionGPUData& collision = _rayCollision[collisionIndex];
+
+			if (collision._faceIndex != NULL_INDEX)
+			{
+				const unsigned isSameCollision = unsigned(glm::distance(minCollision._point, collision._point) < allowedRadius || (minCollision._faceIndex == collision._faceIndex && minCollision._modelCompID == collision._modelCompID)
+													|| this->areTriangleContiguous(minCollision._modelCompID, collision._modelCompID, minCollision._faceIndex, collision._faceIndex));
+				rays[collisionIndex]._continueRay = 1 - isSameCollision;
+				rays[collisionIndex]._lastCollisionIndex = collisionIndex;
+				minCollision._numIntersectedRays += isSameCollision;
+			}
+			else
+			{
+				rays[collisionIndex]._continueRay = 0;
+				rays[collisionIndex]._lastCollisionIndex = NULL_INDEX;
+			}
+		}
+
+		const vec3 normalizedDirection = glm::normalize(-minRay._direction);
+		Model3D::TriangleCollisionGPUData& pulseCollision = _rayCollision[rayOffset];
+
+		pulseCollision = minCollision;
+		pulseCollision._previousCollision = lastCollisionIndex;
+		pulseCollision._rayIndex = minCollisionIndex;
+		pulseCollision._returnNumber = minRay._returnNumber;
+		pulseCollision._angle = glm::clamp(std::acos(glm::clamp(glm::dot(normalizedDirection * uniforms._sensorNormal, normalizedDirection), -1.0f, 1.0f)), -glm::half_pi<float>(), glm::half_pi<float>()) / glm::half_pi<float>() * 90.0f;
+		pulseCollision._distance = glm::distance(minRay._startingPoint, pulseCollision._point);
+		pulseCollision._gpsTime = minRay._gpsTime + (pulseCollision._distance * 2.0f) / params->LIGHT_SPEED_MS;
+
+		validPulse[pulseIdx] = this->validateCollision(rayOffset, minCollisionIndex, rays, params, uniforms);
+	}
+
+	// Exclusive scan replaces the atomic counter of GPU so that collisions keep the pulse order
+	const size_t baseIndex = collisions.size();
+	unsigned numValid = 0;
+
+	for (int pulseIdx = 0; pulseIdx < numPulses; ++pulseIdx)
+	{
+		const unsigned isValid = validPulse[pulseIdx];
+		validPulse[pulseIdx] = isValid ? numValid : NULL_INDEX;
+		numValid += isValid;
+	}
+
+	collisions.resize(baseIndex + numValid);
+
+	#pragma omp parallel for
+	for (int pulseIdx = 0; pulseIdx < numPulses; ++pulseIdx)
+	{
+		if (validPulse[pulseIdx] == NULL_INDEX) continue;
+
+		const unsigned rayOffset = pulseIdx * raysPulse, finalIndex = static_cast<unsigned>(baseIndex) + validPulse[pulseIdx];
+		collisions[finalIndex] = _rayCollision[rayOffset];
+
+		for (unsigned rayIdx = 0; rayIdx < raysPulse; ++rayIdx)
+		{
+			rays[rayOffset + rayIdx]._lastCollisionIndex = finalIndex;
+		}
+	}
+
+	return numValid;
+}
+
+float LiDARCPUSolver::reflectIrradiance(const Model3D::TriangleCollisionGPUData& collision, const Model3D::RayGPUData& ray, const unsigned materialOffset)
+{
+	const vec3 N = glm::normalize(collision._normal);
+	const vec3 L = glm::normalize(ray._origin - collision._point);
+	const unsigned materialID = _groupData->_meshData[collision._modelCompID]._materialID + materialOffset;
+	const float y = (std::abs(glm::dot(L, N)) * glm::half_pi<float>()) * 180.0f / glm::pi<float>();
+	const float x = ((std::atan2(L.z, L.x) + glm::half_pi<float>()) * 2.0f) * 180.0f / glm::pi<float>();
+
+	return glm::clamp(this->getHermiteInterpolation(materialID, x, y), .0f, 1.0f);
+}
+
+void LiDARCPUSolver::setCollision(Model3D::TriangleCollisionGPUData& collision, const Model3D::RayGPUData& ray, const float t, const unsigned faceIndex, const unsigned instanceIndex)
+{
+	const Model3D::FaceGPUData& face = _groupData->_triangleMesh[faceIndex];
+
+	collision._point = ray._origin + ray._direction * t;
+	collision._normal = face._normal;
+	collision._rayDirection = ray._direction;
+	collision._distance = glm::distance(collision._point, ray._origin);
+	collision._faceIndex = faceIndex;
+	collision._modelCompID = face._modelCompID;
+	collision._returnNumber = ray._returnNumber;
+
+	if (instanceIndex != NULL_INDEX)
+	{
+		// Faces belong to the prototype, whereas materials are those of the instance
+		const Model3D::InstanceGPUData& instance = _groupData->_instance[instanceIndex];
+
+		collision._normal = glm::normalize(glm::transpose(mat3(instance._inverseTransform)) * face._normal);
+		collision._modelCompID = instance._modelCompOffset + face._modelCompID - instance._prototypeCompOffset;
+	}
+}
+
+vec3 LiDARCPUSolver::translateShinySurface(const unsigned rayIndex, const Model3D::TriangleCollisionGPUData& collision, const Model3D::RayGPUData& ray, const float shininessFactor, const SimulationUniforms& uniforms)
+{
+	const float modelCompRandom = RandomUtilities::getCounterRandomValue(_seed, collision._modelCompID, MODEL_COMP_NOISE_OFFSET) * SHINY_MODEL_WEIGHT;		// Bias shared by the whole model component
+	const float pointRandom = this->getWhiteNoise(rayIndex, ray._returnNumber, POINT_NOISE_OFFSET, uniforms) * SHINY_INDIVIDUAL_ERROR;
+
+	return ray._direction * shininessFactor * shininessFactor * collision._distance * SHINY_DISTANCE_WEIGHT + ray._direction * (modelCompRandom + pointRandom) * shininessFactor;
+}
+
+vec3 LiDARCPUSolver::translateTerrain(const unsigned rayIndex, const Model3D::TriangleCollisionGPUData& collision, const Model3D::RayGPUData& ray, const SimulationUniforms& uniforms)
+{
+	const float height = ray._startingPoint.y - collision._point.y;
+	const float verticalNoise = this->getWhiteNoise(rayIndex, ray._returnNumber, TERRAIN_NOISE_OFFSET.x, uniforms);
+	const float horizontalNoise = this->getWhiteNoise(rayIndex, ray._returnNumber, TERRAIN_NOISE_OFFSET.y, uniforms);
+	const float verticalError = verticalNoise * (VERTICAL_TERRAIN_ERROR_HEIGHT_W * height + VERTICAL_TERRAIN_ERROR_ANGLE_W * collision._angle);
+	const float horizontalError = horizontalNoise * HORIZONTAL_TERRAIN_ERROR_W * height;
+	const vec3 horizontalAxis = vec3(this->getWhiteNoise(rayIndex, ray._returnNumber, HORIZONTAL_AXIS_OFFSET.x, uniforms), .0f, this->getWhiteNoise(rayIndex, ray._returnNumber, HORIZONTAL_AXIS_OFFSET.y, uniforms));
+
+	return vec3(.0f, 1.0f, .0f) * verticalError + horizontalAxis * horizontalError;
+}
+
+void LiDARCPUSolver::transformRay(const Model3D::RayGPUData& ray, const unsigned instanceIndex, Model3D::RayGPUData& localRay, vec3& localInverseDirection)
+{
+	localRay._origin = ray._origin;
+	localRay._direction = ray._direction;
+
+	if (instanceIndex != NULL_INDEX)
+	{
+		const Model3D::InstanceGPUData& instance = _groupData->_instance[instanceIndex];
+		localRay._origin = vec3(instance._inverseTransform * vec4(ray._origin, 1.0f));
+		localRay._direction = mat3(instance._inverseTransform) * ray._direction;
+	}
+
+	localInverseDirection = 1.0f / localRay._direction;
+}
+
+unsigned long long LiDARCPUSolver::traverseBVH(const Model3D::RayGPUData& ray, Model3D::RayHitGPUData& hit)
+{
+	const unsigned rootIndex = static_cast<unsigned>(_groupData->_cluster.size()) - 1;
+	const vec3 inverseDirection = 1.0f / ray._direction;
+	unsigned long long nodeVisits = 0;
+
+	unsigned toExplore[BVH_STACK_SIZE], toExploreInstance[BVH_STACK_SIZE];
+	float toExploreDistance[BVH_STACK_SIZE];
+	int currentIndex = -1;
+	float tNear, tNear1, tNear2;
+
+	// Nodes below an instance are tested against the ray in the space of its prototype. Directions are not normalized, so distances are preserved
+	Model3D::RayGPUData localRay = ray;
+	vec3 localInverseDirection = inverseDirection;
+	unsigned currentInstance = NULL_INDEX;
+
+	const Model3D::BVHCluster& root = _groupData->_cluster[rootIndex];
+	if (Intersections3D::intersect(root._minPoint, root._maxPoint, ray._origin, inverseDirection, hit._distance, tNear))
+	{
+		toExplore[++currentIndex] = rootIndex;
+		toExploreInstance[currentIndex] = NULL_INDEX;
+		toExploreDistance[currentIndex] = tNear;
+	}
+
+	while (currentIndex >= 0)
+	{
+		// Nodes are culled again as the nearest hit may have been updated since they were pushed
+		const float bestDistance = hit._distance;
+		const unsigned clusterIndex = toExplore[currentIndex], instanceIndex = toExploreInstance[currentIndex];
+		const float clusterDistance = toExploreDistance[currentIndex--];
+
+		if (clusterDistance > bestDistance) continue;
+
+		if (instanceIndex != currentInstance)
+		{
+			currentInstance = instanceIndex;
+			this->transformRay(ray, currentInstance, localRay, localInverseDirection);
+		}
+
+		const Model3D::BVHCluster& cluster = _groupData->_cluster[clusterIndex];
+		++nodeVisits;
+
+		if ((cluster._faceIndex & INSTANCE_FLAG) != 0)
+		{
+			// Instance leaf: its world-space box was already intersected, hence the traversal goes on with the root of its prototype
+			const unsigned leafInstance = cluster._faceIndex & ~INSTANCE_FLAG;
+			const Model3D::InstanceGPUData& instance = _groupData->_instance[leafInstance];
+
+			toExplore[++currentIndex] = instance._blasRoot;
+			toExploreInstance[currentIndex] = leafInstance;
+			toExploreDistance[currentIndex] = clusterDistance;
+		}
+		else if (cluster._faceIndex != NULL_INDEX)
+		{
+			this->intersectLeaf(cluster._faceIndex, cluster._numFaces, localRay, currentInstance, hit);
+		}
+		else if (currentIndex + 2 < static_cast<int>(BVH_STACK_SIZE))
+		{
+			const Model3D::BVHCluster& child1 = _groupData->_cluster[cluster._prevIndex1];
+			const Model3D::BVHCluster& child2 = _groupData->_cluster[cluster._prevIndex2];
+			const bool intersect1 = Intersections3D::intersect(child1._minPoint, child1._maxPoint, localRay._origin, localInverseDirection, bestDistance, tNear1);
+			const bool intersect2 = Intersections3D::intersect(child2._minPoint, child2._maxPoint, localRay._origin, localInverseDirection, bestDistance, tNear2);
+
+			// The farthest child is pushed first so that the nearest one is explored next
+			if (intersect1 && intersect2 && tNear1 < tNear2)
+			{
+				toExplore[++currentIndex] = cluster._prevIndex2;
+				toExploreInstance[currentIndex] = currentInstance;
+				toExploreDistance[currentIndex] = tNear2;
+				toExplore[++currentIndex] = cluster._prevIndex1;
+				toExploreInstance[currentIndex] = currentInstance;
+				toExploreDistance[currentIndex] = tNear1;
+			}
+			else
+			{
+				if (intersect1)
+				{
+					toExplore[++currentIndex] = cluster._prevIndex1;
+					toExploreInstance[currentIndex] = currentInstance;
+					toExploreDistance[currentIndex] = tNear1;
+				}
+
+				if (intersect2)
+				{
+					toExplore[++currentIndex] = cluster._prevIndex2;
+					toExploreInstance[currentIndex] = currentInstance;
+					toExploreDistance[currentIndex] = tNear2;
+				}
+			}
+		}
+	}
+
+	return nodeVisits;
+}
+
+unsigned long long LiDARCPUSolver::traverseCompressedBVH(const Model3D::RayGPUData& ray, Model3D::RayHitGPUData& hit)
+{
+	typedef Group3D::CompressedBVHNode CompressedNode;
+
+	const vec3 inverseDirection = 1.0f / ray._direction;
+	unsigned long long nodeVisits = 0;
+
+	// Decoded boxes are pushed along with node references, since bounds of children are relative to them
+	unsigned toExplore[BVH_STACK_SIZE], toExploreInstance[BVH_STACK_SIZE];
+	vec3 toExploreMin[BVH_STACK_SIZE], toExploreMax[BVH_STACK_SIZE];
+	float toExploreDistance[BVH_STACK_SIZE];
+	int currentIndex = -1;
+	float tNear, tNear1, tNear2;
+	vec3 childMin1, childMax1, childMin2, childMax2;
+
+	Model3D::RayGPUData localRay = ray;
+	vec3 localInverseDirection = inverseDirection;
+	unsigned currentInstance = NULL_INDEX;
+
+	const Group3D::CompressedBVHRoot& root = _groupData->_compressedRoot[0];
+	if (Intersections3D::intersect(root._minPoint, root._maxPoint, ray._origin, inverseDirection, hit._distance, tNear))
+	{
+		toExplore[++currentIndex] = root._child;
+		toExploreInstance[currentIndex] = NULL_INDEX;
+		toExploreMin[currentIndex] = root._minPoint;
+		toExploreMax[currentIndex] = root._maxPoint;
+		toExploreDistance[currentIndex] = tNear;
+	}
+
+	while (currentIndex >= 0)
+	{
+		const float bestDistance = hit._distance;
+		const unsigned reference = toExplore[currentIndex], instanceIndex = toExploreInstance[currentIndex];
+		const vec3 minPoint = toExploreMin[currentIndex], maxPoint = toExploreMax[currentIndex];
+		const float nodeDistance = toExploreDistance[currentIndex--];
+
+		if (nodeDistance > bestDistance) continue;
+
+		if (instanceIndex != currentInstance)
+		{
+			currentInstance = instanceIndex;
+			this->transformRay(ray, currentInstance, localRay, localInverseDirection);
+		}
+
+		++nodeVisits;
+
+		if ((reference & CompressedNode::LEAF_FLAG) != 0)
+		{
+			const unsigned numFaces = (reference & ~CompressedNode::LEAF_FLAG) >> CompressedNode::LEAF_FACES_SHIFT, index = reference & CompressedNode::INDEX_MASK;
+
+			if (numFaces > 0)
+			{
+				this->intersectLeaf(index, numFaces, localRay, currentInstance, hit);
+			}
+			else
+			{
+				// Instance leaf: the traversal goes on with the root of its prototype, whose box is stored with full precision
+				const Group3D::CompressedBVHRoot& instanceRoot = _groupData->_compressedRoot[index + 1];
+
+				toExplore[++currentIndex] = instanceRoot._child;
+				toExploreInstance[currentIndex] = index;
+				toExploreMin[currentIndex] = instanceRoot._minPoint;
+				toExploreMax[currentIndex] = instanceRoot._maxPoint;
+				toExploreDistance[currentIndex] = nodeDistance;
+			}
+		}
+		else if (currentIndex + 2 < static_cast<int>(BVH_STACK_SIZE))
+		{
+			const CompressedNode& node = _groupData->_compressedNode[reference];
+			node.getChildBounds(0, minPoint, maxPoint, childMin1, childMax1);
+			node.getChildBounds(1, minPoint, maxPoint, childMin2, childMax2);
+
+			const bool intersect1 = Intersections3D::intersect(childMin1, childMax1, localRay._origin, localInverseDirection, bestDistance, tNear1);
+			const bool intersect2 = Intersections3D::intersect(childMin2, childMax2, localRay._origin, localInverseDirection, bestDistance, tNear2);
+
+			auto pushChild = [&](const unsigned childIdx, const vec3& childMin, const vec3& childMax, const float childDistance)
+			{
+				toExplore[++currentIndex] = node._child[childIdx];
+				toExploreInstance[currentIndex] = currentInstance;
+				toExploreMin[currentIndex] = childMin;
+				toExploreMax[currentIndex] = childMax;
+				toExploreDistance[currentIndex] = childDistance;
+			};
+
+			// The farthest child is pushed first so that the nearest one is explored next
+			if (intersect1 && intersect2 && tNear1 < tNear2)
+			{
+				pushChild(1, childMin2, childMax2, tNear2);
+				pushChild(0, childMin1, childMax1, tNear1);
+			}
+			else
+			{
+				if (intersect1) pushChild(0, childMin1, childMax1, tNear1);
+				if (intersect2) pushChild(1, childMin2, childMax2, tNear2);
+			}
+		}
+	}
+
+	return nodeVisits;
+}
+
+unsigned long long LiDARCPUSolver::traverseWideBVH(const Model3D::RayGPUData& ray, Model3D::RayHitGPUData& hit)
+{
+	unsigned long long nodeVisits = 0;
+
+	// Entries are wide nodes, leaves (non-zero number of faces) or flagged instances, as stored in the slots of their parent
+	unsigned toExplore[BVH_STACK_SIZE], toExploreFaces[BVH_STACK_SIZE], toExploreInstance[BVH_STACK_SIZE];
+	float toExploreDistance[BVH_STACK_SIZE], tNear[BVH_WIDTH];
+	unsigned hitSlot[BVH_WIDTH];
+	int currentIndex = 0;
+
+	Model3D::RayGPUData localRay = ray;
+	vec3 localInverseDirection = 1.0f / ray._direction;
+	unsigned currentInstance = NULL_INDEX;
+
+	toExplore[0] = 0;
+	toExploreFaces[0] = 0;
+	toExploreInstance[0] = NULL_INDEX;
+	toExploreDistance[0] = .0f;
+
+	while (currentIndex >= 0)
+	{
+		const float bestDistance = hit._distance;
+		const unsigned child = toExplore[currentIndex], numFaces = toExploreFaces[currentIndex], instanceIndex = toExploreInstance[currentIndex];
+		const float childDistance = toExploreDistance[currentIndex--];
+
+		if (childDistance > bestDistance) continue;
+
+		if (instanceIndex != currentInstance)
+		{
+			currentInstance = instanceIndex;
+			this->transformRay(ray, currentInstance, localRay, localInverseDirection);
+		}
+
+		++nodeVisits;
+
+		if (numFaces > 0)
+		{
+			this->intersectLeaf(child, numFaces, localRay, currentInstance, hit);
+		}
+		else if ((child & INSTANCE_FLAG) != 0)
+		{
+			const unsigned leafInstance = child & ~INSTANCE_FLAG;
+
+			toExplore[++currentIndex] = _groupData->_wideInstanceRoot[leafInstance];
+			toExploreFaces[currentIndex] = 0;
+			toExploreInstance[currentIndex] = leafInstance;
+			toExploreDistance[currentIndex] = childDistance;
+		}
+		else
+		{
+			const Group3D::WideBVHNode& node = _groupData->_wideNode[child];
+			unsigned hitMask = this->intersectWideNode(node, localRay._origin, localInverseDirection, bestDistance, tNear), numHitSlots = 0;
+
+			// Hit children are sorted by decreasing distance, so that the nearest one is explored next
+			for (unsigned slotIdx = 0; hitMask != 0; ++slotIdx, hitMask >>= 1)
+			{
+				if ((hitMask & 1) == 0) continue;
+
+				unsigned position = numHitSlots++;
+				while (position > 0 && tNear[hitSlot[position - 1]] < tNear[slotIdx])
+				{
+					hitSlot[position] = hitSlot[position - 1];
+					--position;
+				}
+
+				hitSlot[position] = slotIdx;
+			}
+
+			if (currentIndex + static_cast<int>(numHitSlots) >= static_cast<int>(BVH_STACK_SIZE)) continue;
+
+			for (unsigned hitIdx = 0; hitIdx < numHitSlots; ++hitIdx)
+			{
+				const unsigned slotIdx = hitSlot[hitIdx];
+
+				toExplore[++currentIndex] = node._child[slotIdx];
+				toExploreFaces[currentIndex] = node._numFaces[slotIdx];
+				toExploreInstance[currentIndex] = currentInstance;
+				toExploreDistance[currentIndex] = tNear[slotIdx];
+			}
+		}
+	}
+
+	return nodeVisits;
+}
+
+void LiDARCPUSolver::updateReturns(std::vector<Model3D::RayGPUData>& rays, std::vector<Model3D::TriangleCollisionGPUData>& collisions)
+{
+	const int numCollisions = static_cast<int>(collisions.size());
+	std::vector<unsigned> nextCollision(numCollisions, NULL_INDEX);
+
+	// Each collision reads the return number of the last collision of its chain, hence no thread writes on shared collisions
+	for (int index = 0; index < numCollisions; ++index)
+	{
+		const unsigned previousCollision = collisions[index]._previousCollision;
+		if (previousCollision < static_cast<unsigned>(numCollisions)) nextCollision[previousCollision] = index;
+	}
+
+	#pragma omp parallel for
+	for (int index = 0; index < numCollisions; ++index)
+	{
+		unsigned lastCollision = index;
+		while (nextCollision[lastCollision] != NULL_INDEX) lastCollision = nextCollision[lastCollision];
+
+		if (collisions[lastCollision]._rayIndex != NULL_INDEX)
+		{
+			collisions[index]._numReturns = rays[collisions[lastCollision]._rayIndex]._returnNumber;
+		}
+	}
+}
+
+bool LiDARCPUSolver::validateCollision(const unsigned collisionIndex, const unsigned rayIndex, std::vector<Model3D::RayGPUData>& rays, LiDARParameters* params, const SimulationUniforms& uniforms)
+{
+	Model3D::TriangleCollisionGPUData& collision = _rayCollision[collisionIndex];
+	const Model3D::MeshGPUData& mesh = _groupData->_meshData[collision._modelCompID];
+	const bool isWater = (mesh._surfaceType & WATER_MASK) != 0, isTerrain = (mesh._surfaceType & TERRAIN_MASK) != 0;
+	const bool exceedReturns = (rays[rayIndex]._returnNumber + 1) >= params->_maxReturns;
+	const float noisyMaxRange = params->_maxRange + this->getWhiteNoise(rayIndex, rays[rayIndex]._returnNumber, DISTANCE_NOISE_OFFSET, uniforms) * (params->_maxRangeSoftBoundary.y - params->_maxRangeSoftBoundary.x) + params->_maxRangeSoftBoundary.x;
+
+	const Model3D::VertexGPUData& vertex = _groupData->_geometry[_groupData->_triangleMesh[collision._faceIndex]._vertices.x + mesh._startIndex];
+	const float shininessFactor = glm::clamp(std::pow(vertex._ks, vertex._shininess) * _material[mesh._materialID]._roughness, .0f, 1.0f);
+	const bool isReturnLost = this->getWhiteNoise(rayIndex, rays[rayIndex]._returnNumber, LOSS_NOISE_OFFSET, uniforms) <= this->getLossThreshold(shininessFactor, params) && !uniforms._bathymetric;
+	const bool isValid = collision._distance < noisyMaxRange && (!isWater || collision._previousCollision == NULL_INDEX) && !isReturnLost;
+
+	if (!isValid) return false;
+
+	if (params->_includeShinySurfaceError)
+		collision._point += this->translateShinySurface(rayIndex, collision, rays[rayIndex], 1.0f - shininessFactor, uniforms);
+
+	if (params->_includeTerrainInducedError && isTerrain)
+		collision._point += this->translateTerrain(rayIndex, collision, rays[rayIndex], uniforms);
+
+	for (unsigned rayIdx = 0; rayIdx < static_cast<unsigned>(params->_raysPulse); ++rayIdx)
+	{
+		Model3D::RayGPUData& ray = rays[collisionIndex + rayIdx];
+
+		if (!exceedReturns && (ray._continueRay == 1 || (ray._lastCollisionIndex != NULL_INDEX && isWater && uniforms._bathymetric)))
+		{
+			ray._continueRay = 1;
+
+			if (isWater)
+			{
+				ray._origin = _rayCollision[collisionIndex + rayIdx]._point + ray._direction * 0.0001f;
+				ray._previousDirection = ray._direction;
+				ray._direction = glm::normalize(glm::refract(ray._direction, collision._normal, _material[mesh._materialID]._refractiveIndex));
+			}
+			else
+			{
+				ray._previousDirection = ray._direction;
+			}
+		}
+		else
+		{
+			ray._continueRay = 0;
+		}
+
+		ray._returnNumber += 1;
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,286 @@
+#pragma once
+
+#include "Graphics/Application/LiDARParameters.h"
+#include "Graphics/Core/Group3D.h"
+#include "Graphics/Core/MaterialDatabase.h"
+#include "Graphics/Core/Model3D.h"
+#include "Utilities/PipelineMetrics.h"
+#include "Utilities/RandomUtilities.h"
+
+/**
+*	@file LiDARCPUSolver.h
+*	@authors Alfonso Lpez Ruiz (alr00048@red.ujaen.es)
+*	@date 10/16/2026
+*/
+
+/**
+*	@brief Multithreaded CPU counterpart of the LiDAR compute shaders. Each stage mirrors one of the shaders at Assets/Shaders/Compute/LiDAR.
+*	Rays are built by the CPU ray builders and the scene is gathered in main memory by the group, hence no OpenGL context is required.
+*/
+class LiDARCPUSolver
+{
+public:
+	/**
+	*	@brief Values which are defined as uniform variables in the GPU pipeline.
+	*/
+	struct SimulationUniforms
+	{
+		float		_atmosphericAttenuation;					//!< Attenuation of atmospheric conditions for the radar equation
+		bool		_bathymetric;								//!< Rays can go through water surfaces
+		unsigned	_nullModelCompID;							//!< Model component assigned to outliers
+		unsigned	_rayOffset;									//!< Index of the first ray of the batch in the whole simulation, which keys its noise
+		float		_reflectanceWeight;							//!< Weight of material reflectance in intensity equation
+		vec3		_sensorNormal;								//!< Reference vector to compute scan angles
+		float		_waterHeight;								//!< Height of water surfaces for bathymetric intensity
+	};
+
+protected:
+	inline static const unsigned	BVH_STACK_SIZE = 200;		//!< Maximum depth of BVH traversal stack
+	inline static const unsigned	BRDF_MATERIAL_SIZE = 32760;	//!< Number of samples of a single material in the BRDF buffer (360 x 91)
+	inline static const float		EPSILON = 1e-8f;			//!< Tolerance of intersection tests, as defined in constraints.glsl
+	inline static const unsigned	INSTANCE_FLAG = 0x80000000;	//!< Leaves whose face index refers to an instance, as in compute shaders
+	inline static const unsigned	NULL_INDEX = 0xFFFFFFF;		//!< Infinite value as defined in compute shaders
+
+	// [Surface masks]
+	inline static const unsigned	TERRAIN_MASK = 1 << 0;		//!<
+	inline static const unsigned	WATER_MASK = 1 << 1;		//!<
+
+	// [Induced errors]
+	inline static const float		HORIZONTAL_TERRAIN_ERROR_W = 1.0f / 1000.0f;
+	inline static const float		VERTICAL_TERRAIN_ERROR_HEIGHT_W = 1e-4f;
+	inline static const float		VERTICAL_TERRAIN_ERROR_ANGLE_W = .5f;
+	inline static const float		SHINY_DISTANCE_WEIGHT = 1.0f / 200.0f;
+	inline static const float		SHINY_MODEL_WEIGHT = 1.0f / 80.0f;
+	inline static const float		SHINY_INDIVIDUAL_ERROR = 1.0f / 100.0f;
+
+	// [Water]
+	inline static const vec3		WATER_DIFFUSE = vec3(0.45f, 0.48f, 0.5f);
+	inline static const float		WATER_REFRACTIVE = 1.33f;
+
+	// [Noise streams] Same values as compute shaders so that both backends draw the same random values
+	inline static const unsigned	DISTANCE_NOISE_OFFSET = 0x456823;
+	inline static const uvec2		HORIZONTAL_AXIS_OFFSET = uvec2(0x45623, 0x7652FA);
+	inline static const unsigned	LOSS_NOISE_OFFSET = 0x45632;
+	inline static const unsigned	MODEL_COMP_NOISE_OFFSET = 0xAC987;
+	inline static const unsigned	OUTLIER_DISTANCE_NOISE_OFFSET = 0xFCBA23;
+	inline static const unsigned	OUTLIER_NOISE_OFFSET = 0x234578;
+	inline static const unsigned	POINT_NOISE_OFFSET = 0xAC666;
+	inline static const unsigned	RETURN_NOISE_STRIDE = 0x1000000;		//!< Streams are below 2^24, hence every return draws from its own streams
+	inline static const uvec2		TERRAIN_NOISE_OFFSET = uvec2(0x56789, 0x65432);
+
+protected:
+	// [Scene]
+	Group3D::StaticCPUData*							_groupData;			//!< Geometry, topology and BVH of the scene
+
+	// [Simulation data]
+	std::vector<float>								_brdf;				//!< Sampled BRDF of every material
+	std::vector<float>								_hermiteTensor;		//!< Coefficients of Hermite interpolation
+	std::vector<MaterialDatabase::LiDARMaterialGPUData> _material;		//!< Materials for the current wavelength
+	unsigned										_numSpectralBands;	//!< Bands whose BRDF is concatenated in _brdf
+	std::vector<Model3D::TriangleCollisionGPUData>	_rayCollision;		//!< Nearest collision of each ray
+	std::vector<Model3D::RayHitGPUData>			_rayHits;			//!< Nearest hit of each ray, reused by successive returns
+	unsigned										_seed;				//!< Key of the counter-based generator
+	unsigned										_spectralMaterialStride; //!< Number of materials per spectral band
+	Group3D::BVHLayout								_bvhLayout;			//!< BVH traversed by rays
+
+protected:
+	/**
+	*	@brief Appends outliers along the rays which collided in the last iteration.
+	*/
+	void addOutliers(std::vector<Model3D::RayGPUData>& rays, std::vector<Model3D::TriangleCollisionGPUData>& collisions, const unsigned newCollisions, LiDARParameters* params, const SimulationUniforms& uniforms);
+
+	/**
+	*	@return True if both triangles share any vertex.
+	*/
+	bool areTriangleContiguous(const unsigned mesh1, const unsigned mesh2, const unsigned triangle1, const unsigned triangle2);
+
+	/**
+	*	@brief Radar equation for collisions which happen below a water surface.
+	*/
+	float computeBathymetricIntensity(const Model3D::TriangleCollisionGPUData& collision, const Model3D::TriangleCollisionGPUData& waterCollision, const float brdfFactor, const Model3D::RayGPUData& ray, const LiDARParameters* params, const SimulationUniforms& uniforms);
+
+	/**
+	*	@brief Computes the intensity of every valid collision.
+	*	@param materialOffset First material of the spectral band whose BRDF is sampled.
+	*	@param intensity If not null, intensities are written here rather than into the collisions.
+	*/
+	void computeColor(std::vector<Model3D::RayGPUData>& rays, std::vector<Model3D::TriangleCollisionGPUData>& collisions, LiDARParameters* params, const SimulationUniforms& uniforms, const unsigned materialOffset = 0, float* intensity = nullptr);
+
+	/**
+	*	@brief Radar equation.
+	*/
+	float computeIntensity(const Model3D::TriangleCollisionGPUData& collision, const float brdfFactor, const Model3D::RayGPUData& ray, const LiDARParameters* params, const SimulationUniforms& uniforms);
+
+	/**
+	*	@brief Reuses the nearest hit of a ray which was neither moved nor deviated since it was found, as a new traversal would find it again.
+	*	@return False if the ray must traverse the BVH again.
+	*/
+	bool consumeHit(Model3D::TriangleCollisionGPUData& collision, const Model3D::RayHitGPUData& hit, const Model3D::RayGPUData& ray);
+
+	/**
+	*	@brief Finds the nearest collision of each active ray by traversing the BVH of the selected layout.
+	*	@param reuseHits Hits from the previous traversal are reused whenever it is possible.
+	*	@param maxDistance Maximum range plus its upper soft boundary, measured from the starting point of rays.
+	*	@return Number of visited BVH nodes.
+	*/
+	unsigned long long findBVHCollision(std::vector<Model3D::RayGPUData>& rays, const bool reuseHits, const float maxDistance);
+
+	/**
+	*	@return Atmospheric attenuation for a travelled distance.
+	*/
+	float getAttenuation(const float distance, const SimulationUniforms& uniforms);
+
+	/**
+	*	@return BRDF value of a material through a Hermite interpolation.
+	*/
+	float getHermiteInterpolation(const unsigned materialID, const float x, const float y);
+
+	/**
+	*	@return Probability of losing a return on a shiny surface.
+	*/
+	float getLossThreshold(const float ks, const LiDARParameters* params);
+
+	/**
+	*	@return Uniform noise in [0, 1) for a ray of the batch, its current return and a stream of random values. Same values as getWhiteNoise in reduceCollisions-comp.glsl.
+	*/
+	float getWhiteNoise(const unsigned rayIndex, const unsigned returnNumber, const unsigned stream, const SimulationUniforms& uniforms) { return RandomUtilities::getCounterRandomValue(_seed, uniforms._rayOffset + rayIndex, stream + returnNumber * RETURN_NOISE_STRIDE); }
+
+	/**
+	*	@brief Tests the faces of a leaf and keeps the nearest hit of a ray.
+	*	@param instanceIndex Instance whose space the local ray is expressed in, or NULL_INDEX for non-instanced geometry.
+	*/
+	void intersectLeaf(const unsigned firstFace, const unsigned numFaces, const Model3D::RayGPUData& localRay, const unsigned instanceIndex, Model3D::RayHitGPUData& hit);
+
+	/**
+	*	@brief Slab test of a ray against every child of a wide node at once, vectorized with AVX2 whenever it is enabled.
+	*	@param tNear Entry distance of the ray for every slot.
+	*	@return Mask of hit slots.
+	*/
+	unsigned intersectWideNode(const Group3D::WideBVHNode& node, const vec3& origin, const vec3& inverseDirection, const float maxDistance, float* tNear);
+
+	/**
+	*	@brief Resets ray attributes before launching them.
+	*/
+	void prepareData(std::vector<Model3D::RayGPUData>& rays, LiDARParameters* params);
+
+	/**
+	*	@brief Mller-Trumbore intersection.
+	*	@param t Parametric value of the intersection, if any.
+	*/
+	bool rayTriangleIntersection(const Model3D::FaceGPUData& face, const Model3D::RayGPUData& ray, float& t);
+
+	/**
+	*	@brief Fills the collision of a ray from a gathered hit.
+	*	@param instanceIndex Instance whose prototype contains the face, or NULL_INDEX for non-instanced geometry.
+	*/
+	void setCollision(Model3D::TriangleCollisionGPUData& collision, const Model3D::RayGPUData& ray, const float t, const unsigned faceIndex, const unsigned instanceIndex);
+
+	/**
+	*	@brief Reduces the collisions of each pulse into a single one.
+	*	@return Number of new collisions.
+	*/
+	unsigned reduceCollisions(std::vector<Model3D::RayGPUData>& rays, std::vector<Model3D::TriangleCollisionGPUData>& collisions, LiDARParameters* params, const SimulationUniforms& uniforms);
+
+	/**
+	*	@return Reflected irradiance according to the BRDF of the collided material.
+	*/
+	float reflectIrradiance(const Model3D::TriangleCollisionGPUData& collision, const Model3D::RayGPUData& ray, const unsigned materialOffset);
+
+	/**
+	*	@return Displacement of points captured over shiny surfaces.
+	*/
+	vec3 translateShinySurface(const unsigned rayIndex, const Model3D::TriangleCollisionGPUData& collision, const Model3D::RayGPUData& ray, const float shininessFactor, const SimulationUniforms& uniforms);
+
+	/**
+	*	@return Displacement induced by terrain slope and sensor height.
+	*/
+	vec3 translateTerrain(const unsigned rayIndex, const Model3D::TriangleCollisionGPUData& collision, const Model3D::RayGPUData& ray, const SimulationUniforms& uniforms);
+
+	/**
+	*	@brief Expresses a ray in the space of the prototype of an instance, or in world space for NULL_INDEX.
+	*/
+	void transformRay(const Model3D::RayGPUData& ray, const unsigned instanceIndex, Model3D::RayGPUData& localRay, vec3& localInverseDirection);
+
+	/**
+	*	@brief Finds the nearest hit of a ray by traversing the binary BVH front to back. Nodes beyond the nearest hit, whose distance is initially the sensor range, are culled.
+	*	@return Number of visited BVH nodes.
+	*/
+	unsigned long long traverseBVH(const Model3D::RayGPUData& ray, Model3D::RayHitGPUData& hit);
+
+	/**
+	*	@brief Counterpart of traverseBVH for the compressed BVH. The bounds of every node are decoded from those of its parent, which are kept in the stack.
+	*	@return Number of visited BVH nodes.
+	*/
+	unsigned long long traverseCompressedBVH(const Model3D::RayGPUData& ray, Model3D::RayHitGPUData& hit);
+
+	/**
+	*	@brief Counterpart of traverseBVH for the wide BVH. Every child of a node is tested at once, and those which are hit are explored by increasing distance.
+	*	@return Number of visited nodes and leaves.
+	*/
+	unsigned long long traverseWideBVH(const Model3D::RayGPUData& ray, Model3D::RayHitGPUData& hit);
+
+	/**
+	*	@brief Propagates the final number of returns along the collisions of each ray.
+	*/
+	void updateReturns(std::vector<Model3D::RayGPUData>& rays, std::vector<Model3D::TriangleCollisionGPUData>& collisions);
+
+	/**
+	*	@brief Decides whether the collision of a pulse is registered and updates the pulse rays for the next return.
+	*	@param collisionIndex Index of the first ray of the pulse, where the reduced collision is stored.
+	*	@param rayIndex Ray which provided the nearest collision.
+	*/
+	bool validateCollision(const unsigned collisionIndex, const unsigned rayIndex, std::vector<Model3D::RayGPUData>& rays, LiDARParameters* params, const SimulationUniforms& uniforms);
+
+public:
+	/**
+	*	@brief Default constructor.
+	*/
+	LiDARCPUSolver();
+
+	/**
+	*	@brief Destructor.
+	*/
+	virtual ~LiDARCPUSolver();
+
+	/**
+	*	@brief Solves the intersections of a ray batch.
+	*	@param rays Rays to be traced. They are modified as in GPU.
+	*	@param collisions Vector where valid collisions are appended.
+	*	@param pipelineMetrics Metrics where the response time of each stage is accumulated.
+	*	@param spectralIntensity If not null, band-major intensity of the appended collisions for every spectral band.
+	*/
+	void solveRayIntersection(std::vector<Model3D::RayGPUData>& rays, std::vector<Model3D::TriangleCollisionGPUData>& collisions, LiDARParameters* params, const SimulationUniforms& uniforms, PipelineMetrics& pipelineMetrics, std::vector<float>* spectralIntensity = nullptr);
+
+	// ------------ Setters -------------
+
+	/**
+	*	@brief Selects the BVH to be traversed. Scene data must have been retrieved for the same layout.
+	*/
+	void setBVHLayout(const Group3D::BVHLayout layout) { _bvhLayout = layout; }
+
+	/**
+	*	@brief Modifies the scene where rays are traced.
+	*/
+	void setGroupData(Group3D::StaticCPUData* groupData) { _groupData = groupData; }
+
+	/**
+	*	@brief Modifies the coefficients of Hermite interpolation.
+	*/
+	void setHermiteTensor(const std::vector<float>& hermiteTensor) { _hermiteTensor = hermiteTensor; }
+
+	/**
+	*	@brief Modifies the materials and BRDF samples for the current wavelength.
+	*/
+	void setMaterialData(std::vector<MaterialDatabase::LiDARMaterialGPUData>& material, std::vector<float>& brdf) { _material = std::move(material); _brdf = std::move(brdf); }
+
+	/**
+	*	@brief Modifies the layout of the BRDF buffer when it stores several spectral bands.
+	*/
+	void setSpectralBands(const unsigned numBands, const unsigned materialStride) { _numSpectralBands = numBands; _spectralMaterialStride = materialStride; }
+
+	/**
+	*	@brief Modifies the key of the random generator.
+	*/
+	void setSeed(const unsigned seed) { _seed = seed; }
+};
+
@@ -1,17 +1,81 @@
 #include "stdafx.h"
 #include "LiDARPointCloud.h"
 
+#include <ctime>
+#include <future>
+
+#include "Graphics/Core/Group3D.h"
+#include "Graphics/Core/VAO.h"
 #include "Utilities/Histogram.h"
 #include "Utilities/PipelineMetrics.h"
 
+/// [Initialization of static attributes]
+
+const unsigned LiDARPointCloud::CHUNK_SIZE = 1 << 16;
+const double LiDARPointCloud::LAS_SCAN_ANGLE_STEP = 0.006;
+const double LiDARPointCloud::LAS_MIN_SCALE = 1e-4;
+const std::string LiDARPointCloud::LAS_WKT = "LOCAL_CS[\"LiDAR_BRDF scene\",LOCAL_DATUM[\"Simulation\",0],UNIT[\"metre\",1],AXIS[\"X\",EAST],AXIS[\"Y\",NORTH],AXIS[\"Z\",UP]]";
+const std::vector<std::string> LiDARPointCloud::PLY_PROPERTY = {
+	"float x", "float y", "float z", "float nx", "float ny", "float nz", "float u", "float v", "float intensity", "float scan_rank",
+	"float scan_direction_x", "float scan_direction_y", "float scan_direction_z", "uchar returnNumber", "uchar numReturns", "float returnPercent",
+	"uchar semanticGroup", "uchar asprsSemanticGroup", "float semanticGroup_red", "float semanticGroup_green", "float semanticGroup_blue",
+	"float asprsSemanticGroup_red", "float asprsSemanticGroup_green", "float asprsSemanticGroup_blue"
+};
+const unsigned LiDARPointCloud::PLY_RECORD_SIZE = 20 * sizeof(float) + 4 * sizeof(uint8_t);
+
+static_assert(sizeof(LiDARPointCloud::LASHeader) == 375, "LAS 1.4 header must be 375 bytes long");
+static_assert(sizeof(LiDARPointCloud::LASVLRHeader) == 54, "LAS variable length record header must be 54 bytes long");
+static_assert(sizeof(LiDARPointCloud::LASPointRecord) == 30, "LAS point data format 6 must be 30 bytes long");
+
 /// [Public methods]
 
-LiDARPointCloud::LiDARPointCloud() : _numPoints(.0f), _maxGPSTime(.0f)
+LiDARPointCloud::LiDARPointCloud() : _numPoints(.0f), _maxGPSTime(.0f), _capturedPointsVAO(nullptr), _numCapturedPoints(0)
 {
 }
 
 LiDARPointCloud::~LiDARPointCloud()
 {
+	delete _capturedPointsVAO;
+}
+
+void LiDARPointCloud::appendCapturedPoints(const unsigned firstPoint, std::vector<Model3D::ModelComponent*>* modelComponents)
+{
+	const unsigned numNewPoints = _points.size() - firstPoint, numModelComponents = modelComponents->size();
+	if (!numNewPoints) return;
+
+	if (!_capturedPointsVAO)
+	{
+		_capturedPointsVAO = new VAO();
+	}
+
+	// Geometry is written after the points of previous batches, which are not uploaded again
+	_capturedPointsVAO->appendVBOData(RendEnum::VBO_POSITION, _points.data() + firstPoint, _numCapturedPoints, numNewPoints);
+	_capturedPointsVAO->appendVBOData(RendEnum::VBO_NORMAL, _normal.data() + firstPoint, _numCapturedPoints, numNewPoints);
+	_capturedPointsVAO->appendVBOData(RendEnum::VBO_TEXT_COORD, _textCoord.data() + firstPoint, _numCapturedPoints, numNewPoints);
+
+	// Counting sort of new indices by model component, hence each component covers a single range of this batch
+	std::vector<GLuint> componentOffset(numModelComponents + 1, 0), indices(numNewPoints);
+
+	for (unsigned pointIdx = firstPoint; pointIdx < _points.size(); ++pointIdx)
+		++componentOffset[_modelComponent[pointIdx] + 1];
+
+	std::partial_sum(componentOffset.begin(), componentOffset.end(), componentOffset.begin());
+	std::vector<GLuint> nextIndex(componentOffset.begin(), componentOffset.end() - 1);
+
+	for (unsigned pointIdx = firstPoint; pointIdx < _points.size(); ++pointIdx)
+		indices[nextIndex[_modelComponent[pointIdx]]++] = _numCapturedPoints + pointIdx - firstPoint;
+
+	_capturedPointsVAO->appendIBOData(RendEnum::IBO_POINT_CLOUD, indices.data(), _numCapturedPoints, numNewPoints);
+
+	for (unsigned compIdx = 0; compIdx < numModelComponents; ++compIdx)
+	{
+		if (componentOffset[compIdx + 1] > componentOffset[compIdx])
+		{
+			modelComponents->at(compIdx)->pushBackCapturedPoints(_capturedPointsVAO, _numCapturedPoints + componentOffset[compIdx], componentOffset[compIdx + 1] - componentOffset[compIdx]);
+		}
+	}
+
+	_numCapturedPoints += numNewPoints;
 }
 
 bool LiDARPointCloud::archive()
@@ -23,8 +87,11 @@ bool LiDARPointCloud::archive()
 	_modelComponent.clear();
 	_returnNumber.clear();
 	_returnPercent.clear();
+	_numReturns.clear();
 	_scanAngleRank.clear();
 	_scanDirection.clear();
+	_gpsTime.clear();
+	_spectralIntensity.clear();
 	_maxGPSTime = .0;
 
 	return true;
@@ -41,6 +108,7 @@ void LiDARPointCloud::pushCollisions(std::vector<Model3D::TriangleCollisionGPUDa
 		_modelComponent.push_back(collision._modelCompID);
 		_returnNumber.push_back(collision._returnNumber);
 		_returnPercent.push_back((collision._returnNumber + 1) / float(collision._numReturns));
+		_numReturns.push_back(static_cast<uint8_t>(collision._numReturns));
 		_scanAngleRank.push_back(collision._angle);
 		_scanDirection.push_back(collision._rayDirection);
 		_gpsTime.push_back(collision._gpsTime);
@@ -50,12 +118,40 @@ void LiDARPointCloud::pushCollisions(std::vector<Model3D::TriangleCollisionGPUDa
 	}
 }
 
+void LiDARPointCloud::pushSpectralIntensity(const std::vector<float>& intensity, const unsigned numPoints)
+{
+	for (unsigned bandIdx = 0; bandIdx < _spectralIntensity.size(); ++bandIdx)
+	{
+		_spectralIntensity[bandIdx].insert(_spectralIntensity[bandIdx].end(), intensity.begin() + bandIdx * numPoints, intensity.begin() + (bandIdx + 1) * numPoints);
+	}
+}
+
+bool LiDARPointCloud::write(const std::string& filename, Group3D* scene, const int format, bool asynchronous)
+{
+	if (format == PointCloudParameters::LAS_FORMAT) return this->writeLAS(filename, scene, asynchronous);
+
+	return this->writePLY(filename, scene, asynchronous);
+}
+
+bool LiDARPointCloud::writeLAS(const std::string& filename, Group3D* scene, bool asynchronous)
+{
+	if (asynchronous)
+	{
+		std::thread writeThread(&LiDARPointCloud::writeLASThreaded, this, filename, scene, -1);
+		writeThread.detach();
+
+		return true;
+	}
+
+	return this->writeLASThreaded(filename, scene);
+}
+
 bool LiDARPointCloud::writePLY(const std::string& filename, Group3D* scene, bool asynchronous)
 {
 	if (asynchronous)
 	{
 		// Save point cloud in a different thread
-		std::thread writeImageThread(&LiDARPointCloud::writePLYThreaded, this, filename, scene);
+		std::thread writeImageThread(&LiDARPointCloud::writePLYThreaded, this, filename, scene, -1);
 		writeImageThread.detach();
 
 		return true;
@@ -66,119 +162,276 @@ bool LiDARPointCloud::writePLY(const std::string& filename, Group3D* scene, bool
 	}
 }
 
+bool LiDARPointCloud::writeSpectral(const std::vector<std::string>& filenames, Group3D* scene, const int format)
+{
+	std::vector<int> bands(glm::min(filenames.size(), _spectralIntensity.size()));
+	std::iota(bands.begin(), bands.end(), 0);
+
+	std::for_each(std::execution::par, bands.begin(), bands.end(), [&](const int band)
+	{
+		if (format == PointCloudParameters::LAS_FORMAT)
+			this->writeLASThreaded(filenames[band], scene, band);
+		else
+			this->writePLYThreaded(filenames[band], scene, band);
+	});
+
+	return bands.size() == filenames.size();
+}
+
 /// [Protected methods]
 
-bool LiDARPointCloud::writeBinary()
+void LiDARPointCloud::encodeLASChunk(const unsigned firstPoint, const unsigned lastPoint, const std::vector<float>& intensity, const float maxIntensity, const std::vector<SemanticRecord>& semanticRecord, const LASHeader& header, std::vector<char>& buffer, AABB& aabb, uint64_t* numPointsByReturn)
 {
-	return false;
+	buffer.resize(static_cast<size_t>(lastPoint - firstPoint) * sizeof(LASPointRecord));
+	LASPointRecord* record = reinterpret_cast<LASPointRecord*>(buffer.data());
+	const float intensityScale = maxIntensity > .0f ? 65535.0f / maxIntensity : .0f;
+
+	for (unsigned pointIdx = firstPoint; pointIdx < lastPoint; ++pointIdx, ++record)
+	{
+		const vec3 point = vec3(_points[pointIdx].x, -_points[pointIdx].z, _points[pointIdx].y);
+		const unsigned returnNumber = glm::clamp(static_cast<unsigned>(_returnNumber[pointIdx]) + 1, 1u, 15u);
+		const unsigned numReturns = glm::clamp(static_cast<unsigned>(_numReturns[pointIdx]), returnNumber, 15u);
+
+		record->_x = static_cast<int32_t>(std::llround((point.x - header._offset[0]) / header._scale[0]));
+		record->_y = static_cast<int32_t>(std::llround((point.y - header._offset[1]) / header._scale[1]));
+		record->_z = static_cast<int32_t>(std::llround((point.z - header._offset[2]) / header._scale[2]));
+		record->_intensity = static_cast<uint16_t>(glm::clamp(intensity[pointIdx] * intensityScale, .0f, 65535.0f));
+		record->_returns = static_cast<uint8_t>(returnNumber | (numReturns << 4));
+		record->_flags = 0;
+		record->_classification = semanticRecord[_modelComponent[pointIdx]]._asprsGroup;
+		record->_userData = semanticRecord[_modelComponent[pointIdx]]._group;
+		record->_scanAngle = static_cast<int16_t>(std::round(_scanAngleRank[pointIdx] / LAS_SCAN_ANGLE_STEP));
+		record->_pointSourceID = 0;
+		record->_gpsTime = _gpsTime[pointIdx];
+
+		aabb.update(point);
+		++numPointsByReturn[returnNumber - 1];
+	}
 }
 
-bool LiDARPointCloud::writePLYThreaded(const std::string& filename, Group3D* scene)
+void LiDARPointCloud::encodePLYChunk(const unsigned firstPoint, const unsigned lastPoint, const std::vector<float>& intensity, const std::vector<SemanticRecord>& semanticRecord, std::vector<char>& buffer)
 {
-	std::filebuf fileBufferBinary;
-	fileBufferBinary.open(filename, std::ios::out | std::ios::binary);
-	std::ostream outstreamBinary(&fileBufferBinary);
-	if (outstreamBinary.fail()) throw std::runtime_error("Failed to open " + filename + "...");
+	buffer.resize(static_cast<size_t>(lastPoint - firstPoint) * PLY_RECORD_SIZE);
+	char* record = buffer.data();
 
-	tinyply::PlyFile pointCloud;
+	auto append = [&record](const void* value, const size_t size) { std::memcpy(record, value, size); record += size; };
 
-	// Fill vectors
-	std::vector<vec3> position, normal, semanticGroupColor, asprsSemanticGroupColor, scanDirection;
-	std::vector<vec2> textureCoord;
-	std::vector<float> intensity, returnPercent, scanAngleRank;
-	std::vector<uvec2> returns;
-	std::vector<uint8_t> semanticGroups, asprsSemanticGroups;
+	for (unsigned pointIdx = firstPoint; pointIdx < lastPoint; ++pointIdx)
+	{
+		const SemanticRecord& semantic = semanticRecord[_modelComponent[pointIdx]];
+		const uint8_t returns[2] = { static_cast<uint8_t>(_returnNumber[pointIdx]), _numReturns[pointIdx] };
 
-	std::unordered_map<unsigned, int> modelSemanticGroup, modelASPRSGroup;
-	unsigned semanticGroup, asprsSemanticGroup;
-	unsigned modelComponentID;
-	const unsigned numPoints = this->getNumPoints();
+		append(&_points[pointIdx], sizeof(vec3));
+		append(&_normal[pointIdx], sizeof(vec3));
+		append(&_textCoord[pointIdx], sizeof(vec2));
+		append(&intensity[pointIdx], sizeof(float));
+		append(&_scanAngleRank[pointIdx], sizeof(float));
+		append(&_scanDirection[pointIdx], sizeof(vec3));
+		append(returns, sizeof(returns));
+		append(&_returnPercent[pointIdx], sizeof(float));
+		append(&semantic._group, sizeof(uint8_t));
+		append(&semantic._asprsGroup, sizeof(uint8_t));
+		append(&semantic._groupColor, sizeof(vec3));
+		append(&semantic._asprsColor, sizeof(vec3));
+	}
+}
+
+LiDARPointCloud::LASHeader LiDARPointCloud::getLASHeader()
+{
+	LASHeader header;
+	std::memset(&header, 0, sizeof(LASHeader));
 
-	// Reserve space to avoid asking to avoid allocating more than once
-	position.reserve(numPoints);
-	normal.reserve(numPoints);
-	semanticGroupColor.reserve(numPoints);
-	asprsSemanticGroupColor.reserve(numPoints);
-	semanticGroups.reserve(numPoints);
-	asprsSemanticGroups.reserve(numPoints);
-	textureCoord.reserve(numPoints);
-	intensity.reserve(numPoints);
-	returnPercent.reserve(numPoints);
-	returns.reserve(numPoints);
-	scanDirection.reserve(numPoints);
-	scanAngleRank.reserve(numPoints);
-
-	for (int pointIdx = 0; pointIdx < numPoints; ++pointIdx)
-	{
-		modelComponentID = _modelComponent[pointIdx];
-		semanticGroup = scene->getModelComponent(modelComponentID)->_semanticGroup;
-		asprsSemanticGroup = scene->getModelComponent(modelComponentID)->_asprsSemanticGroup;
+	std::memcpy(header._fileSignature, "LASF", 4);
+	std::strncpy(header._systemIdentifier, "SIMULATION", sizeof(header._systemIdentifier));
+	std::strncpy(header._generatingSoftware, "LiDAR_BRDF", sizeof(header._generatingSoftware));
 
-		if (semanticGroup < 0)
+	const std::time_t currentTime = std::time(nullptr);
+	std::tm localTime;
+	localtime_s(&localTime, &currentTime);
+
+	header._globalEncoding			= 1 << 4;				// WKT, as required by point data format 6; the WKT record follows the header
+	header._versionMajor			= 1;
+	header._versionMinor			= 4;
+	header._creationDay				= static_cast<uint16_t>(localTime.tm_yday + 1);
+	header._creationYear			= static_cast<uint16_t>(localTime.tm_year + 1900);
+	header._headerSize				= sizeof(LASHeader);
+	header._pointDataOffset			= static_cast<uint32_t>(sizeof(LASHeader) + sizeof(LASVLRHeader) + LAS_WKT.size() + 1);
+	header._numVLRs					= 1;
+	header._pointDataFormat			= 6;
+	header._pointDataRecordLength	= sizeof(LASPointRecord);
+	header._numPoints				= this->getNumPoints();
+
+	// Finest decimal scale whose quantized coordinates fit into 32 bits
+	if (header._numPoints)
+	{
+		const vec3 minPoint = vec3(_aabb.min().x, -_aabb.max().z, _aabb.min().y), maxPoint = vec3(_aabb.max().x, -_aabb.min().z, _aabb.max().y);
+
+		for (int axis = 0; axis < 3; ++axis)
 		{
-			auto it = modelSemanticGroup.find(semanticGroup);
+			header._offset[axis] = std::floor(minPoint[axis]);
+			header._scale[axis] = LAS_MIN_SCALE;
 
-			if (it != modelSemanticGroup.end())
+			while ((maxPoint[axis] - header._offset[axis]) / header._scale[axis] > static_cast<double>(std::numeric_limits<int32_t>::max()))
 			{
-				semanticGroup = modelSemanticGroup[modelComponentID];
+				header._scale[axis] *= 10.0;
 			}
-			else
-			{
-				bool found = false;
-				int semanticGroup_x = -1;
+		}
+	}
+	else
+	{
+		header._scale[0] = header._scale[1] = header._scale[2] = LAS_MIN_SCALE;
+	}
 
-				scene->getSemanticGroup(modelComponentID, semanticGroup_x, found);
-				modelSemanticGroup[modelComponentID] = semanticGroup = semanticGroup_x;
-			}
+	return header;
+}
+
+std::vector<LiDARPointCloud::SemanticRecord> LiDARPointCloud::getSemanticRecords(Group3D* scene)
+{
+	std::vector<Model3D::ModelComponent*>* modelComponent = scene->getRegisteredModelComponents();
+	std::vector<SemanticRecord> semanticRecord(modelComponent->size());
+
+	for (unsigned modelCompID = 0; modelCompID < modelComponent->size(); ++modelCompID)
+	{
+		int semanticGroup = modelComponent->at(modelCompID)->_semanticGroup, asprsSemanticGroup = modelComponent->at(modelCompID)->_asprsSemanticGroup;
+		bool found;
+
+		// Components without group inherit it from their hierarchy
+		if (semanticGroup < 0)
+		{
+			found = false;
+			scene->getSemanticGroup(modelCompID, semanticGroup, found);
 		}
 
 		if (asprsSemanticGroup < 0)
 		{
-			auto it = modelASPRSGroup.find(asprsSemanticGroup);
+			found = false;
+			scene->getASPRSSemanticGroup(modelCompID, asprsSemanticGroup, found);
+		}
+
+		semanticRecord[modelCompID]._group = static_cast<uint8_t>(semanticGroup);
+		semanticRecord[modelCompID]._asprsGroup = static_cast<uint8_t>(asprsSemanticGroup);
+		semanticRecord[modelCompID]._groupColor = semanticGroup >= 0 ? scene->getSemanticColor(semanticGroup) : vec3(.0f);
+		semanticRecord[modelCompID]._asprsColor = asprsSemanticGroup >= 0 ? scene->getASPRSColor(asprsSemanticGroup) : vec3(.0f);
+	}
+
+	return semanticRecord;
+}
+
+bool LiDARPointCloud::writeBinary()
+{
+	return false;
+}
+
+void LiDARPointCloud::writeChunks(std::ostream& outstream, const unsigned numPoints, const ChunkEncoder& encodeChunk)
+{
+	const unsigned numChunks = (numPoints + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	const unsigned windowSize = glm::max(std::thread::hardware_concurrency(), 1u);
+
+	// Two windows of chunks, so that a window is encoded while the previous one is being written
+	std::vector<std::vector<char>> chunk[2] = { std::vector<std::vector<char>>(windowSize), std::vector<std::vector<char>>(windowSize) };
+	std::future<void> pendingWrite;
+	unsigned window = 0;
+
+	for (unsigned firstChunk = 0; firstChunk < numChunks; firstChunk += windowSize, window = 1 - window)
+	{
+		const int numWindowChunks = static_cast<int>(glm::min(windowSize, numChunks - firstChunk));
+		std::vector<std::vector<char>>& windowChunk = chunk[window];
+
+		#pragma omp parallel for
+		for (int chunkIdx = 0; chunkIdx < numWindowChunks; ++chunkIdx)
+		{
+			const unsigned firstPoint = (firstChunk + chunkIdx) * CHUNK_SIZE;
+			encodeChunk(firstChunk + chunkIdx, firstPoint, glm::min(firstPoint + CHUNK_SIZE, numPoints), windowChunk[chunkIdx]);
+		}
+
+		if (pendingWrite.valid()) pendingWrite.get();
 
-			if (it != modelASPRSGroup.end())
+		pendingWrite = std::async(std::launch::async, [&outstream, &windowChunk, numWindowChunks]()
+		{
+			for (int chunkIdx = 0; chunkIdx < numWindowChunks; ++chunkIdx)
 			{
-				asprsSemanticGroup = modelASPRSGroup[modelComponentID];
+				outstream.write(windowChunk[chunkIdx].data(), windowChunk[chunkIdx].size());
 			}
-			else
-			{
-				bool found = false;
-				int semanticGroup_y = -1;
+		});
+	}
 
-				scene->getASPRSSemanticGroup(modelComponentID, semanticGroup_y, found);
-				modelASPRSGroup[modelComponentID] = asprsSemanticGroup = semanticGroup_y;
-			}
+	if (pendingWrite.valid()) pendingWrite.get();
+}
+
+bool LiDARPointCloud::writeLASThreaded(const std::string& filename, Group3D* scene, int band)
+{
+	std::ofstream outstream(filename, std::ios::out | std::ios::binary);
+	if (outstream.fail()) throw std::runtime_error("Failed to open " + filename + "...");
+
+	const unsigned numPoints = this->getNumPoints();
+	const unsigned numChunks = (numPoints + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	const std::vector<float>& pointIntensity = band >= 0 ? _spectralIntensity[band] : _intensity;
+	const std::vector<SemanticRecord> semanticRecord = this->getSemanticRecords(scene);
+	const float maxIntensity = numPoints ? *std::max_element(std::execution::par, pointIntensity.begin(), pointIntensity.end()) : .0f;
+
+	LASHeader header = this->getLASHeader();
+	std::vector<AABB> chunkAABB(numChunks);
+	std::vector<std::vector<uint64_t>> chunkReturns(numChunks, std::vector<uint64_t>(15, 0));
+
+	// Bounding box and number of points by return are only known once the records are encoded, hence the header is written again at the end
+	outstream.write(reinterpret_cast<const char*>(&header), sizeof(LASHeader));
+
+	// Coordinate system record, announced by the WKT bit of the global encoding
+	LASVLRHeader wktRecord;
+	std::memset(&wktRecord, 0, sizeof(LASVLRHeader));
+	std::strncpy(wktRecord._userID, "LASF_Projection", sizeof(wktRecord._userID));
+	std::strncpy(wktRecord._description, "OGC WKT Coordinate System", sizeof(wktRecord._description));
+	wktRecord._recordID = 2112;
+	wktRecord._recordLength = static_cast<uint16_t>(LAS_WKT.size() + 1);
+
+	outstream.write(reinterpret_cast<const char*>(&wktRecord), sizeof(LASVLRHeader));
+	outstream.write(LAS_WKT.c_str(), LAS_WKT.size() + 1);
+
+	this->writeChunks(outstream, numPoints, [&](const unsigned chunkIdx, const unsigned firstPoint, const unsigned lastPoint, std::vector<char>& buffer)
+	{
+		this->encodeLASChunk(firstPoint, lastPoint, pointIntensity, maxIntensity, semanticRecord, header, buffer, chunkAABB[chunkIdx], chunkReturns[chunkIdx].data());
+	});
+
+	AABB aabb;
+	for (unsigned chunkIdx = 0; chunkIdx < numChunks; ++chunkIdx)
+	{
+		aabb.update(chunkAABB[chunkIdx]);
+
+		for (int returnIdx = 0; returnIdx < 15; ++returnIdx)
+		{
+			header._numPointsByReturn[returnIdx] += chunkReturns[chunkIdx][returnIdx];
 		}
+	}
 
-		position.push_back(_points[pointIdx]);
-		normal.push_back(_normal[pointIdx]);
-		textureCoord.push_back(_textCoord[pointIdx]);
-		intensity.push_back(_intensity[pointIdx]);
-		returns.push_back(uvec2(_returnNumber[pointIdx], unsigned(_returnNumber[pointIdx] * _returnPercent[pointIdx])));
-		returnPercent.push_back(_returnPercent[pointIdx]);
-		semanticGroups.push_back(semanticGroup);
-		asprsSemanticGroups.push_back(asprsSemanticGroup);
-		semanticGroupColor.push_back(scene->getSemanticColor(semanticGroup));
-		asprsSemanticGroupColor.push_back(scene->getASPRSColor(asprsSemanticGroup));
-		scanAngleRank.push_back(_scanAngleRank[pointIdx]);
-		scanDirection.push_back(_scanDirection[pointIdx]);
+	if (numPoints)
+	{
+		header._minX = aabb.min().x; header._minY = aabb.min().y; header._minZ = aabb.min().z;
+		header._maxX = aabb.max().x; header._maxY = aabb.max().y; header._maxZ = aabb.max().z;
 	}
 
-	pointCloud.add_properties_to_element("LiDAR", { "x", "y", "z" }, tinyply::Type::FLOAT32, position.size(), reinterpret_cast<uint8_t*>(position.data()), tinyply::Type::INVALID, 0);
-	pointCloud.add_properties_to_element("LiDAR", { "nx", "ny", "nz" }, tinyply::Type::FLOAT32, normal.size(), reinterpret_cast<uint8_t*>(normal.data()), tinyply::Type::INVALID, 0);
-	pointCloud.add_properties_to_element("LiDAR", { "u", "v" }, tinyply::Type::FLOAT32, textureCoord.size(), reinterpret_cast<uint8_t*>(textureCoord.data()), tinyply::Type::INVALID, 0);
-	pointCloud.add_properties_to_element("LiDAR", { "intensity" }, tinyply::Type::FLOAT32, intensity.size(), reinterpret_cast<uint8_t*>(intensity.data()), tinyply::Type::INVALID, 0);
-	pointCloud.add_properties_to_element("LiDAR", { "scan_rank" }, tinyply::Type::FLOAT32, scanAngleRank.size(), reinterpret_cast<uint8_t*>(scanAngleRank.data()), tinyply::Type::INVALID, 0);
-	pointCloud.add_properties_to_element("LiDAR", { "scan_direction_x", "scan_direction_y", "scan_direction_z" }, tinyply::Type::FLOAT32, scanDirection.size(), reinterpret_cast<uint8_t*>(scanDirection.data()), tinyply::Type::INVALID, 0);
-	pointCloud.add_properties_to_element("LiDAR", { "returnNumber", "numReturns" }, tinyply::Type::UINT8, returns.size(), reinterpret_cast<uint8_t*>(returns.data()), tinyply::Type::INVALID, 0);
-	pointCloud.add_properties_to_element("LiDAR", { "returnPercent" }, tinyply::Type::FLOAT32, returnPercent.size(), reinterpret_cast<uint8_t*>(returnPercent.data()), tinyply::Type::INVALID, 0);
-	pointCloud.add_properties_to_element("LiDAR", { "semanticGroup" }, tinyply::Type::UINT8, semanticGroups.size(), reinterpret_cast<uint8_t*>(semanticGroups.data()), tinyply::Type::INVALID, 0);
-	pointCloud.add_properties_to_element("LiDAR", { "asprsSemanticGroup" }, tinyply::Type::UINT8, asprsSemanticGroups.size(), reinterpret_cast<uint8_t*>(asprsSemanticGroups.data()), tinyply::Type::INVALID, 0);
-	pointCloud.add_properties_to_element("LiDAR", { "semanticGroup_red", "semanticGroup_green", "semanticGroup_blue" }, tinyply::Type::FLOAT32, semanticGroupColor.size(), reinterpret_cast<uint8_t*>(semanticGroupColor.data()), tinyply::Type::INVALID, 0);
-	pointCloud.add_properties_to_element("LiDAR", { "asprsSemanticGroup_red", "asprsSemanticGroup_green", "asprsSemanticGroup_blue" }, tinyply::Type::FLOAT32, asprsSemanticGroupColor.size(), reinterpret_cast<uint8_t*>(asprsSemanticGroupColor.data()), tinyply::Type::INVALID, 0);
-
-	// Write a binary file
-	pointCloud.write(outstreamBinary, true);
+	outstream.seekp(0);
+	outstream.write(reinterpret_cast<const char*>(&header), sizeof(LASHeader));
 
-	return true;
+	return !outstream.fail();
 }
+
+bool LiDARPointCloud::writePLYThreaded(const std::string& filename, Group3D* scene, int band)
+{
+	std::ofstream outstream(filename, std::ios::out | std::ios::binary);
+	if (outstream.fail()) throw std::runtime_error("Failed to open " + filename + "...");
+
+	const unsigned numPoints = this->getNumPoints();
+	const std::vector<float>& pointIntensity = band >= 0 ? _spectralIntensity[band] : _intensity;
+	const std::vector<SemanticRecord> semanticRecord = this->getSemanticRecords(scene);
+
+	outstream << "ply\nformat binary_little_endian 1.0\nelement LiDAR " << numPoints << "\n";
+	for (const std::string& property : PLY_PROPERTY) outstream << "property " << property << "\n";
+	outstream << "end_header\n";
+
+	this->writeChunks(outstream, numPoints, [&](const unsigned chunkIdx, const unsigned firstPoint, const unsigned lastPoint, std::vector<char>& buffer)
+	{
+		this->encodePLYChunk(firstPoint, lastPoint, pointIntensity, semanticRecord, buffer);
+	});
+
+	return !outstream.fail();
+}
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Geometry/3D/AABB.h"
+#include "Graphics/Application/PointCloudParameters.h"
 #include "Graphics/Core/Model3D.h"
 #include "Utilities/FileManagement.h"
 
@@ -22,6 +23,91 @@ class LiDARPointCloud
 protected:
 	friend class DrawLiDARPointCloud;
 
+	/**
+	*	@brief Semantic attributes shared by every point of a model component.
+	*/
+	struct SemanticRecord
+	{
+		uint8_t				_group;						//!< Semantic group
+		uint8_t				_asprsGroup;				//!< ASPRS class
+		vec3				_groupColor;				//!< Color of the semantic group
+		vec3				_asprsColor;				//!< Color of the ASPRS class
+	};
+
+#pragma pack(push, 1)
+	/**
+	*	@brief Public header block of a LAS 1.4 file, without variable length records.
+	*/
+	struct LASHeader
+	{
+		char				_fileSignature[4];			//!< LASF
+		uint16_t			_fileSourceID;				//!<
+		uint16_t			_globalEncoding;			//!< Bit 4 (WKT) is required for point data formats over 5
+		uint8_t				_projectID[16];				//!< GUID
+		uint8_t				_versionMajor;				//!<
+		uint8_t				_versionMinor;				//!<
+		char				_systemIdentifier[32];		//!<
+		char				_generatingSoftware[32];	//!<
+		uint16_t			_creationDay;				//!< Day of year
+		uint16_t			_creationYear;				//!<
+		uint16_t			_headerSize;				//!<
+		uint32_t			_pointDataOffset;			//!<
+		uint32_t			_numVLRs;					//!<
+		uint8_t				_pointDataFormat;			//!<
+		uint16_t			_pointDataRecordLength;		//!<
+		uint32_t			_legacyNumPoints;			//!< Zero for point data formats over 5
+		uint32_t			_legacyNumPointsByReturn[5];//!< Zero for point data formats over 5
+		double				_scale[3];					//!< Quantization step of coordinates
+		double				_offset[3];					//!< Origin of quantized coordinates
+		double				_maxX, _minX;				//!<
+		double				_maxY, _minY;				//!<
+		double				_maxZ, _minZ;				//!<
+		uint64_t			_waveformDataOffset;		//!<
+		uint64_t			_firstEVLROffset;			//!<
+		uint32_t			_numEVLRs;					//!<
+		uint64_t			_numPoints;					//!<
+		uint64_t			_numPointsByReturn[15];		//!<
+	};
+
+	/**
+	*	@brief Header of a variable length record, followed by _recordLength bytes of payload.
+	*/
+	struct LASVLRHeader
+	{
+		uint16_t			_reserved;					//!<
+		char				_userID[16];				//!< LASF_Projection for coordinate system records
+		uint16_t			_recordID;					//!< 2112 for OGC WKT coordinate system
+		uint16_t			_recordLength;				//!< Bytes after this header
+		char				_description[32];			//!<
+	};
+
+	/**
+	*	@brief LAS point data record format 6.
+	*/
+	struct LASPointRecord
+	{
+		int32_t				_x, _y, _z;					//!< Quantized coordinates
+		uint16_t			_intensity;					//!< Intensity normalized to the maximum of the point cloud
+		uint8_t				_returns;					//!< Return number (bits 0-3) and number of returns (bits 4-7)
+		uint8_t				_flags;						//!< Classification flags, scanner channel, scan direction and edge of flight line
+		uint8_t				_classification;			//!< ASPRS class
+		uint8_t				_userData;					//!< Semantic group
+		int16_t				_scanAngle;					//!< Increments of 0.006 degrees
+		uint16_t			_pointSourceID;				//!<
+		double				_gpsTime;					//!<
+	};
+#pragma pack(pop)
+
+	typedef std::function<void(const unsigned chunkIdx, const unsigned firstPoint, const unsigned lastPoint, std::vector<char>& buffer)> ChunkEncoder;
+
+protected:
+	const static unsigned					CHUNK_SIZE;				//!< Number of points encoded by a single thread
+	const static double						LAS_SCAN_ANGLE_STEP;	//!< Degrees of a scan angle increment
+	const static double						LAS_MIN_SCALE;			//!< Finest quantization of LAS coordinates
+	const static std::string				LAS_WKT;				//!< Local coordinate system of the simulated scene, in OGC WKT
+	const static std::vector<std::string>	PLY_PROPERTY;			//!< Type and name of every property of a PLY record, in order
+	const static unsigned					PLY_RECORD_SIZE;		//!< Size of a binary PLY record in bytes
+
 protected:
 	std::vector<vec4>		_points;					//!< 3D space
 	unsigned				_numPoints;					//!< 
@@ -32,8 +118,10 @@ protected:
 	std::vector<GLuint>		_modelComponent;			//!< 	
 	std::vector<float>		_returnNumber;				//!< 
 	std::vector<float>		_returnPercent;				//!< 
+	std::vector<uint8_t>	_numReturns;				//!< Number of returns of the pulse each point belongs to
 	std::vector<float>		_intensity;					//!<
 	IntensityClass			_intensityClass;			//!<
+	std::vector<std::vector<float>> _spectralIntensity;	//!< Intensity of every point for each band of a spectral batch
 	std::vector<float>		_scanAngleRank;				//!< 
 	std::vector<vec3>		_scanDirection;				//!<
 	std::vector<float>		_gpsTime;					//!< 
@@ -42,16 +130,54 @@ protected:
 	// [Metadata]
 	AABB					_aabb;						//!< Boundaries
 
+	// [Rendering]
+	VAO*					_capturedPointsVAO;			//!< Points captured since the simulation was cleared, shared by every model component
+	unsigned				_numCapturedPoints;			//!< Points already uploaded to _capturedPointsVAO. Not reset when archiving
+
 protected:
+	/**
+	*	@brief Encodes the LAS records of points in [firstPoint, lastPoint).
+	*	@param aabb Bounding box of the encoded coordinates.
+	*	@param numPointsByReturn Number of encoded points for each return number.
+	*/
+	void encodeLASChunk(const unsigned firstPoint, const unsigned lastPoint, const std::vector<float>& intensity, const float maxIntensity, const std::vector<SemanticRecord>& semanticRecord, const LASHeader& header, std::vector<char>& buffer, AABB& aabb, uint64_t* numPointsByReturn);
+
+	/**
+	*	@brief Encodes the interleaved binary PLY records of points in [firstPoint, lastPoint).
+	*/
+	void encodePLYChunk(const unsigned firstPoint, const unsigned lastPoint, const std::vector<float>& intensity, const std::vector<SemanticRecord>& semanticRecord, std::vector<char>& buffer);
+
+	/**
+	*	@return Semantic attributes of every registered model component, so that they are not resolved once per point.
+	*/
+	std::vector<SemanticRecord> getSemanticRecords(Group3D* scene);
+
+	/**
+	*	@return Header of a LAS file for this point cloud. Coordinates are quantized with a scale and offset derived from its AABB.
+	*/
+	LASHeader getLASHeader();
+
 	/**
 	*	@brief 
 	*/
 	bool writeBinary();
 
 	/**
-	* 
+	*	@brief Writes the points in fixed-size chunks. A window of chunks is encoded in parallel while the previous one is written, so chunks keep their order.
 	*/
-	bool writePLYThreaded(const std::string& filename, Group3D* scene);
+	void writeChunks(std::ostream& outstream, const unsigned numPoints, const ChunkEncoder& encodeChunk);
+
+	/**
+	*	@brief Streams a LAS 1.4 file with point data format 6. Y-up coordinates of the scene are written as Z-up, i.e. (x, -z, y).
+	*	@param band Spectral band whose intensity is written. Otherwise, the intensity of the simulated wavelength is used.
+	*/
+	bool writeLASThreaded(const std::string& filename, Group3D* scene, int band = -1);
+
+	/**
+	*	@brief Streams a binary PLY file. Fixed-size chunks of records are encoded in parallel and written in order, hence memory overhead does not depend on the number of points.
+	*	@param band Spectral band whose intensity is written. Otherwise, the intensity of the simulated wavelength is used.
+	*/
+	bool writePLYThreaded(const std::string& filename, Group3D* scene, int band = -1);
 
 public:
 	/**
@@ -69,16 +195,55 @@ public:
 	*/
 	bool archive();
 
+	/**
+	*	@brief Uploads the points pushed after firstPoint, which are appended to the shared VAO. Their indices are grouped by model component, and each component receives the range of the shared IBO which belongs to it.
+	*/
+	void appendCapturedPoints(const unsigned firstPoint, std::vector<Model3D::ModelComponent*>* modelComponents);
+
+	/**
+	*	@brief Discards the uploaded points. GPU buffers are kept to be reused by next simulations.
+	*/
+	void clearCapturedPoints() { _numCapturedPoints = 0; }
+
 	/**
 	*	@brief  
 	*/
 	void pushCollisions(std::vector<Model3D::TriangleCollisionGPUData>& collisions, std::vector<Model3D::ModelComponent*>* modelComponents);
 
+	/**
+	*	@brief Appends the intensity of the last pushed points for every spectral band.
+	*	@param intensity Band-major intensities, i.e. numPoints values for each band.
+	*/
+	void pushSpectralIntensity(const std::vector<float>& intensity, const unsigned numPoints);
+
+	/**
+	*	@brief Clears the spectral intensities and prepares the storage of a new spectral batch.
+	*/
+	void setNumSpectralBands(const unsigned numBands) { _spectralIntensity.clear(); _spectralIntensity.resize(numBands); }
+
+	/**
+	*	@brief Writes the point cloud in the given format.
+	*	@param format One of PointCloudParameters::PointCloudFormat.
+	*/
+	bool write(const std::string& filename, Group3D* scene, const int format, bool asynchronous = true);
+
+	/**
+	*	@brief Writes a LAS 1.4 file.
+	*/
+	bool writeLAS(const std::string& filename, Group3D* scene, bool asynchronous = true);
+
 	/**
 	*	@brief  
 	*/
 	bool writePLY(const std::string& filename, Group3D* scene, bool asynchronous = true);
 
+	/**
+	*	@brief Writes one point cloud per spectral band in parallel. Bands only differ in the intensity of their points.
+	*	@param filenames Path of each band.
+	*	@param format One of PointCloudParameters::PointCloudFormat.
+	*/
+	bool writeSpectral(const std::vector<std::string>& filenames, Group3D* scene, const int format);
+
 	// ----------- Getters -------------
 
 	/**
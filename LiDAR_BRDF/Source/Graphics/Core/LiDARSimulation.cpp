@@ -1,6 +1,8 @@
 #include "stdafx.h"
 #include "LiDARSimulation.h"
 
+#include <future>
+
 #include "Geometry/3D/Intersections3D.h"
 #include "Geometry/Animation/CatmullRom.h"
 #include "Graphics/Application/Renderer.h"
@@ -20,7 +22,7 @@ LiDARParameters				LiDARSimulation::LIDAR_PARAMS;
 PointCloudParameters		LiDARSimulation::POINT_CLOUD_PARAMS;
 
 const float					LiDARSimulation::NOISE_TEXTURE_FREQUENCY = 10.0f;
-const unsigned				LiDARSimulation::NOISE_TEXTURE_SIZE = 5e6;
+const GLuint64				LiDARSimulation::RAY_FENCE_TIMEOUT = 1000000000;
 const GLuint				LiDARSimulation::RAY_MEMORY_BOUNDARY = 10e6;
 const float					LiDARSimulation::RAY_OVERFLOW = 10000.0f;
 const GLuint				LiDARSimulation::SHADER_UINT_MAX = 0xFFFFFFF;
@@ -30,11 +32,12 @@ const RayBuilderApplicators LiDARSimulation::RAY_BUILDER_APPLICATOR = LiDARSimul
 /// [Public methods]
 
 LiDARSimulation::LiDARSimulation(Group3D* scene) :
-	_scene(scene), _LiDARRaysVAO(nullptr), _numRays(0),
+	_scene(scene), _cpuSolver(nullptr), _LiDARRaysVAO(nullptr), _numRays(0),
 	_emptyModelComponent(nullptr), _groupGPUData(nullptr), _hermiteSSBO(-1),
-	_LiDARMaterialsSSBO(-1), _returnThresholdSSBO(-1), _whiteNoiseSSBO(-1),
+	_LiDARMaterialsSSBO(-1), _returnThresholdSSBO(-1),
 	_brdfSSBO(-1), _collisionSSBO(-1), _counterSSBO(-1), _newCounterSSBO(-1), 
-	_triangleCollisionSSBO(-1)
+	_nodeVisitSSBO(-1), _rayHitsSSBO(-1), _spectralIntensitySSBO(-1), _triangleCollisionSSBO(-1),
+	_numSpectralBands(0), _spectralMaterialStride(0)
 {
 	Renderer* renderer = Renderer::getInstance();
 	
@@ -45,6 +48,7 @@ LiDARSimulation::LiDARSimulation(Group3D* scene) :
 
 LiDARSimulation::~LiDARSimulation()
 {
+	delete _cpuSolver;
 	delete _emptyModelComponent;
 	delete _LiDARRaysVAO;
 	delete _pointCloud;
@@ -54,7 +58,10 @@ void LiDARSimulation::launchSimulation(bool instantiateRaysVAO)
 {
 	if ((LIDAR_PARAMS._LiDARType == LiDARParameters::TERRESTRIAL_SPHERICAL && !LIDAR_PARAMS._tlsUseManualPath && _tlsPositions.empty()) || LIDAR_PARAMS._LiDARType != LiDARParameters::TERRESTRIAL_SPHERICAL)
 	{
-		this->launchSingleSimulation(instantiateRaysVAO);
+		if (LIDAR_PARAMS._spectralBatch && LIDAR_PARAMS._wavelength[0] < LIDAR_PARAMS._wavelength[1])
+			this->launchSpectralSimulation();
+		else
+			this->launchSingleSimulation(instantiateRaysVAO);
 	}
 	else
 	{
@@ -93,35 +100,13 @@ std::vector<std::unique_ptr<RayBuilder>> LiDARSimulation::getRayBuildApplicators
 
 void LiDARSimulation::appendLiDARData(std::vector<Model3D::TriangleCollisionGPUData>* collisions)
 {
-	Model3D::ModelComponent* modelComponent = nullptr;
-	
-	_pointCloud->pushCollisions(*collisions, _scene->getRegisteredModelComponents());				// Append results to previous LiDAR point clouds
-
-	for (Model3D::TriangleCollisionGPUData& collision : *collisions)
-	{
-		modelComponent = _scene->getModelComponent(collision._modelCompID);
-		modelComponent->pushBackCapturedPoints(&collision);
-		_modelCompMap.insert(modelComponent);
-	}
+	const unsigned firstPoint = _pointCloud->getNumPoints();
 
-	for (auto& modelIt : _modelCompMap)
-	{
-		modelIt->loadLiDARPoints();
-	}
-}
+	_pointCloud->pushCollisions(*collisions, _scene->getRegisteredModelComponents());				// Append results to previous LiDAR point clouds
 
-unsigned LiDARSimulation::buildWhiteNoiseTexture(const unsigned size)
-{
-	std::vector<float> noiseOutput(size);
-	const unsigned seed	= rand();
-	RandomUtilities::initializeUniformDistribution(.0f, 1.0f);
-	
-	for (unsigned index = 0; index < noiseOutput.size(); ++index)
-	{
-		noiseOutput[index] = RandomUtilities::getUniformRandomValue();
-	}
+	if (Model3D::HEADLESS) return;																	// Points per model component are only needed for rendering
 
-	return ComputeShader::setReadBuffer(noiseOutput, GL_STATIC_DRAW);
+	_pointCloud->appendCapturedPoints(firstPoint, _scene->getRegisteredModelComponents());			// Only the new points are uploaded
 }
 
 void LiDARSimulation::defineSceneUniforms(ComputeShader* LiDARShader)
@@ -215,6 +200,7 @@ void LiDARSimulation::launchMultipleSimulations(std::vector<vec3>& positions)
 	long long rayBuildTime = 0;
 	AABB aabb = _scene->getAABB();
 	GLuint raySSBO, numRays, totalRays = 0;
+	std::vector<Model3D::RayGPUData> rays;										// Only built by the CPU backend
 	std::vector<Model3D::TriangleCollisionGPUData> collisions;
 
 	// Initialize variables and buffers
@@ -227,6 +213,7 @@ void LiDARSimulation::launchMultipleSimulations(std::vector<vec3>& positions)
 	for (int idx = 0; idx < positions.size(); ++idx)
 	{
 		PipelineMetrics localMetrics;
+		localMetrics.setOpenGLSync(!_cpuSolver);
 		LIDAR_PARAMS._tlsPosition = positions[idx];
 		LIDAR_PARAMS._tlsDirection = vec3(.0f);
 		if (idx < positions.size() - 1)
@@ -244,15 +231,31 @@ void LiDARSimulation::launchMultipleSimulations(std::vector<vec3>& positions)
 			{
 				localMetrics.initChrono();
 
-				RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->buildRays(&LIDAR_PARAMS, aabb);
-				glFinish();
+				if (_cpuSolver)
+				{
+					RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->buildRaysCPU(&LIDAR_PARAMS, rays);
+				}
+				else
+				{
+					RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->buildRays(&LIDAR_PARAMS, aabb);
+					glFinish();
+				}
 
 				localMetrics.measureStage(PipelineMetrics::RAY_BUILDING);
 			}
 
 			{
-				RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->getRaySSBO(raySSBO, numRays);
-				localMetrics.add(this->solveRayIntersection(raySSBO, numRays, collisions, true));
+				if (_cpuSolver)
+				{
+					numRays = static_cast<GLuint>(rays.size());
+					this->solveRayIntersectionCPU(rays, totalRays, collisions, true, true, nullptr, localMetrics);
+				}
+				else
+				{
+					RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->getRaySSBO(raySSBO, numRays);
+					localMetrics.add(this->solveRayIntersection(raySSBO, numRays, totalRays, collisions, true));
+				}
+
 				totalRays += numRays;
 
 				this->appendLiDARData(&collisions);
@@ -266,8 +269,8 @@ void LiDARSimulation::launchMultipleSimulations(std::vector<vec3>& positions)
 		std::cout << "Ray Building Time: " << localMetrics.getStageTime(PipelineMetrics::RAY_BUILDING) << " microseconds for " << totalRays << " rays." << std::endl;
 		std::cout << "LiDAR Response Time: " << localMetrics.getGlobalTime(PipelineMetrics::PREPARE) << " microseconds." << std::endl;
 
-		std::string wlStr = "Results/Paths/TLS/" + std::to_string(iteration) + ".ply";
-		_pointCloud->writePLY(wlStr, _scene, false);
+		std::string wlStr = "Results/Paths/TLS/" + std::to_string(iteration) + PointCloudParameters::PointCloudFormat_EXTENSION[POINT_CLOUD_PARAMS._format];
+		_pointCloud->write(wlStr, _scene, POINT_CLOUD_PARAMS._format, false);
 		_pointCloud->archive();
 	}
 
@@ -281,7 +284,7 @@ void LiDARSimulation::launchMultipleSimulations(std::vector<vec3>& positions)
 
 	if (POINT_CLOUD_PARAMS._savePointCloud)
 	{
-		_pointCloud->writePLY(std::string(POINT_CLOUD_PARAMS._filenameBuffer), _scene, true);
+		_pointCloud->write(POINT_CLOUD_PARAMS.getFilename(), _scene, POINT_CLOUD_PARAMS._format, true);
 	}
 }
 
@@ -289,14 +292,12 @@ void LiDARSimulation::launchSingleSimulation(bool instantiateRaysVAO)
 {
 	PipelineMetrics globalMetrics;
 	AABB aabb = _scene->getAABB();
-	GLuint raySSBO, numRays, totalRays = 0, numExecs = LIDAR_PARAMS._numExecs + int(LIDAR_PARAMS._discardFirstExecution), iteration = 0;
-	long long time = 0;
-	std::vector<Model3D::TriangleCollisionGPUData> collisions;
+	GLuint totalRays = 0, numExecs = LIDAR_PARAMS._numExecs + int(LIDAR_PARAMS._discardFirstExecution);
 
 	// Initialize variables and buffers
 	RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->initializeContext(&LIDAR_PARAMS, aabb);
 	this->prepareLiDARData(RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->getRayMaxCapacity());
-	glFinish();
+	if (!_cpuSolver) glFinish();
 
 	ChronoUtilities::getDuration();			// Clean chrono
 
@@ -309,36 +310,8 @@ void LiDARSimulation::launchSingleSimulation(bool instantiateRaysVAO)
 		{
 			if (execIdx > 0 || numExecs == 1)
 			{
-				totalRays = 0;
 				PipelineMetrics localMetrics;
-				RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->resetPendingRays(&LIDAR_PARAMS);
-
-				while (RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->arePendingRays())
-				{
-					collisions.clear();
-
-					{
-						localMetrics.initChrono();
-
-						RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->buildRays(&LIDAR_PARAMS, aabb);
-
-						localMetrics.measureStage(PipelineMetrics::RAY_BUILDING);
-					}
-
-					{
-						RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->getRaySSBO(raySSBO, numRays);
-						localMetrics.add(this->solveRayIntersection(raySSBO, numRays, collisions, wl, execIdx == 0));
-						totalRays += numRays;
-
-						this->appendLiDARData(&collisions);
-					}
-
-					//std::string wlStr = "Results/Paths/ALS/" + std::to_string(iteration) + ".ply";
-					//_pointCloud->writePLY(wlStr, _scene, false);
-					//_pointCloud->archive();
-
-					++iteration;
-				}
+				totalRays = this->simulatePendingBatches(aabb, wl, execIdx == 0, localMetrics);
 
 				globalMetrics.add(localMetrics);
 
@@ -347,16 +320,8 @@ void LiDARSimulation::launchSingleSimulation(bool instantiateRaysVAO)
 			}
 			else
 			{
-				RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->resetPendingRays(&LIDAR_PARAMS);
-
-				while (RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->arePendingRays())
-				{
-					RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->buildRays(&LIDAR_PARAMS, aabb);
-					RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->getRaySSBO(raySSBO, numRays);
-					this->solveRayIntersection(raySSBO, numRays, collisions, wl, true);
-
-					this->appendLiDARData(&collisions);
-				}
+				PipelineMetrics discardedMetrics;
+				this->simulatePendingBatches(aabb, wl, true, discardedMetrics);
 			}
 		}
 
@@ -366,38 +331,149 @@ void LiDARSimulation::launchSingleSimulation(bool instantiateRaysVAO)
 
 		if (POINT_CLOUD_PARAMS._savePointCloud)
 		{
-			std::string pointCloudStr = std::string(POINT_CLOUD_PARAMS._filenameBuffer);
-			const unsigned pointIndex = pointCloudStr.find(".");
+			const std::string suffix = LIDAR_PARAMS._wavelength[0] != LIDAR_PARAMS._wavelength[1] ? "_" + std::to_string(wl) : "";
+
+			_pointCloud->write(POINT_CLOUD_PARAMS.getFilename(suffix), _scene, POINT_CLOUD_PARAMS._format, false);
+		}
+
+		this->releaseMaterialData();
+	}
+
+	this->releaseLiDARData();
+	RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->freeContext();
+}
+
+void LiDARSimulation::launchSpectralSimulation()
+{
+	PipelineMetrics globalMetrics;
+	AABB aabb = _scene->getAABB();
+	GLuint raySSBO, numRays, totalRays = 0;
+	std::vector<Model3D::RayGPUData> rays;										// Only built by the CPU backend
+	std::vector<Model3D::TriangleCollisionGPUData> collisions;
+	std::vector<float> spectralIntensity;
+	std::vector<std::vector<int>> bandGroups(1);
+
+	// Geometry only depends on the wavelength through the bathymetric switch, hence a single trace is needed per regime
+	for (int wl = LIDAR_PARAMS._wavelength[0]; wl <= LIDAR_PARAMS._wavelength[1]; wl += 1)
+	{
+		if (wl == 533 && !bandGroups.back().empty() && LIDAR_PARAMS._LiDARType != LiDARParameters::TERRESTRIAL_SPHERICAL) bandGroups.emplace_back();
+
+		bandGroups.back().push_back(wl);
+	}
+
+	// Initialize variables and buffers
+	RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->initializeContext(&LIDAR_PARAMS, aabb);
+	this->prepareLiDARData(RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->getRayMaxCapacity());
+	if (!_cpuSolver) glFinish();
+
+	ChronoUtilities::getDuration();			// Clean chrono
+
+	for (const std::vector<int>& bands : bandGroups)
+	{
+		PipelineMetrics localMetrics;
+		localMetrics.setOpenGLSync(!_cpuSolver);
+
+		this->prepareSpectralMaterialData(bands);
+		_pointCloud->archive();
+		_pointCloud->setNumSpectralBands(static_cast<unsigned>(bands.size()));
+		RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->resetPendingRays(&LIDAR_PARAMS);
+
+		while (RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->arePendingRays())
+		{
+			collisions.clear();
 
-			if (pointIndex != std::string::npos)
 			{
-				pointCloudStr = pointCloudStr.substr(0, pointIndex);
+				localMetrics.initChrono();
+
+				if (_cpuSolver)
+				{
+					RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->buildRaysCPU(&LIDAR_PARAMS, rays);
+				}
+				else
+				{
+					RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->buildRays(&LIDAR_PARAMS, aabb);
+				}
+
+				localMetrics.measureStage(PipelineMetrics::RAY_BUILDING);
 			}
 
-			if (LIDAR_PARAMS._wavelength[0] != LIDAR_PARAMS._wavelength[1])
 			{
-				pointCloudStr += "_" + std::to_string(wl);
+				if (_cpuSolver)
+				{
+					numRays = static_cast<GLuint>(rays.size());
+					this->solveRayIntersectionCPU(rays, totalRays, collisions, bands.front(), true, &spectralIntensity, localMetrics);
+				}
+				else
+				{
+					RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->getRaySSBO(raySSBO, numRays);
+					localMetrics.add(this->solveRayIntersection(raySSBO, numRays, totalRays, collisions, bands.front(), true, &spectralIntensity));
+				}
+
+				totalRays += numRays;
+
+				this->appendLiDARData(&collisions);
+				_pointCloud->pushSpectralIntensity(spectralIntensity, static_cast<unsigned>(collisions.size()));
 			}
+		}
 
-			if (pointCloudStr.find(".") == std::string::npos)
-			{
-				pointCloudStr += ".ply";
+		globalMetrics.add(localMetrics);
+
+		std::cout << "Wavelengths: " << bands.front() << " - " << bands.back() << " nm" << std::endl;
+		std::cout << "Number of points: " << _pointCloud->getNumPoints() << std::endl;
 
+		if (POINT_CLOUD_PARAMS._savePointCloud)
+		{
+			std::vector<std::string> bandFilename;
+
+			for (const int wl : bands)
+			{
+				bandFilename.push_back(POINT_CLOUD_PARAMS.getFilename("_" + std::to_string(wl)));
 			}
 
-			_pointCloud->writePLY(pointCloudStr, _scene, false);
+			_pointCloud->writeSpectral(bandFilename, _scene, POINT_CLOUD_PARAMS._format);
 		}
 
 		this->releaseMaterialData();
 	}
 
+	std::cout << "Number of rays: " << totalRays << std::endl;
+	std::cout << globalMetrics << std::endl;
+
 	this->releaseLiDARData();
 	RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType]->freeContext();
 }
 
 void LiDARSimulation::prepareLiDARData(GLuint numRays)
 {
-	_whiteNoiseSSBO	= this->buildWhiteNoiseTexture(NOISE_TEXTURE_SIZE);
+	std::vector<float> hermiteCoefficients{
+		-LIDAR_PARAMS._hermiteT, 2.0f - LIDAR_PARAMS._hermiteT, LIDAR_PARAMS._hermiteT - 2.0f, LIDAR_PARAMS._hermiteT,
+		2.0f * LIDAR_PARAMS._hermiteT, LIDAR_PARAMS._hermiteT - 3.0f, 3.0f - 2.0f * LIDAR_PARAMS._hermiteT, -LIDAR_PARAMS._hermiteT,
+		-LIDAR_PARAMS._hermiteT, 0.0f, LIDAR_PARAMS._hermiteT, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f
+	};
+
+	if (LIDAR_PARAMS._backend != LiDARParameters::GPU_BACKEND)
+	{
+		Group3D::BVHLayout bvhLayout = LIDAR_PARAMS._backend == LiDARParameters::CPU_WIDE_BACKEND ? Group3D::WIDE_BVH :
+											 LIDAR_PARAMS._backend == LiDARParameters::CPU_COMPRESSED_BACKEND ? Group3D::COMPRESSED_BVH : Group3D::BINARY_BVH;
+
+		// Only the CPU solver decodes quantized nodes; compute shaders below always traverse full BVHCluster nodes
+		Group3D::StaticCPUData* groupData = _scene->getStaticCPUData(bvhLayout);
+
+		// Trees whose indices do not fit in compressed references keep the binary nodes
+		if (bvhLayout == Group3D::COMPRESSED_BVH && groupData->_compressedRoot.empty()) bvhLayout = Group3D::BINARY_BVH;
+
+		_cpuSolver = new LiDARCPUSolver();
+		_cpuSolver->setBVHLayout(bvhLayout);
+		_cpuSolver->setGroupData(groupData);
+		_cpuSolver->setHermiteTensor(hermiteCoefficients);
+		_cpuSolver->setSeed(unsigned(LIDAR_PARAMS._randomSeed));
+
+		return;
+	}
+
+	// Scene is uploaded here if it was built for a CPU backend
+	_groupGPUData = _scene->getStaticGPUData();
 
 	{
 		std::vector<float> returnThreshold(LIDAR_PARAMS.MAX_NUMBER_OF_RETURNS);
@@ -409,19 +485,17 @@ void LiDARSimulation::prepareLiDARData(GLuint numRays)
 		_returnThresholdSSBO = ComputeShader::setReadBuffer(returnThreshold, GL_STATIC_DRAW);
 	}
 
-	std::vector<float> hermiteCoefficients{
-		-LIDAR_PARAMS._hermiteT, 2.0f - LIDAR_PARAMS._hermiteT, LIDAR_PARAMS._hermiteT - 2.0f, LIDAR_PARAMS._hermiteT,
-		2.0f * LIDAR_PARAMS._hermiteT, LIDAR_PARAMS._hermiteT - 3.0f, 3.0f - 2.0f * LIDAR_PARAMS._hermiteT, -LIDAR_PARAMS._hermiteT,
-		-LIDAR_PARAMS._hermiteT, 0.0f, LIDAR_PARAMS._hermiteT, 0.0f,
-		0.0f, 1.0f, 0.0f, 0.0f
-	};
-
 	{
 		_triangleCollisionSSBO	= ComputeShader::setWriteBuffer(Model3D::TriangleCollisionGPUData(), numRays * LIDAR_PARAMS._maxReturns, GL_DYNAMIC_DRAW);
 		_collisionSSBO			= ComputeShader::setWriteBuffer(Model3D::TriangleCollisionGPUData(), numRays, GL_DYNAMIC_DRAW);
+		_rayHitsSSBO			= ComputeShader::setWriteBuffer(Model3D::RayHitGPUData(), numRays, GL_DYNAMIC_DRAW);
 		_hermiteSSBO			= ComputeShader::setReadBuffer(hermiteCoefficients, GL_STATIC_DRAW);
 		_counterSSBO			= ComputeShader::setWriteBuffer(GLuint(), 1, GL_DYNAMIC_DRAW);
 		_newCounterSSBO			= ComputeShader::setWriteBuffer(GLuint(), 1, GL_DYNAMIC_DRAW);
+		_nodeVisitSSBO			= ComputeShader::setWriteBuffer(GLuint(), 1, GL_DYNAMIC_DRAW);
+
+		if (LIDAR_PARAMS._spectralBatch)
+			_spectralIntensitySSBO = ComputeShader::setWriteBuffer(float(), numRays * LIDAR_PARAMS._maxReturns, GL_DYNAMIC_DRAW);
 	}
 }
 
@@ -432,27 +506,224 @@ void LiDARSimulation::prepareMaterialData(GLuint wavelength)
 
 	MaterialDatabase::getInstance()->getMaterialGPUArray(wavelength, materials, brdfData);
 
+	if (_cpuSolver)
+	{
+		_cpuSolver->setMaterialData(materials, brdfData);
+		return;
+	}
+
+	_LiDARMaterialsSSBO = ComputeShader::setReadBuffer(materials, GL_STATIC_DRAW);
+	_brdfSSBO = ComputeShader::setReadBuffer(brdfData, GL_STATIC_DRAW);
+}
+
+void LiDARSimulation::prepareSpectralMaterialData(const std::vector<int>& wavelengths)
+{
+	std::vector<float> brdfData;
+	std::vector<MaterialDatabase::LiDARMaterialGPUData> materials, bandMaterials;
+
+	// Refractive indices of the first band drive the ray geometry of the whole batch, whereas the BRDF of every band is appended after the previous one
+	MaterialDatabase::getInstance()->getMaterialGPUArray(wavelengths.front(), materials, brdfData);
+	brdfData.reserve(brdfData.size() * wavelengths.size());
+
+	for (size_t bandIdx = 1; bandIdx < wavelengths.size(); ++bandIdx)
+	{
+		MaterialDatabase::getInstance()->getMaterialGPUArray(wavelengths[bandIdx], bandMaterials, brdfData);
+	}
+
+	_numSpectralBands = static_cast<GLuint>(wavelengths.size());
+	_spectralMaterialStride = static_cast<GLuint>(materials.size());
+
+	if (_cpuSolver)
+	{
+		_cpuSolver->setMaterialData(materials, brdfData);
+		_cpuSolver->setSpectralBands(_numSpectralBands, _spectralMaterialStride);
+		return;
+	}
+
 	_LiDARMaterialsSSBO = ComputeShader::setReadBuffer(materials, GL_STATIC_DRAW);
 	_brdfSSBO = ComputeShader::setReadBuffer(brdfData, GL_STATIC_DRAW);
 }
 
 void LiDARSimulation::releaseLiDARData()
 {	
+	if (_cpuSolver)
+	{
+		delete _cpuSolver;
+		_cpuSolver = nullptr;
+
+		return;
+	}
+
 	glDeleteBuffers(1, &_returnThresholdSSBO);
-	glDeleteBuffers(1, &_whiteNoiseSSBO);
 	glDeleteBuffers(1, &_counterSSBO);
 	glDeleteBuffers(1, &_triangleCollisionSSBO);
 	glDeleteBuffers(1, &_collisionSSBO);
+	glDeleteBuffers(1, &_rayHitsSSBO);
+	glDeleteBuffers(1, &_nodeVisitSSBO);
+	if (LIDAR_PARAMS._spectralBatch) glDeleteBuffers(1, &_spectralIntensitySSBO);
 	glDeleteBuffers(1, &_hermiteSSBO);
 }
 
 void LiDARSimulation::releaseMaterialData()
 {
+	if (_cpuSolver) return;
+
 	glDeleteBuffers(1, &_brdfSSBO);
 	glDeleteBuffers(1, &_LiDARMaterialsSSBO);
 }
 
-PipelineMetrics LiDARSimulation::solveRayIntersection(GLuint raySSBO, GLuint numRays, std::vector<Model3D::TriangleCollisionGPUData>& collisions, int wl, bool readData)
+unsigned LiDARSimulation::simulatePendingBatches(AABB& aabb, int wl, bool readData, PipelineMetrics& pipelineMetrics)
+{
+	RayBuilder* rayBuilder = RAY_BUILDER_APPLICATOR[LIDAR_PARAMS._LiDARType].get();
+	std::vector<Model3D::RayGPUData> rays[2];									// Batches built in CPU, either by a CPU backend or with no GPU instancing
+	std::vector<Model3D::TriangleCollisionGPUData> collisions[2];				// A batch is solved while the previous one is ingested
+	std::future<void> building;													// Batch built in CPU by a worker thread
+	std::future<PipelineMetrics> intersection;									// Batch intersected by a worker thread (CPU backend)
+	std::future<long long> ingestion;											// Batch pushed into the point cloud by a worker thread
+	GLsync rayFence = nullptr;													// Signaled once compute shaders have written a batch of rays
+	GLuint raySSBO, numRays, totalRays = 0, batchIdx = 0, firstPoint = 0;
+	const auto startTime = std::chrono::high_resolution_clock::now();
+
+	// Waits for the ingestion in progress and uploads its points, which requires the OpenGL context of this thread
+	auto joinIngestion = [&]()
+		{
+			if (!ingestion.valid()) return;
+
+			pipelineMetrics.addStageTime(PipelineMetrics::INGESTION, ingestion.get());
+
+			if (!Model3D::HEADLESS)
+			{
+				pipelineMetrics.initChrono();
+				_pointCloud->appendCapturedPoints(firstPoint, _scene->getRegisteredModelComponents());
+				pipelineMetrics.measureStage(PipelineMetrics::INGESTION);
+			}
+		};
+
+	// Collisions of a batch are ingested while the next one is simulated. Only one ingestion is in flight, so the point cloud is never modified concurrently
+	auto ingestBatch = [&](std::vector<Model3D::TriangleCollisionGPUData>* batchCollisions)
+		{
+			joinIngestion();
+
+			if (!readData) return;
+
+			firstPoint = _pointCloud->getNumPoints();
+			ingestion = std::async(std::launch::async, [this, batchCollisions]() -> long long
+				{
+					const auto ingestionTime = std::chrono::high_resolution_clock::now();
+					_pointCloud->pushCollisions(*batchCollisions, _scene->getRegisteredModelComponents());
+
+					return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - ingestionTime).count();
+				});
+		};
+
+	// Starts building a batch of rays. Compute shaders write it into the back ray buffer of the GPU backend, whereas rays built in CPU are computed by a worker thread
+	auto buildBatch = [&](const unsigned bufferIdx)
+		{
+			if (!rayBuilder->arePendingRays()) return;
+
+			if (!_cpuSolver && LIDAR_PARAMS.isGPUInstantiated())
+			{
+				rayBuilder->buildRays(&LIDAR_PARAMS, aabb);
+				rayFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			}
+			else
+			{
+				building = std::async(std::launch::async, [rayBuilder, &rays, bufferIdx]()
+					{
+						rayBuilder->buildRaysCPU(&LIDAR_PARAMS, rays[bufferIdx]);
+					});
+			}
+		};
+
+	// Waits for the batch in progress. Its rays are then swapped into the front ray buffer of the GPU backend, so the pipeline is never finished to wait for them
+	auto waitBatch = [&](const unsigned bufferIdx)
+		{
+			pipelineMetrics.initChrono();
+
+			if (building.valid())
+			{
+				building.get();
+				numRays = static_cast<GLuint>(rays[bufferIdx].size());
+
+				if (!_cpuSolver) rayBuilder->uploadRays(rays[bufferIdx]);
+			}
+			else
+			{
+				while (glClientWaitSync(rayFence, GL_SYNC_FLUSH_COMMANDS_BIT, RAY_FENCE_TIMEOUT) == GL_TIMEOUT_EXPIRED);
+				glDeleteSync(rayFence);
+				rayFence = nullptr;
+			}
+
+			pipelineMetrics.measureStage(PipelineMetrics::RAY_BUILDING);
+
+			if (!_cpuSolver)
+			{
+				rayBuilder->getRaySSBO(raySSBO, numRays);
+				rayBuilder->swapRayBuffers();
+			}
+		};
+
+	pipelineMetrics.setOpenGLSync(false);							// Batches of rays are waited through their future or fence
+	rayBuilder->resetPendingRays(&LIDAR_PARAMS);
+	buildBatch(0);
+
+	while (building.valid() || rayFence)
+	{
+		const unsigned bufferIdx = batchIdx % 2;
+
+		// 1. Rays of this batch were built while the previous one was intersected and ingested
+		waitBatch(bufferIdx);
+
+		const GLuint rayOffset = totalRays;
+		totalRays += numRays;
+
+		// 2. Intersection, while the next batch is built into the other ray buffer
+		if (_cpuSolver)
+		{
+			if (intersection.valid())
+			{
+				pipelineMetrics.add(intersection.get());
+				ingestBatch(&collisions[1 - bufferIdx]);
+			}
+
+			collisions[bufferIdx].clear();						// Its ingestion was joined by ingestBatch
+			intersection = std::async(std::launch::async, [this, &rays, &collisions, bufferIdx, rayOffset, wl, readData]()
+				{
+					PipelineMetrics batchMetrics;
+					this->solveRayIntersectionCPU(rays[bufferIdx], rayOffset, collisions[bufferIdx], wl, readData, nullptr, batchMetrics);
+
+					return batchMetrics;
+				});
+
+			buildBatch(1 - bufferIdx);							// Rays of the previous batch were released once it was intersected
+		}
+		else
+		{
+			buildBatch(1 - bufferIdx);
+
+			collisions[bufferIdx].clear();						// Its ingestion was joined along with the previous batch
+			pipelineMetrics.add(this->solveRayIntersection(raySSBO, numRays, rayOffset, collisions[bufferIdx], wl, readData));
+			ingestBatch(&collisions[bufferIdx]);
+		}
+
+		++batchIdx;
+	}
+
+	// Drain the pipeline
+	if (intersection.valid())
+	{
+		pipelineMetrics.add(intersection.get());
+		ingestBatch(&collisions[1 - batchIdx % 2]);
+	}
+
+	joinIngestion();
+
+	pipelineMetrics.addWallTime(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - startTime).count());
+
+	return totalRays;
+}
+
+PipelineMetrics LiDARSimulation::solveRayIntersection(GLuint raySSBO, GLuint numRays, GLuint rayOffset, std::vector<Model3D::TriangleCollisionGPUData>& collisions, int wl, bool readData, std::vector<float>* spectralIntensity)
 {
 	PipelineMetrics		pipelineMetrics;
 
@@ -468,18 +739,23 @@ PipelineMetrics LiDARSimulation::solveRayIntersection(GLuint raySSBO, GLuint num
 	unsigned			previousCollisions		= 0;
 	unsigned			newCollisions			= 0;
 	unsigned			idReturn				= 0;
+	unsigned			nodeVisits				= 0;
 	unsigned			bathymetric				= unsigned(wl < 533) && lidarParams->_LiDARType != LiDARParameters::TERRESTRIAL_SPHERICAL;
-	const unsigned		clusterSize				= _groupGPUData->_numTriangles * 2 - 1;
+	const unsigned		clusterSize				= _groupGPUData->_numClusters;
 	const unsigned		numGroups				= ComputeShader::getNumGroups(numRays);
 	const unsigned		numGroupsPulse			= ComputeShader::getNumGroups(numRays / lidarParams->_raysPulse);
 	unsigned			currentNumRays			= numRays;
 	unsigned			actualNumRays			= numRays / lidarParams->_raysPulse;
+	const float			maxDistance				= lidarParams->_maxRange + lidarParams->_maxRangeSoftBoundary.y;
 
 	{
 		pipelineMetrics.initChrono();
 
 		numCollisions = newCollisions = previousCollisions = 0;
 		ComputeShader::updateReadBuffer(_counterSSBO, &numCollisions, 1, GL_DYNAMIC_DRAW);
+#if COUNT_BVH_NODE_VISITS
+		ComputeShader::updateReadBuffer(_nodeVisitSSBO, &nodeVisits, 1, GL_DYNAMIC_DRAW);
+#endif
 
 		pipelineMetrics.measureStage(PipelineMetrics::WRITE);
 
@@ -503,13 +779,17 @@ PipelineMetrics LiDARSimulation::solveRayIntersection(GLuint raySSBO, GLuint num
 			findBVHCollisionShader->use();
 			findBVHCollisionShader->bindBuffers(std::vector<GLuint>{
 					_groupGPUData->_clusterSSBO, _groupGPUData->_groupGeometrySSBO, _groupGPUData->_groupTopologySSBO,
-					_groupGPUData->_groupMeshSSBO, raySSBO, _collisionSSBO
+					_groupGPUData->_groupMeshSSBO, raySSBO, _collisionSSBO, _rayHitsSSBO, _nodeVisitSSBO, _groupGPUData->_instanceSSBO, _groupGPUData->_leafFaceSSBO
 			});
+			findBVHCollisionShader->setUniform("countNodeVisits", unsigned(COUNT_BVH_NODE_VISITS));
+			findBVHCollisionShader->setUniform("maxDistance", maxDistance);
 			findBVHCollisionShader->setUniform("numClusters", clusterSize);
 			findBVHCollisionShader->setUniform("numRays", currentNumRays);
+			findBVHCollisionShader->setUniform("reuseHits", unsigned(lidarParams->_reuseRayHits && idReturn > 0));
 			findBVHCollisionShader->execute(numGroups, 1, 1, ComputeShader::getMaxGroupSize(), 1, 1);
 
 			pipelineMetrics.measureStage(PipelineMetrics::FIND_COLLISION);
+			pipelineMetrics.addTracedRays(currentNumRays);
 
 			// 3. Reduce collisions, as some of them may are generated by the same pulse
 			pipelineMetrics.initChrono();
@@ -518,9 +798,10 @@ PipelineMetrics LiDARSimulation::solveRayIntersection(GLuint raySSBO, GLuint num
 			reduceCollisionsShader->bindBuffers(std::vector<GLuint>{
 					_groupGPUData->_groupGeometrySSBO, _groupGPUData->_groupTopologySSBO,
 					_groupGPUData->_groupMeshSSBO, _LiDARMaterialsSSBO, raySSBO,
-					_collisionSSBO, _whiteNoiseSSBO, _triangleCollisionSSBO, _counterSSBO
+					_collisionSSBO, _triangleCollisionSSBO, _counterSSBO
 			});
 			reduceCollisionsShader->setUniform("bathymetric", bathymetric);
+			reduceCollisionsShader->setUniform("globalRayOffset", rayOffset);
 			reduceCollisionsShader->setUniform("inducedTerrainError", unsigned(LIDAR_PARAMS._includeTerrainInducedError));
 			reduceCollisionsShader->setUniform("lossAddCoefficient", LIDAR_PARAMS._addCoefficient);
 			reduceCollisionsShader->setUniform("lossMultCoefficient", LIDAR_PARAMS._multCoefficient);
@@ -529,10 +810,10 @@ PipelineMetrics LiDARSimulation::solveRayIntersection(GLuint raySSBO, GLuint num
 			reduceCollisionsShader->setUniform("maxDistance", LIDAR_PARAMS._maxRange);
 			reduceCollisionsShader->setUniform("maxDistanceBoundary", LIDAR_PARAMS._maxRangeSoftBoundary);
 			reduceCollisionsShader->setUniform("maxReturns", LIDAR_PARAMS._maxReturns);
-			reduceCollisionsShader->setUniform("noiseBufferSize", NOISE_TEXTURE_SIZE);
 			reduceCollisionsShader->setUniform("numPulses", actualNumRays);
 			reduceCollisionsShader->setUniform("numRaysPulse", GLuint(lidarParams->_raysPulse));
 			reduceCollisionsShader->setUniform("pulseRadius", lidarParams->_pulseRadius);
+			reduceCollisionsShader->setUniform("seed", unsigned(LIDAR_PARAMS._randomSeed));
 			reduceCollisionsShader->setUniform("sensorNormal", (LIDAR_PARAMS._LiDARType == LiDARParameters::TERRESTRIAL_SPHERICAL) ? vec3(1.0f, .0f, 1.0f) : vec3(1.0f, 1.0f, .0f));
 			reduceCollisionsShader->setUniform("shinySurfaceError", unsigned(LIDAR_PARAMS._includeShinySurfaceError));
 			reduceCollisionsShader->execute(numGroupsPulse, 1, 1, ComputeShader::getMaxGroupSize(), 1, 1);
@@ -545,11 +826,18 @@ PipelineMetrics LiDARSimulation::solveRayIntersection(GLuint raySSBO, GLuint num
 			newCollisions = numCollisions - previousCollisions;
 			previousCollisions = numCollisions;
 
+#if COUNT_BVH_NODE_VISITS
+			pipelineMetrics.addNodeVisits(*ComputeShader::readData(_nodeVisitSSBO, unsigned()));
+#endif
+
 			pipelineMetrics.measureStage(PipelineMetrics::READ);
 
 			pipelineMetrics.initChrono();
 
 			ComputeShader::updateReadBuffer(_newCounterSSBO, &newCollisions, 1, GL_DYNAMIC_DRAW);
+#if COUNT_BVH_NODE_VISITS
+			ComputeShader::updateReadBuffer(_nodeVisitSSBO, &nodeVisits, 1, GL_DYNAMIC_DRAW);		// Reset so that a single traversal never overflows the counter
+#endif
 
 			pipelineMetrics.measureStage(PipelineMetrics::WRITE);
 
@@ -559,11 +847,12 @@ PipelineMetrics LiDARSimulation::solveRayIntersection(GLuint raySSBO, GLuint num
 				pipelineMetrics.initChrono();
 
 				addOutliersShader->use();
-				addOutliersShader->bindBuffers(std::vector<GLuint>{ raySSBO, _triangleCollisionSSBO, _whiteNoiseSSBO, _counterSSBO, _newCounterSSBO });
-				addOutliersShader->setUniform("noiseBufferSize", NOISE_TEXTURE_SIZE);
+				addOutliersShader->bindBuffers(std::vector<GLuint>{ raySSBO, _triangleCollisionSSBO, _counterSSBO, _newCounterSSBO });
+				addOutliersShader->setUniform("globalRayOffset", rayOffset);
 				addOutliersShader->setUniform("noiseRange", LIDAR_PARAMS._outlierRange);
 				addOutliersShader->setUniform("noiseThreshold", LIDAR_PARAMS._outlierThreshold);
 				addOutliersShader->setUniform("nullModelCompID", _emptyModelComponent->_id);
+				addOutliersShader->setUniform("seed", unsigned(LIDAR_PARAMS._randomSeed));
 				addOutliersShader->execute(numGroups, 1, 1, ComputeShader::getMaxGroupSize(), 1, 1);
 
 				pipelineMetrics.measureStage(PipelineMetrics::OUTLIERS);
@@ -583,8 +872,10 @@ PipelineMetrics LiDARSimulation::solveRayIntersection(GLuint raySSBO, GLuint num
 		this->defineSceneUniforms(computeColorShader);
 		computeColorShader->setUniform("atmosphericAttenuation", this->getAtmosphericAttenuation());
 		computeColorShader->setUniform("bathymetric", bathymetric);
+		computeColorShader->setUniform("materialOffset", GLuint(0));
 		computeColorShader->setUniform("reflectanceWeight", LIDAR_PARAMS._reflectanceWeight * (bathymetric == 1 ? .5f : 1.0f));
 		computeColorShader->setUniform("sensorDiameter", LIDAR_PARAMS._sensorDiameter);
+		computeColorShader->setUniform("spectralOutput", GLuint(0));
 		computeColorShader->setUniform("systemAttenuation", LIDAR_PARAMS._systemAttenuation);
 		computeColorShader->setUniform("waterHeight", 1.0f);		// To check
 		computeColorShader->execute(numGroupsPulse, 1, 1, ComputeShader::getMaxGroupSize(), 1, 1);
@@ -611,8 +902,52 @@ PipelineMetrics LiDARSimulation::solveRayIntersection(GLuint raySSBO, GLuint num
 			pipelineMetrics.measureStage(PipelineMetrics::READ);
 
 			collisions.insert(collisions.end(), pCollision, pCollision + numCollisions);
+
+			// 7. Shade the same collisions for every band of a spectral batch
+			if (spectralIntensity)
+			{
+				pipelineMetrics.initChrono();
+
+				spectralIntensity->resize(_numSpectralBands * numCollisions);
+
+				computeColorShader->use();
+				computeColorShader->bindBuffers(std::vector<GLuint>{
+					_groupGPUData->_groupGeometrySSBO, _groupGPUData->_groupTopologySSBO,
+						_groupGPUData->_groupMeshSSBO, _LiDARMaterialsSSBO, raySSBO, _triangleCollisionSSBO, _counterSSBO, _brdfSSBO, _hermiteSSBO, _spectralIntensitySSBO
+				});
+				computeColorShader->setUniform("spectralOutput", GLuint(1));
+
+				for (GLuint bandIdx = 0; bandIdx < _numSpectralBands; ++bandIdx)
+				{
+					computeColorShader->setUniform("materialOffset", bandIdx * _spectralMaterialStride);
+					computeColorShader->execute(ComputeShader::getNumGroups(numCollisions), 1, 1, ComputeShader::getMaxGroupSize(), 1, 1);
+
+					glBindBuffer(GL_SHADER_STORAGE_BUFFER, _spectralIntensitySSBO);
+					glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, numCollisions * sizeof(float), spectralIntensity->data() + bandIdx * numCollisions);
+				}
+
+				pipelineMetrics.measureStage(PipelineMetrics::INTENSITY);
+			}
 		}
 	}
 
 	return pipelineMetrics;
+}
+
+void LiDARSimulation::solveRayIntersectionCPU(std::vector<Model3D::RayGPUData>& rays, GLuint rayOffset, std::vector<Model3D::TriangleCollisionGPUData>& collisions, int wl, bool readData, std::vector<float>* spectralIntensity, PipelineMetrics& pipelineMetrics)
+{
+	std::vector<Model3D::TriangleCollisionGPUData> discardedCollisions;
+	LiDARCPUSolver::SimulationUniforms uniforms;
+	const bool			bathymetric				= wl < 533 && LIDAR_PARAMS._LiDARType != LiDARParameters::TERRESTRIAL_SPHERICAL;
+
+	uniforms._atmosphericAttenuation	= this->getAtmosphericAttenuation();
+	uniforms._bathymetric				= bathymetric;
+	uniforms._nullModelCompID			= _emptyModelComponent->_id;
+	uniforms._rayOffset					= rayOffset;
+	uniforms._reflectanceWeight			= LIDAR_PARAMS._reflectanceWeight * (bathymetric ? .5f : 1.0f);
+	uniforms._sensorNormal				= (LIDAR_PARAMS._LiDARType == LiDARParameters::TERRESTRIAL_SPHERICAL) ? vec3(1.0f, .0f, 1.0f) : vec3(1.0f, 1.0f, .0f);
+	uniforms._waterHeight				= 1.0f;		// Same as compute shaders
+
+	pipelineMetrics.setOpenGLSync(false);				// CPU stages do not wait for OpenGL, and they may be measured by a worker thread
+	_cpuSolver->solveRayIntersection(rays, readData ? collisions : discardedCollisions, &LIDAR_PARAMS, uniforms, pipelineMetrics, readData ? spectralIntensity : nullptr);
 }
\ No newline at end of file
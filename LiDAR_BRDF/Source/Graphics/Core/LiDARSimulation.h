@@ -4,6 +4,7 @@
 #include "Graphics/Application/LiDARParameters.h"
 #include "Graphics/Application/PointCloudParameters.h"
 #include "Graphics/Core/Group3D.h"
+#include "Graphics/Core/LiDARCPUSolver.h"
 #include "Graphics/Core/LiDARPointCloud.h"
 #include "Graphics/Core/MaterialDatabase.h"
 #include "Graphics/Core/Model3D.h"
@@ -20,7 +21,6 @@
 #define ITERATE_BY_COUNT false
 #define SAVE_OVERLEAF_CONTENT false
 
-typedef std::unordered_set<Model3D::ModelComponent*> ModelComponentSet;
 typedef std::vector<std::unique_ptr<RayBuilder>> RayBuilderApplicators;
 
 /**
@@ -30,7 +30,7 @@ class LiDARSimulation
 {
 protected:
 	const static float					NOISE_TEXTURE_FREQUENCY;				//!< Frequency of texture clustering
-	const static unsigned				NOISE_TEXTURE_SIZE;						//!< Size of noise textures
+	const static GLuint64				RAY_FENCE_TIMEOUT;						//!< Nanoseconds waited for a batch of rays before polling its fence again
 	const static GLuint					RAY_MEMORY_BOUNDARY;					//!< Maximum number of rays per LiDAR iteration
 	const static float					RAY_OVERFLOW;							//!< Exceeds ray destination point to make it looks like an infinite ray
 	const static GLuint					SHADER_UINT_MAX;						//!< Infinite value for compute shaders
@@ -43,7 +43,6 @@ protected:
 
 protected:
 	// [State]
-	ModelComponentSet				_modelCompMap;								//!<
 	std::vector<vec3>				_tlsPositions;								//!< Set of TLS positions to automatize data colleciton within an environment
 
 	// [Results]
@@ -54,10 +53,17 @@ protected:
 	Group3D::StaticGPUData*			_groupGPUData;								//!<							//!<
 	Group3D*						_scene;										//!<
 
+	// [CPU backend]
+	LiDARCPUSolver*					_cpuSolver;									//!< Only instantiated during CPU-based simulations
+
 	// [Rendering]
 	VAO*							_LiDARRaysVAO;								//!<
 	unsigned						_numRays;									//!<
 
+	// [Spectral batch]
+	unsigned						_numSpectralBands;							//!< Wavelengths shaded after a single trace
+	unsigned						_spectralMaterialStride;					//!< Number of materials whose BRDF is stored for each band
+
 	// [Temporary data]
 	unsigned						_brdfSSBO;									//!<
 	unsigned						_collisionSSBO;								//!<
@@ -65,9 +71,11 @@ protected:
 	unsigned						_hermiteSSBO;								//!<
 	unsigned						_LiDARMaterialsSSBO;						//!<
 	unsigned						_newCounterSSBO;							//!<
+	unsigned						_nodeVisitSSBO;								//!< Number of BVH nodes visited by the collision search
+	unsigned						_rayHitsSSBO;								//!< Nearest hit of each ray, reused by successive returns
 	unsigned						_returnThresholdSSBO;						//!<
+	unsigned						_spectralIntensitySSBO;						//!< Intensity of the collisions for a single spectral band
 	unsigned						_triangleCollisionSSBO;						//!<
-	unsigned						_whiteNoiseSSBO;							//!<
 
 protected:
 	/**
@@ -81,11 +89,6 @@ protected:
 	*/
 	void appendLiDARData(std::vector<Model3D::TriangleCollisionGPUData>* collisions);
 
-	/**
-	*	@brief Creates a new noise texture to sample random values from a uniform distribution.
-	*/
-	unsigned buildWhiteNoiseTexture(const unsigned size);
-
 	/**
 	*	@brief Defines those uniform variables which depend on the type of scene and its parameters.
 	*/
@@ -121,6 +124,11 @@ protected:
 	*/
 	void launchSingleSimulation(bool instantiateRaysVAO);
 
+	/**
+	*	@brief Launchs a single LiDAR simulation whose rays are traced once per bathymetric regime and shaded for every wavelength of the range.
+	*/
+	void launchSpectralSimulation();
+
 	/**
 	*	@brief Prepares temporary data for LiDAR simulation. 
 	*/
@@ -131,6 +139,11 @@ protected:
 	*/
 	void prepareMaterialData(GLuint wavelength);
 
+	/**
+	*	@brief Prepares material-related data for a spectral batch. BRDFs of every band are concatenated.
+	*/
+	void prepareSpectralMaterialData(const std::vector<int>& wavelengths);
+
 	/**
 	*	@brief Releases memory from temporary data. 
 	*/
@@ -141,11 +154,28 @@ protected:
 	*/
 	void releaseMaterialData();
 
+	/**
+	*	@brief Simulates every pending batch as a pipeline with double-buffered rays and collisions. The rays of a batch are built while the previous one is intersected, 
+	*	either by a worker thread in CPU or by compute shaders into the back ray buffer, which are waited with a fence instead of finishing the pipeline. Collisions are 
+	*	ingested into the point cloud by a worker thread while the next batch is simulated. OpenGL calls are only issued from the calling thread, hence the intersection 
+	*	only runs in a worker thread with the CPU backend.
+	*	@param readData Collisions are ingested into the point cloud.
+	*	@return Number of simulated rays.
+	*/
+	unsigned simulatePendingBatches(AABB& aabb, int wl, bool readData, PipelineMetrics& pipelineMetrics);
+
 	/**
 	*	@brief Gets ray intersections with clusters in BVH.
 	*	@param rayArray Vector of arrays which needs to be tried.
+	*	@param rayOffset Rays simulated before this batch, so that noise is never repeated across batches.
+	*	@param spectralIntensity If not null, band-major intensity of the read collisions for every band prepared by prepareSpectralMaterialData.
+	*/
+	PipelineMetrics solveRayIntersection(GLuint raySSBO, GLuint numRays, GLuint rayOffset, std::vector<Model3D::TriangleCollisionGPUData>& collisions, int wl, bool readData = true, std::vector<float>* spectralIntensity = nullptr);
+
+	/**
+	*	@brief Solves ray intersections with the multithreaded CPU backend, whose rays are built in main memory. No OpenGL call is issued, so it can be run by a worker thread.
 	*/
-	PipelineMetrics solveRayIntersection(GLuint raySSBO, GLuint numRays, std::vector<Model3D::TriangleCollisionGPUData>& collisions, int wl, bool readData = true);
+	void solveRayIntersectionCPU(std::vector<Model3D::RayGPUData>& rays, GLuint rayOffset, std::vector<Model3D::TriangleCollisionGPUData>& collisions, int wl, bool readData, std::vector<float>* spectralIntensity, PipelineMetrics& pipelineMetrics);
 
 public:
 	/**
@@ -5,6 +5,7 @@
 #include "Graphics/Application/Renderer.h"
 #include "Graphics/Core/FBOScreenshot.h"
 #include "Graphics/Core/Group3D.h"
+#include "Graphics/Core/Image.h"
 #include "Graphics/Core/OpenGLUtilities.h"
 #include "Graphics/Core/ShaderList.h"
 #include "Graphics/Core/VAO.h"
@@ -16,6 +17,7 @@
 // [Static variables initialization]
 
 const GLuint Model3D::RESTART_PRIMITIVE_INDEX = 0xFFFFFFFF;
+bool Model3D::HEADLESS = false;
 
 std::unordered_map<unsigned, vec3> Model3D::_asprsGroupColor = Model3D::getASPRSCodeColor();
 std::unordered_map<unsigned, vec3> Model3D::_groupColor;
@@ -26,6 +28,8 @@ GLuint Model3D::_ssaoKernelTextureID = -1;
 GLuint Model3D::_ssaoNoiseTextureID = -1;
 GLuint Model3D::_shadowTextureID = -1;
 
+static_assert(sizeof(Model3D::RayHitGPUData) == 48, "RayHitGPUData must match its std430 layout");
+
 
 /// [Static methods
 
@@ -289,6 +293,61 @@ void Model3D::getSemanticGroup(unsigned modelCompID, int& lastSemanticGroup, boo
 	}
 }
 
+void Model3D::retrieveColorsCPU()
+{
+	static const std::string nullMaterialName = "None";
+
+	std::unordered_map<std::string, std::unique_ptr<Image>> images;
+
+	// Texel of a coordinate, wrapped as a mirrored repeat as in textures
+	auto mirrorTexel = [](const float coord, const int size) -> int
+		{
+			float texel = std::fmod(std::abs(coord), 2.0f);
+			if (texel > 1.0f) texel = 2.0f - texel;
+
+			return glm::clamp(int(texel * size), 0, size - 1);
+		};
+
+	for (ModelComponent* modelComponent : _modelComp)
+	{
+		const ModelComponentDescription& description = modelComponent->_modelDescription;
+		const std::string materialName = description._materialName, mapKd = description._mapKd;
+		vec3 kd = vec3(1.0f);															// Components with no material are white
+		Image* image = nullptr;
+
+		if (!materialName.empty() && materialName != nullMaterialName)
+		{
+			kd = description._kd;
+
+			if (!mapKd.empty())
+			{
+				std::unique_ptr<Image>& mapImage = images[mapKd];
+				if (!mapImage) mapImage.reset(new Image(mapKd));
+				if (mapImage->getWidth() > 0) image = mapImage.get();
+			}
+		}
+
+		#pragma omp parallel for
+		for (int vertexIdx = 0; vertexIdx < modelComponent->_geometry.size(); ++vertexIdx)
+		{
+			VertexGPUData& vertex = modelComponent->_geometry[vertexIdx];
+			vec3 rgb = kd;
+
+			if (image)
+			{
+				const int x = mirrorTexel(vertex._textCoord.x, image->getWidth()), y = mirrorTexel(vertex._textCoord.y, image->getHeight());
+				const unsigned char* texel = image->bits() + (y * image->getWidth() + x) * image->getDepth();
+
+				rgb = vec3(texel[0], texel[1], texel[2]) / 255.0f;
+			}
+
+			vertex._kad			= vec4(rgb, 1.0f);
+			vertex._ks			= 1.0f;
+			vertex._shininess	= 1.0f;
+		}
+	}
+}
+
 void Model3D::retrieveColorsGPU()
 {
 	ComputeShader* shader = ShaderList::getInstance()->getComputeShader(RendEnum::RETRIEVE_COLORS);
@@ -507,6 +566,36 @@ void Model3D::computeTangents(ModelComponent* modelComp)
 	glDeleteBuffers(1, &outBufferID);
 }
 
+void Model3D::computeTangentsCPU(ModelComponent* modelComp)
+{
+	std::vector<vec3> tangent(modelComp->_geometry.size(), vec3(.0f));
+
+	// Faces sharing a vertex accumulate their tangents on it, hence this loop is sequential
+	for (const FaceGPUData& face : modelComp->_topology)
+	{
+		const VertexGPUData& vertex1 = modelComp->_geometry[face._vertices.x];
+		const VertexGPUData& vertex2 = modelComp->_geometry[face._vertices.y];
+		const VertexGPUData& vertex3 = modelComp->_geometry[face._vertices.z];
+
+		const vec3 edge1 = vertex2._position - vertex1._position, edge2 = vertex3._position - vertex1._position;
+		const vec2 st1 = vertex2._textCoord - vertex1._textCoord, st2 = vertex3._textCoord - vertex1._textCoord;
+
+		const float r = 1.0f / (st1.x * st2.y - st2.x * st1.y);
+		const vec3 sdir = (edge1 * st2.y - edge2 * st1.y) * r;
+
+		tangent[face._vertices.x] += sdir;
+		tangent[face._vertices.y] += sdir;
+		tangent[face._vertices.z] += sdir;
+	}
+
+	#pragma omp parallel for
+	for (int vertexIdx = 0; vertexIdx < modelComp->_geometry.size(); ++vertexIdx)
+	{
+		VertexGPUData& vertex = modelComp->_geometry[vertexIdx];
+		vertex._tangent = glm::normalize(tangent[vertexIdx] - vertex._normal * glm::dot(vertex._normal, tangent[vertexIdx]));		// Gram-Schmidt orthogonalize
+	}
+}
+
 void Model3D::generatePointCloud()
 {
 	for (ModelComponent* modelComp : _modelComp)
@@ -790,7 +879,7 @@ void Model3D::renderCapturedPoints(RenderingShader* shader, const RendEnum::Rend
 		shader->setUniform("mModelViewProj", matrix[RendEnum::VIEW_PROJ_MATRIX] * matrix[RendEnum::MODEL_MATRIX]);
 		shader->setUniform("pointSize", rendParams->_lidarPointSize);
 
-		vao->drawObject(RendEnum::IBO_POINT_CLOUD, primitive, GLuint(modelComp->_lidarPointPosition.size()));
+		vao->drawObject(RendEnum::IBO_POINT_CLOUD, primitive, modelComp->_lidarPointCount, modelComp->_lidarPointOffset);
 	}
 }
 
@@ -810,7 +899,7 @@ void Model3D::renderCapturedPointsRGB(RenderingShader* shader, const RendEnum::R
 			material->applyMaterial4ColouredPoints(shader);
 		}
 
-		vao->drawObject(RendEnum::IBO_POINT_CLOUD, primitive, GLuint(modelComp->_lidarPointPosition.size()));
+		vao->drawObject(RendEnum::IBO_POINT_CLOUD, primitive, modelComp->_lidarPointCount, modelComp->_lidarPointOffset);
 	}
 }
 
@@ -828,7 +917,7 @@ void Model3D::renderCapturedPointsWithGroup(RenderingShader* shader, const RendE
 		if (!ASPRS && modelComp->_semanticGroup != -1) shader->setUniform("vColor", _groupColor[modelComp->_semanticGroup]);
 		else if (ASPRS && modelComp->_asprsSemanticGroup != -1) shader->setUniform("vColor", _asprsGroupColor[modelComp->_asprsSemanticGroup]);
 
-		vao->drawObject(RendEnum::IBO_POINT_CLOUD, primitive, GLuint(modelComp->_lidarPointPosition.size()));
+		vao->drawObject(RendEnum::IBO_POINT_CLOUD, primitive, modelComp->_lidarPointCount, modelComp->_lidarPointOffset);
 	}
 }
 
@@ -845,7 +934,6 @@ Model3D::ModelComponent::ModelComponent(Model3D* root) :
 Model3D::ModelComponent::~ModelComponent()
 {
 	delete _vao;
-	delete _vaoLiDAR;
 }
 
 void Model3D::ModelComponent::assignModelCompIDFaces()
@@ -907,31 +995,26 @@ void Model3D::ModelComponent::buildWireframeTopology()
 
 void Model3D::ModelComponent::clearLiDARPoints()
 {
-	_lidarPointPosition.clear();
-	_lidarPointTextureCoordinates.clear();
+	_lidarPointCount.clear();
+	_lidarPointOffset.clear();
+	_vaoLiDAR = nullptr;
 }
 
-void Model3D::ModelComponent::loadLiDARPoints()
+void Model3D::ModelComponent::pushBackCapturedPoints(VAO* vao, const GLuint firstIndex, const GLuint numIndices)
 {
-	if (!_vaoLiDAR)
-	{
-		_vaoLiDAR = new VAO();
-	}
-
-	std::vector<GLuint> pointCloud(_lidarPointPosition.size());
-	std::iota(pointCloud.begin(), pointCloud.end(), 0);
+	const GLubyte* offset = (GLubyte*)nullptr + size_t(firstIndex) * sizeof(GLuint);
 
-	_vaoLiDAR->setVBOData(RendEnum::VBO_POSITION, _lidarPointPosition);
-	_vaoLiDAR->setVBOData(RendEnum::VBO_NORMAL, _lidarPointNormal);
-	_vaoLiDAR->setVBOData(RendEnum::VBO_TEXT_COORD, _lidarPointTextureCoordinates);
-	_vaoLiDAR->setIBOData(RendEnum::IBO_POINT_CLOUD, pointCloud);
-}
+	_vaoLiDAR = vao;
 
-void Model3D::ModelComponent::pushBackCapturedPoints(TriangleCollisionGPUData* collision)
-{
-	_lidarPointPosition.push_back(vec4(collision->_point, 1.0f));
-	_lidarPointNormal.push_back(collision->_normal);
-	_lidarPointTextureCoordinates.push_back(collision->_textCoord);
+	if (!_lidarPointCount.empty() && (const GLubyte*)_lidarPointOffset.back() + size_t(_lidarPointCount.back()) * sizeof(GLuint) == offset)
+	{
+		_lidarPointCount.back() += numIndices;
+	}
+	else
+	{
+		_lidarPointCount.push_back(numIndices);
+		_lidarPointOffset.push_back(offset);
+	}
 }
 
 void Model3D::ModelComponent::releaseMemory()
@@ -89,8 +89,9 @@ public:
 		vec3		_maxPoint;
 		unsigned	_prevIndex2;
 
-		unsigned	_faceIndex;
-		vec3		_padding;
+		unsigned	_faceIndex;								//!< First position of leaves within the leaf faces buffer, or instance index if flagged
+		unsigned	_numFaces;								//!< Faces referenced by leaves, which are contiguous in the leaf faces buffer
+		uvec2		_padding;
 
 		mat4 getScaleMatrix()
 		{
@@ -107,6 +108,20 @@ public:
 		}
 	};
 
+	/**
+	*	@brief Placement of a prototype whose geometry is shared by every instance. Rays are transformed into the prototype space instead of replicating its triangles.
+	*/
+	struct InstanceGPUData
+	{
+		mat4		_transform;								//!< From prototype to world space
+		mat4		_inverseTransform;						//!< From world to prototype space
+
+		unsigned	_blasRoot;								//!< Root node of the BVH built over the prototype triangles
+		unsigned	_modelCompOffset;						//!< Identifier of the first model component of the instance
+		unsigned	_prototypeCompOffset;					//!< Identifier of the first model component of the prototype
+		unsigned	_padding;
+	};
+
 	struct RayGPUData
 	{
 		vec3		_origin;
@@ -150,6 +165,21 @@ public:
 		}
 	};
 
+	/**
+	*	@brief Nearest hit of a ray, along with the ray it was found for.
+	*/
+	struct RayHitGPUData
+	{
+		vec3		_origin;				//!< Ray origin when the hit was found
+		float		_distance;				//!< Parametric value of the hit
+
+		vec3		_direction;				//!< Ray direction when the hit was found
+		unsigned	_faceIndex;				//!< Null index if the ray hit nothing
+
+		unsigned	_instanceIndex;			//!< Instance where the face was hit, if any
+		unsigned	_padding1, _padding2, _padding3;
+	};
+
 	struct TriangleCollisionGPUData
 	{
 		vec3		_point;
@@ -250,6 +280,7 @@ public:
 public:
 	// [Rendering]
 	const static GLuint		RESTART_PRIMITIVE_INDEX;		//!< Index which marks the end of a primitive
+	static bool				HEADLESS;						//!< No OpenGL context nor rendering resource (VAO, FBO...) is available, e.g. for batch simulations
 
 protected:
 	static std::unordered_map<unsigned, vec3>			_asprsGroupColor;
@@ -288,6 +319,11 @@ protected:
 	*/
 	virtual void computeTangents(ModelComponent* modelComp);
 
+	/**
+	*	@brief Computes the tangents in CPU, as in the compute shaders of computeTangents.
+	*/
+	virtual void computeTangentsCPU(ModelComponent* modelComp);
+
 	/**
 	*	@brief
 	*/
@@ -514,6 +550,11 @@ public:
 	*/
 	Model3D& operator=(const Model3D& model) = delete;
 
+	/**
+	*	@brief Retrieve diffuse colors from the description of materials in CPU, as in retrieveColorsGPU. Textures are sampled at their closest texel.
+	*/
+	virtual void retrieveColorsCPU();
+
 	/**
 	*	@brief Retrieve diffuse and specular colors from textures in compute shader.
 	*/
@@ -551,6 +592,11 @@ public:
 	*/
 	ModelComponent* getModelComponent(unsigned index) { return _modelComp[index]; }
 
+	/**
+	*	@return Number of model components.
+	*/
+	unsigned getNumModelComponents() { return static_cast<unsigned>(_modelComp.size()); }
+
 	/**
 	*	@return Model transformation matrix.
 	*/
@@ -630,9 +676,8 @@ public:
 	std::vector<unsigned>		_topologyIndicesLength;						//!<
 
 	// [LiDAR geometry]
-	std::vector<vec4>			_lidarPointPosition;						//!<
-	std::vector<vec3>			_lidarPointNormal;							//!<
-	std::vector<vec2>			_lidarPointTextureCoordinates;				//!<
+	std::vector<GLsizei>		_lidarPointCount;							//!< Number of indices of each range of captured points
+	std::vector<const void*>	_lidarPointOffset;							//!< Offset in bytes of each range within the shared IBO of captured points
 
 	// [GPU Data]
 	std::vector<VertexGPUData>	_geometry;									//!<
@@ -640,7 +685,7 @@ public:
 				
 	// [GPU storage]
 	VAO*						_vao;										//!<
-	VAO*						_vaoLiDAR;									//!<
+	VAO*						_vaoLiDAR;									//!< Shared by every model component, owned by the LiDAR point cloud
 			
 	// [Additional info]
 	bool						_enabled;
@@ -693,20 +738,17 @@ public:
 	*/
 	void clearLiDARPoints();
 
-	/**
-	*	@brief Loads those points captured by a LiDAR sensor into a VAO buffer.
-	*/
-	void loadLiDARPoints();
-
 	/**
 	*	@brief Assignment operator overriding.
 	*/
 	ModelComponent& operator=(const ModelComponent& orig) = delete;
 
 	/**
-	*	@brief Adds a new point captured by a sensor as well as its associated geometry for rendering.
+	*	@brief Adds a range of indices of points captured by a sensor. It is merged with the last one if both are contiguous.
+	*	@param vao Shared buffers where captured points are stored.
+	*	@param firstIndex First index of the range within the IBO of captured points.
 	*/
-	void pushBackCapturedPoints(TriangleCollisionGPUData* collision);
+	void pushBackCapturedPoints(VAO* vao, const GLuint firstIndex, const GLuint numIndices);
 
 	/**
 	*	@brief Clear geometry and topology arrays to free memory linked to process.
@@ -95,7 +95,7 @@ VAO* Primitives::getCubeVAO()
 	return _cubeVAO.get();
 }
 
-VAO* Primitives::getCubesVAO(std::vector<Model3D::BVHCluster>& nodes, unsigned nNodes)
+VAO* Primitives::getCubesVAO(const std::vector<Model3D::BVHCluster>& nodes, unsigned nNodes)
 {
 	VAO*				vao = new VAO();
 	std::vector<vec4>	position;							// Positions for each node
@@ -44,7 +44,7 @@ public:
 	*	@param nNodes Number of cubes to be taken into account.
 	*	@return VAO with geometry and topology of a set of cubes.
 	*/
-	static VAO* getCubesVAO(std::vector<Model3D::BVHCluster>& nodes, unsigned nNodes);
+	static VAO* getCubesVAO(const std::vector<Model3D::BVHCluster>& nodes, unsigned nNodes);
 
 	/**
 	*	@return VAO with geometry and topology of a quad
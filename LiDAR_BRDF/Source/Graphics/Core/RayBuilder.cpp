@@ -8,12 +8,32 @@
 
 const vec3		RayBuilder::AERIAL_UP_VECTOR = vec3(.0f, -1.0f, .0f);
 const float		RayBuilder::BOUNDARY_OFFSET = .0f;
-const GLuint	RayBuilder::NOISE_BUFFER_SIZE = 5e5;
+const unsigned	RayBuilder::CPU_BATCH_RAYS = 1 << 20;
 const vec3		RayBuilder::TERRESTRIAL_UP_VECTOR = vec3(.0f, 1.0f, .0f);
 
+const unsigned	RayBuilder::ANGLE_NOISE_STREAM = 0xAC987;
+const uvec3		RayBuilder::AXIS_NOISE_STREAM = uvec3(0xFF245, 0x23456, 0xFFFF28);
+const unsigned	RayBuilder::HEIGHT_NOISE_STREAM = 0xAC987;
+const unsigned	RayBuilder::PATH_NOISE_STREAM = 0x3C6EF3;
+const uvec2		RayBuilder::PULSE_NOISE_STREAM = uvec2(0x66565, 0x23456);
+const uvec3		RayBuilder::RAY_NOISE_STREAM = uvec3(0xFF245, 0x23456, 0xFFFF289);
+
 
 /// [Public methods]
 
+void RayBuilder::buildRaysCPU(LiDARParameters* LiDARParams, std::vector<Model3D::RayGPUData>& rays)
+{
+	const unsigned leftPulses = (_parameters->_leftRays + LiDARParams->_raysPulse - 1) / LiDARParams->_raysPulse;
+	const unsigned numPulses = std::min(_parameters->_allowedRaysIteration, leftPulses);
+
+	rays.resize(numPulses * LiDARParams->_raysPulse);
+	this->throwPulses(LiDARParams, _parameters->_nextPulse, numPulses, rays);
+
+	_parameters->_nextPulse			+= numPulses;
+	_parameters->_currentNumRays	= rays.size();
+	_parameters->_leftRays			-= std::min(size_t(_parameters->_leftRays), rays.size());
+}
+
 void RayBuilder::freeContext()
 {
 	delete _parameters;
@@ -24,47 +44,40 @@ void RayBuilder::resetPendingRays(LiDARParameters* LiDARParams)
 {
 	_parameters->_leftRays = _parameters->_numRays * LiDARParams->_raysPulse;
 	_parameters->_currentNumRays = std::min(_parameters->_allowedRaysIteration * LiDARParams->_raysPulse, _parameters->_leftRays);
+	_parameters->_nextPulse = 0;
+}
+
+void RayBuilder::uploadRays(const std::vector<Model3D::RayGPUData>& rays)
+{
+	ComputeShader::updateReadBufferRange(_parameters->_rayBuffer, rays.data(), 0, rays.size());
 }
 
 /// [Protected methods]
 
-void RayBuilder::addPulseRadius(std::vector<Model3D::RayGPUData>& rays, unsigned baseIndex, const vec3& up, const int numRaysPulse, const float radius)
+void RayBuilder::addPulseRadius(std::vector<Model3D::RayGPUData>& rays, unsigned baseIndex, const vec3& up, const int numRaysPulse, const float radius, const unsigned pulseIndex, const unsigned seed)
 {
 	vec3 u, v, noise;
 	this->getRadiusAxes(rays[baseIndex]._direction, u, v, up);
 
-	for (int ray = 0; ray < numRaysPulse - 1; ++ray)
+	for (int ray = 1; ray < numRaysPulse; ++ray)
 	{
-		noise = float(RandomUtilities::getUniformRandomValue()) * radius * u + float(RandomUtilities::getUniformRandomValue()) * radius * v;	
-		rays[baseIndex + ray + 1] = Model3D::RayGPUData(rays[baseIndex]._origin + noise, rays[baseIndex]._destination + noise);
+		noise = getJittering(seed, pulseIndex, PULSE_NOISE_STREAM.x + ray) * radius * u + getJittering(seed, pulseIndex, PULSE_NOISE_STREAM.y + ray) * radius * v;
+		rays[baseIndex + ray] = Model3D::RayGPUData(rays[baseIndex]._origin + noise, rays[baseIndex]._destination + noise);
 	}
 }
 
-void RayBuilder::addPulseRadius(std::vector<Model3D::RayGPUData>& rays, Model3D::RayGPUData& ray, const vec3& up, const int numRaysPulse, const float radius)
+void RayBuilder::addPulseRadius(std::vector<Model3D::RayGPUData>& rays, Model3D::RayGPUData& ray, const vec3& up, const int numRaysPulse, const float radius, const unsigned pulseIndex, const unsigned seed)
 {
 	vec3 u, v, noise;
 	this->getRadiusAxes(ray._direction, u, v, up);
 
-	for (int rayIdx = 0; rayIdx < numRaysPulse - 1; ++rayIdx)
+	for (int rayIdx = 1; rayIdx < numRaysPulse; ++rayIdx)
 	{
-		noise = float(RandomUtilities::getUniformRandomValue()) * radius * u + float(RandomUtilities::getUniformRandomValue()) * radius * v;
+		noise = getJittering(seed, pulseIndex, PULSE_NOISE_STREAM.x + rayIdx) * radius * u + getJittering(seed, pulseIndex, PULSE_NOISE_STREAM.y + rayIdx) * radius * v;
 		rays.push_back(Model3D::RayGPUData(ray._origin + noise, ray._destination + noise));
 	}
 }
 
-GLuint RayBuilder::buildNoiseBuffer()
-{
-	std::vector<float> noiseOutput(NOISE_BUFFER_SIZE);
-	RandomUtilities::initializeUniformDistribution(-1.0f, 1.0f);
-
-	for (unsigned index = 0; index < noiseOutput.size(); ++index)
-	{
-		noiseOutput[index] = RandomUtilities::getUniformRandomValue();
-	}
-
-	return ComputeShader::setReadBuffer(noiseOutput, GL_STATIC_DRAW);
-}
-
 std::vector<vec2> RayBuilder::douglasPecker(const std::vector<vec2>& points, float epsilon)
 {
 	std::vector<vec2> resultList;
@@ -247,17 +260,28 @@ void RayBuilder::getRadiusAxes(const vec3& n, vec3& u, vec3& v, const vec3& up)
 
 void RayBuilder::initializeContext(LiDARParameters* LiDARParams, BuildingParameters* params)
 {
-	params->_allowedRaysIteration	= std::ceil(ComputeShader::getAllowedNumberOfInstances(Model3D::TriangleCollisionGPUData()) / float(LiDARParams->_raysPulse) / float(glm::max(GLuint(LiDARParams->_rayDivisor), LiDARParams->_maxReturns))) - 1;
+	// Batches of GPU backends are bounded by the size of the collision buffer, whereas CPU ones are not queried from OpenGL
+	if (LiDARParams->_backend == LiDARParameters::GPU_BACKEND)
+	{
+		params->_allowedRaysIteration = std::ceil(ComputeShader::getAllowedNumberOfInstances(Model3D::TriangleCollisionGPUData()) / float(LiDARParams->_raysPulse) / float(glm::max(GLuint(LiDARParams->_rayDivisor), LiDARParams->_maxReturns))) - 1;
+	}
+	else
+	{
+		params->_allowedRaysIteration = glm::max(CPU_BATCH_RAYS / LiDARParams->_raysPulse, 1u);
+	}
+
 	params->_numRays				= params->_numThreads;
 	params->_minSize				= std::min(params->_allowedRaysIteration, params->_numRays) * LiDARParams->_raysPulse;
 	params->_numGroups				= ComputeShader::getNumGroups(params->_minSize / LiDARParams->_raysPulse);
 	params->_leftRays				= params->_numRays * LiDARParams->_raysPulse;
 	params->_currentNumRays			= std::min(params->_allowedRaysIteration * LiDARParams->_raysPulse, params->_leftRays);
+	params->_nextPulse				= 0;
 
-	if (LiDARParams->_gpuInstantiation)
+	// Rays are written here either by compute shaders or by CPU batches of the GPU backend
+	if (LiDARParams->_backend == LiDARParameters::GPU_BACKEND)
 	{
 		params->_rayBuffer = ComputeShader::setWriteBuffer(Model3D::RayGPUData(vec3(.0f), vec3(.0f)), params->_minSize);
-		params->_noiseBuffer = RayBuilder::buildNoiseBuffer();
+		params->_backRayBuffer = ComputeShader::setWriteBuffer(Model3D::RayGPUData(vec3(.0f), vec3(.0f)), params->_minSize);
 	}
 }
 
@@ -302,11 +326,12 @@ void RayBuilder::removeRedundantPoints(std::vector<vec2>& points)
 	}
 }
 
-void RayBuilder::retrievePath(std::vector<Interpolation*> paths, std::vector<vec4>& waypoints, const float tIncrement)
+void RayBuilder::retrievePath(std::vector<Interpolation*> paths, std::vector<vec4>& waypoints, const float tIncrement, const unsigned seed)
 {
-	for (Interpolation* interpolation: paths)
+	for (unsigned pathIdx = 0; pathIdx < paths.size(); ++pathIdx)
 	{
-		float t = (RandomUtilities::getUniformRandomValue() + 1.0f) / 2.0f * tIncrement / 10.0f;
+		Interpolation* interpolation = paths[pathIdx];
+		float t = RandomUtilities::getCounterRandomValue(seed, pathIdx, PATH_NOISE_STREAM) * tIncrement / 10.0f;
 		bool isPathOver = false;
 		vec4 direction, point;
 
@@ -325,3 +350,11 @@ void RayBuilder::retrievePath(std::vector<Interpolation*> paths, std::vector<vec
 		}
 	}
 }
+
+void RayBuilder::uploadRaysCPU(LiDARParameters* LiDARParams)
+{
+	std::vector<Model3D::RayGPUData> rays;
+
+	this->buildRaysCPU(LiDARParams, rays);
+	this->uploadRays(rays);
+}
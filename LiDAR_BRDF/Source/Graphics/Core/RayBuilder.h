@@ -24,9 +24,17 @@ class RayBuilder
 protected:
 	const static vec3	AERIAL_UP_VECTOR;			//!<
 	const static float	BOUNDARY_OFFSET;			//!< Offset for terrain boundaries when throwing rays
-	const static GLuint	NOISE_BUFFER_SIZE;			//!<
+	const static unsigned	CPU_BATCH_RAYS;			//!< Rays of a batch built in CPU for CPU backends, which are not limited by the size of shader storage blocks
 	const static vec3	TERRESTRIAL_UP_VECTOR;		//!<
 
+	// [Noise streams] Same values as ray building shaders
+	const static unsigned	ANGLE_NOISE_STREAM;		//!< Rotation angle of TLS jittering
+	const static uvec3		AXIS_NOISE_STREAM;		//!< Rotation axis of TLS jittering
+	const static unsigned	HEIGHT_NOISE_STREAM;	//!< Height jittering of ALS sensors
+	const static unsigned	PATH_NOISE_STREAM;		//!< Starting point and angle of airborne paths
+	const static uvec2		PULSE_NOISE_STREAM;		//!< Displacement of the rays of a pulse, increased by the ray index
+	const static uvec3		RAY_NOISE_STREAM;		//!< Direction jittering of ALS rays
+
 protected:
 	struct BuildingParameters
 	{
@@ -36,31 +44,33 @@ protected:
 		unsigned	_numRays;
 		unsigned	_numThreads;
 		unsigned	_minSize;
+		unsigned	_nextPulse;
 		unsigned	_numGroups;
 		float		_timePulse;
 
 		// SSBOs
+		GLuint		_backRayBuffer;					//!< Written with the next batch while the current one is intersected
 		GLuint		_rayBuffer;
-		GLuint		_noiseBuffer;
 
 		/**
 		*	@brief Constructor.
 		*/
-		BuildingParameters() { _rayBuffer = UINT_MAX; _noiseBuffer = UINT_MAX; }
+		BuildingParameters() { _nextPulse = 0; _backRayBuffer = _rayBuffer = UINT_MAX; }
 
 		/**
-		*	@brief Destructor.
+		*	@brief Destructor. Buffers are never allocated for CPU backends, which may run with no OpenGL context.
 		*/
 		virtual ~BuildingParameters()
 		{
-			glDeleteBuffers(1, &_rayBuffer);
-			glDeleteBuffers(1, &_noiseBuffer);
+			if (_backRayBuffer != UINT_MAX) glDeleteBuffers(1, &_backRayBuffer);
+			if (_rayBuffer != UINT_MAX) glDeleteBuffers(1, &_rayBuffer);
 		}
 	};
 
 	struct TLSParameters: public BuildingParameters
 	{
 		float				_channelSpacing;
+		std::vector<vec3>	_channelPosition;
 		vec2				_fovRadians, _reducedFovRadians;
 		vec2				_incrementRadians;
 		unsigned			_numChannels;
@@ -85,8 +95,8 @@ protected:
 		*/
 		virtual ~TLSParameters()
 		{
-			glDeleteBuffers(1, &_channelBuffer);
-			glDeleteBuffers(1, &_vAngleBuffer);
+			if (_channelBuffer != UINT_MAX) glDeleteBuffers(1, &_channelBuffer);
+			if (_vAngleBuffer != UINT_MAX) glDeleteBuffers(1, &_vAngleBuffer);
 		}
 	};
 
@@ -110,6 +120,7 @@ protected:
 		unsigned	_scansSec;
 		float		_startRadians;
 		vec3		_upVector;
+		std::vector<vec4> _waypoints;
 
 		// SSBOs
 		GLuint		_waypointBuffer;
@@ -124,7 +135,7 @@ protected:
 		*/
 		virtual ~ALSParameters()
 		{
-			glDeleteBuffers(1, &_waypointBuffer);
+			if (_waypointBuffer != UINT_MAX) glDeleteBuffers(1, &_waypointBuffer);
 		}
 	};
 
@@ -133,19 +144,15 @@ protected:
 
 protected:
 	/**
-	*	@brief
+	*	@brief Fills the rays of the pulse whose main ray is located at baseIndex. Random values are keyed by the pulse index, so that it is safe to call it from several threads.
+	*	@param pulseIndex Index of the pulse within the whole simulation, which may differ from its index within the batch.
 	*/
-	void addPulseRadius(std::vector<Model3D::RayGPUData>& rays, unsigned baseIndex, const vec3& up, const int numRaysPulse, const float radius);
+	void addPulseRadius(std::vector<Model3D::RayGPUData>& rays, unsigned baseIndex, const vec3& up, const int numRaysPulse, const float radius, const unsigned pulseIndex, const unsigned seed);
 
 	/**
-	*	@brief
-	*/
-	void addPulseRadius(std::vector<Model3D::RayGPUData>& rays, Model3D::RayGPUData& ray, const vec3& up, const int numRaysPulse, const float radius);
-	
-	/**
-	*	@brief Builds a white noise texture.
+	*	@brief Appends the rays of a pulse to the given vector.
 	*/
-	GLuint buildNoiseBuffer();
+	void addPulseRadius(std::vector<Model3D::RayGPUData>& rays, Model3D::RayGPUData& ray, const vec3& up, const int numRaysPulse, const float radius, const unsigned pulseIndex, const unsigned seed);
 	
 	/**
 	*	@brief Simplifies a vector of points to avoid user's noise.
@@ -198,9 +205,26 @@ protected:
 	static void removeRedundantPoints(std::vector<vec2>& points);
 
 	/**
-	*	@brief  
+	*	@return Uniform value in [-1, 1) for a pulse and a stream of random values.
+	*/
+	static float getJittering(const unsigned seed, const unsigned pulseIndex, const unsigned stream) { return RandomUtilities::getCounterRandomValue(seed, pulseIndex, stream) * 2.0f - 1.0f; }
+
+	/**
+	*	@brief Samples the waypoints of airborne paths. The starting point of each path is displaced by a random value keyed by seed.
+	*/
+	void retrievePath(std::vector<Interpolation*> paths, std::vector<vec4>& waypoints, const float tIncrement, const unsigned seed);
+
+	/**
+	*	@brief Builds a range of pulses in CPU, whose rays are written from the beginning of the given vector. Random values are keyed by the
+	*	index of every pulse within the simulation, hence batches match the ones of compute shaders regardless of their size.
+	*	@param firstPulse Index of the first pulse within the simulation.
 	*/
-	void retrievePath(std::vector<Interpolation*> paths, std::vector<vec4>& waypoints, const float tIncrement);
+	virtual void throwPulses(LiDARParameters* LiDARParams, const unsigned firstPulse, const unsigned numPulses, std::vector<Model3D::RayGPUData>& rays) = 0;
+
+	/**
+	*	@brief Builds the next batch of rays in CPU and uploads it into the ray buffer, for GPU simulations whose rays are not instantiated in GPU.
+	*/
+	void uploadRaysCPU(LiDARParameters* LiDARParams);
 
 public:
 	/**
@@ -208,6 +232,11 @@ public:
 	*/
 	virtual void buildRays(LiDARParameters* LiDARParams, AABB& sceneAABB) = 0;
 
+	/**
+	*	@brief Builds the next batch of rays in main memory with no OpenGL call, as needed by CPU backends.
+	*/
+	void buildRaysCPU(LiDARParameters* LiDARParams, std::vector<Model3D::RayGPUData>& rays);
+
 	/**
 	*	@brief Deletes allocated content.
 	*/
@@ -245,6 +274,16 @@ public:
 	*/
 	void getRaySSBO(GLuint& ssbo, GLuint& size) { ssbo = _parameters->_rayBuffer; size = _parameters->_currentNumRays; }
 
+	/**
+	*	@brief Swaps the ray buffers, so that the next batch is written while the current one is still read by the intersection shaders.
+	*/
+	void swapRayBuffers() { std::swap(_parameters->_rayBuffer, _parameters->_backRayBuffer); }
+
+	/**
+	*	@brief Uploads a batch of rays built in CPU into the ray buffer.
+	*/
+	void uploadRays(const std::vector<Model3D::RayGPUData>& rays);
+
 	/**
 	*	@return AABB offset for paths.
 	*/
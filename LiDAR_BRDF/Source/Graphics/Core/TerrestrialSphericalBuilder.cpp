@@ -12,13 +12,13 @@ void TerrestrialSphericalBuilder::buildRays(LiDARParameters* LiDARParams, AABB&
 {	
 	TLSParameters* parameters = dynamic_cast<TLSParameters*>(_parameters);
 
-	if (LiDARParams->_gpuInstantiation)
+	if (LiDARParams->isGPUInstantiated())
 	{
 		this->buildRaysGPU(parameters, LiDARParams, sceneAABB);
 	}
 	else
 	{
-		this->buildRaysCPU(parameters, LiDARParams, sceneAABB);
+		this->uploadRaysCPU(LiDARParams);
 	}
 }
 
@@ -68,12 +68,12 @@ RayBuilder::TLSParameters* TerrestrialSphericalBuilder::buildParameters(LiDARPar
 	params->_numThreads = params->_numRays;
 	RayBuilder::initializeContext(LiDARParams, params);
 
-	if (LiDARParams->_gpuInstantiation)
+	this->getSensorPosition(params->_channelPosition, params->_numChannels, LiDARParams->_tlsPosition);
+
+	if (LiDARParams->isGPUInstantiated())
 	{
-		std::vector<vec3> channelPosition;
 		std::vector<vec4> channelPositionv4;
-		this->getSensorPosition(channelPosition, params->_numChannels, LiDARParams->_tlsPosition);
-		for (vec3& channelPos : channelPosition) channelPositionv4.push_back(vec4(channelPos, 1.0f));
+		for (vec3& channelPos : params->_channelPosition) channelPositionv4.push_back(vec4(channelPos, 1.0f));
 
 		params->_channelBuffer = ComputeShader::setReadBuffer(channelPositionv4, GL_STATIC_DRAW);
 		params->_vAngleBuffer = ComputeShader::setReadBuffer(params->_verticalAngleIncrement, GL_STATIC_DRAW);
@@ -92,19 +92,19 @@ void TerrestrialSphericalBuilder::buildRaysGPU(TLSParameters* parameters, LiDARP
 		unsigned threadOffset = (parameters->_numRays * LiDARParams->_raysPulse - parameters->_leftRays) / LiDARParams->_raysPulse;
 		parameters->_currentNumRays = std::min(parameters->_allowedRaysIteration, parameters->_leftRays);
 
-		shader->bindBuffers(std::vector<GLuint> { parameters->_channelBuffer, parameters->_rayBuffer, parameters->_noiseBuffer, parameters->_vAngleBuffer });
+		shader->bindBuffers(std::vector<GLuint> { parameters->_channelBuffer, parameters->_rayBuffer, parameters->_vAngleBuffer });
 		shader->use();
 		shader->setUniform("advance", LiDARParams->_tlsDirection / vec3(parameters->_numRays, 1.0f, parameters->_numRays));
 		shader->setUniform("angleJittering", LiDARParams->_tlsAngleJittering);
 		//shader->setUniform("axisJittering", LiDARParams->_tlsAxisJittering);
 		shader->setUniform("fovRadians", parameters->_fovRadians);
 		shader->setUniform("incrementRadians", parameters->_incrementRadians);
-		shader->setUniform("noiseBufferSize", NOISE_BUFFER_SIZE);
 		shader->setUniform("numThreads", parameters->_currentNumRays);
 		shader->setUniform("numChannels", parameters->_numChannels);
 		shader->setUniform("position", LiDARParams->_tlsPosition);
 		shader->setUniform("pulseRadius", LiDARParams->_pulseRadius);
 		shader->setUniform("raysPulse", unsigned(LiDARParams->_raysPulse));
+		shader->setUniform("seed", unsigned(LiDARParams->_randomSeed));
 		shader->setUniform("startRadians", parameters->_startRadians);
 		shader->setUniform("threadOffset", threadOffset);
 		shader->setUniform("timePulse", parameters->_timePulse);
@@ -115,43 +115,37 @@ void TerrestrialSphericalBuilder::buildRaysGPU(TLSParameters* parameters, LiDARP
 	}
 }
 
-void TerrestrialSphericalBuilder::buildRaysCPU(TLSParameters* parameters, LiDARParameters* LiDARParams, AABB& sceneAABB)
+void TerrestrialSphericalBuilder::throwPulses(LiDARParameters* LiDARParams, const unsigned firstPulse, const unsigned numPulses, std::vector<Model3D::RayGPUData>& rays)
 {
-	float horizontalAngle = -parameters->_fovRadians.x / 2.0f + parameters->_startRadians, horizontalTmp;
-	unsigned verticalResChannel = unsigned(std::floor(parameters->_verticalRes / parameters->_numChannels));
-
-	std::vector<Model3D::RayGPUData> rays (LiDARParams->_tlsResolutionHorizontal * parameters->_verticalRes * LiDARParams->_raysPulse);
-	std::vector<vec3> channelPosition;
-	this->getSensorPosition(channelPosition, parameters->_numChannels, LiDARParams->_tlsPosition);
-
-	RandomUtilities::initializeUniformDistribution(-1.0f, 1.0f);
+	TLSParameters* parameters = dynamic_cast<TLSParameters*>(_parameters);
+	const float horizontalAngle = -parameters->_fovRadians.x / 2.0f + parameters->_startRadians;
+	const unsigned verticalResChannel = unsigned(std::floor(parameters->_verticalRes / parameters->_numChannels));
+	const unsigned seed = LiDARParams->_randomSeed;
+	const unsigned numRevolutionPulses = LiDARParams->_tlsResolutionHorizontal * parameters->_verticalRes;
 
+	// Pulses are indexed as in GPU, and random values are keyed by the pulse index, so that rays do not depend on the number of threads nor the size of the batch.
+	// Simulations longer than a revolution repeat the same directions with different noise
 	#pragma omp parallel for
-	for (int horizontalIdx = 0; horizontalIdx < LiDARParams->_tlsResolutionHorizontal; ++horizontalIdx)
+	for (int batchPulseIdx = 0; batchPulseIdx < static_cast<int>(numPulses); ++batchPulseIdx)
 	{
-		for (int verticalIdx = 0; verticalIdx < parameters->_verticalRes; ++verticalIdx)
-		{
-			unsigned channel	= glm::clamp(verticalIdx / verticalResChannel, unsigned(0), parameters->_numChannels - 1);
-			float verticalAngle = parameters->_verticalAngleIncrement[verticalIdx];
-
-			horizontalTmp		= horizontalAngle + parameters->_incrementRadians.x * float(horizontalIdx * parameters->_verticalRes) + parameters->_incrementRadians.x * verticalIdx;
-			vec3 spherePosition = vec3(std::cos(horizontalTmp), 0.0f, -std::sin(horizontalTmp));
-			vec3 rotationAxis	= vec3(spherePosition.z, 0.0f, -spherePosition.x);
-			vec3 noise			= vec3(RandomUtilities::getUniformRandomValue(), RandomUtilities::getUniformRandomValue(), RandomUtilities::getUniformRandomValue()) * LiDARParams->_tlsAxisJittering;
-			mat4 noiseRotation	= (LiDARParams->_tlsAngleJittering > glm::epsilon<float>()/* && LiDARParams->_tlsAxisJittering > glm::epsilon<float>()*/) ? 
-								   glm::rotate(mat4(1.0f), float(RandomUtilities::getUniformRandomValue() * LiDARParams->_tlsAngleJittering), noise) : mat4(1.0f);
-			vec3 destination	= vec3(noiseRotation * glm::rotate(mat4(1.0f), verticalAngle, rotationAxis) * vec4(spherePosition, 1.0f));
-
-			unsigned baseIndex	= horizontalIdx * parameters->_verticalRes * LiDARParams->_raysPulse + verticalIdx * LiDARParams->_raysPulse;
-			rays[baseIndex]		= Model3D::RayGPUData(LiDARParams->_tlsPosition + channelPosition[channel], LiDARParams->_tlsPosition + channelPosition[channel] + destination);
-
-			this->addPulseRadius(rays, baseIndex, parameters->_upVector, LiDARParams->_raysPulse, LiDARParams->_pulseRadius);
-		}
+		const unsigned pulseIdx = firstPulse + batchPulseIdx, revolutionPulseIdx = pulseIdx % numRevolutionPulses;
+		const unsigned horizontalIdx = revolutionPulseIdx / parameters->_verticalRes, verticalIdx = revolutionPulseIdx % parameters->_verticalRes;
+		unsigned channel	= glm::clamp(verticalIdx / verticalResChannel, unsigned(0), parameters->_numChannels - 1);
+		float verticalAngle = parameters->_verticalAngleIncrement[verticalIdx];
+
+		float horizontalTmp	= horizontalAngle + parameters->_incrementRadians.x * float(horizontalIdx * parameters->_verticalRes) + parameters->_incrementRadians.x * verticalIdx;
+		vec3 spherePosition = vec3(std::cos(horizontalTmp), 0.0f, -std::sin(horizontalTmp));
+		vec3 rotationAxis	= vec3(spherePosition.z, 0.0f, -spherePosition.x);
+		vec3 noise			= vec3(getJittering(seed, pulseIdx, AXIS_NOISE_STREAM.x), getJittering(seed, pulseIdx, AXIS_NOISE_STREAM.y), getJittering(seed, pulseIdx, AXIS_NOISE_STREAM.z)) * LiDARParams->_tlsAxisJittering;
+		mat4 noiseRotation	= (LiDARParams->_tlsAngleJittering > glm::epsilon<float>()/* && LiDARParams->_tlsAxisJittering > glm::epsilon<float>()*/) ? 
+							   glm::rotate(mat4(1.0f), getJittering(seed, pulseIdx, ANGLE_NOISE_STREAM) * LiDARParams->_tlsAngleJittering, noise) : mat4(1.0f);
+		vec3 destination	= vec3(noiseRotation * glm::rotate(mat4(1.0f), verticalAngle, rotationAxis) * vec4(spherePosition, 1.0f));
+
+		unsigned baseIndex	= batchPulseIdx * LiDARParams->_raysPulse;
+		rays[baseIndex]		= Model3D::RayGPUData(LiDARParams->_tlsPosition + parameters->_channelPosition[channel], LiDARParams->_tlsPosition + parameters->_channelPosition[channel] + destination);
+
+		this->addPulseRadius(rays, baseIndex, parameters->_upVector, LiDARParams->_raysPulse, LiDARParams->_pulseRadius, pulseIdx, seed);
 	}
-
-	parameters->_currentNumRays = parameters->_numRays * LiDARParams->_raysPulse;
-	parameters->_leftRays = 0;
-	parameters->_rayBuffer = ComputeShader::setReadBuffer(rays, GL_DYNAMIC_DRAW);
 }
 
 void TerrestrialSphericalBuilder::getSensorPosition(std::vector<vec3>& sensor, const unsigned numChannels, const vec3& origin)
@@ -24,9 +24,9 @@ protected:
 	TLSParameters* buildParameters(LiDARParameters* LiDARParams, AABB& sceneAABB);
 	
 	/**
-	*	@brief Builds rays to be launched in GPU.
+	*	@brief Builds a range of pulses in CPU.
 	*/
-	virtual void buildRaysCPU(TLSParameters* parameters, LiDARParameters* LiDARParams, AABB& sceneAABB);
+	virtual void throwPulses(LiDARParameters* LiDARParams, const unsigned firstPulse, const unsigned numPulses, std::vector<Model3D::RayGPUData>& rays);
 	
 	/**
 	*	@brief Builds rays to be launched in GPU.
@@ -3,7 +3,7 @@
 
 /// [Public methods]
 
-VAO::VAO(bool gpuGeometry): _vao(-1), _vbo(RendEnum::numVBOTypes()), _ibo(RendEnum::numIBOTypes())
+VAO::VAO(bool gpuGeometry): _vao(-1), _vbo(RendEnum::numVBOTypes()), _ibo(RendEnum::numIBOTypes()), _vboCapacity(RendEnum::numVBOTypes(), 0), _iboCapacity(RendEnum::numIBOTypes(), 0)
 {
 	// [VAO]
 	glGenVertexArrays(1, &_vao);
@@ -34,6 +34,18 @@ VAO::~VAO()
 	glDeleteVertexArrays(1, &_vao);
 }
 
+void VAO::appendIBOData(const RendEnum::IBOTypes iboType, const GLuint* topologyData, const GLuint offset, const GLuint size)
+{
+	if (!size) return;
+
+	this->reserveBuffer(_ibo[iboType], _iboCapacity[iboType], GLsizeiptr(offset) * sizeof(GLuint), (GLsizeiptr(offset) + size) * sizeof(GLuint));
+
+	// Generic target, so that the element array binding of the currently bound VAO is not modified
+	glBindBuffer(GL_COPY_WRITE_BUFFER, _ibo[iboType]);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, GLintptr(offset) * sizeof(GLuint), GLsizeiptr(size) * sizeof(GLuint), topologyData);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
 void VAO::defineColorTextCoordVBO()
 {
 	glBindVertexArray(_vao);
@@ -161,6 +173,17 @@ void VAO::drawObject(const GLuint openGLPrimitive, const GLuint numVertices, con
 	}
 }
 
+void VAO::drawObject(const RendEnum::IBOTypes iboType, const GLuint openGLPrimitive, const std::vector<GLsizei>& numIndices, const std::vector<const void*>& firstIndex)
+{
+	if (numIndices.empty()) return;
+
+	glBindVertexArray(_vao);
+	{
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo[iboType]);
+		glMultiDrawElements(openGLPrimitive, numIndices.data(), GL_UNSIGNED_INT, firstIndex.data(), GLsizei(numIndices.size()));
+	}
+}
+
 void VAO::setVBOData(const std::vector<Model3D::VertexGPUData>& geometryData, const GLuint changeFrequency)
 {
 	glBindVertexArray(_vao);
@@ -168,6 +191,7 @@ void VAO::setVBOData(const std::vector<Model3D::VertexGPUData>& geometryData, co
 	{
 		glBindBuffer(GL_ARRAY_BUFFER, _vbo[RendEnum::VBO_POSITION]);
 		glBufferData(GL_ARRAY_BUFFER, geometryData.size() * sizeof(Model3D::VertexGPUData), geometryData.data(), changeFrequency);
+		_vboCapacity[RendEnum::VBO_POSITION] = geometryData.size() * sizeof(Model3D::VertexGPUData);
 	}
 }
 
@@ -177,6 +201,7 @@ void VAO::setIBOData(const RendEnum::IBOTypes iboType, const std::vector<GLuint>
 	{
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo[iboType]);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, topologyData.size() * sizeof(GLuint), topologyData.data(), changeFrequency);
+		_iboCapacity[iboType] = topologyData.size() * sizeof(GLuint);
 	}
 }
 
@@ -244,3 +269,36 @@ void VAO::genGPUGeometryVBO()
 	glEnableVertexAttribArray(3);
 	glVertexAttribPointer(3, sizeof(vec3) / sizeof(GLfloat), GL_FLOAT, GL_FALSE, structSize, ((GLubyte*)nullptr + accumSize));
 }
+
+void VAO::reserveBuffer(const GLuint buffer, GLsizeiptr& capacity, const GLsizeiptr usedSize, const GLsizeiptr requiredSize)
+{
+	if (requiredSize <= capacity) return;
+
+	const GLsizeiptr newCapacity = std::max(requiredSize, capacity * 2);			// Geometric growth keeps the amortized cost of appending linear
+	GLuint copyBuffer = 0;
+
+	// Keep the preserved bytes in a temporary buffer while the original one is reallocated
+	if (usedSize > 0)
+	{
+		glGenBuffers(1, &copyBuffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, copyBuffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, usedSize, nullptr, GL_STREAM_COPY);
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedSize);
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, newCapacity, nullptr, GL_DYNAMIC_DRAW);
+
+	if (usedSize > 0)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, copyBuffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedSize);
+		glDeleteBuffers(1, &copyBuffer);
+	}
+
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	capacity = newCapacity;
+}
@@ -20,6 +20,10 @@ protected:
 	std::vector<GLuint> _vbo;								//!< One per defined geometry
 	std::vector<GLuint> _ibo;								//!< One per defined topology
 
+	// [Booked space]
+	std::vector<GLsizeiptr> _vboCapacity;					//!< Bytes allocated for each VBO
+	std::vector<GLsizeiptr> _iboCapacity;					//!< Bytes allocated for each IBO
+
 	int					_vboIndex;							//!< Controls index of next VBO
 
 protected:
@@ -47,6 +51,15 @@ protected:
 	*/
 	void genGPUGeometryVBO();
 
+	/**
+	*	@brief Grows a buffer so that it can hold at least the required number of bytes. Its identifier is preserved, so the VAO layout remains valid.
+	*	@param buffer Identifier of VBO or IBO.
+	*	@param capacity Bytes currently allocated, updated with the new size.
+	*	@param usedSize Bytes which must be kept after growing.
+	*	@param requiredSize Minimum number of bytes of the buffer.
+	*/
+	void reserveBuffer(const GLuint buffer, GLsizeiptr& capacity, const GLsizeiptr usedSize, const GLsizeiptr requiredSize);
+
 public:
 	/**
 	*	@brief Default constructor. Does not book any space in GPU for any geometry / topology.
@@ -68,6 +81,25 @@ public:
 	*/
 	VAO& operator=(const VAO& orig) = delete;
 
+	/**
+	*	@brief Writes data after the first elements of a VBO, growing it geometrically if needed.
+	*	@param vboType VBO to be modified.
+	*	@param geometryData Geometry data to be appended.
+	*	@param offset Number of elements of type T which are already stored and must be preserved.
+	*	@param size Number of elements to be written.
+	*/
+	template<typename T>
+	void appendVBOData(const RendEnum::VBOTypes vboType, const T* geometryData, const GLuint offset, const GLuint size);
+
+	/**
+	*	@brief Writes indices after the first elements of an IBO, growing it geometrically if needed.
+	*	@param iboType IBO to be modified.
+	*	@param topologyData Indices to be appended.
+	*	@param offset Number of indices which are already stored and must be preserved.
+	*	@param size Number of indices to be written.
+	*/
+	void appendIBOData(const RendEnum::IBOTypes iboType, const GLuint* topologyData, const GLuint offset, const GLuint size);
+
 	/**
 	*	@brief Defines the VBO for a texture coordinate.
 	*/
@@ -149,6 +181,15 @@ public:
 	*/
 	void drawObject(const GLuint openGLPrimitive, const GLuint numIndices, const GLuint numObjects);
 
+	/**
+	*	@brief Draws several ranges of an IBO with a single call.
+	*	@param type IBO que debemos utilizar para dibujar el objeto.
+	*	@param openGLPrimitive Primitiva que usaremos al dibujar: GL_POINTS, GL_TRIANGLE_STRIP...
+	*	@param numIndices Number of indices of each range.
+	*	@param firstIndex Offset in bytes of each range within the IBO.
+	*/
+	void drawObject(const RendEnum::IBOTypes iboType, const GLuint openGLPrimitive, const std::vector<GLsizei>& numIndices, const std::vector<const void*>& firstIndex);
+
 	/**
 	*	@brief Sets data in the VBO.
 	*	@param vboType VBO to be modified.
@@ -178,6 +219,18 @@ public:
 	void setIBOData(const RendEnum::IBOTypes iboType, const std::vector<GLuint>& topologyData, const GLuint changeFrequency = GL_STATIC_DRAW);
 };
 
+template<typename T>
+void VAO::appendVBOData(const RendEnum::VBOTypes vboType, const T* geometryData, const GLuint offset, const GLuint size)
+{
+	if (!size) return;
+
+	this->reserveBuffer(_vbo[vboType], _vboCapacity[vboType], GLsizeiptr(offset) * sizeof(T), (GLsizeiptr(offset) + size) * sizeof(T));
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, _vbo[vboType]);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, GLintptr(offset) * sizeof(T), GLsizeiptr(size) * sizeof(T), geometryData);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
 template<typename T>
 void VAO::setVBOData(const RendEnum::VBOTypes vboType, const std::vector<T>& geometryData, const GLuint changeFrequency)
 {
@@ -193,6 +246,7 @@ void VAO::setVBOData(const RendEnum::VBOTypes vboType, const std::vector<T>& geo
 		*	Fourth argument: change frecuency of the specified geometry
 		*/
 		glBufferData(GL_ARRAY_BUFFER, geometryData.size() * sizeof(T), geometryData.data(), changeFrequency);
+		_vboCapacity[vboType] = geometryData.size() * sizeof(T);
 	}
 }
 
@@ -211,5 +265,6 @@ void VAO::setVBOData(const RendEnum::VBOTypes vboType, T* geometryData, const GL
 		*	Fourth argument: change frecuency of the specified geometry
 		*/
 		glBufferData(GL_ARRAY_BUFFER, size * sizeof(T), geometryData, changeFrequency);
+		_vboCapacity[vboType] = size * sizeof(T);
 	}
 }
@@ -0,0 +1,147 @@
+#include "stdafx.h"
+#include "BatchRunner.h"
+
+#include "Graphics/Application/CADScene.h"
+#include "Graphics/Application/Renderer.h"
+#include "Graphics/Core/LiDARSimulation.h"
+#include "Graphics/Core/MaterialDatabase.h"
+#include "Utilities/ChronoUtilities.h"
+#include "Utilities/FileManagement.h"
+
+/// [Protected methods]
+
+BatchRunner::BatchRunner(): Singleton()
+{
+}
+
+bool BatchRunner::readParameters(const std::string& filename, LiDARParameters* LiDARParams, PointCloudParameters* pointCloudParams)
+{
+	typedef std::function<void(const std::vector<float>&, const std::vector<std::string>&)> ParameterSetter;
+
+	auto toVec2 = [](const std::vector<float>& value) { return value.size() >= 2 ? vec2(value[0], value[1]) : vec2(.0f); };
+	auto toVec3 = [](const std::vector<float>& value) { return value.size() >= 3 ? vec3(value[0], value[1], value[2]) : vec3(.0f); };
+
+	const std::unordered_map<std::string, ParameterSetter> parameterSetter = {
+		// [LiDAR]
+		{ "Specifications",			[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_LiDARSpecs = int(value[0]); LiDARParams->buildSpecifications(); } },
+		{ "LiDARType",				[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_LiDARType = int(value[0]); } },
+		{ "Backend",				[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_backend = int(value[0]); } },
+		{ "BVHBuilder",				[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_bvhBuilder = glm::clamp(int(value[0]), 0, LiDARParameters::NUM_BVH_BUILDERS - 1); } },
+		{ "BVHLeafFaces",			[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_bvhLeafFaces = glm::clamp(unsigned(value[0]), LiDARParameters::MIN_BVH_LEAF_FACES, LiDARParameters::MAX_BVH_LEAF_FACES); } },
+		{ "BVHPreSplit",			[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_bvhPreSplit = value[0] != .0f; } },
+		{ "ExportBVHQuality",		[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_exportBVHQuality = value[0] != .0f; } },
+		{ "ReuseRayHits",			[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_reuseRayHits = value[0] != .0f; } },
+		{ "NumExecs",				[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_numExecs = int(value[0]); } },
+		{ "RandomSeed",				[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_randomSeed = int(value[0]); } },
+		{ "Wavelength",				[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_wavelength = ivec2(value[0], value.size() > 1 ? value[1] : value[0]); } },
+		{ "SpectralBatch",			[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_spectralBatch = value[0] != .0f; } },
+		{ "MaxRange",				[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_maxRange = value[0]; } },
+		{ "MaxReturns",				[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_maxReturns = glm::clamp(unsigned(value[0]), LiDARParameters::MIN_NUMBER_OF_RETURNS, LiDARParameters::MAX_NUMBER_OF_RETURNS); } },
+		{ "PeakPower",				[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_peakPower = value[0]; } },
+		{ "PulseRadius",			[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_pulseRadius = value[0]; } },
+		{ "RaysPulse",				[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_raysPulse = int(value[0]); } },
+		{ "SensorDiameter",			[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_sensorDiameter = value[0]; } },
+		{ "ReflectanceWeight",		[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_reflectanceWeight = value[0]; } },
+		{ "IncludeOutliers",		[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_includeOutliers = value[0] != .0f; } },
+		{ "OutlierThreshold",		[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_outlierThreshold = value[0]; } },
+		{ "ShinySurfaceError",		[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_includeShinySurfaceError = value[0] != .0f; } },
+		{ "TerrainInducedError",	[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_includeTerrainInducedError = value[0] != .0f; } },
+
+		// [TLS]
+		{ "TLSPosition",			[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_tlsPosition = toVec3(value); } },
+		{ "TLSFOV",					[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_tlsFOVHorizontal = toVec2(value).x; LiDARParams->_tlsFOVVertical = toVec2(value).y; } },
+		{ "TLSResolution",			[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_tlsResolutionHorizontal = int(toVec2(value).x); LiDARParams->_tlsResolutionVertical = int(toVec2(value).y); } },
+
+		// [ALS]
+		{ "ALSPosition",			[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_alsPosition = toVec3(value); } },
+		{ "ALSFOV",					[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_alsFOVHorizontal = toVec2(value).x; LiDARParams->_alsFOVVertical = toVec2(value).y; } },
+		{ "ALSSpeed",				[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_alsSpeed = value[0]; } },
+		{ "ALSScanFrequency",		[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_alsScanFrequency = int(value[0]); } },
+		{ "ALSPulseFrequency",		[&](const std::vector<float>& value, const std::vector<std::string>&) { LiDARParams->_alsPulseFrequency = int(value[0]); } },
+
+		// [Point cloud]
+		{ "SavePointCloud",			[&](const std::vector<float>& value, const std::vector<std::string>&) { pointCloudParams->_savePointCloud = value[0] != .0f; } },
+		{ "PointCloudFormat",		[&](const std::vector<float>& value, const std::vector<std::string>&) { pointCloudParams->_format = glm::clamp(int(value[0]), 0, PointCloudParameters::NUM_FORMATS - 1); } },
+		{ "OutputFile",				[&](const std::vector<float>&, const std::vector<std::string>& name)
+									{
+										std::strncpy(pointCloudParams->_filenameBuffer, name[1].c_str(), sizeof(pointCloudParams->_filenameBuffer) - 1);
+										pointCloudParams->_filenameBuffer[sizeof(pointCloudParams->_filenameBuffer) - 1] = '\0';
+									} },
+	};
+
+	std::string fileLine;
+	std::vector<float> floatTokens;
+	std::vector<std::string> strTokens;
+
+	std::ifstream fin(filename, std::ios::in);
+	if (!fin.is_open()) return false;
+
+	while (std::getline(fin, fileLine))
+	{
+		FileManagement::clearTokens(strTokens, floatTokens);
+		FileManagement::readTokens(fileLine, ' ', strTokens, floatTokens);
+
+		if (strTokens.empty() || strTokens[0].rfind(Renderer::STR_LINE_COMMENT, 0) == 0) continue;
+
+		auto setterIt = parameterSetter.find(strTokens[0]);
+		const bool isStringParameter = strTokens[0] == "OutputFile";
+
+		if (setterIt == parameterSetter.end() || (isStringParameter && strTokens.size() < 2) || (!isStringParameter && floatTokens.empty()))
+		{
+			std::cout << "Ignored parameter line: " << fileLine << std::endl;
+			continue;
+		}
+
+		setterIt->second(floatTokens, strTokens);
+	}
+
+	fin.close();
+
+	return true;
+}
+
+/// [Public methods]
+
+BatchRunner::~BatchRunner()
+{
+}
+
+bool BatchRunner::load()
+{
+	// Only the state required by simulations; no OpenGL context, framebuffers, SSAO kernels or shadow textures
+	Model3D::HEADLESS = true;
+	MaterialDatabase::getInstance();
+
+	return true;
+}
+
+bool BatchRunner::run(const std::string& sceneName, const std::string& parameterFile)
+{
+	LiDARParameters* LiDARParams = LiDARSimulation::getLiDARParams();
+
+	if (!parameterFile.empty() && !this->readParameters(parameterFile, LiDARParams, LiDARSimulation::getPointCloudParams()))
+	{
+		std::cout << "__ Could not read parameter file " << parameterFile << " __" << std::endl;
+
+		return false;
+	}
+
+	// There is no OpenGL context for compute shaders
+	if (LiDARParams->_backend == LiDARParameters::GPU_BACKEND)
+	{
+		std::cout << "GPU backend is not available in batch simulations; CPU backend is used instead" << std::endl;
+		LiDARParams->_backend = LiDARParameters::CPU_BACKEND;
+	}
+
+	ChronoUtilities::initChrono();
+
+	CADScene::setRootScene(sceneName);
+	_scene.reset(new CADScene());
+	_scene->load();
+
+	std::cout << "Scene loaded in " << ChronoUtilities::getDuration(ChronoUtilities::MILLISECONDS) << " ms" << std::endl;
+
+	_scene->launchSimulation();
+
+	return true;
+}
\ No newline at end of file
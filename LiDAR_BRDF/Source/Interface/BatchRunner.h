@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Graphics/Application/LiDARParameters.h"
+#include "Graphics/Application/LiDARScene.h"
+#include "Graphics/Application/PointCloudParameters.h"
+#include "Utilities/Singleton.h"
+
+/**
+*	@file BatchRunner.h
+*	@authors Alfonso Lpez Ruiz (alr00048@red.ujaen.es)
+*	@date 10/16/2026
+*/
+
+/**
+*	@brief Launches LiDAR simulations without any window, GUI or rendering resource.
+*/
+class BatchRunner: public Singleton<BatchRunner>
+{
+	friend class Singleton<BatchRunner>;
+
+protected:
+	std::unique_ptr<LiDARScene>		_scene;						//!< Scene to be scanned
+
+protected:
+	/**
+	*	@brief Private constructor as this class implement the Singleton pattern.
+	*/
+	BatchRunner();
+
+	/**
+	*	@brief Reads a file with one parameter per line, e.g. "MaxReturns 3". Lines starting with # are ignored.
+	*	@return False if the file could not be opened.
+	*/
+	bool readParameters(const std::string& filename, LiDARParameters* LiDARParams, PointCloudParameters* pointCloudParams);
+
+public:
+	/**
+	*	@brief Destructor.
+	*/
+	virtual ~BatchRunner();
+
+	/**
+	*	@brief Initializes the state required by simulations. No OpenGL context is created, hence simulations run with the CPU backend.
+	*	@return Success of initialization.
+	*/
+	bool load();
+
+	/**
+	*	@brief Loads a scene, applies the parameter file and launches the simulation. Results are written as configured in PointCloudParameters.
+	*	GPU backend and builder are replaced by their CPU counterparts.
+	*	@param sceneName Folder of Assets/Scene where models are located.
+	*	@param parameterFile File with LiDAR and point cloud parameters. Default values are used if empty.
+	*/
+	bool run(const std::string& sceneName, const std::string& parameterFile);
+};
+
@@ -651,6 +651,10 @@ void GUI::showLiDARTabItem()
 			_LiDARParams->buildSpecifications();
 		}
 
+		ImGui::Combo("Intersection Backend", &_LiDARParams->_backend, _LiDARParams->IntersectionBackend_STR, IM_ARRAYSIZE(_LiDARParams->IntersectionBackend_STR));
+		ImGui::SameLine(); this->renderHelpMarker("Compressed BVH nodes are only decoded by the CPU solver, hence they cannot be traversed with compute shaders");
+		ImGui::Checkbox("Reuse Ray Hits", &_LiDARParams->_reuseRayHits);
+
 		ImGui::Checkbox("GPU Instancing", &_LiDARParams->_gpuInstantiation);
 		ImGui::SameLine(0, 20); 
 		ImGui::PushItemWidth(120.0f); 
@@ -659,6 +663,8 @@ void GUI::showLiDARTabItem()
 		ImGui::Checkbox("Omit First Execution", &_LiDARParams->_discardFirstExecution);
 		ImGui::SameLine(0, 20);
 		ImGui::SliderInt("Ray Divisor", &_LiDARParams->_rayDivisor, 1, 20);
+		ImGui::SameLine(0, 20);
+		ImGui::InputInt("Random Seed", &_LiDARParams->_randomSeed);
 		ImGui::PopItemWidth();
 		ImGui::Checkbox("Use Time", &_LiDARParams->_useSimulationTime);
 		ImGui::SameLine(0, 20);
@@ -673,6 +679,7 @@ void GUI::showLiDARTabItem()
 			this->leaveSpace(2);
 
 			ImGui::SliderInt2("Wavelength (nm)", &_LiDARParams->_wavelength[0], 400, 1000);
+			ImGui::Checkbox("Spectral Batch (Trace Once)", &_LiDARParams->_spectralBatch);
 			ImGui::SliderScalar("Pulse Radius (m)", ImGuiDataType_Float, &_LiDARParams->_pulseRadius, &_LiDARParams->MIN_PULSE_RADIUS, &_LiDARParams->MAX_PULSE_RADIUS);
 			ImGui::SliderInt("Rays per Pulse", &_LiDARParams->_raysPulse, _LiDARParams->MIN_RAYS_PULSE, _LiDARParams->MAX_RAYS_PULSE);
 			ImGui::SliderScalar("Peak Power (watts)", ImGuiDataType_Float , &_LiDARParams->_peakPower, &_LiDARParams->MIN_PEAK_POWER, &_LiDARParams->MAX_PEAK_POWER);
@@ -774,6 +781,8 @@ void GUI::showPointCloudSettings()
 	if (ImGui::Begin("Point Cloud File", &_showPointCloudSettings, ImGuiWindowFlags_AlwaysAutoResize))
 	{
 		ImGui::InputText("Filename", _pointCloudParams->_filenameBuffer, IM_ARRAYSIZE(_pointCloudParams->_filenameBuffer));
+		ImGui::Combo("Format", &_pointCloudParams->_format, PointCloudParameters::PointCloudFormat_STR, IM_ARRAYSIZE(PointCloudParameters::PointCloudFormat_STR));
+		this->renderHelpMarker("Extension of the filename is replaced according to the selected format");
 		this->leaveSpace(1);
 		ImGui::Checkbox("Asynchronous Write", &_pointCloudParams->_asynchronousWrite);
 		ImGui::Checkbox("Save Point Cloud", &_pointCloudParams->_savePointCloud);
@@ -0,0 +1,315 @@
+#include "stdafx.h"
+#include "BVHQualityReport.h"
+
+#include "Graphics/Core/LiDARCPUSolver.h"
+#include "Utilities/FileManagement.h"
+
+// [Public methods]
+
+BVHQualityReport::BVHQualityReport():
+	_averageDepth(.0f), _epo(.0f), _maxDepth(0), _numInnerNodes(0), _numInstanceLeaves(0), _numNodes(0), _numPathologicalFaces(0), _predictedStackDepth(0), _sahCost(.0f),
+	_siblingOverlap(.0f), _weightedSiblingOverlap(.0f)
+{
+}
+
+void BVHQualityReport::analyze(Group3D* group)
+{
+	*this = BVHQualityReport();
+
+	// Buffers are retrieved from GPU; the mirror is kept only if it was already requested
+	const bool keepCPUData = group->_staticCPUData != nullptr;
+	Group3D::StaticCPUData* cpuData = group->getStaticCPUData();
+
+	auto releaseCPUData = [&]()
+	{
+		if (!keepCPUData)
+		{
+			delete group->_staticCPUData;
+			group->_staticCPUData = nullptr;
+		}
+	};
+
+	if (!cpuData) return;
+	if (cpuData->_cluster.empty())
+	{
+		releaseCPUData();
+		return;
+	}
+
+	auto surfaceArea = [](const vec3& minPoint, const vec3& maxPoint) -> float
+	{
+		const vec3 size = maxPoint - minPoint;
+		if (size.x < .0f || size.y < .0f || size.z < .0f) return .0f;
+
+		return 2.0f * (size.x * size.y + size.x * size.z + size.y * size.z);
+	};
+
+	const std::vector<Model3D::BVHCluster>& cluster = cpuData->_cluster;
+	const unsigned rootIdx = cluster.size() - 1, numStaticFaces = group->getNumTriangles();
+
+	_numNodes	= cluster.size();
+	_sahCost	= group->computeSAHCost(cluster, cpuData->_instance);
+
+	// First step: height, leaves and sum of leaf depths of every subtree. Children are stored before their parents, and trees of prototypes before the tree of the scene
+	std::vector<unsigned> height(_numNodes, 0), numLeaves(_numNodes, 0), subtreeSize(_numNodes, 1);
+	std::vector<double> depthSum(_numNodes, .0);
+	double siblingOverlapSum = .0, overlapAreaSum = .0, parentAreaSum = .0;
+
+	for (unsigned nodeIdx = 0; nodeIdx < _numNodes; ++nodeIdx)
+	{
+		const Model3D::BVHCluster& node = cluster[nodeIdx];
+
+		if ((node._faceIndex & Group3D::BVH_INSTANCE_FLAG) != 0)
+		{
+			// Traversal goes on with the root of the prototype, one level below the instance leaf
+			const unsigned blasRoot = cpuData->_instance[node._faceIndex & ~Group3D::BVH_INSTANCE_FLAG]._blasRoot;
+
+			height[nodeIdx]		= height[blasRoot] + 1;
+			numLeaves[nodeIdx]	= numLeaves[blasRoot];
+			depthSum[nodeIdx]	= depthSum[blasRoot] + numLeaves[blasRoot];
+			++_numInstanceLeaves;
+		}
+		else if (node._faceIndex != Group3D::BVH_NULL_INDEX)
+		{
+			if (node._numFaces >= _leafSize.size()) _leafSize.resize(node._numFaces + 1, 0);
+
+			numLeaves[nodeIdx] = 1;
+			++_leafSize[node._numFaces];
+		}
+		else
+		{
+			const Model3D::BVHCluster& child1 = cluster[node._prevIndex1], &child2 = cluster[node._prevIndex2];
+			const float parentArea = surfaceArea(node._minPoint, node._maxPoint);
+			const float overlapArea = surfaceArea(glm::max(child1._minPoint, child2._minPoint), glm::min(child1._maxPoint, child2._maxPoint));
+
+			height[nodeIdx]			= glm::max(height[node._prevIndex1], height[node._prevIndex2]) + 1;
+			numLeaves[nodeIdx]		= numLeaves[node._prevIndex1] + numLeaves[node._prevIndex2];
+			depthSum[nodeIdx]		= depthSum[node._prevIndex1] + depthSum[node._prevIndex2] + numLeaves[nodeIdx];
+			subtreeSize[nodeIdx]	= subtreeSize[node._prevIndex1] + subtreeSize[node._prevIndex2] + 1;
+
+			if (parentArea > .0f) siblingOverlapSum += overlapArea / parentArea;
+			overlapAreaSum += overlapArea;
+			parentAreaSum += parentArea;
+			++_numInnerNodes;
+		}
+	}
+
+	// Every inner node pops itself and pushes both children, hence the deepest path may leave one sibling per level in the stack
+	_maxDepth					= height[rootIdx];
+	_averageDepth				= numLeaves[rootIdx] > 0 ? static_cast<float>(depthSum[rootIdx] / numLeaves[rootIdx]) : .0f;
+	_predictedStackDepth		= _maxDepth + 1;
+	_siblingOverlap				= _numInnerNodes > 0 ? static_cast<float>(siblingOverlapSum / _numInnerNodes) : .0f;
+	_weightedSiblingOverlap		= parentAreaSum > .0 ? static_cast<float>(overlapAreaSum / parentAreaSum) : .0f;
+
+	// Second step: leaf of every face and preorder of the tree of the scene, so that a node is an ancestor of a leaf if the preorder of the leaf is within its subtree
+	std::vector<unsigned> faceLeaf(cpuData->_triangleMesh.size(), Group3D::BVH_NULL_INDEX), preorder(_numNodes, 0);
+	std::vector<unsigned> toExplore{ rootIdx };
+	unsigned preorderIdx = 0;
+
+	while (!toExplore.empty())
+	{
+		const unsigned nodeIdx = toExplore.back();
+		const Model3D::BVHCluster& node = cluster[nodeIdx];
+		toExplore.pop_back();
+
+		preorder[nodeIdx] = preorderIdx++;
+
+		if (node._faceIndex == Group3D::BVH_NULL_INDEX)
+		{
+			toExplore.push_back(node._prevIndex2);
+			toExplore.push_back(node._prevIndex1);
+		}
+		else if ((node._faceIndex & Group3D::BVH_INSTANCE_FLAG) == 0)
+		{
+			for (unsigned faceIdx = node._faceIndex; faceIdx < node._faceIndex + node._numFaces; ++faceIdx)
+			{
+				faceLeaf[cpuData->_leafFace[faceIdx]] = nodeIdx;
+			}
+		}
+	}
+
+	// Third step: effective parallel overlap, i.e. area of non-instanced faces within nodes which do not contain them, weighted by the cost of such nodes
+	std::vector<float> faceArea(numStaticFaces);
+	std::vector<unsigned> overlappedNodes(numStaticFaces, 0);
+	double epoSum = .0, faceAreaSum = .0;
+
+	#pragma omp parallel for reduction(+: epoSum, faceAreaSum) schedule(dynamic, 256)
+	for (int faceIdx = 0; faceIdx < static_cast<int>(numStaticFaces); ++faceIdx)
+	{
+		const Model3D::FaceGPUData& face = cpuData->_triangleMesh[faceIdx];
+		const unsigned startIndex = cpuData->_meshData[face._modelCompID]._startIndex;
+		const vec3 vertex[3] = { cpuData->_geometry[startIndex + face._vertices.x]._position, cpuData->_geometry[startIndex + face._vertices.y]._position, cpuData->_geometry[startIndex + face._vertices.z]._position };
+
+		faceArea[faceIdx] = .5f * glm::length(glm::cross(vertex[1] - vertex[0], vertex[2] - vertex[0]));
+		faceAreaSum += faceArea[faceIdx];
+
+		if (faceLeaf[faceIdx] == Group3D::BVH_NULL_INDEX) continue;
+
+		const unsigned leafPreorder = preorder[faceLeaf[faceIdx]];
+		std::vector<unsigned> toVisit{ rootIdx };
+
+		while (!toVisit.empty())
+		{
+			const unsigned nodeIdx = toVisit.back();
+			const Model3D::BVHCluster& node = cluster[nodeIdx];
+			toVisit.pop_back();
+
+			if (glm::any(glm::lessThan(node._maxPoint, face._minPoint)) || glm::any(glm::greaterThan(node._minPoint, face._maxPoint))) continue;
+
+			if (preorder[nodeIdx] > leafPreorder || leafPreorder >= preorder[nodeIdx] + subtreeSize[nodeIdx])
+			{
+				// Descendants are within this node, hence they are not crossed by the face either
+				const float clippedArea = getClippedArea(vertex, node._minPoint, node._maxPoint);
+				if (clippedArea <= .0f) continue;
+
+				const bool isLeaf = node._faceIndex != Group3D::BVH_NULL_INDEX && (node._faceIndex & Group3D::BVH_INSTANCE_FLAG) == 0;
+				epoSum += clippedArea * (isLeaf ? Group3D::BVH_INTERSECTION_COST * node._numFaces : Group3D::BVH_TRAVERSAL_COST);
+				++overlappedNodes[faceIdx];
+			}
+
+			if (node._faceIndex == Group3D::BVH_NULL_INDEX)
+			{
+				toVisit.push_back(node._prevIndex1);
+				toVisit.push_back(node._prevIndex2);
+			}
+		}
+	}
+
+	_epo = faceAreaSum > .0 ? static_cast<float>(epoSum / faceAreaSum) : .0f;
+
+	// Fourth step: faces whose box is huge or mostly empty, sorted by the number of nodes they inflate
+	const float rootArea = surfaceArea(cluster[rootIdx]._minPoint, cluster[rootIdx]._maxPoint);
+
+	for (unsigned faceIdx = 0; faceIdx < numStaticFaces; ++faceIdx)
+	{
+		const Model3D::FaceGPUData& face = cpuData->_triangleMesh[faceIdx];
+		const float boxArea = surfaceArea(face._minPoint, face._maxPoint);
+
+		PathologicalFace pathologicalFace;
+		pathologicalFace._faceIndex			= faceIdx;
+		pathologicalFace._modelCompID		= face._modelCompID;
+		pathologicalFace._areaRatio			= rootArea > .0f ? boxArea / rootArea : .0f;
+		pathologicalFace._fillRatio			= boxArea > .0f ? faceArea[faceIdx] / boxArea : 1.0f;
+		pathologicalFace._overlappedNodes	= overlappedNodes[faceIdx];
+
+		if (pathologicalFace._areaRatio > HUGE_FACE_AREA || pathologicalFace._fillRatio < SLIVER_FACE_RATIO)
+		{
+			_pathologicalFaces.push_back(pathologicalFace);
+		}
+	}
+
+	_numPathologicalFaces = _pathologicalFaces.size();
+
+	const unsigned numReportedFaces = glm::min(_numPathologicalFaces, MAX_PATHOLOGICAL_FACES);
+	std::partial_sort(_pathologicalFaces.begin(), _pathologicalFaces.begin() + numReportedFaces, _pathologicalFaces.end(), [](const PathologicalFace& face1, const PathologicalFace& face2)
+	{
+		return face1._overlappedNodes > face2._overlappedNodes || (face1._overlappedNodes == face2._overlappedNodes && face1._areaRatio > face2._areaRatio);
+	});
+	_pathologicalFaces.resize(numReportedFaces);
+
+	for (PathologicalFace& pathologicalFace : _pathologicalFaces)
+	{
+		pathologicalFace._modelCompName = group->getModelComponent(pathologicalFace._modelCompID)->_name;
+	}
+
+	releaseCPUData();
+}
+
+bool BVHQualityReport::exportJSON(const std::string& filename)
+{
+	auto escape = [](const std::string& text) -> std::string
+	{
+		std::string escapedText;
+
+		for (const char character : text)
+		{
+			if (character == '"' || character == '\\') escapedText += '\\';
+			escapedText += character;
+		}
+
+		return escapedText;
+	};
+
+	std::stringstream json;
+
+	json << "{\n";
+	json << "\t\"nodes\": " << _numNodes << ",\n";
+	json << "\t\"innerNodes\": " << _numInnerNodes << ",\n";
+	json << "\t\"instanceLeaves\": " << _numInstanceLeaves << ",\n";
+	json << "\t\"sahCost\": " << _sahCost << ",\n";
+	json << "\t\"epo\": " << _epo << ",\n";
+	json << "\t\"maxDepth\": " << _maxDepth << ",\n";
+	json << "\t\"averageDepth\": " << _averageDepth << ",\n";
+	json << "\t\"siblingOverlap\": " << _siblingOverlap << ",\n";
+	json << "\t\"weightedSiblingOverlap\": " << _weightedSiblingOverlap << ",\n";
+	json << "\t\"predictedStackDepth\": " << _predictedStackDepth << ",\n";
+	json << "\t\"stackSize\": " << LiDARCPUSolver::BVH_STACK_SIZE << ",\n";
+	json << "\t\"stackOverflow\": " << (_predictedStackDepth > LiDARCPUSolver::BVH_STACK_SIZE ? "true" : "false") << ",\n";
+
+	// Index of every count is the number of faces of the leaves
+	json << "\t\"leafSize\": [";
+	for (unsigned numFaces = 0; numFaces < _leafSize.size(); ++numFaces)
+	{
+		json << (numFaces > 0 ? ", " : "") << _leafSize[numFaces];
+	}
+	json << "],\n";
+
+	json << "\t\"pathologicalFaces\": " << _numPathologicalFaces << ",\n";
+	json << "\t\"worstFaces\": [";
+	for (unsigned faceIdx = 0; faceIdx < _pathologicalFaces.size(); ++faceIdx)
+	{
+		const PathologicalFace& face = _pathologicalFaces[faceIdx];
+
+		json << (faceIdx > 0 ? "," : "") << "\n\t\t{ ";
+		json << "\"face\": " << face._faceIndex << ", ";
+		json << "\"modelComponent\": " << face._modelCompID << ", ";
+		json << "\"name\": \"" << escape(face._modelCompName) << "\", ";
+		json << "\"reason\": \"" << (face._areaRatio > HUGE_FACE_AREA ? "huge" : "sliver") << "\", ";
+		json << "\"areaRatio\": " << face._areaRatio << ", ";
+		json << "\"fillRatio\": " << face._fillRatio << ", ";
+		json << "\"overlappedNodes\": " << face._overlappedNodes << " }";
+	}
+	json << (_pathologicalFaces.empty() ? "" : "\n\t") << "]\n";
+	json << "}\n";
+
+	return FileManagement::writeString(filename, json.str());
+}
+
+// [Protected methods]
+
+float BVHQualityReport::getClippedArea(const vec3* vertex, const vec3& minPoint, const vec3& maxPoint)
+{
+	// Sutherland-Hodgman clipping against the six planes of the box, which leaves up to nine vertices
+	std::vector<vec3> polygon(vertex, vertex + 3), clippedPolygon;
+
+	for (int axis = 0; axis < 3 && !polygon.empty(); ++axis)
+	{
+		for (int side = 0; side < 2 && !polygon.empty(); ++side)
+		{
+			const float plane = side == 0 ? minPoint[axis] : maxPoint[axis], sign = side == 0 ? 1.0f : -1.0f;
+			clippedPolygon.clear();
+
+			for (unsigned vertexIdx = 0; vertexIdx < polygon.size(); ++vertexIdx)
+			{
+				const vec3& current = polygon[vertexIdx], &next = polygon[(vertexIdx + 1) % polygon.size()];
+				const float currentDistance = sign * (current[axis] - plane), nextDistance = sign * (next[axis] - plane);
+
+				if (currentDistance >= .0f) clippedPolygon.push_back(current);
+				if ((currentDistance >= .0f) != (nextDistance >= .0f))
+				{
+					clippedPolygon.push_back(current + (next - current) * (currentDistance / (currentDistance - nextDistance)));
+				}
+			}
+
+			polygon.swap(clippedPolygon);
+		}
+	}
+
+	vec3 areaVector(.0f);
+	for (unsigned vertexIdx = 1; vertexIdx + 1 < polygon.size(); ++vertexIdx)
+	{
+		areaVector += glm::cross(polygon[vertexIdx] - polygon[0], polygon[vertexIdx + 1] - polygon[0]);
+	}
+
+	return .5f * glm::length(areaVector);
+}
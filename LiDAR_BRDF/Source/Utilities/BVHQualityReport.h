@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Graphics/Core/Group3D.h"
+
+/**
+*	@file BVHQualityReport.h
+*	@authors Alfonso Lpez Ruiz (alr00048@red.ujaen.es)
+*	@date 16/10/2026
+*/
+
+/**
+*	@brief Quality metrics of the BVH of a group, so that builders and assets can be compared by the tree they produce rather than by response times.
+*/
+class BVHQualityReport
+{
+public:
+	/**
+	*	@brief Face whose boundaries are likely to inflate the nodes it crosses.
+	*/
+	struct PathologicalFace
+	{
+		unsigned		_faceIndex;								//!< Index within the topology buffer
+		unsigned		_modelCompID;							//!< Model component where the face belongs to
+		std::string		_modelCompName;							//!<
+		float			_areaRatio;								//!< Surface area of the face box relative to the one of the root
+		float			_fillRatio;								//!< Area of the face relative to the surface area of its box, i.e. near zero for slivers
+		unsigned		_overlappedNodes;						//!< Nodes which intersect the face though they do not contain it
+	};
+
+protected:
+	const static inline std::string BVH_QUALITY_FILENAME = "Results/BVHQuality.json";
+	const static inline float		HUGE_FACE_AREA = 0.01f;		//!< Ratio of the root area from which a face is considered huge
+	const static inline unsigned	MAX_PATHOLOGICAL_FACES = 32;	//!< Faces which are reported, sorted by the number of nodes they overlap
+	const static inline float		SLIVER_FACE_RATIO = 0.01f;	//!< Fill ratio below which a face is considered a sliver
+
+	float							_averageDepth;				//!< Average depth of leaves, where instance leaves are expanded into the tree of their prototype
+	float							_epo;						//!< Effective parallel overlap of non-instanced faces
+	std::vector<unsigned>			_leafSize;					//!< Number of leaves per number of faces
+	unsigned						_maxDepth;					//!< Depth of the deepest leaf
+	unsigned						_numInnerNodes;				//!<
+	unsigned						_numInstanceLeaves;			//!<
+	unsigned						_numNodes;					//!<
+	unsigned						_numPathologicalFaces;		//!< Faces flagged as huge or slivers, including those which are not reported
+	std::vector<PathologicalFace>	_pathologicalFaces;			//!< Worst flagged faces
+	unsigned						_predictedStackDepth;		//!< Worst-case length of the traversal stack
+	float							_sahCost;					//!< Surface area heuristic cost, relative to the area of the root
+	float							_siblingOverlap;			//!< Average surface area of the overlap of siblings, relative to the one of their parent
+	float							_weightedSiblingOverlap;	//!< Overlap of siblings over every inner node, weighted by the area of their parent
+
+protected:
+	/**
+	*	@return Area of the polygon which results from clipping a triangle with a box.
+	*/
+	static float getClippedArea(const vec3* vertex, const vec3& minPoint, const vec3& maxPoint);
+
+public:
+	/**
+	*	@brief Constructor.
+	*/
+	BVHQualityReport();
+
+	/**
+	*	@brief Computes every metric from the binary BVH of a group, which is read from GPU if it was not mirrored yet.
+	*/
+	void analyze(Group3D* group);
+
+	/**
+	*	@brief Exports the metrics as a JSON file.
+	*/
+	bool exportJSON(const std::string& filename = BVH_QUALITY_FILENAME);
+};
+
@@ -24,7 +24,7 @@ namespace ChronoUtilities
 	//!< Private members
 	namespace
 	{
-		std::chrono::high_resolution_clock::time_point _initTime;
+		thread_local std::chrono::high_resolution_clock::time_point _initTime;		// One clock per thread, so that concurrent stages can be measured
 	}
 
 	/**
@@ -0,0 +1,90 @@
+#include "stdafx.h"
+#include "MemoryMappedFile.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// [Public methods]
+
+MemoryMappedFile::MemoryMappedFile() : _data(nullptr), _fileHandle(nullptr), _mappingHandle(nullptr), _size(0)
+{
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+	this->close();
+}
+
+void MemoryMappedFile::close()
+{
+#ifdef _WIN32
+	if (_data) UnmapViewOfFile(_data);
+	if (_mappingHandle) CloseHandle(_mappingHandle);
+	if (_fileHandle) CloseHandle(_fileHandle);
+#else
+	if (_data) munmap(const_cast<char*>(_data), _size);
+	if (_fileHandle) ::close(int(reinterpret_cast<intptr_t>(_fileHandle)) - 1);
+#endif
+
+	_data = nullptr;
+	_fileHandle = _mappingHandle = nullptr;
+	_size = 0;
+}
+
+bool MemoryMappedFile::open(const std::string& filename)
+{
+	this->close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	_fileHandle = file;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		this->close();
+		return false;
+	}
+
+	_mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!_mappingHandle)
+	{
+		this->close();
+		return false;
+	}
+
+	_data = static_cast<const char*>(MapViewOfFile(_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	_size = size_t(fileSize.QuadPart);
+#else
+	const int file = ::open(filename.c_str(), O_RDONLY);
+	if (file < 0) return false;
+	_fileHandle = reinterpret_cast<void*>(intptr_t(file) + 1);				// Null handle stands for no file
+
+	struct stat fileStat;
+	if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		this->close();
+		return false;
+	}
+
+	void* data = mmap(nullptr, size_t(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	_data = data == MAP_FAILED ? nullptr : static_cast<const char*>(data);
+	_size = size_t(fileStat.st_size);
+#endif
+
+	if (!_data)
+	{
+		this->close();
+		return false;
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+/**
+*	@file MemoryMappedFile.h
+*	@authors Alfonso Lpez Ruiz (alr00048@red.ujaen.es)
+*	@date 10/16/2026
+*/
+
+/**
+*	@brief Read-only view of a file mapped into memory. Pages are loaded on demand from the page cache, so no intermediate buffer is needed.
+*/
+class MemoryMappedFile
+{
+protected:
+	const char*			_data;					//!< First byte of the view
+	void*				_fileHandle;			//!< Handle of the opened file
+	void*				_mappingHandle;			//!< Handle of the file mapping
+	size_t				_size;					//!< Size of the file in bytes
+
+public:
+	/**
+	*	@brief Default constructor. No file is mapped.
+	*/
+	MemoryMappedFile();
+
+	/**
+	*	@brief Unsupported copy constructor.
+	*/
+	MemoryMappedFile(const MemoryMappedFile& orig) = delete;
+
+	/**
+	*	@brief Destructor. Unmaps the file, if any.
+	*/
+	virtual ~MemoryMappedFile();
+
+	/**
+	*	@brief Unmaps the current file.
+	*/
+	void close();
+
+	/**
+	*	@brief Maps a whole file as read-only.
+	*	@return False if the file could not be opened or is empty.
+	*/
+	bool open(const std::string& filename);
+
+	/**
+	*	@brief Unsupported assignment operator.
+	*/
+	MemoryMappedFile& operator=(const MemoryMappedFile& orig) = delete;
+
+	// ---------- Getters -----------
+
+	/**
+	*	@return Pointer to the first byte of the file.
+	*/
+	const char* data() const { return _data; }
+
+	/**
+	*	@return Size of the file in bytes.
+	*/
+	size_t size() const { return _size; }
+};
+
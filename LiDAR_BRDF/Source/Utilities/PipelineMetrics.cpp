@@ -6,7 +6,7 @@
 
 // [Public methods]
 
-PipelineMetrics::PipelineMetrics(): _numCollisions(0)
+PipelineMetrics::PipelineMetrics(): _nodeVisits(0), _numCollisions(0), _openGLSync(true), _tracedRays(0), _wallTime(0)
 {
 	for (int stageIdx = 0; stageIdx < NUM_STAGES; ++stageIdx)
 	{
@@ -21,6 +21,10 @@ void PipelineMetrics::add(const PipelineMetrics& measurements)
 		_stageTime[stageIdx] += measurements._stageTime[stageIdx];
 	}
 
+	_nodeVisits += measurements._nodeVisits;
+	_tracedRays += measurements._tracedRays;
+	_wallTime += measurements._wallTime;
+
 	this->addFrame(measurements);
 }
 
@@ -62,6 +66,8 @@ void PipelineMetrics::divide(float division)
 	{
 		_stageTime[stageIdx] /= division;
 	}
+
+	_tracedRays /= division;
 }
 
 void PipelineMetrics::exportCollisionClass()
@@ -150,7 +156,7 @@ long long PipelineMetrics::getGlobalTime(PipelineMetrics::LiDARStage stageInit,
 {
 	long long globalTime = 0;
 
-	for (int stageIdx = stageInit; stageIdx <= glm::min(int(stageFinal), int(WRITE)); ++stageIdx)
+	for (int stageIdx = stageInit; stageIdx <= glm::min(int(stageFinal), int(NUM_STAGES) - 1); ++stageIdx)
 	{
 		globalTime += _stageTime[stageIdx];
 	}
@@ -175,7 +181,7 @@ float PipelineMetrics::getStd(PipelineMetrics::LiDARStage initStage, PipelineMet
 void PipelineMetrics::measureStage(LiDARStage stage, ChronoUtilities::TimeUnit unit)
 {
 #if STOP_OPENGL_PIPELINE
-	glFinish();
+	if (_openGLSync) glFinish();
 #endif
 
 #if ENABLE_INIT_CHRONO 
@@ -192,6 +198,23 @@ std::ostream& operator<<(std::ostream& os, const PipelineMetrics& pm)
 		os << PipelineMetrics::STAGE_TITLE[stageIdx] << ": " << float(pm._stageTime[stageIdx]) / globalTime << " | " << float(pm._stageTime[stageIdx]) / float(pm._frameResponseTime.size()) << " +- " << pm.getStd(static_cast<PipelineMetrics::LiDARStage>(stageIdx), (static_cast<PipelineMetrics::LiDARStage>(stageIdx))) << "\n";
 	}
 
+#if COUNT_BVH_NODE_VISITS
+	os << "BVH Node Visits: " << pm._nodeVisits << "\n";
+#endif
+
+	if (pm._tracedRays > 0)
+	{
+		// Rays per microsecond are millions of rays per second
+		os << "Find Collision Throughput: " << float(pm._tracedRays) / glm::max(float(pm._stageTime[PipelineMetrics::FIND_COLLISION]), 1.0f) << " Mrays/s\n";
+	}
+
+	if (pm._wallTime > 0)
+	{
+		// Stages of consecutive batches run concurrently, hence their sum exceeds the elapsed time
+		const long long stageTime = pm.getGlobalTime(PipelineMetrics::RAY_BUILDING, PipelineMetrics::INGESTION);
+		os << "Wall Time: " << pm._wallTime / 1000.0f << " ms | Sum of Stages: " << stageTime / 1000.0f << " ms | Overlap: " << 1.0f - float(pm._wallTime) / glm::max(float(stageTime), 1.0f) << "\n";
+	}
+
 	return os;
 }
 
@@ -9,6 +9,7 @@
 *	@date 31/01/2022
 */
 
+#define COUNT_BVH_NODE_VISITS false
 #define ENABLE_INIT_CHRONO true
 #define STOP_OPENGL_PIPELINE true
 #define USE_MATERIAL_NAME true
@@ -21,21 +22,25 @@ class PipelineMetrics
 public:
 	enum LiDARStage
 	{
-		PREPARE_ATTRIBUTES, RAY_BUILDING, PREPARE, FIND_COLLISION, REDUCE, INTENSITY, OUTLIERS, RETURNS, READ, WRITE, NUM_STAGES
+		PREPARE_ATTRIBUTES, RAY_BUILDING, PREPARE, FIND_COLLISION, REDUCE, INTENSITY, OUTLIERS, RETURNS, READ, WRITE, INGESTION, NUM_STAGES
 	};
 
 protected:
 	const static inline std::string CLASS_COUNT_FILENAME = "Results/ClassCount.txt";
 	const static inline std::string FRAME_COLLISION_FILENAME = "Results/FrameCollisions.txt";
 	const static inline std::string FRAME_RESPONSE_TIME_FILENAME = "Results/frame_time.txt";
-	const static inline std::string STAGE_TITLE[NUM_STAGES] = { "Prepare Attributes", "Ray Building", "Prepare", "Find Collision", "Reduce", "Intensity", "Outliers", "Returns", "Read", "Write" };
+	const static inline std::string STAGE_TITLE[NUM_STAGES] = { "Prepare Attributes", "Ray Building", "Prepare", "Find Collision", "Reduce", "Intensity", "Outliers", "Returns", "Read", "Write", "Ingestion" };
 
 	std::map<std::string, unsigned>			_classCount;					//!<
 	std::vector<long>						_frameCollisions;				//!<
 	std::vector<long long>					_frameResponseTime;				//!<
 	std::vector<PipelineMetrics>			_frameMetrics;					//!<
+	unsigned long long						_nodeVisits;					//!< BVH nodes visited during the collision search
 	long									_numCollisions;					//!<
+	bool									_openGLSync;					//!< OpenGL pipeline is finished before measuring a stage
 	long long								_stageTime[NUM_STAGES];			//!< Time recorded per stage
+	unsigned long long						_tracedRays;					//!< Rays launched into the collision search, so that its throughput can be reported
+	long long								_wallTime;						//!< Elapsed time of pipelined stages. Lower than the sum of stages if they overlap
 
 protected:
 	/**
@@ -64,6 +69,26 @@ public:
 	*/
 	void addCollisions(std::vector<Model3D::TriangleCollisionGPUData>* collisions, Group3D* scene);
 
+	/**
+	*	@brief Accumulates the number of BVH nodes visited by a traversal.
+	*/
+	void addNodeVisits(unsigned long long nodeVisits) { _nodeVisits += nodeVisits; }
+
+	/**
+	*	@brief Accumulates the number of rays launched into a BVH traversal.
+	*/
+	void addTracedRays(unsigned long long numRays) { _tracedRays += numRays; }
+
+	/**
+	*	@brief Accumulates time of a stage which was measured elsewhere, e.g. in a worker thread.
+	*/
+	void addStageTime(LiDARStage stage, long long time) { _stageTime[stage] += time; }
+
+	/**
+	*	@brief Accumulates the elapsed time of a pipelined execution.
+	*/
+	void addWallTime(long long time) { _wallTime += time; }
+
 	/**
 	*	@brief Clears current storage concerning class count.
 	*/
@@ -94,6 +119,11 @@ public:
 	*/
 	long long getGlobalTime(PipelineMetrics::LiDARStage stageInit = PipelineMetrics::PREPARE_ATTRIBUTES, PipelineMetrics::LiDARStage stageFinal = PipelineMetrics::WRITE) const;
 
+	/**
+	*	@return Number of BVH nodes visited during the collision search.
+	*/
+	unsigned long long getNodeVisits() const { return _nodeVisits; }
+
 	/**
 	*	@return Response time for an specific stage.
 	*/
@@ -118,6 +148,11 @@ public:
 	*/
 	void measureStage(LiDARStage stage, ChronoUtilities::TimeUnit unit = ChronoUtilities::MICROSECONDS);
 
+	/**
+	*	@brief Enables or disables finishing the OpenGL pipeline before measuring. It must be disabled for stages measured in threads without an OpenGL context.
+	*/
+	void setOpenGLSync(bool sync) { _openGLSync = sync; }
+
 	/**
 	*	@brief Overriding console message.
 	*/
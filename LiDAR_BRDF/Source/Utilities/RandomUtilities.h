@@ -24,6 +24,18 @@ namespace RandomUtilities
 		DoubleUniformDistribution	_uniformDistribution;
 	}
 
+	const uint32_t	PHILOX_MULTIPLIER = 0xD256D193;		//!< Multiplier of Philox2x32 rounds
+	const uint32_t	PHILOX_WEYL = 0x9E3779B9;			//!< Key increment of Philox2x32 rounds
+	const int		PHILOX_ROUNDS = 10;					//!< Number of bijective rounds
+
+	/**
+	*	@return Uniform value in [0, 1) given by a stateless counter-based generator. Same values are drawn by getCounterRandomValue in random.glsl.
+	*	@param seed Key of the generator.
+	*	@param index Element (e.g. ray or collision) which requests the value.
+	*	@param stream Identifier of the random variable, so that several uncorrelated values are drawn for the same element.
+	*/
+	float getCounterRandomValue(const uint32_t seed, const uint32_t index, const uint32_t stream);
+
 	/**
 	*	@return New random value retrieved from a random uniform distribution.
 	*/
@@ -33,6 +45,16 @@ namespace RandomUtilities
 	*	@brief Initializes the uniform distribution so that it gets a new seed and range.
 	*/
 	void initializeUniformDistribution(const float min, const float max);
+
+	/**
+	*	@brief Philox2x32-10 block function, which scrambles a 64-bit counter with a 32-bit key.
+	*/
+	uvec2 philox(uvec2 counter, uint32_t key);
+}
+
+inline float RandomUtilities::getCounterRandomValue(const uint32_t seed, const uint32_t index, const uint32_t stream)
+{
+	return (philox(uvec2(index, stream), seed).x >> 8) * (1.0f / 16777216.0f);
 }
 
 inline double RandomUtilities::getUniformRandomValue()
@@ -48,3 +70,15 @@ inline void RandomUtilities::initializeUniformDistribution(const float min, cons
 	_uniformDistribution = std::uniform_real_distribution<double>(min, max);
 	_randomNumberGenerator.seed(seedSeq);
 }
+
+inline uvec2 RandomUtilities::philox(uvec2 counter, uint32_t key)
+{
+	for (int round = 0; round < PHILOX_ROUNDS; ++round)
+	{
+		const uint64_t product = static_cast<uint64_t>(PHILOX_MULTIPLIER) * counter.x;
+		counter = uvec2(static_cast<uint32_t>(product >> 32) ^ key ^ counter.y, static_cast<uint32_t>(product));
+		key += PHILOX_WEYL;
+	}
+
+	return counter;
+}
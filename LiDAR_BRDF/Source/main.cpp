@@ -1,11 +1,15 @@
 #include "stdafx.h"
+#include "Interface/BatchRunner.h"
 #include "Interface/Window.h"
+
+#ifdef _WIN32
 #include <windows.h>						// DWORD is undefined otherwise
 
 // Laptop support. Use NVIDIA graphic card instead of Intel
 extern "C" {
 	_declspec(dllexport) DWORD NvOptimusEnablement = 0x00000001;
 }
+#endif
 
 static void glfw_error_callback(int error, const char* description)
 {
@@ -19,6 +23,27 @@ int main(int argc, char *argv[])
 	
 	std::cout << "__ Starting LiDAR Simulator __" << std::endl;
 
+#if HEADLESS_SIMULATION
+	// Usage: LiDAR_BRDF_Batch <scene folder> [parameter file]
+	if (argc < 2)
+	{
+		std::cout << "Usage: " << argv[0] << " <scene folder> [parameter file]" << std::endl;
+		return 1;
+	}
+
+	const auto batchRunner = BatchRunner::getInstance();
+
+	if (!batchRunner->load())
+	{
+		std::cout << "__ Failed to initialize batch runner __" << std::endl;
+		return 1;
+	}
+
+	const bool success = batchRunner->run(argv[1], argc >= 3 ? argv[2] : "");
+	std::cout << "__ Finishing LiDAR Simulator __" << std::endl;
+
+	return success ? 0 : 1;
+#else
 	const std::string title = "LiDAR Simulator";
 	const uint16_t width = 1050, height = 650;
 	const auto window = Window::getInstance();
@@ -39,4 +64,5 @@ int main(int argc, char *argv[])
 	system("pause");
 
 	return 0;
+#endif
 }